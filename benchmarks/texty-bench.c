@@ -0,0 +1,263 @@
+/* texty-bench.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Measures how fast the core handles a generated corpus of the size asked
+ * for, and prints the result as one line of JSON:
+ *
+ *   texty-bench open --size=64
+ *   {"benchmark": "open", "bytes": 67108864, "runs": 3, "best_seconds": ..., "mib_per_s": ...}
+ *
+ * Runs are repeated until a second has gone by, at least three times,
+ * and the best one counts, being the least disturbed by the rest of the
+ * machine. Files are read back from the page cache.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+
+#include "texty-batch.h"
+#include "texty-file-loader.h"
+#include "texty-file-saver.h"
+#include "texty-grep.h"
+#include "texty-line-ending.h"
+
+#define MIN_RUNS 3
+#define MIN_TOTAL_USEC G_USEC_PER_SEC
+/* one line in this many holds the word that is searched for */
+#define NEEDLE_EVERY 40
+#define NEEDLE "texty"
+
+typedef struct
+{
+  GBytes *corpus;
+  GFile *file;
+} Bench;
+
+typedef gboolean (*BenchFunc) (Bench *bench,
+                               GError **error);
+
+static const char *words[] = {
+  "the", "buffer", "line", "ending", "window", "file", "save", "open",
+  "search", "replace", "performance", "regression", "café", "naïve",
+  "日本語", "текст", "λόγος", "x", "0x7f", "{", "}", "=", "->", "//",
+};
+
+/* lines of mixed ASCII and UTF-8 words, the same every time for a size */
+static GBytes *
+generate_corpus (gsize size)
+{
+  g_autoptr (GRand) rand = g_rand_new_with_seed (42);
+  GString *text = g_string_sized_new (size + 256);
+  gsize line = 0;
+
+  while (text->len < size)
+    {
+      int n_words = g_rand_int_range (rand, 2, 20);
+
+      if (line++ % NEEDLE_EVERY == 0)
+        g_string_append (text, NEEDLE " ");
+      for (int i = 0; i < n_words; i++)
+        {
+          g_string_append (text, words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))]);
+          g_string_append_c (text, i + 1 < n_words ? ' ' : '\n');
+        }
+    }
+
+  /* cut back to a whole line */
+  while (text->len > size && text->len > 0)
+    {
+      gsize end = text->len - 1;
+
+      while (end > 0 && text->str[end - 1] != '\n')
+        end--;
+      g_string_truncate (text, end);
+    }
+
+  return g_string_free_to_bytes (text);
+}
+
+static gboolean
+bench_open (Bench *bench,
+            GError **error)
+{
+  g_autoptr (GBytes) bytes = NULL;
+
+  bytes = texty_file_load (bench->file, G_MAXSIZE, NULL, NULL, NULL, error);
+  return bytes != NULL;
+}
+
+static gboolean
+bench_save (Bench *bench,
+            GError **error)
+{
+  return texty_file_save (bench->file,
+                          bench->corpus,
+                          TEXTY_LINE_ENDING_LF,
+                          TEXTY_COMPRESSION_NONE,
+                          NULL,
+                          0,
+                          NULL,
+                          error);
+}
+
+static gboolean
+bench_validate (Bench *bench,
+                GError **error)
+{
+  if (!texty_file_validate_utf8 (bench->corpus, NULL))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "The corpus is not UTF-8");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+bench_search (Bench *bench,
+              GError **error)
+{
+  g_autoptr (TextyGrepModel) model = NULL;
+
+  model = texty_grep (bench->corpus, NEEDLE, 0, NULL, NULL, error);
+  return model != NULL;
+}
+
+static gboolean
+bench_replace (Bench *bench,
+               GError **error)
+{
+  g_autoptr (GRegex) regex = NULL;
+  g_autoptr (GBytes) replaced = NULL;
+
+  regex = g_regex_new (NEEDLE, G_REGEX_OPTIMIZE | G_REGEX_MULTILINE, 0, error);
+  if (regex == NULL)
+    return FALSE;
+
+  replaced = texty_batch_replace (regex, bench->corpus, "TEXTY", error);
+  return replaced != NULL;
+}
+
+static const struct
+{
+  const char *name;
+  BenchFunc func;
+} benchmarks[] = {
+  { "open", bench_open },
+  { "save", bench_save },
+  { "validate", bench_validate },
+  { "search", bench_search },
+  { "replace", bench_replace },
+};
+
+int
+main (int argc,
+      char *argv[])
+{
+  g_autoptr (GOptionContext) context = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree char *dir = NULL;
+  g_autofree char *path = NULL;
+  BenchFunc func = NULL;
+  Bench bench = { 0 };
+  int size_mb = 16;
+  gint64 best = G_MAXINT64;
+  gint64 total = 0;
+  int runs = 0;
+  const GOptionEntry entries[] = {
+    { "size", 's', 0, G_OPTION_ARG_INT, &size_mb, "Size of the corpus in MiB", "MIB" },
+    { NULL }
+  };
+
+  context = g_option_context_new ("open|save|validate|search|replace");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("texty-bench: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  for (guint i = 0; argc == 2 && i < G_N_ELEMENTS (benchmarks); i++)
+    if (g_str_equal (argv[1], benchmarks[i].name))
+      func = benchmarks[i].func;
+  if (func == NULL || size_mb <= 0)
+    {
+      g_printerr ("texty-bench: give one of open, save, validate, search or replace, and a size\n");
+      return EXIT_FAILURE;
+    }
+
+  bench.corpus = generate_corpus ((gsize) size_mb * 1024 * 1024);
+
+  /* open reads back what save wrote, both on a scratch file */
+  dir = g_dir_make_tmp ("texty-bench-XXXXXX", &error);
+  if (dir == NULL)
+    {
+      g_printerr ("texty-bench: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  path = g_build_filename (dir, "corpus.txt", NULL);
+  bench.file = g_file_new_for_path (path);
+  if (!bench_save (&bench, &error))
+    {
+      g_printerr ("texty-bench: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  while (runs < MIN_RUNS || total < MIN_TOTAL_USEC)
+    {
+      gint64 start = g_get_monotonic_time ();
+      gint64 elapsed;
+
+      if (!func (&bench, &error))
+        {
+          g_printerr ("texty-bench: %s\n", error->message);
+          break;
+        }
+      elapsed = MAX (g_get_monotonic_time () - start, 1);
+      best = MIN (best, elapsed);
+      total += elapsed;
+      runs++;
+    }
+
+  g_unlink (path);
+  g_rmdir (dir);
+
+  if (error != NULL)
+    return EXIT_FAILURE;
+
+  /* one line of JSON, for scripts comparing releases */
+  g_print ("{\"benchmark\": \"%s\", \"bytes\": %" G_GSIZE_FORMAT ", \"runs\": %d, "
+           "\"best_seconds\": %.6f, \"mean_seconds\": %.6f, \"mib_per_s\": %.1f}\n",
+           argv[1],
+           g_bytes_get_size (bench.corpus),
+           runs,
+           best / (double) G_USEC_PER_SEC,
+           total / (double) runs / G_USEC_PER_SEC,
+           g_bytes_get_size (bench.corpus) / (double) (1024 * 1024) / (best / (double) G_USEC_PER_SEC));
+
+  g_object_unref (bench.file);
+  g_bytes_unref (bench.corpus);
+
+  return EXIT_SUCCESS;
+}
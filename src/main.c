@@ -23,6 +23,7 @@
 #include <glib/gi18n.h>
 
 #include "texty-application.h"
+#include "texty-trace.h"
 
 int
 main (int argc,
@@ -37,6 +38,7 @@ main (int argc,
 
   app = texty_application_new ("ca.footeware.c.texty", G_APPLICATION_DEFAULT_FLAGS);
   ret = g_application_run (G_APPLICATION (app), argc, argv);
+  texty_trace_stop ();
 
   return ret;
 }
@@ -20,17 +20,95 @@
 
 #include "config.h"
 #include <glib/gi18n.h>
+#include <stdlib.h>
+#ifdef HAVE_MALLOC_TRIM
+#include <malloc.h>
+#endif
 
 #include "texty-application.h"
+#include "texty-batch.h"
+#include "texty-recent.h"
+#include "texty-spell-checker.h"
+#include "texty-trace.h"
 #include "texty-window.h"
 
 struct _TextyApplication
 {
   AdwApplication parent_instance;
+
+  /* GFile -> GtkTextBuffer, so windows on the same file share one buffer */
+  GHashTable *documents;
+
+  GMemoryMonitor *memory_monitor;
 };
 
 G_DEFINE_FINAL_TYPE (TextyApplication, texty_application, ADW_TYPE_APPLICATION)
 
+static gboolean
+is_buffer (gpointer key,
+           gpointer value,
+           gpointer buffer)
+{
+  return value == buffer;
+}
+
+static void
+on_document_finalized (gpointer data,
+                       GObject *where_the_object_was)
+{
+  TextyApplication *self = data;
+
+  g_hash_table_foreach_remove (self->documents, is_buffer, where_the_object_was);
+}
+
+GtkTextBuffer *
+texty_application_lookup_document (TextyApplication *self,
+                                   GFile *file)
+{
+  g_return_val_if_fail (TEXTY_IS_APPLICATION (self), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  return g_hash_table_lookup (self->documents, file);
+}
+
+/* the registry doesn't keep buffers alive, they drop out when finalized */
+void
+texty_application_register_document (TextyApplication *self,
+                                     GFile *file,
+                                     GtkTextBuffer *buffer)
+{
+  GtkTextBuffer *previous;
+
+  g_return_if_fail (TEXTY_IS_APPLICATION (self));
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+
+  previous = g_hash_table_lookup (self->documents, file);
+  if (previous == buffer)
+    return;
+  if (previous != NULL)
+    texty_application_unregister_document (self, previous);
+  texty_application_unregister_document (self, buffer);
+
+  g_hash_table_insert (self->documents, g_object_ref (file), buffer);
+  g_object_weak_ref (G_OBJECT (buffer), on_document_finalized, self);
+}
+
+void
+texty_application_unregister_document (TextyApplication *self,
+                                       GtkTextBuffer *buffer)
+{
+  g_return_if_fail (TEXTY_IS_APPLICATION (self));
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+
+  if (g_hash_table_foreach_remove (self->documents, is_buffer, buffer) > 0)
+    g_object_weak_unref (G_OBJECT (buffer), on_document_finalized, self);
+}
+
+/**********************************/
+/* Documents 👆️                   */
+/**********************************/
+
 TextyApplication *
 texty_application_new (const char *application_id,
                        GApplicationFlags flags)
@@ -43,6 +121,65 @@ texty_application_new (const char *application_id,
                        NULL);
 }
 
+/*
+ * Sheds what can be done without or got back later when the system runs
+ * short of memory, so texty shrinks rather than being the one killed.
+ */
+static void
+on_low_memory_warning (GMemoryMonitor *monitor,
+                       GMemoryMonitorWarningLevel level,
+                       TextyApplication *self)
+{
+  gsize reclaimed;
+
+  reclaimed = texty_spell_checker_forget_verdicts ();
+  for (GList *l = gtk_application_get_windows (GTK_APPLICATION (self)); l != NULL; l = l->next)
+    {
+      if (TEXTY_IS_WINDOW (l->data))
+        reclaimed += texty_window_reclaim_memory (l->data, level);
+    }
+
+#ifdef HAVE_MALLOC_TRIM
+  /* hand the freed heap back, rather than keeping it for later */
+  malloc_trim (0);
+#endif
+
+  g_message ("Memory is low (level %d), released about %" G_GSIZE_FORMAT " bytes",
+             level,
+             reclaimed);
+}
+
+/**********************************/
+/* Memory pressure 👆️             */
+/**********************************/
+
+static gboolean
+prefetch_recent (gpointer user_data)
+{
+  texty_recent_prefetch ();
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+texty_application_startup (GApplication *app)
+{
+  TextyApplication *self = TEXTY_APPLICATION (app);
+
+  G_APPLICATION_CLASS (texty_application_parent_class)->startup (app);
+
+  /* 'texty --batch' never gets here, it has no caches to shed */
+  self->memory_monitor = g_memory_monitor_dup_default ();
+  g_signal_connect_object (self->memory_monitor,
+                           "low-memory-warning",
+                           G_CALLBACK (on_low_memory_warning),
+                           self,
+                           0);
+
+  /* once the first window is up, the recent files are likely opened next */
+  g_idle_add_full (G_PRIORITY_LOW, prefetch_recent, NULL, NULL);
+}
+
 static void
 texty_application_activate (GApplication *app)
 {
@@ -55,12 +192,77 @@ texty_application_activate (GApplication *app)
   gtk_window_present (window);
 }
 
+/*
+ * 'texty --batch' edits its files and exits here, before the application
+ * registers or starts up, so GTK never opens a display.
+ */
+static int
+texty_application_handle_local_options (GApplication *app,
+                                        GVariantDict *options)
+{
+  TextyBatchOptions batch = { 0 };
+  g_autofree const char **files = NULL;
+  g_autoptr (GError) error = NULL;
+  const char *trace = NULL;
+
+  /* started this early so batch edits are traced too, main() stops it */
+  if (g_variant_dict_lookup (options, "trace", "^&ay", &trace)
+      && !texty_trace_start (trace, &error))
+    {
+      g_printerr ("texty: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  g_variant_dict_lookup (options, G_OPTION_REMAINING, "^a&ay", &files);
+
+  if (!g_variant_dict_contains (options, "batch"))
+    {
+      if (files == NULL)
+        return -1;
+      g_printerr ("texty: files can only be given with --batch\n");
+      return EXIT_FAILURE;
+    }
+
+  g_variant_dict_lookup (options, "find", "&s", &batch.find);
+  g_variant_dict_lookup (options, "replace", "&s", &batch.replace);
+  g_variant_dict_lookup (options, "line-endings", "&s", &batch.line_endings);
+  g_variant_dict_lookup (options, "from-encoding", "&s", &batch.from_encoding);
+  g_variant_dict_lookup (options, "to-encoding", "&s", &batch.to_encoding);
+  g_variant_dict_lookup (options, "sort", "&s", &batch.sort);
+  batch.trim = g_variant_dict_contains (options, "trim");
+  g_variant_dict_lookup (options, "jobs", "i", &batch.jobs);
+  g_variant_dict_lookup (options, "backups", "i", &batch.backups);
+
+  return texty_batch_run (&batch, (char **) files);
+}
+
+static void
+texty_application_finalize (GObject *object)
+{
+  TextyApplication *self = TEXTY_APPLICATION (object);
+  GHashTableIter iter;
+  gpointer buffer;
+
+  g_hash_table_iter_init (&iter, self->documents);
+  while (g_hash_table_iter_next (&iter, NULL, &buffer))
+    g_object_weak_unref (G_OBJECT (buffer), on_document_finalized, self);
+  g_clear_pointer (&self->documents, g_hash_table_unref);
+  g_clear_object (&self->memory_monitor);
+
+  G_OBJECT_CLASS (texty_application_parent_class)->finalize (object);
+}
+
 static void
 texty_application_class_init (TextyApplicationClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GApplicationClass *app_class = G_APPLICATION_CLASS (klass);
 
+  object_class->finalize = texty_application_finalize;
+
+  app_class->startup = texty_application_startup;
   app_class->activate = texty_application_activate;
+  app_class->handle_local_options = texty_application_handle_local_options;
 }
 
 static void
@@ -122,9 +324,49 @@ static const GActionEntry app_actions[] = {
   { "new-window", texty_application_new_window_action }
 };
 
+static const GOptionEntry batch_options[] = {
+  { "batch", 'b', 0, G_OPTION_ARG_NONE, NULL,
+    N_ ("Edit the given files without opening a window"), NULL },
+  { "find", 0, 0, G_OPTION_ARG_STRING, NULL,
+    N_ ("Regular expression to replace"), N_ ("PATTERN") },
+  { "replace", 0, 0, G_OPTION_ARG_STRING, NULL,
+    N_ ("Replacement for --find, may refer to groups as \\1"), N_ ("TEXT") },
+  { "line-endings", 0, 0, G_OPTION_ARG_STRING, NULL,
+    N_ ("Convert line endings to lf, crlf or cr"), N_ ("ENDING") },
+  { "from-encoding", 0, 0, G_OPTION_ARG_STRING, NULL,
+    N_ ("Read the files in this character set instead of UTF-8"), N_ ("CHARSET") },
+  { "to-encoding", 0, 0, G_OPTION_ARG_STRING, NULL,
+    N_ ("Write the files in this character set instead of UTF-8"), N_ ("CHARSET") },
+  { "trim", 0, 0, G_OPTION_ARG_NONE, NULL,
+    N_ ("Remove trailing whitespace"), NULL },
+  { "sort", 0, 0, G_OPTION_ARG_STRING, NULL,
+    N_ ("Sort lines as text, numeric, natural or caseless"), N_ ("ORDER") },
+  { "jobs", 'j', 0, G_OPTION_ARG_INT, NULL,
+    N_ ("Files edited at once, one per core by default"), N_ ("N") },
+  { "backups", 0, 0, G_OPTION_ARG_INT, NULL,
+    N_ ("Backups kept of every file changed"), N_ ("N") },
+  { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, NULL,
+    NULL, N_ ("FILE…") },
+  { NULL }
+};
+
+static const GOptionEntry trace_options[] = {
+  { "trace", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+    N_ ("Write how long opening, saving and editing took to a Chrome trace"), N_ ("FILE") },
+  { NULL }
+};
+
 static void
 texty_application_init (TextyApplication *self)
 {
+  self->documents = g_hash_table_new_full (g_file_hash,
+                                           (GEqualFunc) g_file_equal,
+                                           g_object_unref,
+                                           NULL);
+
+  g_application_add_main_option_entries (G_APPLICATION (self), batch_options);
+  g_application_add_main_option_entries (G_APPLICATION (self), trace_options);
+
   g_action_map_add_action_entries (G_ACTION_MAP (self),
                                    app_actions,
                                    G_N_ELEMENTS (app_actions),
@@ -165,11 +407,53 @@ texty_application_init (TextyApplication *self)
                                              "<Ctrl><Shift>w",
                                              NULL,
                                          });
+  gtk_application_set_accels_for_action (GTK_APPLICATION (self),
+                                         "win.follow",
+                                         (const char *[]){
+                                             "<Ctrl><Shift>t",
+                                             NULL,
+                                         });
+  gtk_application_set_accels_for_action (GTK_APPLICATION (self),
+                                         "win.filter",
+                                         (const char *[]){
+                                             "<Ctrl><Shift>f",
+                                             NULL,
+                                         });
+  gtk_application_set_accels_for_action (GTK_APPLICATION (self),
+                                         "win.quick-open",
+                                         (const char *[]){
+                                             "<Ctrl>p",
+                                             NULL,
+                                         });
+  gtk_application_set_accels_for_action (GTK_APPLICATION (self),
+                                         "win.toggle-sidebar",
+                                         (const char *[]){
+                                             "F9",
+                                             NULL,
+                                         });
+  gtk_application_set_accels_for_action (GTK_APPLICATION (self),
+                                         "win.fold",
+                                         (const char *[]){
+                                             "<Ctrl><Shift>bracketleft",
+                                             NULL,
+                                         });
+  gtk_application_set_accels_for_action (GTK_APPLICATION (self),
+                                         "win.unfold-all",
+                                         (const char *[]){
+                                             "<Ctrl><Shift>bracketright",
+                                             NULL,
+                                         });
   gtk_application_set_accels_for_action (GTK_APPLICATION (self),
                                          "app.new-window",
                                          (const char *[]){
                                              "<Ctrl><Shift>n",
                                              NULL,
                                          });
+  gtk_application_set_accels_for_action (GTK_APPLICATION (self),
+                                         "win.toggle-latency-overlay",
+                                         (const char *[]){
+                                             "<Ctrl><Shift>F12",
+                                             NULL,
+                                         });
 }
 
@@ -28,7 +28,14 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (TextyApplication, texty_application, TEXTY, APPLICATION, AdwApplication)
 
-TextyApplication *texty_application_new (const char        *application_id,
-                                         GApplicationFlags  flags);
+TextyApplication *texty_application_new                 (const char        *application_id,
+                                                        GApplicationFlags  flags);
+GtkTextBuffer    *texty_application_lookup_document     (TextyApplication  *self,
+                                                        GFile             *file);
+void              texty_application_register_document   (TextyApplication  *self,
+                                                        GFile             *file,
+                                                        GtkTextBuffer     *buffer);
+void              texty_application_unregister_document (TextyApplication  *self,
+                                                        GtkTextBuffer     *buffer);
 
 G_END_DECLS
@@ -0,0 +1,181 @@
+/* texty-backup.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define _GNU_SOURCE
+
+#include "config.h"
+#include "texty-backup.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_FICLONE
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+/* "notes.txt" is backed up as "notes.txt.~1~", the oldest has the highest number */
+static GFile *
+get_backup_file (GFile *file,
+                 guint n)
+{
+  g_autofree char *basename = g_file_get_basename (file);
+  g_autofree char *name = g_strdup_printf ("%s.~%u~", basename, n);
+  g_autoptr (GFile) parent = g_file_get_parent (file);
+
+  return g_file_get_child (parent, name);
+}
+
+/*
+ * Copies between local files without moving the data through user space:
+ * a reflink shares the extents on btrfs, XFS and the like, copy_file_range()
+ * lets the kernel or the filesystem do the copy. Returns FALSE with errno
+ * set when neither is supported so a streamed copy can be used instead.
+ */
+static gboolean
+clone_file (const char *src_path,
+            const char *dst_path)
+{
+  struct stat st;
+  int src_fd;
+  int dst_fd;
+  gboolean ok = FALSE;
+  int saved_errno;
+
+  src_fd = g_open (src_path, O_RDONLY | O_CLOEXEC, 0);
+  if (src_fd < 0)
+    return FALSE;
+  if (fstat (src_fd, &st) < 0)
+    {
+      saved_errno = errno;
+      g_close (src_fd, NULL);
+      errno = saved_errno;
+      return FALSE;
+    }
+
+  dst_fd = g_open (dst_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+  if (dst_fd < 0)
+    {
+      saved_errno = errno;
+      g_close (src_fd, NULL);
+      errno = saved_errno;
+      return FALSE;
+    }
+
+#ifdef HAVE_FICLONE
+  ok = ioctl (dst_fd, FICLONE, src_fd) == 0;
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+  if (!ok)
+    {
+      off_t remaining = st.st_size;
+
+      errno = 0;
+      while (remaining > 0)
+        {
+          ssize_t n = copy_file_range (src_fd, NULL, dst_fd, NULL, remaining, 0);
+
+          if (n < 0 && errno == EINTR)
+            continue;
+          if (n <= 0)
+            break;
+          remaining -= n;
+        }
+      ok = remaining == 0;
+    }
+#endif
+
+  saved_errno = errno;
+  g_close (src_fd, NULL);
+  if (!g_close (dst_fd, NULL))
+    {
+      saved_errno = errno;
+      ok = FALSE;
+    }
+  if (!ok)
+    g_unlink (dst_path);
+  errno = saved_errno;
+
+  return ok;
+}
+
+static gboolean
+copy_file (GFile *src,
+           GFile *dst,
+           GCancellable *cancellable,
+           GError **error)
+{
+  g_autofree char *src_path = g_file_get_path (src);
+  g_autofree char *dst_path = g_file_get_path (dst);
+
+  if (src_path != NULL && dst_path != NULL && clone_file (src_path, dst_path))
+    return TRUE;
+
+  /* other filesystems and remote locations get an ordinary streamed copy */
+  return g_file_copy (src,
+                      dst,
+                      G_FILE_COPY_OVERWRITE | G_FILE_COPY_ALL_METADATA,
+                      cancellable,
+                      NULL,
+                      NULL,
+                      error);
+}
+
+/*
+ * Keeps up to 'n_backups' numbered copies of 'file' before it is replaced,
+ * shifting the existing ones along first. A file that doesn't exist yet has
+ * nothing to back up.
+ */
+gboolean
+texty_backup_create (GFile *file,
+                     guint n_backups,
+                     GCancellable *cancellable,
+                     GError **error)
+{
+  g_autoptr (GFile) newest = NULL;
+  guint i;
+
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+
+  if (n_backups == 0 || !g_file_query_exists (file, cancellable))
+    return TRUE;
+
+  /* the oldest falls off the end when the rest are renamed over it */
+  for (i = n_backups - 1; i > 0; i--)
+    {
+      g_autoptr (GFile) from = get_backup_file (file, i);
+      g_autoptr (GFile) to = get_backup_file (file, i + 1);
+      g_autoptr (GError) local_error = NULL;
+
+      if (!g_file_move (from, to, G_FILE_COPY_OVERWRITE, cancellable, NULL, NULL, &local_error)
+          && !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+          g_propagate_error (error, g_steal_pointer (&local_error));
+          return FALSE;
+        }
+    }
+
+  newest = get_backup_file (file, 1);
+  return copy_file (file, newest, cancellable, error);
+}
@@ -0,0 +1,426 @@
+/* texty-batch.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-batch.h"
+
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "texty-compression.h"
+#include "texty-file-loader.h"
+#include "texty-file-saver.h"
+#include "texty-line-ending.h"
+#include "texty-line-ops.h"
+
+/* the parsed options, shared read-only by every worker */
+typedef struct
+{
+  GRegex *regex;
+  const char *replace;
+  gboolean convert_line_endings;
+  TextyLineEnding line_ending;
+  const char *from_encoding;
+  const char *to_encoding;
+  gboolean trim;
+  gboolean sort;
+  TextyLineOp sort_op;
+  guint backups;
+
+  /* set by any worker whose file failed */
+  gint failed;
+} Batch;
+
+static gboolean
+is_utf8 (const char *charset)
+{
+  return charset == NULL || g_ascii_strcasecmp (charset, "UTF-8") == 0;
+}
+
+/*
+ * Opens 'file' through its decompressor, by suffix, and a converter from
+ * 'charset' into UTF-8 unless it is UTF-8 already, so text in other
+ * encodings never has to be held twice.
+ */
+static GInputStream *
+open_decoded (GFile *file,
+              const char *charset,
+              TextyCompression *compression,
+              GError **error)
+{
+  g_autoptr (GFileInputStream) file_stream = NULL;
+  g_autoptr (GInputStream) input = NULL;
+  g_autoptr (GCharsetConverter) decoder = NULL;
+
+  file_stream = g_file_read (file, NULL, error);
+  if (file_stream == NULL)
+    return NULL;
+  input = g_object_ref (G_INPUT_STREAM (file_stream));
+
+  *compression = texty_compression_from_file (file);
+  if (*compression != TEXTY_COMPRESSION_NONE)
+    {
+      g_autoptr (GConverter) decompressor = NULL;
+      GInputStream *base = g_steal_pointer (&input);
+
+      decompressor = texty_compression_new_decompressor (*compression, error);
+      if (decompressor == NULL)
+        {
+          g_object_unref (base);
+          return NULL;
+        }
+      input = g_converter_input_stream_new (base, decompressor);
+      g_object_unref (base);
+    }
+
+  if (is_utf8 (charset))
+    return g_steal_pointer (&input);
+
+  decoder = g_charset_converter_new ("UTF-8", charset, error);
+  if (decoder == NULL)
+    return NULL;
+  return g_converter_input_stream_new (input, G_CONVERTER (decoder));
+}
+
+static GBytes *
+decode_file (GFile *file,
+             const char *charset,
+             TextyCompression *compression,
+             GError **error)
+{
+  g_autoptr (GInputStream) decoded = NULL;
+  g_autoptr (GOutputStream) output = NULL;
+
+  decoded = open_decoded (file, charset, compression, error);
+  if (decoded == NULL)
+    return NULL;
+
+  output = g_memory_output_stream_new_resizable ();
+  if (g_output_stream_splice (output,
+                              decoded,
+                              G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+                                  G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                              NULL,
+                              error) < 0)
+    return NULL;
+
+  return g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (output));
+}
+
+static GBytes *
+load_file (Batch *batch,
+           GFile *file,
+           TextyCompression *compression,
+           GError **error)
+{
+  g_autoptr (GBytes) bytes = NULL;
+  gboolean truncated = FALSE;
+
+  if (!is_utf8 (batch->from_encoding))
+    bytes = decode_file (file, batch->from_encoding, compression, error);
+  else
+    bytes = texty_file_load (file, G_MAXSIZE, compression, &truncated, NULL, error);
+  if (bytes == NULL)
+    return NULL;
+
+  if (truncated)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+                           "The file is too large to load");
+      return NULL;
+    }
+  if (!texty_file_validate_utf8 (bytes, NULL))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                           "The file is not valid UTF-8, try --from-encoding");
+      return NULL;
+    }
+
+  return g_steal_pointer (&bytes);
+}
+
+/* replaces every match of 'regex' in 'text', as --find and --replace do */
+GBytes *
+texty_batch_replace (GRegex *regex,
+                     GBytes *text,
+                     const char *replacement,
+                     GError **error)
+{
+  gsize length;
+  const char *data = g_bytes_get_data (text, &length);
+  char *result;
+
+  result = g_regex_replace (regex, data, length, 0, replacement, 0, error);
+  if (result == NULL)
+    return NULL;
+
+  return g_bytes_new_take (result, strlen (result));
+}
+
+/* runs every requested edit over one file, then writes it back if needed */
+static gboolean
+process_file (Batch *batch,
+              GFile *file,
+              GError **error)
+{
+  g_autoptr (GBytes) original = NULL;
+  g_autoptr (GBytes) text = NULL;
+  TextyCompression compression = TEXTY_COMPRESSION_NONE;
+  TextyLineEnding line_ending;
+  gboolean mixed;
+  gboolean dirty;
+
+  /*
+   * re-encoding alone never needs the whole text, it is converted as it is
+   * read back into the file; the other edits see all of it at once
+   */
+  if (batch->regex == NULL && !batch->trim && !batch->sort &&
+      (!is_utf8 (batch->from_encoding) || !is_utf8 (batch->to_encoding)))
+    {
+      g_autoptr (GInputStream) input = NULL;
+
+      input = open_decoded (file, batch->from_encoding, &compression, error);
+      if (input == NULL)
+        return FALSE;
+
+      return texty_file_save_stream (file,
+                                     input,
+                                     batch->convert_line_endings ? batch->line_ending : TEXTY_LINE_ENDING_MIXED,
+                                     compression,
+                                     batch->to_encoding,
+                                     batch->backups,
+                                     NULL,
+                                     error);
+    }
+
+  original = load_file (batch, file, &compression, error);
+  if (original == NULL)
+    return FALSE;
+
+  /* endings are kept as they were unless asked otherwise */
+  line_ending = texty_line_ending_detect (g_bytes_get_data (original, NULL),
+                                          g_bytes_get_size (original),
+                                          &mixed);
+  if (mixed)
+    line_ending = TEXTY_LINE_ENDING_MIXED;
+  dirty = !is_utf8 (batch->from_encoding) || !is_utf8 (batch->to_encoding);
+  if (batch->convert_line_endings && batch->line_ending != line_ending)
+    {
+      line_ending = batch->line_ending;
+      dirty = TRUE;
+    }
+
+  text = g_bytes_ref (original);
+  if (batch->regex != NULL)
+    {
+      GBytes *replaced = texty_batch_replace (batch->regex, text, batch->replace, error);
+
+      if (replaced == NULL)
+        return FALSE;
+      g_bytes_unref (text);
+      text = replaced;
+    }
+  if (batch->trim)
+    {
+      GBytes *trimmed = texty_line_ops_run (text, TEXTY_LINE_OP_TRIM, NULL, NULL, error);
+
+      if (trimmed == NULL)
+        return FALSE;
+      g_bytes_unref (text);
+      text = trimmed;
+    }
+  if (batch->sort)
+    {
+      GBytes *sorted = texty_line_ops_run (text, batch->sort_op, NULL, NULL, error);
+
+      if (sorted == NULL)
+        return FALSE;
+      g_bytes_unref (text);
+      text = sorted;
+    }
+
+  /* untouched files keep their timestamps and need no backup */
+  if (!dirty && g_bytes_equal (text, original))
+    return TRUE;
+
+  return texty_file_save (file,
+                          text,
+                          line_ending,
+                          compression,
+                          batch->to_encoding,
+                          batch->backups,
+                          NULL,
+                          error);
+}
+
+static void
+process_file_func (gpointer data,
+                   gpointer user_data)
+{
+  g_autoptr (GFile) file = data;
+  g_autoptr (GError) error = NULL;
+  Batch *batch = user_data;
+
+  if (!process_file (batch, file, &error))
+    {
+      g_autofree char *name = g_file_get_parse_name (file);
+
+      g_printerr ("texty: %s: %s\n", name, error->message);
+      g_atomic_int_set (&batch->failed, TRUE);
+    }
+}
+
+static gboolean
+parse_sort (const char *sort,
+            TextyLineOp *op)
+{
+  g_autofree char *name = NULL;
+
+  if (g_strcmp0 (sort, "text") == 0)
+    name = g_strdup ("sort");
+  else
+    name = g_strconcat ("sort-", sort, NULL);
+
+  return texty_line_op_from_string (name, op) && *op <= TEXTY_LINE_OP_SORT_CASELESS;
+}
+
+static gboolean
+check_charset (const char *charset,
+               GError **error)
+{
+  g_autoptr (GCharsetConverter) converter = NULL;
+
+  if (is_utf8 (charset))
+    return TRUE;
+
+  converter = g_charset_converter_new ("UTF-8", charset, error);
+  return converter != NULL;
+}
+
+/* turns the command line into a Batch, failing before any file is touched */
+static gboolean
+batch_init (Batch *batch,
+            const TextyBatchOptions *options,
+            GError **error)
+{
+  if (options->find != NULL)
+    {
+      batch->regex = g_regex_new (options->find, G_REGEX_OPTIMIZE | G_REGEX_MULTILINE, 0, error);
+      if (batch->regex == NULL)
+        return FALSE;
+      batch->replace = options->replace != NULL ? options->replace : "";
+      if (!g_regex_check_replacement (batch->replace, NULL, error))
+        return FALSE;
+    }
+  else if (options->replace != NULL)
+    {
+      g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+                           "--replace needs --find");
+      return FALSE;
+    }
+
+  if (options->line_endings != NULL)
+    {
+      batch->line_ending = texty_line_ending_from_string (options->line_endings);
+      if (batch->line_ending == TEXTY_LINE_ENDING_MIXED ||
+          g_strcmp0 (texty_line_ending_to_string (batch->line_ending), options->line_endings) != 0)
+        {
+          g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                       "Unknown line ending “%s”, use lf, crlf or cr",
+                       options->line_endings);
+          return FALSE;
+        }
+      batch->convert_line_endings = TRUE;
+    }
+
+  if (options->sort != NULL)
+    {
+      if (!parse_sort (options->sort, &batch->sort_op))
+        {
+          g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                       "Unknown sort “%s”, use text, numeric, natural or caseless",
+                       options->sort);
+          return FALSE;
+        }
+      batch->sort = TRUE;
+    }
+
+  if (!check_charset (options->from_encoding, error) ||
+      !check_charset (options->to_encoding, error))
+    return FALSE;
+
+  batch->from_encoding = options->from_encoding;
+  batch->to_encoding = options->to_encoding;
+  batch->trim = options->trim;
+  batch->backups = MAX (options->backups, 0);
+
+  return TRUE;
+}
+
+/*
+ * Applies 'options' to every one of 'files' without any window, spreading
+ * the files over a pool of worker threads, one per core unless 'jobs' says
+ * otherwise. Returns the exit status for the command line.
+ */
+int
+texty_batch_run (const TextyBatchOptions *options,
+                 char **files)
+{
+  g_autoptr (GError) error = NULL;
+  GThreadPool *pool;
+  Batch batch = { 0 };
+  int jobs;
+
+  g_return_val_if_fail (options != NULL, EXIT_FAILURE);
+
+  if (files == NULL || files[0] == NULL)
+    {
+      g_printerr ("texty: --batch needs at least one file\n");
+      return EXIT_FAILURE;
+    }
+
+  if (!batch_init (&batch, options, &error))
+    {
+      g_printerr ("texty: %s\n", error->message);
+      g_clear_pointer (&batch.regex, g_regex_unref);
+      return EXIT_FAILURE;
+    }
+
+  jobs = options->jobs > 0 ? options->jobs : (int) g_get_num_processors ();
+  jobs = MIN (jobs, (int) g_strv_length (files));
+
+  pool = g_thread_pool_new (process_file_func, &batch, jobs, TRUE, &error);
+  if (pool == NULL)
+    {
+      g_printerr ("texty: %s\n", error->message);
+      g_clear_pointer (&batch.regex, g_regex_unref);
+      return EXIT_FAILURE;
+    }
+
+  for (guint i = 0; files[i] != NULL; i++)
+    g_thread_pool_push (pool, g_file_new_for_commandline_arg (files[i]), NULL);
+
+  /* waits for every queued file */
+  g_thread_pool_free (pool, FALSE, TRUE);
+  g_clear_pointer (&batch.regex, g_regex_unref);
+
+  return g_atomic_int_get (&batch.failed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
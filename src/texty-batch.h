@@ -0,0 +1,48 @@
+/* texty-batch.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* what 'texty --batch' does to every file, NULL or FALSE leaves it alone */
+typedef struct
+{
+  const char *find;
+  const char *replace;
+  const char *line_endings;
+  const char *from_encoding;
+  const char *to_encoding;
+  const char *sort;
+  gboolean trim;
+  int jobs;
+  int backups;
+} TextyBatchOptions;
+
+int     texty_batch_run     (const TextyBatchOptions  *options,
+                             char                    **files);
+GBytes *texty_batch_replace (GRegex                   *regex,
+                             GBytes                   *text,
+                             const char               *replacement,
+                             GError                  **error);
+
+G_END_DECLS
@@ -0,0 +1,394 @@
+/* texty-clipboard.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-clipboard.h"
+
+#include <string.h>
+
+/* characters copied out of the buffer per write, or bytes once copied */
+#define WRITE_SIZE (256 * 1024)
+
+struct _TextyClipboard
+{
+  GdkContentProvider parent_instance;
+
+  /*
+   * the selection, read straight from the buffer while it is unchanged...
+   * (a weak pointer, the clipboard mustn't keep a closed document around)
+   */
+  GtkTextBuffer *buffer;
+  int start;
+  int end;
+  /* ...and copied out of it just before it is first edited */
+  GBytes *bytes;
+};
+
+G_DEFINE_FINAL_TYPE (TextyClipboard, texty_clipboard, GDK_TYPE_CONTENT_PROVIDER)
+
+typedef struct
+{
+  GOutputStream *stream;
+  int io_priority;
+  /* how far into the selection the writes have got */
+  int chars_written;
+  gsize bytes_written;
+  char *chunk;
+} WriteData;
+
+static void
+write_data_free (WriteData *data)
+{
+  g_object_unref (data->stream);
+  g_free (data->chunk);
+  g_free (data);
+}
+
+static char *
+get_text (GtkTextBuffer *buffer,
+          int start,
+          int end)
+{
+  GtkTextIter start_iter;
+  GtkTextIter end_iter;
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &start_iter, start);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end_iter, end);
+
+  return gtk_text_buffer_get_text (buffer, &start_iter, &end_iter, TRUE);
+}
+
+static void
+detach (TextyClipboard *self)
+{
+  if (self->buffer == NULL)
+    return;
+
+  g_signal_handlers_disconnect_by_data (self->buffer, self);
+  if (g_object_get_data (G_OBJECT (self->buffer), "clipboard") == self)
+    g_object_set_data (G_OBJECT (self->buffer), "clipboard", NULL);
+  g_object_remove_weak_pointer (G_OBJECT (self->buffer), (gpointer *) &self->buffer);
+  self->buffer = NULL;
+}
+
+/* the selection is about to change or the buffer to go, so keep it as it is */
+static void
+materialize (TextyClipboard *self)
+{
+  char *text;
+
+  if (self->buffer == NULL)
+    return;
+
+  text = get_text (self->buffer, self->start, self->end);
+  self->bytes = g_bytes_new_take (text, strlen (text));
+
+  detach (self);
+}
+
+/*
+ * Edits after the selection leave it where it is, edits before it move it,
+ * and only those inside it need it copied out first.
+ */
+static void
+on_insert (TextyClipboard *self,
+           GtkTextIter *location,
+           int n_chars)
+{
+  int offset = gtk_text_iter_get_offset (location);
+
+  if (offset >= self->end)
+    return;
+  if (offset > self->start)
+    {
+      materialize (self);
+      return;
+    }
+
+  self->start += n_chars;
+  self->end += n_chars;
+}
+
+static void
+on_insert_text (GtkTextBuffer *buffer,
+                GtkTextIter *location,
+                char *text,
+                int length,
+                TextyClipboard *self)
+{
+  on_insert (self, location, g_utf8_strlen (text, length));
+}
+
+static void
+on_insert_object (GtkTextBuffer *buffer,
+                  GtkTextIter *location,
+                  gpointer object,
+                  TextyClipboard *self)
+{
+  on_insert (self, location, 1);
+}
+
+static void
+on_delete_range (GtkTextBuffer *buffer,
+                 GtkTextIter *start,
+                 GtkTextIter *end,
+                 TextyClipboard *self)
+{
+  int start_offset = gtk_text_iter_get_offset (start);
+  int end_offset = gtk_text_iter_get_offset (end);
+
+  if (start_offset >= self->end)
+    return;
+  if (end_offset > self->start)
+    {
+      materialize (self);
+      return;
+    }
+
+  self->start -= end_offset - start_offset;
+  self->end -= end_offset - start_offset;
+}
+
+/**********************************/
+/* Snapshot 👆️                    */
+/**********************************/
+
+static const char *
+get_mime_types (void)
+{
+  const char *charset;
+
+  /* plain text is taken to be in the locale's encoding */
+  if (g_get_charset (&charset))
+    return "text/plain;charset=utf-8 text/plain";
+  return "text/plain;charset=utf-8";
+}
+
+static GdkContentFormats *
+texty_clipboard_ref_formats (GdkContentProvider *provider)
+{
+  return gdk_content_formats_parse (get_mime_types ());
+}
+
+static void write_next (GTask *task);
+
+static void
+on_chunk_written (GObject *source,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+  g_autoptr (GTask) task = user_data;
+  WriteData *data = g_task_get_task_data (task);
+  GError *error = NULL;
+  gsize written;
+
+  if (!g_output_stream_write_all_finish (G_OUTPUT_STREAM (source), result, &written, &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  data->bytes_written += written;
+  write_next (g_steal_pointer (&task));
+}
+
+/* writes the next chunk, from the buffer or from the copy taken of it */
+static void
+write_next (GTask *task)
+{
+  TextyClipboard *self = g_task_get_source_object (task);
+  WriteData *data = g_task_get_task_data (task);
+  const char *chunk;
+  gsize length;
+
+  g_clear_pointer (&data->chunk, g_free);
+
+  if (self->bytes != NULL)
+    {
+      gsize size;
+      const char *text = g_bytes_get_data (self->bytes, &size);
+
+      chunk = text + data->bytes_written;
+      length = MIN (size - data->bytes_written, WRITE_SIZE);
+    }
+  else if (self->buffer == NULL)
+    {
+      /* the document was dropped without being released first */
+      chunk = NULL;
+      length = 0;
+    }
+  else
+    {
+      int count = MIN (self->end - self->start - data->chars_written, WRITE_SIZE);
+
+      data->chunk = get_text (self->buffer,
+                              self->start + data->chars_written,
+                              self->start + data->chars_written + count);
+      data->chars_written += count;
+      chunk = data->chunk;
+      length = strlen (chunk);
+    }
+
+  if (length == 0)
+    {
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return;
+    }
+
+  g_output_stream_write_all_async (data->stream,
+                                   chunk,
+                                   length,
+                                   data->io_priority,
+                                   g_task_get_cancellable (task),
+                                   on_chunk_written,
+                                   task);
+}
+
+static void
+texty_clipboard_write_mime_type_async (GdkContentProvider *provider,
+                                       const char *mime_type,
+                                       GOutputStream *stream,
+                                       int io_priority,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data)
+{
+  g_autoptr (GdkContentFormats) formats = NULL;
+  GTask *task;
+  WriteData *data;
+
+  task = g_task_new (provider, cancellable, callback, user_data);
+  g_task_set_source_tag (task, texty_clipboard_write_mime_type_async);
+  g_task_set_priority (task, io_priority);
+
+  formats = texty_clipboard_ref_formats (provider);
+  if (!gdk_content_formats_contain_mime_type (formats, mime_type))
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                               "Cannot provide contents as “%s”", mime_type);
+      g_object_unref (task);
+      return;
+    }
+
+  data = g_new0 (WriteData, 1);
+  data->stream = g_object_ref (stream);
+  data->io_priority = io_priority;
+  g_task_set_task_data (task, data, (GDestroyNotify) write_data_free);
+
+  write_next (task);
+}
+
+static gboolean
+texty_clipboard_write_mime_type_finish (GdkContentProvider *provider,
+                                        GAsyncResult *result,
+                                        GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, provider), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**********************************/
+/* Serializing 👆️                 */
+/**********************************/
+
+static void
+texty_clipboard_dispose (GObject *object)
+{
+  TextyClipboard *self = TEXTY_CLIPBOARD (object);
+
+  detach (self);
+  g_clear_pointer (&self->bytes, g_bytes_unref);
+
+  G_OBJECT_CLASS (texty_clipboard_parent_class)->dispose (object);
+}
+
+static void
+texty_clipboard_class_init (TextyClipboardClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GdkContentProviderClass *provider_class = GDK_CONTENT_PROVIDER_CLASS (klass);
+
+  object_class->dispose = texty_clipboard_dispose;
+
+  provider_class->ref_formats = texty_clipboard_ref_formats;
+  provider_class->write_mime_type_async = texty_clipboard_write_mime_type_async;
+  provider_class->write_mime_type_finish = texty_clipboard_write_mime_type_finish;
+}
+
+static void
+texty_clipboard_init (TextyClipboard *self)
+{
+}
+
+/*
+ * Offers the text between 'start' and 'end' on a clipboard without copying
+ * it: it is read out of 'buffer' a chunk at a time when someone pastes, and
+ * only copied whole if the selected text is edited while still on offer;
+ * edits elsewhere merely move it.
+ */
+GdkContentProvider *
+texty_clipboard_new (GtkTextBuffer *buffer,
+                     const GtkTextIter *start,
+                     const GtkTextIter *end)
+{
+  TextyClipboard *self;
+  TextyClipboard *previous;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+  g_return_val_if_fail (start != NULL && end != NULL, NULL);
+
+  /* only one selection per buffer is tracked, an older one still alive keeps a copy */
+  previous = g_object_get_data (G_OBJECT (buffer), "clipboard");
+  if (previous != NULL)
+    materialize (previous);
+
+  self = g_object_new (TEXTY_TYPE_CLIPBOARD, NULL);
+  self->buffer = buffer;
+  g_object_add_weak_pointer (G_OBJECT (buffer), (gpointer *) &self->buffer);
+  g_object_set_data (G_OBJECT (buffer), "clipboard", self);
+  self->start = MIN (gtk_text_iter_get_offset (start), gtk_text_iter_get_offset (end));
+  self->end = MAX (gtk_text_iter_get_offset (start), gtk_text_iter_get_offset (end));
+
+  /* ahead of the default handlers, while the text is still there */
+  g_signal_connect (buffer, "insert-text", G_CALLBACK (on_insert_text), self);
+  g_signal_connect (buffer, "insert-paintable", G_CALLBACK (on_insert_object), self);
+  g_signal_connect (buffer, "insert-child-anchor", G_CALLBACK (on_insert_object), self);
+  g_signal_connect (buffer, "delete-range", G_CALLBACK (on_delete_range), self);
+
+  return GDK_CONTENT_PROVIDER (self);
+}
+
+/*
+ * Copies out the selection offered from 'buffer', if any, for when it is no
+ * longer shown and may be closed while still on the clipboard.
+ */
+void
+texty_clipboard_release_buffer (GtkTextBuffer *buffer)
+{
+  TextyClipboard *self;
+
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+
+  self = g_object_get_data (G_OBJECT (buffer), "clipboard");
+  if (self != NULL)
+    materialize (self);
+}
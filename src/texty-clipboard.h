@@ -0,0 +1,36 @@
+/* texty-clipboard.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define TEXTY_TYPE_CLIPBOARD (texty_clipboard_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyClipboard, texty_clipboard, TEXTY, CLIPBOARD, GdkContentProvider)
+
+GdkContentProvider *texty_clipboard_new (GtkTextBuffer     *buffer,
+                                         const GtkTextIter *start,
+                                         const GtkTextIter *end);
+void                texty_clipboard_release_buffer (GtkTextBuffer *buffer);
+
+G_END_DECLS
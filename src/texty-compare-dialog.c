@@ -0,0 +1,264 @@
+/* texty-compare-dialog.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-compare-dialog.h"
+
+#include "texty-diff.h"
+
+enum
+{
+  COLUMN_OLD_NUMBER,
+  COLUMN_OLD_TEXT,
+  COLUMN_NEW_NUMBER,
+  COLUMN_NEW_TEXT,
+};
+
+struct _TextyCompareDialog
+{
+  AdwDialog parent_instance;
+
+  /* Template widgets */
+  AdwWindowTitle *window_title;
+  GtkStack *stack;
+  AdwStatusPage *error_page;
+  GtkColumnView *column_view;
+
+  GCancellable *cancellable;
+};
+
+G_DEFINE_FINAL_TYPE (TextyCompareDialog, texty_compare_dialog, ADW_TYPE_DIALOG)
+
+static void
+setup_cell (GtkSignalListItemFactory *factory,
+            GtkListItem *item,
+            gpointer user_data)
+{
+  int column = GPOINTER_TO_INT (user_data);
+  GtkWidget *label = gtk_label_new (NULL);
+
+  if (column == COLUMN_OLD_NUMBER || column == COLUMN_NEW_NUMBER)
+    {
+      gtk_label_set_xalign (GTK_LABEL (label), 1);
+      gtk_label_set_width_chars (GTK_LABEL (label), 7);
+      gtk_widget_add_css_class (label, "dim-label");
+      gtk_widget_add_css_class (label, "numeric");
+    }
+  else
+    {
+      gtk_label_set_xalign (GTK_LABEL (label), 0);
+      gtk_label_set_single_line_mode (GTK_LABEL (label), TRUE);
+      gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_END);
+      gtk_widget_add_css_class (label, "monospace");
+    }
+
+  gtk_list_item_set_child (item, label);
+}
+
+static void
+bind_cell (GtkSignalListItemFactory *factory,
+           GtkListItem *item,
+           gpointer user_data)
+{
+  int column = GPOINTER_TO_INT (user_data);
+  TextyDiffRow *row = gtk_list_item_get_item (item);
+  GtkWidget *label = gtk_list_item_get_child (item);
+  TextyDiffKind kind = texty_diff_row_get_kind (row);
+  g_autofree char *str = NULL;
+  const char *text;
+  int number;
+
+  gtk_widget_remove_css_class (label, "error");
+  gtk_widget_remove_css_class (label, "success");
+
+  switch (column)
+    {
+    case COLUMN_OLD_NUMBER:
+    case COLUMN_NEW_NUMBER:
+      number = column == COLUMN_OLD_NUMBER ? texty_diff_row_get_old_number (row)
+                                           : texty_diff_row_get_new_number (row);
+      if (kind != TEXTY_DIFF_SKIP && number >= 0)
+        str = g_strdup_printf ("%d", number + 1);
+      gtk_label_set_text (GTK_LABEL (label), str != NULL ? str : "");
+      break;
+
+    case COLUMN_OLD_TEXT:
+      if (kind == TEXTY_DIFF_SKIP)
+        {
+          str = g_strdup_printf ("⋯ %u unchanged lines", texty_diff_row_get_skipped (row));
+          gtk_label_set_text (GTK_LABEL (label), str);
+          break;
+        }
+      /* a deleted or inserted line has nothing on the other side */
+      text = texty_diff_row_get_old_text (row);
+      gtk_label_set_text (GTK_LABEL (label), text != NULL ? text : "");
+      if (kind == TEXTY_DIFF_DELETE || kind == TEXTY_DIFF_CHANGE)
+        gtk_widget_add_css_class (label, "error");
+      break;
+
+    case COLUMN_NEW_TEXT:
+      text = texty_diff_row_get_new_text (row);
+      gtk_label_set_text (GTK_LABEL (label), text != NULL ? text : "");
+      if (kind == TEXTY_DIFF_INSERT || kind == TEXTY_DIFF_CHANGE)
+        gtk_widget_add_css_class (label, "success");
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static void
+append_column (TextyCompareDialog *self,
+               const char *title,
+               int column)
+{
+  g_autoptr (GtkListItemFactory) factory = gtk_signal_list_item_factory_new ();
+  g_autoptr (GtkColumnViewColumn) view_column = NULL;
+
+  g_signal_connect (factory, "setup", G_CALLBACK (setup_cell), GINT_TO_POINTER (column));
+  g_signal_connect (factory, "bind", G_CALLBACK (bind_cell), GINT_TO_POINTER (column));
+
+  view_column = gtk_column_view_column_new (title, g_object_ref (factory));
+  gtk_column_view_column_set_expand (view_column,
+                                     column == COLUMN_OLD_TEXT || column == COLUMN_NEW_TEXT);
+  gtk_column_view_append_column (self->column_view, view_column);
+}
+
+static void
+diff_complete (GObject *source_object,
+               GAsyncResult *result,
+               gpointer user_data)
+{
+  g_autoptr (TextyCompareDialog) self = user_data;
+  g_autoptr (TextyDiffModel) model = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree char *subtitle = NULL;
+  guint n_changes;
+
+  model = texty_diff_finish (result, &error);
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+  if (error != NULL)
+    {
+      adw_status_page_set_description (self->error_page, error->message);
+      gtk_stack_set_visible_child_name (self->stack, "error");
+      return;
+    }
+
+  n_changes = texty_diff_model_get_n_changes (model);
+  if (n_changes == 0)
+    {
+      gtk_stack_set_visible_child_name (self->stack, "same");
+      return;
+    }
+
+  subtitle = g_strdup_printf (n_changes == 1 ? "%u change" : "%u changes", n_changes);
+  adw_window_title_set_subtitle (self->window_title, subtitle);
+  gtk_column_view_set_model (self->column_view,
+                             GTK_SELECTION_MODEL (gtk_no_selection_new (G_LIST_MODEL (g_steal_pointer (&model)))));
+  gtk_stack_set_visible_child_name (self->stack, "diff");
+}
+
+static void
+on_closed (TextyCompareDialog *self,
+           gpointer user_data)
+{
+  /* no point finishing a comparison nobody will see */
+  g_cancellable_cancel (self->cancellable);
+}
+
+static void
+texty_compare_dialog_dispose (GObject *object)
+{
+  TextyCompareDialog *self = TEXTY_COMPARE_DIALOG (object);
+
+  g_cancellable_cancel (self->cancellable);
+  g_clear_object (&self->cancellable);
+
+  G_OBJECT_CLASS (texty_compare_dialog_parent_class)->dispose (object);
+}
+
+static void
+texty_compare_dialog_class_init (TextyCompareDialogClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->dispose = texty_compare_dialog_dispose;
+
+  gtk_widget_class_set_template_from_resource (widget_class,
+                                               "/ca/footeware/c/texty/texty-compare-dialog.ui");
+
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyCompareDialog,
+                                        window_title);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyCompareDialog,
+                                        stack);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyCompareDialog,
+                                        error_page);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyCompareDialog,
+                                        column_view);
+}
+
+static void
+texty_compare_dialog_init (TextyCompareDialog *self)
+{
+  gtk_widget_init_template (GTK_WIDGET (self));
+
+  self->cancellable = g_cancellable_new ();
+  g_signal_connect (self, "closed", G_CALLBACK (on_closed), NULL);
+}
+
+/*
+ * Shows the differences between two texts side by side. The comparison
+ * runs in a worker thread while the dialog shows a spinner.
+ */
+AdwDialog *
+texty_compare_dialog_new (GBytes *old_text,
+                          const char *old_title,
+                          GBytes *new_text,
+                          const char *new_title)
+{
+  TextyCompareDialog *self;
+
+  g_return_val_if_fail (old_text != NULL, NULL);
+  g_return_val_if_fail (new_text != NULL, NULL);
+
+  self = g_object_new (TEXTY_TYPE_COMPARE_DIALOG, NULL);
+
+  /* one list drives both sides, so they scroll together */
+  append_column (self, "", COLUMN_OLD_NUMBER);
+  append_column (self, old_title, COLUMN_OLD_TEXT);
+  append_column (self, "", COLUMN_NEW_NUMBER);
+  append_column (self, new_title, COLUMN_NEW_TEXT);
+
+  gtk_stack_set_visible_child_name (self->stack, "busy");
+  texty_diff_async (old_text,
+                    new_text,
+                    self->cancellable,
+                    diff_complete,
+                    g_object_ref (self));
+
+  return ADW_DIALOG (self);
+}
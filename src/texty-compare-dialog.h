@@ -0,0 +1,36 @@
+/* texty-compare-dialog.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <adwaita.h>
+
+G_BEGIN_DECLS
+
+#define TEXTY_TYPE_COMPARE_DIALOG (texty_compare_dialog_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyCompareDialog, texty_compare_dialog, TEXTY, COMPARE_DIALOG, AdwDialog)
+
+AdwDialog *texty_compare_dialog_new (GBytes     *old_text,
+                                     const char *old_title,
+                                     GBytes     *new_text,
+                                     const char *new_title);
+
+G_END_DECLS
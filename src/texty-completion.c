@@ -0,0 +1,393 @@
+/* texty-completion.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-completion.h"
+
+#include <string.h>
+
+#include "texty-word-index.h"
+
+/* characters typed before anything is proposed */
+#define MIN_PREFIX 3
+#define MAX_PROPOSALS 8
+/* how far back to look for the start of the word being typed */
+#define MAX_PREFIX 64
+
+struct _TextyCompletion
+{
+  GObject parent_instance;
+
+  GtkTextView *view;
+  GtkTextBuffer *buffer;
+  GtkWidget *popover;
+  GtkListBox *list;
+  /* added to the view, so taken off it again */
+  GtkEventController *key_controller;
+  GtkEventController *focus_controller;
+  GtkEventController *click_controller;
+
+  /* set while a proposal is being inserted */
+  gboolean accepting;
+};
+
+G_DEFINE_FINAL_TYPE (TextyCompletion, texty_completion, G_TYPE_OBJECT)
+
+static inline gboolean
+is_word_char (gunichar c)
+{
+  return c == '_' || g_unichar_isalnum (c);
+}
+
+/*
+ * The part of the word before the cursor, with 'start' set to where it
+ * begins, or NULL when the cursor is not at the end of a word.
+ */
+static char *
+get_prefix (TextyCompletion *self,
+            GtkTextIter *start)
+{
+  GtkTextIter cursor;
+
+  gtk_text_buffer_get_iter_at_mark (self->buffer, &cursor, gtk_text_buffer_get_insert (self->buffer));
+  if (is_word_char (gtk_text_iter_get_char (&cursor)))
+    return NULL;
+
+  *start = cursor;
+  for (int i = 0; i < MAX_PREFIX && !gtk_text_iter_is_start (start); i++)
+    {
+      GtkTextIter previous = *start;
+
+      gtk_text_iter_backward_char (&previous);
+      if (!is_word_char (gtk_text_iter_get_char (&previous)))
+        break;
+      *start = previous;
+    }
+
+  if (gtk_text_iter_get_offset (&cursor) - gtk_text_iter_get_offset (start) < MIN_PREFIX)
+    return NULL;
+
+  return gtk_text_iter_get_slice (start, &cursor);
+}
+
+static void
+hide (TextyCompletion *self)
+{
+  if (gtk_widget_get_visible (self->popover))
+    gtk_popover_popdown (GTK_POPOVER (self->popover));
+}
+
+/* proposes the indexed words that finish the one being typed */
+static void
+refresh (TextyCompletion *self)
+{
+  g_autofree char *prefix = NULL;
+  g_auto (GStrv) proposals = NULL;
+  GtkTextIter start;
+  GdkRectangle rect;
+
+  prefix = get_prefix (self, &start);
+  if (prefix != NULL)
+    proposals = texty_word_index_complete (texty_word_index_get_default (), prefix, MAX_PROPOSALS);
+
+  if (proposals == NULL || proposals[0] == NULL)
+    {
+      hide (self);
+      return;
+    }
+
+  gtk_list_box_remove_all (self->list);
+  for (guint i = 0; proposals[i] != NULL; i++)
+    {
+      GtkWidget *label = gtk_label_new (proposals[i]);
+
+      gtk_label_set_xalign (GTK_LABEL (label), 0);
+      gtk_list_box_append (self->list, label);
+    }
+  gtk_list_box_select_row (self->list, gtk_list_box_get_row_at_index (self->list, 0));
+
+  /* under the start of the word, so the list stays put while typing */
+  gtk_text_view_get_iter_location (self->view, &start, &rect);
+  gtk_text_view_buffer_to_window_coords (self->view,
+                                         GTK_TEXT_WINDOW_WIDGET,
+                                         rect.x,
+                                         rect.y,
+                                         &rect.x,
+                                         &rect.y);
+  gtk_popover_set_pointing_to (GTK_POPOVER (self->popover), &rect);
+
+  if (gtk_widget_get_visible (self->popover))
+    gtk_popover_present (GTK_POPOVER (self->popover));
+  else
+    gtk_popover_popup (GTK_POPOVER (self->popover));
+}
+
+static void
+accept (TextyCompletion *self,
+        GtkListBoxRow *row)
+{
+  g_autofree char *prefix = NULL;
+  const char *word;
+  GtkTextIter start;
+
+  if (row == NULL)
+    return;
+
+  word = gtk_label_get_label (GTK_LABEL (gtk_list_box_row_get_child (row)));
+  prefix = get_prefix (self, &start);
+  hide (self);
+  if (prefix == NULL || !g_str_has_prefix (word, prefix))
+    return;
+
+  self->accepting = TRUE;
+  gtk_text_buffer_begin_user_action (self->buffer);
+  gtk_text_buffer_insert_at_cursor (self->buffer, word + strlen (prefix), -1);
+  gtk_text_buffer_end_user_action (self->buffer);
+  self->accepting = FALSE;
+}
+
+static void
+on_row_activated (GtkListBox *list,
+                  GtkListBoxRow *row,
+                  TextyCompletion *self)
+{
+  accept (self, row);
+}
+
+static void
+move_selection (TextyCompletion *self,
+                int step)
+{
+  GtkListBoxRow *row = gtk_list_box_get_selected_row (self->list);
+  int index = row != NULL ? gtk_list_box_row_get_index (row) + step : 0;
+
+  row = gtk_list_box_get_row_at_index (self->list, MAX (index, 0));
+  if (row != NULL)
+    gtk_list_box_select_row (self->list, row);
+}
+
+/* while proposals are shown, the keys that pick them are taken from the view */
+static gboolean
+on_key_pressed (GtkEventControllerKey *controller,
+                guint keyval,
+                guint keycode,
+                GdkModifierType state,
+                TextyCompletion *self)
+{
+  if (!gtk_widget_get_visible (self->popover))
+    return GDK_EVENT_PROPAGATE;
+
+  switch (keyval)
+    {
+    case GDK_KEY_Down:
+    case GDK_KEY_KP_Down:
+      move_selection (self, 1);
+      return GDK_EVENT_STOP;
+
+    case GDK_KEY_Up:
+    case GDK_KEY_KP_Up:
+      move_selection (self, -1);
+      return GDK_EVENT_STOP;
+
+    case GDK_KEY_Return:
+    case GDK_KEY_KP_Enter:
+    case GDK_KEY_Tab:
+      accept (self, gtk_list_box_get_selected_row (self->list));
+      return GDK_EVENT_STOP;
+
+    case GDK_KEY_Escape:
+      hide (self);
+      return GDK_EVENT_STOP;
+
+    case GDK_KEY_Left:
+    case GDK_KEY_Right:
+    case GDK_KEY_Home:
+    case GDK_KEY_End:
+    case GDK_KEY_Page_Up:
+    case GDK_KEY_Page_Down:
+      hide (self);
+      return GDK_EVENT_PROPAGATE;
+
+    default:
+      return GDK_EVENT_PROPAGATE;
+    }
+}
+
+static void
+on_focus_leave (GtkEventControllerFocus *controller,
+                TextyCompletion *self)
+{
+  hide (self);
+}
+
+static void
+on_pressed (GtkGestureClick *gesture,
+            int n_press,
+            double x,
+            double y,
+            TextyCompletion *self)
+{
+  hide (self);
+}
+
+/* only typing a word character proposes anything, and only at the cursor */
+static void
+after_insert_text (GtkTextBuffer *buffer,
+                   GtkTextIter *location,
+                   const char *text,
+                   int length,
+                   TextyCompletion *self)
+{
+  GtkTextIter cursor;
+
+  if (self->accepting)
+    return;
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &cursor, gtk_text_buffer_get_insert (buffer));
+  if (g_utf8_strlen (text, length) != 1 ||
+      !is_word_char (g_utf8_get_char (text)) ||
+      !gtk_text_iter_equal (location, &cursor))
+    {
+      hide (self);
+      return;
+    }
+
+  refresh (self);
+}
+
+static void
+after_delete_range (GtkTextBuffer *buffer,
+                    GtkTextIter *start,
+                    GtkTextIter *end,
+                    TextyCompletion *self)
+{
+  if (gtk_widget_get_visible (self->popover))
+    refresh (self);
+}
+
+static void
+set_buffer (TextyCompletion *self,
+            GtkTextBuffer *buffer)
+{
+  if (self->buffer != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (self->buffer, self);
+      g_clear_object (&self->buffer);
+    }
+
+  hide (self);
+  if (buffer == NULL)
+    return;
+
+  /* connected first, so the index has the new text by the time it is asked */
+  texty_word_index_watch (texty_word_index_get_default (), buffer);
+
+  self->buffer = g_object_ref (buffer);
+  g_signal_connect_after (buffer, "insert-text", G_CALLBACK (after_insert_text), self);
+  g_signal_connect_after (buffer, "delete-range", G_CALLBACK (after_delete_range), self);
+}
+
+static void
+on_notify_buffer (GtkTextView *view,
+                  GParamSpec *pspec,
+                  TextyCompletion *self)
+{
+  set_buffer (self, gtk_text_view_get_buffer (view));
+}
+
+static void
+texty_completion_dispose (GObject *object)
+{
+  TextyCompletion *self = TEXTY_COMPLETION (object);
+
+  if (self->view != NULL)
+    {
+      set_buffer (self, NULL);
+      g_signal_handlers_disconnect_by_data (self->view, self);
+      gtk_widget_remove_controller (GTK_WIDGET (self->view), self->key_controller);
+      gtk_widget_remove_controller (GTK_WIDGET (self->view), self->focus_controller);
+      gtk_widget_remove_controller (GTK_WIDGET (self->view), self->click_controller);
+      g_clear_pointer (&self->popover, gtk_widget_unparent);
+      self->view = NULL;
+    }
+
+  G_OBJECT_CLASS (texty_completion_parent_class)->dispose (object);
+}
+
+static void
+texty_completion_class_init (TextyCompletionClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = texty_completion_dispose;
+}
+
+static void
+texty_completion_init (TextyCompletion *self)
+{
+}
+
+/*
+ * Proposes words from every open document to finish the word being typed
+ * in 'view', in a popover that leaves the keyboard focus in the view. The
+ * view must outlive the completion.
+ */
+TextyCompletion *
+texty_completion_new (GtkTextView *view)
+{
+  TextyCompletion *self;
+
+  g_return_val_if_fail (GTK_IS_TEXT_VIEW (view), NULL);
+
+  self = g_object_new (TEXTY_TYPE_COMPLETION, NULL);
+  self->view = view;
+
+  self->list = GTK_LIST_BOX (gtk_list_box_new ());
+  gtk_list_box_set_selection_mode (self->list, GTK_SELECTION_SINGLE);
+  g_signal_connect (self->list, "row-activated", G_CALLBACK (on_row_activated), self);
+
+  self->popover = gtk_popover_new ();
+  gtk_popover_set_child (GTK_POPOVER (self->popover), GTK_WIDGET (self->list));
+  gtk_popover_set_autohide (GTK_POPOVER (self->popover), FALSE);
+  gtk_popover_set_has_arrow (GTK_POPOVER (self->popover), FALSE);
+  gtk_popover_set_position (GTK_POPOVER (self->popover), GTK_POS_BOTTOM);
+  gtk_widget_set_halign (self->popover, GTK_ALIGN_START);
+  gtk_widget_set_can_focus (self->popover, FALSE);
+  gtk_widget_add_css_class (self->popover, "menu");
+  gtk_widget_set_parent (self->popover, GTK_WIDGET (view));
+
+  self->key_controller = gtk_event_controller_key_new ();
+  gtk_event_controller_set_propagation_phase (self->key_controller, GTK_PHASE_CAPTURE);
+  g_signal_connect (self->key_controller, "key-pressed", G_CALLBACK (on_key_pressed), self);
+  gtk_widget_add_controller (GTK_WIDGET (view), self->key_controller);
+
+  self->focus_controller = gtk_event_controller_focus_new ();
+  g_signal_connect (self->focus_controller, "leave", G_CALLBACK (on_focus_leave), self);
+  gtk_widget_add_controller (GTK_WIDGET (view), self->focus_controller);
+
+  self->click_controller = GTK_EVENT_CONTROLLER (gtk_gesture_click_new ());
+  g_signal_connect (self->click_controller, "pressed", G_CALLBACK (on_pressed), self);
+  gtk_widget_add_controller (GTK_WIDGET (view), self->click_controller);
+
+  g_signal_connect (view, "notify::buffer", G_CALLBACK (on_notify_buffer), self);
+  set_buffer (self, gtk_text_view_get_buffer (view));
+
+  return self;
+}
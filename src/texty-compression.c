@@ -0,0 +1,324 @@
+/* texty-compression.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-compression.h"
+
+#include <string.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+static const guint8 gzip_magic[] = { 0x1f, 0x8b };
+static const guint8 zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+TextyCompression
+texty_compression_detect (const guint8 *data,
+                          gsize length)
+{
+  if (length >= sizeof gzip_magic && memcmp (data, gzip_magic, sizeof gzip_magic) == 0)
+    return TEXTY_COMPRESSION_GZIP;
+  if (length >= sizeof zstd_magic && memcmp (data, zstd_magic, sizeof zstd_magic) == 0)
+    return TEXTY_COMPRESSION_ZSTD;
+  return TEXTY_COMPRESSION_NONE;
+}
+
+/* used for files that have never been read, e.g. the target of a "Save As" */
+TextyCompression
+texty_compression_from_file (GFile *file)
+{
+  g_autofree char *basename = g_file_get_basename (file);
+
+  if (basename == NULL)
+    return TEXTY_COMPRESSION_NONE;
+  if (g_str_has_suffix (basename, ".gz"))
+    return TEXTY_COMPRESSION_GZIP;
+  if (g_str_has_suffix (basename, ".zst"))
+    return TEXTY_COMPRESSION_ZSTD;
+  return TEXTY_COMPRESSION_NONE;
+}
+
+/**********************************/
+/* Detection 👆️                   */
+/**********************************/
+
+#ifdef HAVE_ZSTD
+
+#define TEXTY_TYPE_ZSTD_CONVERTER (texty_zstd_converter_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyZstdConverter, texty_zstd_converter, TEXTY, ZSTD_CONVERTER, GObject)
+
+struct _TextyZstdConverter
+{
+  GObject parent_instance;
+
+  ZSTD_CCtx *cctx;
+  ZSTD_DCtx *dctx;
+  /* the last frame decoded was complete, and nothing has been fed since */
+  gboolean frame_done;
+};
+
+static void texty_zstd_converter_iface_init (GConverterIface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE (TextyZstdConverter,
+                               texty_zstd_converter,
+                               G_TYPE_OBJECT,
+                               G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER,
+                                                      texty_zstd_converter_iface_init))
+
+static GConverterResult
+compress (TextyZstdConverter *self,
+          ZSTD_inBuffer *in,
+          ZSTD_outBuffer *out,
+          GConverterFlags flags,
+          GError **error)
+{
+  ZSTD_EndDirective mode;
+  size_t remaining;
+
+  if (flags & G_CONVERTER_INPUT_AT_END)
+    mode = ZSTD_e_end;
+  else if (flags & G_CONVERTER_FLUSH)
+    mode = ZSTD_e_flush;
+  else
+    mode = ZSTD_e_continue;
+
+  remaining = ZSTD_compressStream2 (self->cctx, out, in, mode);
+  if (ZSTD_isError (remaining))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "zstd compression failed: %s", ZSTD_getErrorName (remaining));
+      return G_CONVERTER_ERROR;
+    }
+
+  /* zstd wants 'remaining' more bytes of room to finish the frame */
+  if (remaining == 0 && in->pos == in->size)
+    {
+      if (mode == ZSTD_e_end)
+        return G_CONVERTER_FINISHED;
+      if (mode == ZSTD_e_flush)
+        return G_CONVERTER_FLUSHED;
+    }
+
+  return G_CONVERTER_CONVERTED;
+}
+
+static GConverterResult
+decompress (TextyZstdConverter *self,
+            ZSTD_inBuffer *in,
+            ZSTD_outBuffer *out,
+            GConverterFlags flags,
+            GError **error)
+{
+  size_t hint;
+
+  /*
+   * the end usually comes as a last call without input, after the frame
+   * was completed by the one before; asked again, zstd would hint at the
+   * header of a next frame instead
+   */
+  if (in->size == 0 && self->frame_done && (flags & G_CONVERTER_INPUT_AT_END))
+    return G_CONVERTER_FINISHED;
+
+  hint = ZSTD_decompressStream (self->dctx, out, in);
+  if (ZSTD_isError (hint))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Invalid zstd data: %s", ZSTD_getErrorName (hint));
+      return G_CONVERTER_ERROR;
+    }
+
+  /* a hint of zero means the frame is complete and everything is flushed */
+  if (in->pos > 0)
+    self->frame_done = FALSE;
+  if (hint == 0)
+    self->frame_done = TRUE;
+  if (hint == 0 && in->pos == in->size && (flags & G_CONVERTER_INPUT_AT_END))
+    return G_CONVERTER_FINISHED;
+
+  if (in->pos == 0 && out->pos == 0 && in->size == 0)
+    {
+      if (flags & G_CONVERTER_INPUT_AT_END)
+        {
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                               "Truncated zstd data");
+          return G_CONVERTER_ERROR;
+        }
+      if (flags & G_CONVERTER_FLUSH)
+        return G_CONVERTER_FLUSHED;
+    }
+
+  return G_CONVERTER_CONVERTED;
+}
+
+static GConverterResult
+texty_zstd_converter_convert (GConverter *converter,
+                              const void *inbuf,
+                              gsize inbuf_size,
+                              void *outbuf,
+                              gsize outbuf_size,
+                              GConverterFlags flags,
+                              gsize *bytes_read,
+                              gsize *bytes_written,
+                              GError **error)
+{
+  TextyZstdConverter *self = TEXTY_ZSTD_CONVERTER (converter);
+  ZSTD_inBuffer in = { inbuf, inbuf_size, 0 };
+  ZSTD_outBuffer out = { outbuf, outbuf_size, 0 };
+  GConverterResult result;
+
+  if (self->cctx != NULL)
+    result = compress (self, &in, &out, flags, error);
+  else
+    result = decompress (self, &in, &out, flags, error);
+
+  if (result == G_CONVERTER_ERROR)
+    return result;
+
+  *bytes_read = in.pos;
+  *bytes_written = out.pos;
+
+  /* no progress at all with input still pending means the output is too small */
+  if (result == G_CONVERTER_CONVERTED && in.pos == 0 && out.pos == 0)
+    {
+      if (inbuf_size == 0 && !(flags & (G_CONVERTER_INPUT_AT_END | G_CONVERTER_FLUSH)))
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                             "Need more input");
+      else
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+                             "Not enough space in output buffer");
+      return G_CONVERTER_ERROR;
+    }
+
+  return result;
+}
+
+static void
+texty_zstd_converter_reset (GConverter *converter)
+{
+  TextyZstdConverter *self = TEXTY_ZSTD_CONVERTER (converter);
+
+  if (self->cctx != NULL)
+    ZSTD_CCtx_reset (self->cctx, ZSTD_reset_session_only);
+  if (self->dctx != NULL)
+    ZSTD_DCtx_reset (self->dctx, ZSTD_reset_session_only);
+  self->frame_done = FALSE;
+}
+
+static void
+texty_zstd_converter_iface_init (GConverterIface *iface)
+{
+  iface->convert = texty_zstd_converter_convert;
+  iface->reset = texty_zstd_converter_reset;
+}
+
+static void
+texty_zstd_converter_finalize (GObject *object)
+{
+  TextyZstdConverter *self = TEXTY_ZSTD_CONVERTER (object);
+
+  g_clear_pointer (&self->cctx, ZSTD_freeCCtx);
+  g_clear_pointer (&self->dctx, ZSTD_freeDCtx);
+
+  G_OBJECT_CLASS (texty_zstd_converter_parent_class)->finalize (object);
+}
+
+static void
+texty_zstd_converter_class_init (TextyZstdConverterClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = texty_zstd_converter_finalize;
+}
+
+static void
+texty_zstd_converter_init (TextyZstdConverter *self)
+{
+}
+
+static GConverter *
+texty_zstd_converter_new (gboolean compressor)
+{
+  TextyZstdConverter *self = g_object_new (TEXTY_TYPE_ZSTD_CONVERTER, NULL);
+
+  if (compressor)
+    {
+      self->cctx = ZSTD_createCCtx ();
+      /* spread the work over the cores when libzstd was built with threads */
+      ZSTD_CCtx_setParameter (self->cctx, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
+      ZSTD_CCtx_setParameter (self->cctx, ZSTD_c_nbWorkers, (int) g_get_num_processors ());
+    }
+  else
+    {
+      self->dctx = ZSTD_createDCtx ();
+    }
+
+  return G_CONVERTER (self);
+}
+
+#endif /* HAVE_ZSTD */
+
+/**********************************/
+/* Zstd converter 👆️              */
+/**********************************/
+
+static GConverter *
+new_converter (TextyCompression compression,
+               gboolean compressor,
+               GError **error)
+{
+  switch (compression)
+    {
+    case TEXTY_COMPRESSION_GZIP:
+      if (compressor)
+        return G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+      return G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+
+    case TEXTY_COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+      return texty_zstd_converter_new (compressor);
+#else
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "texty was built without zstd support");
+      return NULL;
+#endif
+
+    case TEXTY_COMPRESSION_NONE:
+    default:
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                           "Not a compressed format");
+      return NULL;
+    }
+}
+
+GConverter *
+texty_compression_new_compressor (TextyCompression compression,
+                                  GError **error)
+{
+  return new_converter (compression, TRUE, error);
+}
+
+GConverter *
+texty_compression_new_decompressor (TextyCompression compression,
+                                    GError **error)
+{
+  return new_converter (compression, FALSE, error);
+}
@@ -0,0 +1,45 @@
+/* texty-compression.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  TEXTY_COMPRESSION_NONE,
+  TEXTY_COMPRESSION_GZIP,
+  TEXTY_COMPRESSION_ZSTD,
+} TextyCompression;
+
+/* enough leading bytes to recognise every supported format */
+#define TEXTY_COMPRESSION_MAGIC_LENGTH 4
+
+TextyCompression  texty_compression_detect            (const guint8     *data,
+                                                       gsize             length);
+TextyCompression  texty_compression_from_file         (GFile            *file);
+GConverter       *texty_compression_new_compressor    (TextyCompression  compression,
+                                                       GError          **error);
+GConverter       *texty_compression_new_decompressor  (TextyCompression  compression,
+                                                       GError          **error);
+
+G_END_DECLS
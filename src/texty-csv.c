@@ -0,0 +1,631 @@
+/* texty-csv.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-csv.h"
+
+#include <string.h>
+
+/* small enough that the first rows are listed at once */
+#define CHUNK_SIZE (4 * 1024 * 1024)
+/* fields are cut short for display, on a character boundary */
+#define MAX_DISPLAY_LENGTH 1000
+#define QUOTED_BIT 0x80000000u
+
+G_STATIC_ASSERT (CHUNK_SIZE < QUOTED_BIT);
+
+/* a field of a record, quotes excluded */
+typedef struct
+{
+  gsize start;
+  gsize end;
+  gboolean quoted;
+} Span;
+
+struct _TextyCsvRow
+{
+  GObject parent_instance;
+
+  GBytes *data;
+  guint number;
+  GArray *fields;
+};
+
+G_DEFINE_FINAL_TYPE (TextyCsvRow, texty_csv_row, G_TYPE_OBJECT)
+
+static void
+texty_csv_row_finalize (GObject *object)
+{
+  TextyCsvRow *self = TEXTY_CSV_ROW (object);
+
+  g_bytes_unref (self->data);
+  g_array_unref (self->fields);
+
+  G_OBJECT_CLASS (texty_csv_row_parent_class)->finalize (object);
+}
+
+static void
+texty_csv_row_class_init (TextyCsvRowClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = texty_csv_row_finalize;
+}
+
+static void
+texty_csv_row_init (TextyCsvRow *self)
+{
+  self->fields = g_array_new (FALSE, FALSE, sizeof (Span));
+}
+
+/*
+ * Splits the record between 'start' and 'end' into its fields. A quoted
+ * field runs to the closing quote, stepping over doubled ones, and may
+ * hold delimiters and line breaks of its own.
+ */
+static TextyCsvRow *
+texty_csv_row_new (GBytes *data,
+                   gsize start,
+                   gsize end,
+                   char delimiter,
+                   guint number)
+{
+  TextyCsvRow *self;
+  const char *text = g_bytes_get_data (data, NULL);
+  const char *found;
+  gsize p = start;
+
+  self = g_object_new (TEXTY_TYPE_CSV_ROW, NULL);
+  self->data = g_bytes_ref (data);
+  self->number = number;
+
+  for (;;)
+    {
+      Span span;
+
+      if (p < end && text[p] == '"')
+        {
+          span.quoted = TRUE;
+          span.start = ++p;
+          for (;;)
+            {
+              found = memchr (text + p, '"', end - p);
+              if (found == NULL)
+                {
+                  p = end;
+                  break;
+                }
+              p = found - text;
+              if (p + 1 < end && text[p + 1] == '"')
+                {
+                  p += 2;
+                  continue;
+                }
+              break;
+            }
+          span.end = p;
+          /* anything between the closing quote and the delimiter is dropped */
+          found = memchr (text + p, delimiter, end - p);
+          p = found != NULL ? (gsize) (found - text) : end;
+        }
+      else
+        {
+          span.quoted = FALSE;
+          span.start = p;
+          found = memchr (text + p, delimiter, end - p);
+          p = span.end = found != NULL ? (gsize) (found - text) : end;
+        }
+
+      g_array_append_val (self->fields, span);
+      if (p >= end)
+        break;
+      p++;
+    }
+
+  return self;
+}
+
+/* one based, counting the data rows after the header */
+guint
+texty_csv_row_get_number (TextyCsvRow *self)
+{
+  g_return_val_if_fail (TEXTY_IS_CSV_ROW (self), 0);
+
+  return self->number;
+}
+
+/*
+ * Returns the text of field 'column' for display, unquoted, on one line
+ * and cut short when long, or NULL when the row has fewer fields.
+ */
+char *
+texty_csv_row_get_field (TextyCsvRow *self,
+                         guint column)
+{
+  const char *text;
+  const Span *span;
+  GString *field;
+  gsize length;
+
+  g_return_val_if_fail (TEXTY_IS_CSV_ROW (self), NULL);
+
+  if (column >= self->fields->len)
+    return NULL;
+
+  text = g_bytes_get_data (self->data, NULL);
+  span = &g_array_index (self->fields, Span, column);
+  length = span->end - span->start;
+  if (length > MAX_DISPLAY_LENGTH)
+    {
+      length = MAX_DISPLAY_LENGTH;
+      while (length > 0 && (text[span->start + length] & 0xc0) == 0x80)
+        length--;
+    }
+
+  field = g_string_sized_new (length);
+  for (gsize i = span->start; i < span->start + length; i++)
+    {
+      char c = text[i];
+
+      /* a doubled quote stands for one */
+      if (span->quoted && c == '"' && i + 1 < span->end && text[i + 1] == '"')
+        i++;
+      else if (c == '\n' || c == '\r' || c == '\t')
+        c = ' ';
+      g_string_append_c (field, c);
+    }
+
+  if (!g_utf8_validate_len (field->str, field->len, NULL))
+    {
+      char *valid = g_utf8_make_valid (field->str, field->len);
+
+      g_string_free (field, TRUE);
+      return valid;
+    }
+
+  return g_string_free (field, FALSE);
+}
+
+/**********************************/
+/* Row 👆️                         */
+/**********************************/
+
+typedef struct
+{
+  gsize start;
+  gsize end;
+  /*
+   * The offset of each line break from 'start', with QUOTED_BIT set when an
+   * odd number of quotes come before it in the chunk. Whether it ends a
+   * record depends on the quotes in the chunks before, not known yet.
+   */
+  GArray *breaks;
+  /* an odd number of quotes in the whole chunk */
+  gboolean odd;
+  gboolean done;
+} Chunk;
+
+struct _TextyCsvModel
+{
+  GObject parent_instance;
+
+  GBytes *data;
+  char delimiter;
+  /* names the columns, and is not listed */
+  TextyCsvRow *header;
+
+  /* where each record starts, the header's included */
+  GArray *starts;
+  gboolean complete;
+
+  GThreadPool *pool;
+  GCancellable *cancellable;
+  Chunk *chunks;
+  guint n_chunks;
+  /* the first chunk not yet turned into records, and whether it starts inside quotes */
+  guint next_chunk;
+  gboolean in_quotes;
+};
+
+static void texty_csv_model_list_model_init (GListModelInterface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE (TextyCsvModel,
+                               texty_csv_model,
+                               G_TYPE_OBJECT,
+                               G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL,
+                                                      texty_csv_model_list_model_init))
+
+static guint
+count_rows (TextyCsvModel *self)
+{
+  /* until the end is reached, the last record may run on into the next chunk */
+  guint n_records = self->complete ? self->starts->len : self->starts->len - 1;
+
+  return n_records > 0 ? n_records - 1 : 0;
+}
+
+static GType
+texty_csv_model_get_item_type (GListModel *list)
+{
+  return TEXTY_TYPE_CSV_ROW;
+}
+
+static guint
+texty_csv_model_get_n_items (GListModel *list)
+{
+  return count_rows (TEXTY_CSV_MODEL (list));
+}
+
+/* rows are only split into fields when the view asks for them, as it scrolls */
+static gpointer
+texty_csv_model_get_item (GListModel *list,
+                          guint position)
+{
+  TextyCsvModel *self = TEXTY_CSV_MODEL (list);
+  const char *text = g_bytes_get_data (self->data, NULL);
+  guint record = position + 1;
+  gsize start;
+  gsize end;
+
+  if (position >= count_rows (self))
+    return NULL;
+
+  start = g_array_index (self->starts, guint64, record);
+  if (record + 1 < self->starts->len)
+    end = g_array_index (self->starts, guint64, record + 1) - 1;
+  else
+    end = g_bytes_get_size (self->data);
+  if (end > start && text[end - 1] == '\r')
+    end--;
+
+  return texty_csv_row_new (self->data, start, end, self->delimiter, record);
+}
+
+static void
+texty_csv_model_list_model_init (GListModelInterface *iface)
+{
+  iface->get_item_type = texty_csv_model_get_item_type;
+  iface->get_n_items = texty_csv_model_get_n_items;
+  iface->get_item = texty_csv_model_get_item;
+}
+
+/*
+ * Runs in a worker: notes every line break in the chunk and the quote
+ * parity before it, hopping between both with the vectorized memchr.
+ */
+static void
+scan_chunk (Chunk *chunk,
+            const char *text)
+{
+  const char *end = text + chunk->end;
+  const char *base = text + chunk->start;
+  const char *quote = memchr (base, '"', end - base);
+  const char *newline = memchr (base, '\n', end - base);
+  guint32 parity = 0;
+
+  while (newline != NULL)
+    {
+      guint32 offset;
+
+      while (quote != NULL && quote < newline)
+        {
+          parity ^= QUOTED_BIT;
+          quote = memchr (quote + 1, '"', end - quote - 1);
+        }
+
+      offset = (newline - base) | parity;
+      g_array_append_val (chunk->breaks, offset);
+      newline = memchr (newline + 1, '\n', end - newline - 1);
+    }
+
+  while (quote != NULL)
+    {
+      parity ^= QUOTED_BIT;
+      quote = memchr (quote + 1, '"', end - quote - 1);
+    }
+  chunk->odd = parity != 0;
+}
+
+/*
+ * Turns the chunks scanned so far, in order, into records. Each chunk's
+ * line breaks end a record when they are outside quotes, which is known
+ * once the quotes of every chunk before it have been counted.
+ */
+static void
+publish_chunks (TextyCsvModel *self)
+{
+  guint n_rows = count_rows (self);
+  gsize length = g_bytes_get_size (self->data);
+
+  while (self->next_chunk < self->n_chunks && self->chunks[self->next_chunk].done)
+    {
+      Chunk *chunk = &self->chunks[self->next_chunk];
+      guint32 in_quotes = self->in_quotes ? QUOTED_BIT : 0;
+
+      for (guint i = 0; i < chunk->breaks->len; i++)
+        {
+          guint32 offset = g_array_index (chunk->breaks, guint32, i);
+
+          if ((offset & QUOTED_BIT) == in_quotes)
+            {
+              guint64 start = chunk->start + (offset & ~QUOTED_BIT) + 1;
+
+              g_array_append_val (self->starts, start);
+            }
+        }
+
+      self->in_quotes ^= chunk->odd;
+      g_clear_pointer (&chunk->breaks, g_array_unref);
+      self->next_chunk++;
+    }
+
+  if (self->next_chunk == self->n_chunks && !self->complete)
+    {
+      self->complete = TRUE;
+      /* a final line break does not start another record */
+      if (g_array_index (self->starts, guint64, self->starts->len - 1) == length)
+        g_array_set_size (self->starts, self->starts->len - 1);
+    }
+
+  if (count_rows (self) != n_rows)
+    g_list_model_items_changed (G_LIST_MODEL (self), n_rows, 0, count_rows (self) - n_rows);
+}
+
+typedef struct
+{
+  TextyCsvModel *self;
+  guint index;
+} ChunkDone;
+
+static void
+chunk_done_free (ChunkDone *done)
+{
+  g_object_unref (done->self);
+  g_free (done);
+}
+
+static gboolean
+on_chunk_done (gpointer user_data)
+{
+  ChunkDone *done = user_data;
+
+  if (!g_cancellable_is_cancelled (done->self->cancellable))
+    {
+      done->self->chunks[done->index].done = TRUE;
+      publish_chunks (done->self);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+scan_thread (gpointer data,
+             gpointer user_data)
+{
+  TextyCsvModel *self = user_data;
+  guint index = GPOINTER_TO_UINT (data) - 1;
+  ChunkDone *done;
+
+  if (g_cancellable_is_cancelled (self->cancellable))
+    return;
+
+  scan_chunk (&self->chunks[index], g_bytes_get_data (self->data, NULL));
+
+  done = g_new0 (ChunkDone, 1);
+  done->self = g_object_ref (self);
+  done->index = index;
+  g_main_context_invoke_full (NULL,
+                              G_PRIORITY_DEFAULT,
+                              on_chunk_done,
+                              done,
+                              (GDestroyNotify) chunk_done_free);
+}
+
+static void
+texty_csv_model_dispose (GObject *object)
+{
+  TextyCsvModel *self = TEXTY_CSV_MODEL (object);
+
+  g_cancellable_cancel (self->cancellable);
+  /* drops the chunks still queued, waiting only for those being scanned */
+  if (self->pool != NULL)
+    g_thread_pool_free (g_steal_pointer (&self->pool), TRUE, TRUE);
+
+  G_OBJECT_CLASS (texty_csv_model_parent_class)->dispose (object);
+}
+
+static void
+texty_csv_model_finalize (GObject *object)
+{
+  TextyCsvModel *self = TEXTY_CSV_MODEL (object);
+
+  for (guint i = 0; i < self->n_chunks; i++)
+    g_clear_pointer (&self->chunks[i].breaks, g_array_unref);
+  g_free (self->chunks);
+  g_array_unref (self->starts);
+  g_clear_object (&self->header);
+  g_clear_object (&self->cancellable);
+  g_bytes_unref (self->data);
+
+  G_OBJECT_CLASS (texty_csv_model_parent_class)->finalize (object);
+}
+
+static void
+texty_csv_model_class_init (TextyCsvModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = texty_csv_model_dispose;
+  object_class->finalize = texty_csv_model_finalize;
+}
+
+static void
+texty_csv_model_init (TextyCsvModel *self)
+{
+  guint64 start = 0;
+
+  self->cancellable = g_cancellable_new ();
+  self->starts = g_array_new (FALSE, FALSE, sizeof (guint64));
+  g_array_append_val (self->starts, start);
+}
+
+/* where the first record ends, quoted line breaks and all */
+static gsize
+find_header_end (const char *text,
+                 gsize length)
+{
+  gboolean quoted = FALSE;
+
+  for (gsize i = 0; i < length; i++)
+    {
+      if (text[i] == '"')
+        quoted = !quoted;
+      else if (text[i] == '\n' && !quoted)
+        return i;
+    }
+
+  return length;
+}
+
+/*
+ * Lists the records of the CSV in 'data' after the first, which names the
+ * columns. The data is split into chunks that are scanned for line breaks
+ * in parallel, each worker also counting the quotes before every break,
+ * and the records appear in order as soon as the chunks before them are
+ * done, so the first rows show while the rest is still being read. 'data'
+ * is only referenced, so it may well be a mapped file.
+ */
+TextyCsvModel *
+texty_csv_model_new (GBytes *data,
+                     char delimiter)
+{
+  TextyCsvModel *self;
+  const char *text;
+  gsize length;
+  gsize header_end;
+
+  g_return_val_if_fail (data != NULL, NULL);
+
+  self = g_object_new (TEXTY_TYPE_CSV_MODEL, NULL);
+  self->data = g_bytes_ref (data);
+  self->delimiter = delimiter;
+
+  text = g_bytes_get_data (data, &length);
+  header_end = find_header_end (text, length);
+  self->header = texty_csv_row_new (data,
+                                    0,
+                                    header_end > 0 && text[header_end - 1] == '\r' ? header_end - 1 : header_end,
+                                    delimiter,
+                                    0);
+
+  self->n_chunks = (length + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  self->chunks = g_new0 (Chunk, self->n_chunks);
+  for (guint i = 0; i < self->n_chunks; i++)
+    {
+      self->chunks[i].start = (gsize) i * CHUNK_SIZE;
+      self->chunks[i].end = MIN (self->chunks[i].start + CHUNK_SIZE, length);
+      self->chunks[i].breaks = g_array_new (FALSE, FALSE, sizeof (guint32));
+    }
+
+  if (self->n_chunks == 0)
+    {
+      publish_chunks (self);
+      return self;
+    }
+
+  self->pool = g_thread_pool_new (scan_thread,
+                                  self,
+                                  g_get_num_processors (),
+                                  FALSE,
+                                  NULL);
+  /* queued in order, so the first rows are ready first */
+  for (guint i = 0; i < self->n_chunks; i++)
+    g_thread_pool_push (self->pool, GUINT_TO_POINTER (i + 1), NULL);
+
+  return self;
+}
+
+guint
+texty_csv_model_get_n_columns (TextyCsvModel *self)
+{
+  g_return_val_if_fail (TEXTY_IS_CSV_MODEL (self), 0);
+
+  return self->header->fields->len;
+}
+
+char *
+texty_csv_model_get_title (TextyCsvModel *self,
+                           guint column)
+{
+  g_return_val_if_fail (TEXTY_IS_CSV_MODEL (self), NULL);
+
+  return texty_csv_row_get_field (self->header, column);
+}
+
+/**********************************/
+/* Model 👆️                       */
+/**********************************/
+
+/*
+ * Tabs for .tsv files, otherwise whichever of comma, semicolon, tab and
+ * bar turns up most often in the first line, outside quotes.
+ */
+char
+texty_csv_guess_delimiter (GBytes *data,
+                           const char *name)
+{
+  static const char candidates[] = { ',', ';', '\t', '|' };
+  guint counts[G_N_ELEMENTS (candidates)] = { 0 };
+  const char *text;
+  gsize length;
+  gboolean quoted = FALSE;
+  char best = ',';
+  guint best_count = 0;
+
+  g_return_val_if_fail (data != NULL, ',');
+
+  if (name != NULL && (g_str_has_suffix (name, ".tsv") || g_str_has_suffix (name, ".tab")))
+    return '\t';
+
+  text = g_bytes_get_data (data, &length);
+  for (gsize i = 0; i < length; i++)
+    {
+      if (text[i] == '"')
+        quoted = !quoted;
+      if (quoted)
+        continue;
+      if (text[i] == '\n')
+        break;
+      for (guint j = 0; j < G_N_ELEMENTS (candidates); j++)
+        if (text[i] == candidates[j])
+          counts[j]++;
+    }
+
+  for (guint j = 0; j < G_N_ELEMENTS (candidates); j++)
+    {
+      if (counts[j] > best_count)
+        {
+          best = candidates[j];
+          best_count = counts[j];
+        }
+    }
+
+  return best;
+}
@@ -0,0 +1,48 @@
+/* texty-csv.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define TEXTY_TYPE_CSV_ROW (texty_csv_row_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyCsvRow, texty_csv_row, TEXTY, CSV_ROW, GObject)
+
+guint          texty_csv_row_get_number      (TextyCsvRow   *self);
+char          *texty_csv_row_get_field       (TextyCsvRow   *self,
+                                              guint          column);
+
+#define TEXTY_TYPE_CSV_MODEL (texty_csv_model_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyCsvModel, texty_csv_model, TEXTY, CSV_MODEL, GObject)
+
+TextyCsvModel *texty_csv_model_new           (GBytes        *data,
+                                              char           delimiter);
+guint          texty_csv_model_get_n_columns (TextyCsvModel *self);
+char          *texty_csv_model_get_title     (TextyCsvModel *self,
+                                              guint          column);
+
+char           texty_csv_guess_delimiter     (GBytes        *data,
+                                              const char    *name);
+
+G_END_DECLS
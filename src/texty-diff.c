@@ -0,0 +1,857 @@
+/* texty-diff.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-diff.h"
+
+#include "texty-line-ending.h"
+
+#include <string.h>
+
+/* unchanged lines shown around each change */
+#define CONTEXT_LINES 3
+/* a label doesn't need more of a line than this */
+#define MAX_DISPLAY_LENGTH 4096
+
+typedef struct
+{
+  const char *text;
+  /* without the line break */
+  gsize length;
+} Line;
+
+typedef struct
+{
+  int old_line;
+  int new_line;
+  TextyDiffKind kind;
+  guint skipped;
+} Row;
+
+struct _TextyDiffRow
+{
+  GObject parent_instance;
+
+  TextyDiffKind kind;
+  int old_number;
+  char *old_text;
+  int new_number;
+  char *new_text;
+  guint skipped;
+};
+
+G_DEFINE_FINAL_TYPE (TextyDiffRow, texty_diff_row, G_TYPE_OBJECT)
+
+static void
+texty_diff_row_finalize (GObject *object)
+{
+  TextyDiffRow *self = TEXTY_DIFF_ROW (object);
+
+  g_free (self->old_text);
+  g_free (self->new_text);
+
+  G_OBJECT_CLASS (texty_diff_row_parent_class)->finalize (object);
+}
+
+static void
+texty_diff_row_class_init (TextyDiffRowClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = texty_diff_row_finalize;
+}
+
+static void
+texty_diff_row_init (TextyDiffRow *self)
+{
+}
+
+/* cut very long lines short, on a character boundary */
+static char *
+dup_line (const Line *line)
+{
+  gsize length = line->length;
+
+  if (length > MAX_DISPLAY_LENGTH)
+    {
+      length = MAX_DISPLAY_LENGTH;
+      while (length > 0 && (line->text[length] & 0xc0) == 0x80)
+        length--;
+    }
+
+  return g_strndup (line->text, length);
+}
+
+TextyDiffKind
+texty_diff_row_get_kind (TextyDiffRow *self)
+{
+  g_return_val_if_fail (TEXTY_IS_DIFF_ROW (self), TEXTY_DIFF_EQUAL);
+
+  return self->kind;
+}
+
+/* zero based, -1 when the row has no line on that side */
+int
+texty_diff_row_get_old_number (TextyDiffRow *self)
+{
+  g_return_val_if_fail (TEXTY_IS_DIFF_ROW (self), -1);
+
+  return self->old_number;
+}
+
+const char *
+texty_diff_row_get_old_text (TextyDiffRow *self)
+{
+  g_return_val_if_fail (TEXTY_IS_DIFF_ROW (self), NULL);
+
+  return self->old_text;
+}
+
+int
+texty_diff_row_get_new_number (TextyDiffRow *self)
+{
+  g_return_val_if_fail (TEXTY_IS_DIFF_ROW (self), -1);
+
+  return self->new_number;
+}
+
+const char *
+texty_diff_row_get_new_text (TextyDiffRow *self)
+{
+  g_return_val_if_fail (TEXTY_IS_DIFF_ROW (self), NULL);
+
+  return self->new_text;
+}
+
+/* how many unchanged lines a TEXTY_DIFF_SKIP row stands in for */
+guint
+texty_diff_row_get_skipped (TextyDiffRow *self)
+{
+  g_return_val_if_fail (TEXTY_IS_DIFF_ROW (self), 0);
+
+  return self->skipped;
+}
+
+/**********************************/
+/* Row 👆️                         */
+/**********************************/
+
+struct _TextyDiffModel
+{
+  GObject parent_instance;
+
+  /* the snapshots compared, lines only point into them */
+  GBytes *old_bytes;
+  GBytes *new_bytes;
+  Line *old_lines;
+  Line *new_lines;
+  GArray *rows;
+  guint n_changes;
+};
+
+static void texty_diff_model_list_model_init (GListModelInterface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE (TextyDiffModel,
+                               texty_diff_model,
+                               G_TYPE_OBJECT,
+                               G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL,
+                                                      texty_diff_model_list_model_init))
+
+static GType
+texty_diff_model_get_item_type (GListModel *list)
+{
+  return TEXTY_TYPE_DIFF_ROW;
+}
+
+static guint
+texty_diff_model_get_n_items (GListModel *list)
+{
+  return TEXTY_DIFF_MODEL (list)->rows->len;
+}
+
+/* items are only made for the rows the view asks for, as it scrolls */
+static gpointer
+texty_diff_model_get_item (GListModel *list,
+                           guint position)
+{
+  TextyDiffModel *self = TEXTY_DIFF_MODEL (list);
+  TextyDiffRow *item;
+  const Row *row;
+
+  if (position >= self->rows->len)
+    return NULL;
+  row = &g_array_index (self->rows, Row, position);
+
+  item = g_object_new (TEXTY_TYPE_DIFF_ROW, NULL);
+  item->kind = row->kind;
+  item->old_number = row->old_line;
+  item->new_number = row->new_line;
+  item->skipped = row->skipped;
+  if (row->kind != TEXTY_DIFF_SKIP)
+    {
+      if (row->old_line >= 0)
+        item->old_text = dup_line (&self->old_lines[row->old_line]);
+      if (row->new_line >= 0)
+        item->new_text = dup_line (&self->new_lines[row->new_line]);
+    }
+
+  return item;
+}
+
+static void
+texty_diff_model_list_model_init (GListModelInterface *iface)
+{
+  iface->get_item_type = texty_diff_model_get_item_type;
+  iface->get_n_items = texty_diff_model_get_n_items;
+  iface->get_item = texty_diff_model_get_item;
+}
+
+static void
+texty_diff_model_finalize (GObject *object)
+{
+  TextyDiffModel *self = TEXTY_DIFF_MODEL (object);
+
+  g_bytes_unref (self->old_bytes);
+  g_bytes_unref (self->new_bytes);
+  g_free (self->old_lines);
+  g_free (self->new_lines);
+  g_array_unref (self->rows);
+
+  G_OBJECT_CLASS (texty_diff_model_parent_class)->finalize (object);
+}
+
+static void
+texty_diff_model_class_init (TextyDiffModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = texty_diff_model_finalize;
+}
+
+static void
+texty_diff_model_init (TextyDiffModel *self)
+{
+}
+
+/* the number of separate places where the texts differ */
+guint
+texty_diff_model_get_n_changes (TextyDiffModel *self)
+{
+  g_return_val_if_fail (TEXTY_IS_DIFF_MODEL (self), 0);
+
+  return self->n_changes;
+}
+
+/**********************************/
+/* Model 👆️                       */
+/**********************************/
+
+static Line *
+split_lines (GBytes *bytes,
+             gsize *n_lines)
+{
+  TextyLineEndingCounts counts;
+  gsize length;
+  const char *p = g_bytes_get_data (bytes, &length);
+  const char *end = p + length;
+  Line *lines;
+  gsize n = 0;
+
+  texty_line_ending_count (p, length, &counts);
+  lines = g_new (Line, counts.lf + counts.crlf + 1);
+
+  while (p < end)
+    {
+      const char *eol = memchr (p, '\n', end - p);
+
+      if (eol == NULL)
+        eol = end;
+      lines[n].text = p;
+      lines[n].length = eol - p;
+      /* so a CRLF file compares equal to its LF copy */
+      if (lines[n].length > 0 && p[lines[n].length - 1] == '\r')
+        lines[n].length--;
+      n++;
+      p = eol + 1;
+    }
+
+  *n_lines = n;
+
+  return lines;
+}
+
+static guint
+hash_line (gconstpointer key)
+{
+  const Line *line = key;
+  guint hash = 2166136261u;
+
+  for (gsize i = 0; i < line->length; i++)
+    hash = (hash ^ (guchar) line->text[i]) * 16777619u;
+
+  return hash;
+}
+
+static gboolean
+equal_line (gconstpointer a,
+            gconstpointer b)
+{
+  const Line *x = a;
+  const Line *y = b;
+
+  return x->length == y->length && memcmp (x->text, y->text, x->length) == 0;
+}
+
+/*
+ * Gives every distinct line a number, so the diff compares integers
+ * rather than strings, and equal numbers always mean equal lines.
+ */
+static guint *
+intern_lines (GHashTable *ids,
+              const Line *lines,
+              gsize n_lines)
+{
+  guint *result = g_new (guint, n_lines);
+
+  for (gsize i = 0; i < n_lines; i++)
+    {
+      gpointer id;
+
+      if (!g_hash_table_lookup_extended (ids, &lines[i], NULL, &id))
+        {
+          id = GUINT_TO_POINTER (g_hash_table_size (ids));
+          g_hash_table_insert (ids, (gpointer) &lines[i], id);
+        }
+      result[i] = GPOINTER_TO_UINT (id);
+    }
+
+  return result;
+}
+
+/**********************************/
+/* Lines 👆️                       */
+/**********************************/
+
+typedef struct
+{
+  const guint *a;
+  const guint *b;
+  /* set for lines of a that were deleted and lines of b that were inserted */
+  guint8 *deleted;
+  guint8 *inserted;
+  /* furthest reaching x on each diagonal, indexed from -(len b) - 1 */
+  gssize *fd;
+  gssize *bd;
+  gssize too_expensive;
+  GCancellable *cancellable;
+} Myers;
+
+/*
+ * Finds the middle snake of a[xoff, xlim) against b[yoff, ylim), searching
+ * forward from the start and backward from the end until the two meet,
+ * as in Myers' linear space refinement. Past 'too_expensive' edits it
+ * settles for the diagonal that got furthest, which keeps pathological
+ * inputs fast at the cost of a diff that is no longer minimal.
+ */
+static void
+find_split (Myers *m,
+            gssize xoff,
+            gssize xlim,
+            gssize yoff,
+            gssize ylim,
+            gssize *xmid,
+            gssize *ymid)
+{
+  gssize *fd = m->fd;
+  gssize *bd = m->bd;
+  gssize dmin = xoff - ylim;
+  gssize dmax = xlim - yoff;
+  gssize fmid = xoff - yoff;
+  gssize bmid = xlim - ylim;
+  gssize fmin = fmid;
+  gssize fmax = fmid;
+  gssize bmin = bmid;
+  gssize bmax = bmid;
+  gboolean odd = (fmid - bmid) & 1;
+
+  fd[fmid] = xoff;
+  bd[bmid] = xlim;
+
+  for (gssize c = 1;; c++)
+    {
+      gssize d;
+
+      /* extend the forward paths by one edit */
+      if (fmin > dmin)
+        fd[--fmin - 1] = -1;
+      else
+        fmin++;
+      if (fmax < dmax)
+        fd[++fmax + 1] = -1;
+      else
+        fmax--;
+      for (d = fmax; d >= fmin; d -= 2)
+        {
+          gssize tlo = fd[d - 1];
+          gssize thi = fd[d + 1];
+          gssize x = tlo >= thi ? tlo + 1 : thi;
+          gssize y = x - d;
+
+          while (x < xlim && y < ylim && m->a[x] == m->b[y])
+            {
+              x++;
+              y++;
+            }
+          fd[d] = x;
+          if (odd && bmin <= d && d <= bmax && bd[d] <= x)
+            {
+              *xmid = x;
+              *ymid = y;
+              return;
+            }
+        }
+
+      /* and the backward paths */
+      if (bmin > dmin)
+        bd[--bmin - 1] = G_MAXSSIZE;
+      else
+        bmin++;
+      if (bmax < dmax)
+        bd[++bmax + 1] = G_MAXSSIZE;
+      else
+        bmax--;
+      for (d = bmax; d >= bmin; d -= 2)
+        {
+          gssize tlo = bd[d - 1];
+          gssize thi = bd[d + 1];
+          gssize x = tlo < thi ? tlo : thi - 1;
+          gssize y = x - d;
+
+          while (x > xoff && y > yoff && m->a[x - 1] == m->b[y - 1])
+            {
+              x--;
+              y--;
+            }
+          bd[d] = x;
+          if (!odd && fmin <= d && d <= fmax && x <= fd[d])
+            {
+              *xmid = x;
+              *ymid = y;
+              return;
+            }
+        }
+
+      if (c >= m->too_expensive)
+        {
+          gssize fxybest = -1;
+          gssize fxbest = xoff;
+          gssize bxybest = G_MAXSSIZE;
+          gssize bxbest = xlim;
+
+          for (d = fmax; d >= fmin; d -= 2)
+            {
+              gssize x = MIN (fd[d], xlim);
+              gssize y = x - d;
+
+              if (ylim < y)
+                {
+                  x = ylim + d;
+                  y = ylim;
+                }
+              if (fxybest < x + y)
+                {
+                  fxybest = x + y;
+                  fxbest = x;
+                }
+            }
+          for (d = bmax; d >= bmin; d -= 2)
+            {
+              gssize x = MAX (xoff, bd[d]);
+              gssize y = x - d;
+
+              if (y < yoff)
+                {
+                  x = yoff + d;
+                  y = yoff;
+                }
+              if (x + y < bxybest)
+                {
+                  bxybest = x + y;
+                  bxbest = x;
+                }
+            }
+
+          if ((xlim + ylim) - bxybest < fxybest - (xoff + yoff))
+            {
+              *xmid = fxbest;
+              *ymid = fxybest - fxbest;
+            }
+          else
+            {
+              *xmid = bxbest;
+              *ymid = bxybest - bxbest;
+            }
+          return;
+        }
+    }
+}
+
+static void
+compare_ranges (Myers *m,
+                gssize xoff,
+                gssize xlim,
+                gssize yoff,
+                gssize ylim)
+{
+  gssize xmid;
+  gssize ymid;
+
+  /* lines in common at either end need no search */
+  while (xoff < xlim && yoff < ylim && m->a[xoff] == m->b[yoff])
+    {
+      xoff++;
+      yoff++;
+    }
+  while (xoff < xlim && yoff < ylim && m->a[xlim - 1] == m->b[ylim - 1])
+    {
+      xlim--;
+      ylim--;
+    }
+
+  if (xoff == xlim)
+    {
+      while (yoff < ylim)
+        m->inserted[yoff++] = TRUE;
+      return;
+    }
+  if (yoff == ylim)
+    {
+      while (xoff < xlim)
+        m->deleted[xoff++] = TRUE;
+      return;
+    }
+  if (g_cancellable_is_cancelled (m->cancellable))
+    return;
+
+  find_split (m, xoff, xlim, yoff, ylim, &xmid, &ymid);
+  compare_ranges (m, xoff, xmid, yoff, ymid);
+  compare_ranges (m, xmid, xlim, ymid, ylim);
+}
+
+/*
+ * Marks the deleted lines of 'a' and inserted lines of 'b'. Lines that
+ * don't occur on the other side at all can't be part of the common
+ * subsequence, they are marked up front and left out of the search,
+ * which is most of the work when only a few lines changed in many places.
+ */
+static void
+diff_ids (const guint *a,
+          gsize n,
+          const guint *b,
+          gsize m,
+          guint n_ids,
+          guint8 *deleted,
+          guint8 *inserted,
+          GCancellable *cancellable)
+{
+  g_autofree guint8 *in_a = g_new0 (guint8, n_ids);
+  g_autofree guint8 *in_b = g_new0 (guint8, n_ids);
+  g_autofree guint *ra = g_new (guint, n + 1);
+  g_autofree guint *rb = g_new (guint, m + 1);
+  g_autofree gsize *a_index = g_new (gsize, n + 1);
+  g_autofree gsize *b_index = g_new (gsize, m + 1);
+  g_autofree guint8 *r_deleted = NULL;
+  g_autofree guint8 *r_inserted = NULL;
+  g_autofree gssize *diagonals = NULL;
+  gsize rn = 0;
+  gsize rm = 0;
+  Myers myers;
+
+  for (gsize i = 0; i < n; i++)
+    in_a[a[i]] = TRUE;
+  for (gsize j = 0; j < m; j++)
+    in_b[b[j]] = TRUE;
+
+  for (gsize i = 0; i < n; i++)
+    {
+      deleted[i] = !in_b[a[i]];
+      if (!deleted[i])
+        {
+          ra[rn] = a[i];
+          a_index[rn++] = i;
+        }
+    }
+  for (gsize j = 0; j < m; j++)
+    {
+      inserted[j] = !in_a[b[j]];
+      if (!inserted[j])
+        {
+          rb[rm] = b[j];
+          b_index[rm++] = j;
+        }
+    }
+
+  r_deleted = g_new0 (guint8, rn + 1);
+  r_inserted = g_new0 (guint8, rm + 1);
+  diagonals = g_new (gssize, 2 * (rn + rm + 3));
+
+  myers.a = ra;
+  myers.b = rb;
+  myers.deleted = r_deleted;
+  myers.inserted = r_inserted;
+  myers.fd = diagonals + rm + 1;
+  myers.bd = diagonals + (rn + rm + 3) + rm + 1;
+  /* roughly the square root of the number of diagonals, like GNU diff */
+  myers.too_expensive = 1;
+  for (gsize diags = rn + rm + 3; diags != 0; diags >>= 2)
+    myers.too_expensive <<= 1;
+  myers.too_expensive = MAX (4096, myers.too_expensive);
+  myers.cancellable = cancellable;
+
+  compare_ranges (&myers, 0, rn, 0, rm);
+
+  for (gsize k = 0; k < rn; k++)
+    deleted[a_index[k]] = r_deleted[k];
+  for (gsize k = 0; k < rm; k++)
+    inserted[b_index[k]] = r_inserted[k];
+}
+
+/**********************************/
+/* Myers 👆️                       */
+/**********************************/
+
+static void
+append_row (GArray *rows,
+            int old_line,
+            int new_line,
+            TextyDiffKind kind,
+            guint skipped)
+{
+  Row row = { old_line, new_line, kind, skipped };
+
+  g_array_append_val (rows, row);
+}
+
+/*
+ * Lines up the two sides: unchanged lines pair with each other, and within
+ * a change deleted and inserted lines share rows for as long as both last.
+ * Unchanged runs away from any change collapse into a single row.
+ */
+static GArray *
+build_rows (const guint8 *deleted,
+            gsize n,
+            const guint8 *inserted,
+            gsize m,
+            guint *n_changes)
+{
+  GArray *rows = g_array_new (FALSE, FALSE, sizeof (Row));
+  gsize i = 0;
+  gsize j = 0;
+
+  *n_changes = 0;
+
+  while (i < n || j < m)
+    {
+      gsize i_end = i;
+      gsize j_end = j;
+
+      /* a run of unchanged lines */
+      while (i_end < n && j_end < m && !deleted[i_end] && !inserted[j_end])
+        {
+          i_end++;
+          j_end++;
+        }
+      if (i_end > i)
+        {
+          gsize run = i_end - i;
+          gsize head = i > 0 || j > 0 ? MIN (run, CONTEXT_LINES) : 0;
+          gsize tail = i_end < n || j_end < m ? MIN (run - head, CONTEXT_LINES) : 0;
+
+          for (gsize k = 0; k < head; k++)
+            append_row (rows, i + k, j + k, TEXTY_DIFF_EQUAL, 0);
+          if (run > head + tail)
+            append_row (rows, i + head, j + head, TEXTY_DIFF_SKIP, run - head - tail);
+          for (gsize k = run - tail; k < run; k++)
+            append_row (rows, i + k, j + k, TEXTY_DIFF_EQUAL, 0);
+
+          i = i_end;
+          j = j_end;
+          continue;
+        }
+
+      /* a change, deleted lines on the left and inserted on the right */
+      while (i_end < n && deleted[i_end])
+        i_end++;
+      while (j_end < m && inserted[j_end])
+        j_end++;
+      /* a line left without a partner, only if the marks disagree */
+      if (i_end == i && j_end == j)
+        {
+          i_end = MIN (i + 1, n);
+          j_end = MIN (j + 1, m);
+        }
+
+      for (gsize k = 0; k < MAX (i_end - i, j_end - j); k++)
+        {
+          gboolean left = i + k < i_end;
+          gboolean right = j + k < j_end;
+
+          append_row (rows,
+                      left ? (int) (i + k) : -1,
+                      right ? (int) (j + k) : -1,
+                      left && right ? TEXTY_DIFF_CHANGE : left ? TEXTY_DIFF_DELETE : TEXTY_DIFF_INSERT,
+                      0);
+        }
+      (*n_changes)++;
+
+      i = i_end;
+      j = j_end;
+    }
+
+  return rows;
+}
+
+/*
+ * Compares the lines of 'old_text' with those of 'new_text'. The model
+ * holds a row per line of each change, with a few unchanged lines around
+ * it, and is empty when the texts have the same lines.
+ */
+TextyDiffModel *
+texty_diff (GBytes *old_text,
+            GBytes *new_text,
+            GCancellable *cancellable,
+            GError **error)
+{
+  TextyDiffModel *self;
+  g_autoptr (GHashTable) ids = NULL;
+  g_autofree guint *a = NULL;
+  g_autofree guint *b = NULL;
+  g_autofree guint8 *deleted = NULL;
+  g_autofree guint8 *inserted = NULL;
+  Line *old_lines;
+  Line *new_lines;
+  gsize n;
+  gsize m;
+
+  g_return_val_if_fail (old_text != NULL, NULL);
+  g_return_val_if_fail (new_text != NULL, NULL);
+
+  old_lines = split_lines (old_text, &n);
+  new_lines = split_lines (new_text, &m);
+  if (n > G_MAXINT || m > G_MAXINT)
+    {
+      g_free (old_lines);
+      g_free (new_lines);
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "Too many lines to compare");
+      return NULL;
+    }
+
+  ids = g_hash_table_new (hash_line, equal_line);
+  a = intern_lines (ids, old_lines, n);
+  b = intern_lines (ids, new_lines, m);
+
+  deleted = g_new0 (guint8, n + 1);
+  inserted = g_new0 (guint8, m + 1);
+  diff_ids (a, n, b, m, g_hash_table_size (ids), deleted, inserted, cancellable);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+      g_free (old_lines);
+      g_free (new_lines);
+      return NULL;
+    }
+
+  self = g_object_new (TEXTY_TYPE_DIFF_MODEL, NULL);
+  self->old_bytes = g_bytes_ref (old_text);
+  self->new_bytes = g_bytes_ref (new_text);
+  self->old_lines = old_lines;
+  self->new_lines = new_lines;
+  self->rows = build_rows (deleted, n, inserted, m, &self->n_changes);
+
+  /* nothing but unchanged lines, leave the model empty */
+  if (self->n_changes == 0)
+    g_array_set_size (self->rows, 0);
+
+  return self;
+}
+
+typedef struct
+{
+  GBytes *old_text;
+  GBytes *new_text;
+} DiffData;
+
+static void
+diff_data_free (DiffData *data)
+{
+  g_bytes_unref (data->old_text);
+  g_bytes_unref (data->new_text);
+  g_free (data);
+}
+
+static void
+diff_thread (GTask *task,
+             gpointer source_object,
+             gpointer task_data,
+             GCancellable *cancellable)
+{
+  DiffData *data = task_data;
+  GError *error = NULL;
+  TextyDiffModel *model;
+
+  model = texty_diff (data->old_text, data->new_text, cancellable, &error);
+  if (model != NULL)
+    g_task_return_pointer (task, model, g_object_unref);
+  else
+    g_task_return_error (task, error);
+}
+
+void
+texty_diff_async (GBytes *old_text,
+                  GBytes *new_text,
+                  GCancellable *cancellable,
+                  GAsyncReadyCallback callback,
+                  gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  DiffData *data;
+
+  g_return_if_fail (old_text != NULL);
+  g_return_if_fail (new_text != NULL);
+
+  data = g_new0 (DiffData, 1);
+  data->old_text = g_bytes_ref (old_text);
+  data->new_text = g_bytes_ref (new_text);
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, texty_diff_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) diff_data_free);
+  g_task_run_in_thread (task, diff_thread);
+}
+
+TextyDiffModel *
+texty_diff_finish (GAsyncResult *result,
+                   GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
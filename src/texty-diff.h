@@ -0,0 +1,66 @@
+/* texty-diff.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  TEXTY_DIFF_EQUAL,
+  TEXTY_DIFF_DELETE,
+  TEXTY_DIFF_INSERT,
+  TEXTY_DIFF_CHANGE,
+  /* stands in for a run of unchanged lines away from any change */
+  TEXTY_DIFF_SKIP,
+} TextyDiffKind;
+
+#define TEXTY_TYPE_DIFF_ROW (texty_diff_row_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyDiffRow, texty_diff_row, TEXTY, DIFF_ROW, GObject)
+
+TextyDiffKind  texty_diff_row_get_kind       (TextyDiffRow         *self);
+int            texty_diff_row_get_old_number (TextyDiffRow         *self);
+const char    *texty_diff_row_get_old_text   (TextyDiffRow         *self);
+int            texty_diff_row_get_new_number (TextyDiffRow         *self);
+const char    *texty_diff_row_get_new_text   (TextyDiffRow         *self);
+guint          texty_diff_row_get_skipped    (TextyDiffRow         *self);
+
+#define TEXTY_TYPE_DIFF_MODEL (texty_diff_model_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyDiffModel, texty_diff_model, TEXTY, DIFF_MODEL, GObject)
+
+guint          texty_diff_model_get_n_changes (TextyDiffModel      *self);
+
+TextyDiffModel *texty_diff                   (GBytes               *old_text,
+                                              GBytes               *new_text,
+                                              GCancellable         *cancellable,
+                                              GError              **error);
+void            texty_diff_async             (GBytes               *old_text,
+                                              GBytes               *new_text,
+                                              GCancellable         *cancellable,
+                                              GAsyncReadyCallback   callback,
+                                              gpointer              user_data);
+TextyDiffModel *texty_diff_finish            (GAsyncResult         *result,
+                                              GError              **error);
+
+G_END_DECLS
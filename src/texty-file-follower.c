@@ -0,0 +1,413 @@
+/* texty-file-follower.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-file-follower.h"
+
+#include <string.h>
+
+/* bound each step so a burst of output never stalls the main loop */
+#define MAX_READ_SIZE (16 * 1024 * 1024)
+
+struct _TextyFileFollower
+{
+  GObject parent_instance;
+
+  /* unowned, the buffer keeps us as object data */
+  GtkTextBuffer *buffer;
+  GFile *file;
+  GFileMonitor *monitor;
+  GCancellable *cancellable;
+  goffset offset;
+  guint max_lines;
+  gboolean reading;
+  gboolean pending;
+};
+
+G_DEFINE_FINAL_TYPE (TextyFileFollower, texty_file_follower, G_TYPE_OBJECT)
+
+enum
+{
+  APPENDED,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+typedef struct
+{
+  GBytes *bytes;
+  goffset offset;
+  gboolean more;
+} ReadResult;
+
+static void
+read_result_free (ReadResult *result)
+{
+  g_clear_pointer (&result->bytes, g_bytes_unref);
+  g_free (result);
+}
+
+/* drops a trailing, incomplete UTF-8 sequence; it is read again next time */
+static gsize
+complete_length (const char *data,
+                 gsize length)
+{
+  gsize i;
+
+  for (i = 1; i <= 3 && i <= length; i++)
+    {
+      guchar c = data[length - i];
+      gsize needed;
+
+      if ((c & 0xc0) == 0x80)
+        continue;
+      if (c < 0xc0)
+        break;
+      needed = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : 2;
+      if (needed > i)
+        return length - i;
+      break;
+    }
+
+  return length;
+}
+
+static void
+read_thread (GTask *task,
+             gpointer source_object,
+             gpointer task_data,
+             GCancellable *cancellable)
+{
+  TextyFileFollower *self = source_object;
+  g_autoptr (GFileInputStream) input = NULL;
+  g_autoptr (GFileInfo) info = NULL;
+  GError *error = NULL;
+  ReadResult *result;
+  goffset offset = *(goffset *) task_data;
+  goffset size;
+  gsize length;
+  gsize n_read = 0;
+
+  input = g_file_read (self->file, cancellable, &error);
+  if (input == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  info = g_file_input_stream_query_info (input,
+                                         G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                         cancellable,
+                                         &error);
+  if (info == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+  size = g_file_info_get_size (info);
+
+  /* truncated or rotated, follow the new content from its start */
+  if (size < offset)
+    offset = 0;
+
+  result = g_new0 (ReadResult, 1);
+  length = MIN (size - offset, MAX_READ_SIZE);
+  if (length > 0)
+    {
+      char *data;
+
+      if (!g_seekable_seek (G_SEEKABLE (input), offset, G_SEEK_SET, cancellable, &error))
+        {
+          read_result_free (result);
+          g_task_return_error (task, error);
+          return;
+        }
+
+      data = g_malloc (length);
+      if (!g_input_stream_read_all (G_INPUT_STREAM (input),
+                                    data,
+                                    length,
+                                    &n_read,
+                                    cancellable,
+                                    &error))
+        {
+          g_free (data);
+          read_result_free (result);
+          g_task_return_error (task, error);
+          return;
+        }
+
+      n_read = complete_length (data, n_read);
+      result->bytes = g_bytes_new_take (data, n_read);
+    }
+
+  result->offset = offset + n_read;
+  result->more = n_read > 0 && result->offset < size;
+  g_task_return_pointer (task, result, (GDestroyNotify) read_result_free);
+}
+
+static void
+append_bytes (TextyFileFollower *self,
+              GBytes *bytes)
+{
+  g_autofree char *valid = NULL;
+  const char *text;
+  gsize length;
+  gboolean modified;
+  gboolean trimmed = FALSE;
+  GtkTextIter end;
+
+  text = g_bytes_get_data (bytes, &length);
+  if (length == 0)
+    return;
+  if (!g_utf8_validate_len (text, length, NULL))
+    {
+      valid = g_utf8_make_valid (text, length);
+      text = valid;
+      length = strlen (valid);
+    }
+
+  /*
+   * what was appended is on disk already, so it doesn't dirty the buffer;
+   * the window keeps it read-only meanwhile, so this is all the history
+   * that grows, and what was undoable before stays so
+   */
+  modified = gtk_text_buffer_get_modified (self->buffer);
+
+  gtk_text_buffer_get_end_iter (self->buffer, &end);
+  gtk_text_buffer_insert (self->buffer, &end, text, length);
+
+  if (self->max_lines > 0)
+    {
+      int lines = gtk_text_buffer_get_line_count (self->buffer);
+
+      if (lines > (int) self->max_lines)
+        {
+          GtkTextIter start;
+          GtkTextIter cut;
+
+          gtk_text_buffer_get_start_iter (self->buffer, &start);
+          gtk_text_buffer_get_iter_at_line (self->buffer, &cut, lines - self->max_lines);
+          gtk_text_buffer_delete (self->buffer, &start, &cut);
+          trimmed = TRUE;
+        }
+    }
+
+  gtk_text_buffer_set_modified (self->buffer, modified);
+
+  g_signal_emit (self, signals[APPENDED], 0, trimmed);
+}
+
+static void read_appended (TextyFileFollower *self);
+
+static void
+on_read_complete (GObject *source_object,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+  TextyFileFollower *self = TEXTY_FILE_FOLLOWER (source_object);
+  g_autoptr (GError) error = NULL;
+  ReadResult *read_result;
+
+  self->reading = FALSE;
+
+  /* a cancelled read means the buffer may already be gone */
+  read_result = g_task_propagate_pointer (G_TASK (result), &error);
+  if (read_result != NULL && self->buffer == NULL)
+    {
+      read_result_free (read_result);
+      return;
+    }
+  if (read_result == NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_debug ("Unable to read appended data: %s", error->message);
+      return;
+    }
+
+  self->offset = read_result->offset;
+  if (read_result->bytes != NULL)
+    append_bytes (self, read_result->bytes);
+
+  if (read_result->more || self->pending)
+    {
+      self->pending = FALSE;
+      read_appended (self);
+    }
+
+  read_result_free (read_result);
+}
+
+static void
+read_appended (TextyFileFollower *self)
+{
+  g_autoptr (GTask) task = NULL;
+
+  if (self->buffer == NULL)
+    return;
+
+  /* coalesce change notifications that arrive while a read is running */
+  if (self->reading)
+    {
+      self->pending = TRUE;
+      return;
+    }
+  self->reading = TRUE;
+
+  task = g_task_new (self, self->cancellable, on_read_complete, NULL);
+  g_task_set_source_tag (task, read_appended);
+  g_task_set_task_data (task, g_memdup2 (&self->offset, sizeof self->offset), g_free);
+  g_task_run_in_thread (task, read_thread);
+}
+
+static void
+on_file_changed (GFileMonitor *monitor,
+                 GFile *file,
+                 GFile *other_file,
+                 GFileMonitorEvent event_type,
+                 TextyFileFollower *self)
+{
+  if (event_type == G_FILE_MONITOR_EVENT_CHANGED
+      || event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT
+      || event_type == G_FILE_MONITOR_EVENT_CREATED)
+    read_appended (self);
+}
+
+/**********************************/
+/* Reading 👆️                     */
+/**********************************/
+
+static void
+texty_file_follower_dispose (GObject *object)
+{
+  TextyFileFollower *self = TEXTY_FILE_FOLLOWER (object);
+
+  texty_file_follower_stop (self);
+
+  G_OBJECT_CLASS (texty_file_follower_parent_class)->dispose (object);
+}
+
+static void
+texty_file_follower_finalize (GObject *object)
+{
+  TextyFileFollower *self = TEXTY_FILE_FOLLOWER (object);
+
+  g_clear_object (&self->cancellable);
+  g_clear_object (&self->file);
+
+  G_OBJECT_CLASS (texty_file_follower_parent_class)->finalize (object);
+}
+
+static void
+texty_file_follower_class_init (TextyFileFollowerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = texty_file_follower_dispose;
+  object_class->finalize = texty_file_follower_finalize;
+
+  /*
+   * emitted after new text has been added to the end of the buffer, with
+   * whether the oldest lines were dropped, so it no longer holds the file
+   */
+  signals[APPENDED] = g_signal_new ("appended",
+                                    G_TYPE_FROM_CLASS (klass),
+                                    G_SIGNAL_RUN_LAST,
+                                    0,
+                                    NULL, NULL,
+                                    NULL,
+                                    G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+}
+
+static void
+texty_file_follower_init (TextyFileFollower *self)
+{
+  self->cancellable = g_cancellable_new ();
+}
+
+/*
+ * Watches 'file' and appends whatever gets written past its current end to
+ * 'buffer', dropping the oldest lines once there are more than 'max_lines'
+ * (0 keeps everything).
+ */
+TextyFileFollower *
+texty_file_follower_new (GtkTextBuffer *buffer,
+                         GFile *file,
+                         guint max_lines)
+{
+  TextyFileFollower *self;
+  g_autoptr (GFileInfo) info = NULL;
+  g_autoptr (GError) error = NULL;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  self = g_object_new (TEXTY_TYPE_FILE_FOLLOWER, NULL);
+  self->buffer = buffer;
+  self->file = g_object_ref (file);
+  self->max_lines = max_lines;
+
+  /* start from the current end, the buffer already shows the rest */
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            NULL);
+  if (info != NULL)
+    self->offset = g_file_info_get_size (info);
+
+  self->monitor = g_file_monitor_file (file,
+                                       G_FILE_MONITOR_NONE,
+                                       self->cancellable,
+                                       &error);
+  if (self->monitor == NULL)
+    {
+      g_warning ("Unable to follow file: %s", error->message);
+      return self;
+    }
+  g_file_monitor_set_rate_limit (self->monitor, 100);
+  g_signal_connect (self->monitor,
+                    "changed",
+                    G_CALLBACK (on_file_changed),
+                    self);
+
+  return self;
+}
+
+/*
+ * Stops watching and forgets the buffer. A read still running holds a
+ * reference on the follower, so this has to happen when the buffer lets go
+ * of it rather than when the follower is finally disposed.
+ */
+void
+texty_file_follower_stop (TextyFileFollower *self)
+{
+  g_return_if_fail (TEXTY_IS_FILE_FOLLOWER (self));
+
+  g_cancellable_cancel (self->cancellable);
+  if (self->monitor != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (self->monitor, self);
+      g_file_monitor_cancel (self->monitor);
+    }
+  g_clear_object (&self->monitor);
+  self->buffer = NULL;
+}
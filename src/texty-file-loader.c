@@ -0,0 +1,522 @@
+/* texty-file-loader.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-file-loader.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "texty-trace.h"
+
+#define READ_CHUNK_SIZE (1024 * 1024)
+
+/* how much of the start of a file is scanned for NUL bytes */
+#define SNIFF_SIZE (64 * 1024)
+
+/* text usually shrinks several times when compressed */
+#define COMPRESSION_RATIO 4
+
+typedef struct
+{
+  GBytes *bytes;
+  TextyCompression compression;
+  gboolean truncated;
+} LoadResult;
+
+static void
+load_result_free (LoadResult *result)
+{
+  g_clear_pointer (&result->bytes, g_bytes_unref);
+  g_free (result);
+}
+
+/*
+ * Decides how a file of 'size' bytes and 'content_type' fits in a memory
+ * budget of 'budget' bytes: loaded for editing, loaded read-only, previewed
+ * by its head and tail, or not opened at all.
+ */
+TextyLoadMode
+texty_file_choose_load_mode (goffset size,
+                             const char *content_type,
+                             gsize budget)
+{
+  gboolean text = TRUE;
+  gboolean compressed = FALSE;
+  guint64 estimate = size;
+
+  if (content_type != NULL)
+    {
+      text = g_content_type_is_a (content_type, "text/plain");
+      compressed = g_content_type_is_a (content_type, "application/gzip")
+                   || g_content_type_is_a (content_type, "application/zstd");
+    }
+
+  if (compressed)
+    estimate *= COMPRESSION_RATIO;
+
+  /* a large file that doesn't even claim to be text, e.g. a core dump */
+  if (!text && !compressed && estimate > budget)
+    return TEXTY_LOAD_MODE_REFUSE;
+  if (estimate <= budget)
+    return TEXTY_LOAD_MODE_NORMAL;
+  /* no editing means no undo history doubling the footprint */
+  if (estimate <= 2 * (guint64) budget)
+    return TEXTY_LOAD_MODE_READ_ONLY;
+  return TEXTY_LOAD_MODE_PREVIEW;
+}
+
+/* fills 'stream' until it holds 'count' bytes or the input is exhausted */
+static gboolean
+fill_at_least (GBufferedInputStream *stream,
+               gsize count,
+               GCancellable *cancellable,
+               GError **error)
+{
+  while (g_buffered_input_stream_get_available (stream) < count)
+    {
+      gssize n_read = g_buffered_input_stream_fill (stream, -1, cancellable, error);
+
+      if (n_read < 0)
+        return FALSE;
+      if (n_read == 0)
+        break;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Reads 'stream' into a single allocation, growing from 'size_hint', until
+ * its end or until 'limit' bytes have been read, in which case 'more' tells
+ * whether anything was left behind.
+ */
+static GBytes *
+read_up_to (GInputStream *stream,
+            gsize limit,
+            gsize size_hint,
+            gboolean *more,
+            GCancellable *cancellable,
+            GError **error)
+{
+  g_autoptr (GByteArray) array = NULL;
+  gsize length = 0;
+
+  *more = FALSE;
+  array = g_byte_array_sized_new (MIN (MIN (MAX (size_hint, READ_CHUNK_SIZE), limit), G_MAXUINT));
+  while (length < limit)
+    {
+      gsize chunk = MIN (READ_CHUNK_SIZE, limit - length);
+      gssize n_read;
+
+      /* a GByteArray can't grow past 4 GiB */
+      if (length + chunk > G_MAXUINT)
+        {
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+                               "The file is too large to load");
+          return NULL;
+        }
+      g_byte_array_set_size (array, length + chunk);
+      n_read = g_input_stream_read (stream,
+                                    array->data + length,
+                                    chunk,
+                                    cancellable,
+                                    error);
+      if (n_read < 0)
+        return NULL;
+      if (n_read == 0)
+        break;
+      length += n_read;
+    }
+  g_byte_array_set_size (array, length);
+
+  if (length == limit)
+    {
+      guint8 probe;
+      gssize n_read = g_input_stream_read (stream, &probe, 1, cancellable, error);
+
+      if (n_read < 0)
+        return NULL;
+      *more = n_read > 0;
+    }
+
+  return g_byte_array_free_to_bytes (g_steal_pointer (&array));
+}
+
+static const char *
+find_last_newline (const char *data,
+                   gsize length)
+{
+  const char *p;
+
+  for (p = data + length; p > data; p--)
+    if (p[-1] == '\n')
+      return p - 1;
+
+  return NULL;
+}
+
+/* 'length' backed up to before a character it would cut in two */
+static gsize
+complete_characters (const char *data,
+                     gsize length)
+{
+  const char *last;
+
+  last = g_utf8_find_prev_char (data, data + length);
+  if (last != NULL && g_utf8_get_char_validated (last, data + length - last) == (gunichar) -2)
+    return last - data;
+
+  return length;
+}
+
+/*
+ * the head is cut after its last complete line, or its last whole
+ * character when it is one long line, and the tail before its first line
+ */
+static GBytes *
+join_preview (GBytes *head,
+              GBytes *tail,
+              guint64 skipped)
+{
+  g_autoptr (GString) preview = NULL;
+  const char *data;
+  const char *cut;
+  gsize length;
+
+  preview = g_string_sized_new (g_bytes_get_size (head) + (tail ? g_bytes_get_size (tail) : 0) + 64);
+
+  data = g_bytes_get_data (head, &length);
+  cut = find_last_newline (data, length);
+  g_string_append_len (preview, data, cut != NULL ? cut - data + 1 : (gssize) complete_characters (data, length));
+
+  if (tail == NULL)
+    {
+      g_string_append (preview, "\n[…the rest of the file is not loaded…]\n");
+    }
+  else
+    {
+      g_string_append_printf (preview,
+                              "\n[…%" G_GUINT64_FORMAT " bytes not loaded…]\n",
+                              skipped);
+      data = g_bytes_get_data (tail, &length);
+      cut = memchr (data, '\n', length);
+      if (cut != NULL)
+        g_string_append_len (preview, cut + 1, data + length - cut - 1);
+    }
+
+  return g_string_free_to_bytes (g_steal_pointer (&preview));
+}
+
+/*
+ * Reads the whole of 'file', transparently decompressing gzip and zstd
+ * content recognised by its leading magic bytes. The compression found is
+ * returned so the file can be recompressed the same way on save.
+ *
+ * Content longer than 'max_length' is not loaded whole: only its first and
+ * last halves of 'max_length' are returned, or only the first when it can't
+ * be seeked, and 'truncated' is set. Content with NUL bytes near its start
+ * is taken for binary and refused with G_IO_ERROR_INVALID_DATA.
+ */
+GBytes *
+texty_file_load (GFile *file,
+                 gsize max_length,
+                 TextyCompression *compression,
+                 gboolean *truncated,
+                 GCancellable *cancellable,
+                 GError **error)
+{
+  g_autoptr (GFileInputStream) file_stream = NULL;
+  g_autoptr (GInputStream) buffered = NULL;
+  g_autoptr (GInputStream) input = NULL;
+  g_autoptr (GFileInfo) info = NULL;
+  g_autoptr (GBytes) head = NULL;
+  g_autoptr (GBytes) tail = NULL;
+  TextyCompression found;
+  gsize size_hint = 0;
+  gsize available;
+  const guint8 *peek;
+  gboolean more;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  if (truncated != NULL)
+    *truncated = FALSE;
+
+  file_stream = g_file_read (file, cancellable, error);
+  if (file_stream == NULL)
+    return NULL;
+
+  info = g_file_input_stream_query_info (file_stream,
+                                         G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                         cancellable,
+                                         NULL);
+  if (info != NULL && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE))
+    size_hint = g_file_info_get_size (info);
+
+  /* peek at the first bytes without consuming them */
+  buffered = g_buffered_input_stream_new_sized (G_INPUT_STREAM (file_stream), READ_CHUNK_SIZE);
+  if (!fill_at_least (G_BUFFERED_INPUT_STREAM (buffered), SNIFF_SIZE, cancellable, error))
+    return NULL;
+  peek = g_buffered_input_stream_peek_buffer (G_BUFFERED_INPUT_STREAM (buffered), &available);
+  found = texty_compression_detect (peek, available);
+
+  if (found != TEXTY_COMPRESSION_NONE)
+    {
+      g_autoptr (GConverter) decompressor = NULL;
+      g_autoptr (GInputStream) converter = NULL;
+
+      decompressor = texty_compression_new_decompressor (found, error);
+      if (decompressor == NULL)
+        return NULL;
+      converter = g_converter_input_stream_new (buffered, decompressor);
+
+      /* sniff the decompressed text rather than the compressed bytes */
+      input = g_buffered_input_stream_new_sized (converter, SNIFF_SIZE);
+      if (!fill_at_least (G_BUFFERED_INPUT_STREAM (input), SNIFF_SIZE, cancellable, error))
+        return NULL;
+      peek = g_buffered_input_stream_peek_buffer (G_BUFFERED_INPUT_STREAM (input), &available);
+    }
+  else
+    {
+      input = g_object_ref (buffered);
+    }
+
+  if (memchr (peek, '\0', MIN (available, SNIFF_SIZE)) != NULL)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                           "The file appears to be binary");
+      return NULL;
+    }
+
+  if (compression != NULL)
+    *compression = found;
+
+  /* plain files are cut without reading what is skipped */
+  if (found == TEXTY_COMPRESSION_NONE && size_hint > max_length)
+    {
+      g_autoptr (GError) seek_error = NULL;
+      gsize half = max_length / 2;
+
+      head = read_up_to (input, half, half, &more, cancellable, error);
+      if (head == NULL)
+        return NULL;
+
+      if (truncated != NULL)
+        *truncated = TRUE;
+
+      /* without seeking to the tail, e.g. on some remote files, show the head only */
+      if (!g_seekable_seek (G_SEEKABLE (input), size_hint - half, G_SEEK_SET, cancellable, &seek_error))
+        {
+          if (g_error_matches (seek_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            {
+              g_propagate_error (error, g_steal_pointer (&seek_error));
+              return NULL;
+            }
+          return join_preview (head, NULL, 0);
+        }
+      tail = read_up_to (input, half, half, &more, cancellable, error);
+      if (tail == NULL)
+        return NULL;
+
+      return join_preview (head, tail, size_hint - 2 * half);
+    }
+
+  /* compressed text starts from the compressed size and grows as it is
+   * read, rather than reserving a guess at how much larger it is */
+  head = read_up_to (input, max_length, size_hint, &more, cancellable, error);
+  if (head == NULL || !more)
+    return g_steal_pointer (&head);
+
+  if (truncated != NULL)
+    *truncated = TRUE;
+  return join_preview (head, NULL, 0);
+}
+
+static void
+load_thread (GTask *task,
+             gpointer source_object,
+             gpointer task_data,
+             GCancellable *cancellable)
+{
+  LoadResult *result;
+  GError *error = NULL;
+  gsize max_length = *(gsize *) task_data;
+  gint64 begin_time = TEXTY_TRACE_CURRENT_TIME;
+
+  result = g_new0 (LoadResult, 1);
+  result->bytes = texty_file_load (G_FILE (source_object),
+                                   max_length,
+                                   &result->compression,
+                                   &result->truncated,
+                                   cancellable,
+                                   &error);
+  texty_trace_mark (begin_time, "load", "%s, %" G_GSIZE_FORMAT " bytes",
+                    g_file_peek_path (G_FILE (source_object)),
+                    result->bytes != NULL ? g_bytes_get_size (result->bytes) : 0);
+  if (result->bytes == NULL)
+    {
+      load_result_free (result);
+      g_task_return_error (task, error);
+      return;
+    }
+
+  g_task_return_pointer (task, result, (GDestroyNotify) load_result_free);
+}
+
+void
+texty_file_load_async (GFile *file,
+                       gsize max_length,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+
+  g_return_if_fail (G_IS_FILE (file));
+
+  task = g_task_new (file, cancellable, callback, user_data);
+  g_task_set_source_tag (task, texty_file_load_async);
+  g_task_set_task_data (task, g_memdup2 (&max_length, sizeof max_length), g_free);
+  g_task_run_in_thread (task, load_thread);
+}
+
+GBytes *
+texty_file_load_finish (GFile *file,
+                        GAsyncResult *result,
+                        TextyCompression *compression,
+                        gboolean *truncated,
+                        GError **error)
+{
+  LoadResult *load_result;
+  GBytes *bytes;
+
+  g_return_val_if_fail (g_task_is_valid (result, file), NULL);
+
+  load_result = g_task_propagate_pointer (G_TASK (result), error);
+  if (load_result == NULL)
+    return NULL;
+
+  if (compression != NULL)
+    *compression = load_result->compression;
+  if (truncated != NULL)
+    *truncated = load_result->truncated;
+  bytes = g_steal_pointer (&load_result->bytes);
+  load_result_free (load_result);
+
+  return bytes;
+}
+
+#ifdef HAVE_POSIX_FADVISE
+static void
+advise_will_need (const char *path,
+                  gsize max_length)
+{
+  gint64 begin_time = TEXTY_TRACE_CURRENT_TIME;
+  struct stat st;
+  int fd;
+
+  fd = open (path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+
+  /* only starts the reads, the kernel goes on with them on its own */
+  if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode))
+    posix_fadvise (fd, 0, MIN ((gsize) st.st_size, max_length), POSIX_FADV_WILLNEED);
+  close (fd);
+
+  texty_trace_mark (begin_time, "prefetch", "%s", path);
+}
+#endif
+
+static void
+prefetch_thread (GTask *task,
+                 gpointer source_object,
+                 gpointer task_data,
+                 GCancellable *cancellable)
+{
+#ifdef HAVE_POSIX_FADVISE
+  const char *path = g_file_peek_path (G_FILE (source_object));
+
+  if (path != NULL)
+    advise_will_need (path, *(gsize *) task_data);
+#endif
+
+  /* nobody waits on the result, but a task has to return one */
+  g_task_return_boolean (task, TRUE);
+}
+
+/*
+ * Has up to the first 'max_length' bytes of 'file' read into the page
+ * cache in the background, so opening it soon after doesn't wait on the
+ * disk. Nothing is reported back, and it does nothing for files that
+ * aren't local or where the system can't be told.
+ */
+void
+texty_file_prefetch (GFile *file,
+                     gsize max_length)
+{
+  g_autoptr (GTask) task = NULL;
+
+  g_return_if_fail (G_IS_FILE (file));
+
+  task = g_task_new (file, NULL, NULL, NULL);
+  g_task_set_source_tag (task, texty_file_prefetch);
+  g_task_set_task_data (task, g_memdup2 (&max_length, sizeof max_length), g_free);
+  g_task_run_in_thread (task, prefetch_thread);
+}
+
+/*
+ * Tells whether 'bytes' is valid UTF-8 without NUL characters, as a text
+ * buffer needs, and how much of it is in 'valid_length'. Runs of ASCII are
+ * skipped eight bytes at a time, which covers most of any source file.
+ */
+gboolean
+texty_file_validate_utf8 (GBytes *bytes,
+                          gsize *valid_length)
+{
+  const char *data;
+  const char *end;
+  gsize length;
+  gsize i = 0;
+  gboolean valid;
+
+  g_return_val_if_fail (bytes != NULL, FALSE);
+
+  data = g_bytes_get_data (bytes, &length);
+  while (i + sizeof (guint64) <= length)
+    {
+      guint64 word;
+
+      memcpy (&word, data + i, sizeof word);
+      /* a high bit set, or a byte borrowed from when it was zero */
+      if (((word - G_GUINT64_CONSTANT (0x0101010101010101)) | word) & G_GUINT64_CONSTANT (0x8080808080808080))
+        break;
+      i += sizeof word;
+    }
+
+  valid = g_utf8_validate_len (data + i, length - i, &end);
+  if (valid_length != NULL)
+    *valid_length = end - data;
+
+  return valid;
+}
@@ -0,0 +1,62 @@
+/* texty-file-loader.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "texty-compression.h"
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  TEXTY_LOAD_MODE_NORMAL,
+  TEXTY_LOAD_MODE_READ_ONLY,
+  TEXTY_LOAD_MODE_PREVIEW,
+  TEXTY_LOAD_MODE_REFUSE,
+} TextyLoadMode;
+
+TextyLoadMode texty_file_choose_load_mode (goffset               size,
+                                           const char           *content_type,
+                                           gsize                 budget);
+
+GBytes       *texty_file_load             (GFile                *file,
+                                           gsize                 max_length,
+                                           TextyCompression     *compression,
+                                           gboolean             *truncated,
+                                           GCancellable         *cancellable,
+                                           GError              **error);
+void          texty_file_load_async       (GFile                *file,
+                                           gsize                 max_length,
+                                           GCancellable         *cancellable,
+                                           GAsyncReadyCallback   callback,
+                                           gpointer              user_data);
+GBytes       *texty_file_load_finish      (GFile                *file,
+                                           GAsyncResult         *result,
+                                           TextyCompression     *compression,
+                                           gboolean             *truncated,
+                                           GError              **error);
+void          texty_file_prefetch         (GFile                *file,
+                                           gsize                 max_length);
+gboolean      texty_file_validate_utf8    (GBytes               *bytes,
+                                           gsize                *valid_length);
+
+G_END_DECLS
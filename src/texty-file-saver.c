@@ -0,0 +1,307 @@
+/* texty-file-saver.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-file-saver.h"
+
+#include "texty-backup.h"
+#include "texty-trace.h"
+
+typedef struct
+{
+  GBytes *bytes;
+  TextyLineEnding line_ending;
+  TextyCompression compression;
+  char *charset;
+  guint n_backups;
+} SaveData;
+
+static void
+save_data_free (SaveData *data)
+{
+  g_bytes_unref (data->bytes);
+  g_free (data->charset);
+  g_free (data);
+}
+
+/* closing with a cancelled cancellable leaves the original file untouched */
+static void
+abort_replace (GOutputStream *stream)
+{
+  g_autoptr (GCancellable) cancellable = g_cancellable_new ();
+
+  g_cancellable_cancel (cancellable);
+  g_output_stream_close (stream, cancellable, NULL);
+}
+
+/*
+ * Opens the chain of streams that 'file' is written through, innermost
+ * first: the file itself, in 'file_stream', so a failure can abandon it,
+ * then the compressor, the encoder and the line ending converter.
+ */
+static GOutputStream *
+open_output (GFile *file,
+             TextyLineEnding line_ending,
+             TextyCompression compression,
+             const char *charset,
+             guint n_backups,
+             GFileOutputStream **file_stream,
+             GCancellable *cancellable,
+             GError **error)
+{
+  g_autoptr (GOutputStream) output = NULL;
+  gint64 begin_time;
+
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  if (!texty_backup_create (file, n_backups, cancellable, error))
+    return NULL;
+  texty_trace_mark (begin_time, "backup", "%u kept", n_backups);
+
+  *file_stream = g_file_replace (file,
+                                 NULL,
+                                 FALSE,
+                                 G_FILE_CREATE_NONE,
+                                 cancellable,
+                                 error);
+  if (*file_stream == NULL)
+    return NULL;
+
+  output = g_object_ref (G_OUTPUT_STREAM (*file_stream));
+
+  /* the compressor sits next to the file... */
+  if (compression != TEXTY_COMPRESSION_NONE)
+    {
+      g_autoptr (GConverter) compressor = NULL;
+      GOutputStream *base = g_steal_pointer (&output);
+
+      compressor = texty_compression_new_compressor (compression, error);
+      if (compressor == NULL)
+        {
+          g_object_unref (base);
+          abort_replace (G_OUTPUT_STREAM (*file_stream));
+          return NULL;
+        }
+      output = g_converter_output_stream_new (base, compressor);
+      g_object_unref (base);
+    }
+
+  /* ...then the encoding, which the line endings are still UTF-8 for... */
+  if (charset != NULL && g_ascii_strcasecmp (charset, "UTF-8") != 0)
+    {
+      g_autoptr (GCharsetConverter) encoder = NULL;
+      GOutputStream *base = g_steal_pointer (&output);
+
+      encoder = g_charset_converter_new (charset, "UTF-8", error);
+      if (encoder == NULL)
+        {
+          g_object_unref (base);
+          abort_replace (G_OUTPUT_STREAM (*file_stream));
+          return NULL;
+        }
+      output = g_converter_output_stream_new (base, G_CONVERTER (encoder));
+      g_object_unref (base);
+    }
+
+  /* ...so line endings are rewritten before the text gets compressed */
+  if (line_ending != TEXTY_LINE_ENDING_MIXED)
+    {
+      g_autoptr (GConverter) converter = texty_line_ending_converter_new (line_ending);
+      GOutputStream *base = g_steal_pointer (&output);
+
+      output = g_converter_output_stream_new (base, converter);
+      g_object_unref (base);
+    }
+
+  return g_steal_pointer (&output);
+}
+
+/*
+ * Writes 'bytes' to 'file', streaming them through a line ending converter
+ * unless 'line_ending' is TEXTY_LINE_ENDING_MIXED, in which case the bytes
+ * are written as they are, then re-encoded from UTF-8 into 'charset' unless
+ * that is NULL, and through a compressor when 'compression' asks for one.
+ * The original file is only replaced once everything has been written,
+ * after up to 'n_backups' copies of it have been kept.
+ */
+gboolean
+texty_file_save (GFile *file,
+                 GBytes *bytes,
+                 TextyLineEnding line_ending,
+                 TextyCompression compression,
+                 const char *charset,
+                 guint n_backups,
+                 GCancellable *cancellable,
+                 GError **error)
+{
+  g_autoptr (GFileOutputStream) file_stream = NULL;
+  g_autoptr (GOutputStream) output = NULL;
+  gconstpointer data;
+  gsize length;
+  gint64 begin_time;
+
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (bytes != NULL, FALSE);
+
+  output = open_output (file, line_ending, compression, charset, n_backups,
+                        &file_stream, cancellable, error);
+  if (output == NULL)
+    return FALSE;
+
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  data = g_bytes_get_data (bytes, &length);
+  if (!g_output_stream_write_all (output, data, length, NULL, cancellable, error))
+    {
+      abort_replace (G_OUTPUT_STREAM (file_stream));
+      return FALSE;
+    }
+  texty_trace_mark (begin_time, "write", "%" G_GSIZE_FORMAT " bytes", length);
+
+  /* closing the outermost stream flushes the converters and the file */
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  if (!g_output_stream_close (output, cancellable, error))
+    {
+      abort_replace (G_OUTPUT_STREAM (file_stream));
+      return FALSE;
+    }
+  texty_trace_mark (begin_time, "close", NULL);
+
+  return TRUE;
+}
+
+/*
+ * Like texty_file_save(), with the UTF-8 text read from 'input' as it is
+ * written rather than held whole, so a file of any size can be converted.
+ * 'input' may be reading 'file' itself: it is only replaced on success.
+ */
+gboolean
+texty_file_save_stream (GFile *file,
+                        GInputStream *input,
+                        TextyLineEnding line_ending,
+                        TextyCompression compression,
+                        const char *charset,
+                        guint n_backups,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+  g_autoptr (GFileOutputStream) file_stream = NULL;
+  g_autoptr (GOutputStream) output = NULL;
+  gssize length;
+  gint64 begin_time;
+
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (G_IS_INPUT_STREAM (input), FALSE);
+
+  output = open_output (file, line_ending, compression, charset, n_backups,
+                        &file_stream, cancellable, error);
+  if (output == NULL)
+    return FALSE;
+
+  /* the target is closed separately, closing it on an error would commit it */
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  length = g_output_stream_splice (output,
+                                   input,
+                                   G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE,
+                                   cancellable,
+                                   error);
+  if (length < 0)
+    {
+      abort_replace (G_OUTPUT_STREAM (file_stream));
+      return FALSE;
+    }
+  texty_trace_mark (begin_time, "write", "%" G_GSSIZE_FORMAT " bytes", length);
+
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  if (!g_output_stream_close (output, cancellable, error))
+    {
+      abort_replace (G_OUTPUT_STREAM (file_stream));
+      return FALSE;
+    }
+  texty_trace_mark (begin_time, "close", NULL);
+
+  return TRUE;
+}
+
+static void
+save_thread (GTask *task,
+             gpointer source_object,
+             gpointer task_data,
+             GCancellable *cancellable)
+{
+  SaveData *data = task_data;
+  GError *error = NULL;
+  gint64 begin_time = TEXTY_TRACE_CURRENT_TIME;
+  gboolean saved;
+
+  saved = texty_file_save (G_FILE (source_object),
+                           data->bytes,
+                           data->line_ending,
+                           data->compression,
+                           data->charset,
+                           data->n_backups,
+                           cancellable,
+                           &error);
+  texty_trace_mark (begin_time, "save", "%s, %" G_GSIZE_FORMAT " bytes",
+                    g_file_peek_path (G_FILE (source_object)),
+                    g_bytes_get_size (data->bytes));
+  if (saved)
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+}
+
+void
+texty_file_save_async (GFile *file,
+                       GBytes *bytes,
+                       TextyLineEnding line_ending,
+                       TextyCompression compression,
+                       const char *charset,
+                       guint n_backups,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  SaveData *data;
+
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (bytes != NULL);
+
+  data = g_new0 (SaveData, 1);
+  data->bytes = g_bytes_ref (bytes);
+  data->line_ending = line_ending;
+  data->compression = compression;
+  data->charset = g_strdup (charset);
+  data->n_backups = n_backups;
+
+  task = g_task_new (file, cancellable, callback, user_data);
+  g_task_set_source_tag (task, texty_file_save_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) save_data_free);
+  g_task_run_in_thread (task, save_thread);
+}
+
+gboolean
+texty_file_save_finish (GFile *file,
+                        GAsyncResult *result,
+                        GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, file), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
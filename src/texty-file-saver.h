@@ -0,0 +1,59 @@
+/* texty-file-saver.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "texty-compression.h"
+#include "texty-line-ending.h"
+
+G_BEGIN_DECLS
+
+gboolean texty_file_save        (GFile                *file,
+                                 GBytes               *bytes,
+                                 TextyLineEnding       line_ending,
+                                 TextyCompression      compression,
+                                 const char           *charset,
+                                 guint                 n_backups,
+                                 GCancellable         *cancellable,
+                                 GError              **error);
+gboolean texty_file_save_stream (GFile                *file,
+                                 GInputStream         *input,
+                                 TextyLineEnding       line_ending,
+                                 TextyCompression      compression,
+                                 const char           *charset,
+                                 guint                 n_backups,
+                                 GCancellable         *cancellable,
+                                 GError              **error);
+void     texty_file_save_async  (GFile                *file,
+                                 GBytes               *bytes,
+                                 TextyLineEnding       line_ending,
+                                 TextyCompression      compression,
+                                 const char           *charset,
+                                 guint                 n_backups,
+                                 GCancellable         *cancellable,
+                                 GAsyncReadyCallback   callback,
+                                 gpointer              user_data);
+gboolean texty_file_save_finish (GFile                *file,
+                                 GAsyncResult         *result,
+                                 GError              **error);
+
+G_END_DECLS
@@ -0,0 +1,660 @@
+/* texty-folding.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-folding.h"
+
+#include <string.h>
+
+/* time spent scanning per idle, checked every so many lines */
+#define SCAN_BUDGET_USEC 4000
+#define SCAN_CHECK_LINES 64
+
+/* in order of preference when several regions start on the same line */
+typedef enum
+{
+  FOLD_BRACE,
+  FOLD_HEADING,
+  FOLD_INDENT,
+} FoldKind;
+
+typedef struct
+{
+  FoldKind kind;
+  /* the line that stays visible, and the last one hidden under it */
+  int start;
+  int end;
+  /* the line that closed the region, so edits there can reopen it */
+  int closed_at;
+  /* the indent, heading level or bracket */
+  int depth;
+} Region;
+
+struct _TextyFolding
+{
+  GObject parent_instance;
+
+  /* not a reference, the buffer owns this object */
+  GtkTextBuffer *buffer;
+  GtkTextTag *fold_tag;
+  GtkTextTag *header_tag;
+  gboolean markdown;
+
+  /* regions found so far, and those still open on each stack */
+  GArray *regions;
+  GArray *braces;
+  GArray *indents;
+  GArray *headings;
+  /* the next line to scan, and the last one that wasn't blank before it */
+  int scan_line;
+  int last_nonblank;
+  /* the first line edited since the last scan step */
+  int dirty_line;
+  guint scan_id;
+};
+
+G_DEFINE_FINAL_TYPE (TextyFolding, texty_folding, G_TYPE_OBJECT)
+
+static void
+close_region (TextyFolding *self,
+              Region *region,
+              int end,
+              int closed_at)
+{
+  region->end = end;
+  region->closed_at = closed_at;
+
+  /* regions without anything to hide are dropped, except bracket pairs:
+   * a rescan needs them back on the stack to match the brackets after */
+  if (region->end > region->start || region->kind == FOLD_BRACE)
+    g_array_append_val (self->regions, *region);
+}
+
+static Region *
+stack_top (GArray *stack)
+{
+  return stack->len > 0 ? &g_array_index (stack, Region, stack->len - 1) : NULL;
+}
+
+static void
+stack_pop (GArray *stack)
+{
+  g_array_set_size (stack, stack->len - 1);
+}
+
+static void
+stack_push (GArray *stack,
+            FoldKind kind,
+            int start,
+            int depth)
+{
+  Region region = { kind, start, start, 0, depth };
+
+  g_array_append_val (stack, region);
+}
+
+static gboolean
+is_blank (const char *text)
+{
+  for (const char *p = text; *p != '\0'; p++)
+    if (!g_ascii_isspace (*p))
+      return FALSE;
+  return TRUE;
+}
+
+static int
+get_indent (const char *text)
+{
+  int column = 0;
+
+  for (const char *p = text; *p == ' ' || *p == '\t'; p++)
+    column = *p == '\t' ? (column / 8 + 1) * 8 : column + 1;
+
+  return column;
+}
+
+/* the level of a Markdown ATX heading, or 0 */
+static int
+get_heading_level (const char *text)
+{
+  int level = 0;
+
+  while (text[level] == '#' && level < 6)
+    level++;
+  if (level == 0 || (text[level] != ' ' && text[level] != '\0'))
+    return 0;
+
+  return level;
+}
+
+static void
+scan_braces (TextyFolding *self,
+             int line,
+             const char *text)
+{
+  gboolean quoted = FALSE;
+
+  for (const char *p = text; *p != '\0'; p++)
+    {
+      Region *top;
+
+      /* brackets in string literals on the same line don't count */
+      if (*p == '\\' && p[1] != '\0')
+        {
+          p++;
+          continue;
+        }
+      if (*p == '"')
+        quoted = !quoted;
+      if (quoted)
+        continue;
+
+      if (*p == '{' || *p == '[')
+        {
+          stack_push (self->braces, FOLD_BRACE, line, *p);
+        }
+      else if ((*p == '}' || *p == ']') && (top = stack_top (self->braces)) != NULL)
+        {
+          /* the closing line stays visible */
+          close_region (self, top, line - 1, line);
+          stack_pop (self->braces);
+        }
+    }
+}
+
+static void
+scan_text_line (TextyFolding *self,
+                int line,
+                const char *text)
+{
+  Region *top;
+  int level;
+  int indent;
+
+  if (self->markdown && (level = get_heading_level (text)) > 0)
+    {
+      while ((top = stack_top (self->headings)) != NULL && top->depth >= level)
+        {
+          close_region (self, top, line - 1, line);
+          stack_pop (self->headings);
+        }
+      stack_push (self->headings, FOLD_HEADING, line, level);
+    }
+
+  if (is_blank (text))
+    return;
+
+  /* a line ends every more deeply indented block above it */
+  indent = get_indent (text);
+  while ((top = stack_top (self->indents)) != NULL && top->depth >= indent)
+    {
+      close_region (self, top, self->last_nonblank, line);
+      stack_pop (self->indents);
+    }
+  stack_push (self->indents, FOLD_INDENT, line, indent);
+  self->last_nonblank = line;
+
+  scan_braces (self, line, text);
+}
+
+static void
+finish_scan (TextyFolding *self,
+             int n_lines)
+{
+  for (guint i = 0; i < self->indents->len; i++)
+    close_region (self, &g_array_index (self->indents, Region, i), self->last_nonblank, n_lines);
+  for (guint i = 0; i < self->headings->len; i++)
+    close_region (self, &g_array_index (self->headings, Region, i), n_lines - 1, n_lines);
+
+  /* brackets never closed don't make a region, but stay open for edits below */
+  g_array_set_size (self->indents, 0);
+  g_array_set_size (self->headings, 0);
+}
+
+static char *
+get_line_text (GtkTextIter *iter)
+{
+  GtkTextIter end = *iter;
+
+  if (!gtk_text_iter_ends_line (&end))
+    gtk_text_iter_forward_to_line_end (&end);
+
+  return gtk_text_iter_get_slice (iter, &end);
+}
+
+static int
+previous_nonblank (TextyFolding *self,
+                   int line)
+{
+  GtkTextIter iter;
+
+  while (--line >= 0)
+    {
+      g_autofree char *text = NULL;
+
+      gtk_text_buffer_get_iter_at_line (self->buffer, &iter, line);
+      text = get_line_text (&iter);
+      if (!is_blank (text))
+        break;
+    }
+
+  return line;
+}
+
+static int
+compare_start (gconstpointer a,
+               gconstpointer b)
+{
+  return ((const Region *) a)->start - ((const Region *) b)->start;
+}
+
+/*
+ * Forgets what was found from 'line' on. Everything wholly above it still
+ * holds, and the regions that closed at or below it go back on the stacks
+ * as if the scan had just reached it.
+ */
+static void
+rewind_scan (TextyFolding *self,
+             int line)
+{
+  GArray *stacks[] = { self->braces, self->headings, self->indents };
+  guint kept = 0;
+
+  if (line >= self->scan_line)
+    return;
+
+  for (guint s = 0; s < G_N_ELEMENTS (stacks); s++)
+    {
+      guint n = 0;
+
+      for (guint i = 0; i < stacks[s]->len; i++)
+        if (g_array_index (stacks[s], Region, i).start < line)
+          g_array_index (stacks[s], Region, n++) = g_array_index (stacks[s], Region, i);
+      g_array_set_size (stacks[s], n);
+    }
+
+  for (guint i = 0; i < self->regions->len; i++)
+    {
+      Region *region = &g_array_index (self->regions, Region, i);
+
+      if (region->start >= line)
+        continue;
+      if (region->closed_at < line)
+        g_array_index (self->regions, Region, kept++) = *region;
+      else
+        g_array_append_val (stacks[region->kind], *region);
+    }
+  g_array_set_size (self->regions, kept);
+
+  for (guint s = 0; s < G_N_ELEMENTS (stacks); s++)
+    g_array_sort (stacks[s], compare_start);
+
+  self->scan_line = line;
+  self->last_nonblank = previous_nonblank (self, line);
+}
+
+/* scans from where it left off, until 'deadline' or the end of the buffer */
+static gboolean
+scan (TextyFolding *self,
+      gint64 deadline)
+{
+  GtkTextIter iter;
+  int n_lines;
+
+  /* rescanning from the line before the edit finds again the blocks that
+   * were closed there without hiding anything, and so were never kept */
+  if (self->dirty_line != G_MAXINT)
+    {
+      rewind_scan (self, MAX (previous_nonblank (self, self->dirty_line), 0));
+      self->dirty_line = G_MAXINT;
+    }
+
+  n_lines = gtk_text_buffer_get_line_count (self->buffer);
+  gtk_text_buffer_get_iter_at_line (self->buffer, &iter, self->scan_line);
+  while (self->scan_line < n_lines)
+    {
+      g_autofree char *text = get_line_text (&iter);
+
+      scan_text_line (self, self->scan_line, text);
+      gtk_text_iter_forward_line (&iter);
+      self->scan_line++;
+
+      if (deadline > 0 &&
+          self->scan_line % SCAN_CHECK_LINES == 0 &&
+          g_get_monotonic_time () > deadline)
+        return FALSE;
+    }
+
+  if (self->scan_line == n_lines)
+    {
+      finish_scan (self, n_lines);
+      /* past the end, so edits anywhere rewind */
+      self->scan_line++;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+scan_step (gpointer user_data)
+{
+  TextyFolding *self = user_data;
+
+  if (!scan (self, g_get_monotonic_time () + SCAN_BUDGET_USEC))
+    return G_SOURCE_CONTINUE;
+
+  self->scan_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
+static void
+queue_scan (TextyFolding *self,
+            int line)
+{
+  self->dirty_line = MIN (self->dirty_line, line);
+  if (self->scan_id == 0)
+    self->scan_id = g_idle_add_full (G_PRIORITY_LOW, scan_step, self, NULL);
+}
+
+static void
+on_insert_text (GtkTextBuffer *buffer,
+                GtkTextIter *location,
+                char *text,
+                int length,
+                TextyFolding *self)
+{
+  queue_scan (self, gtk_text_iter_get_line (location));
+}
+
+static void
+on_delete_range (GtkTextBuffer *buffer,
+                 GtkTextIter *start,
+                 GtkTextIter *end,
+                 TextyFolding *self)
+{
+  queue_scan (self, gtk_text_iter_get_line (start));
+}
+
+/**********************************/
+/* Scanning 👆️                    */
+/**********************************/
+
+static int
+get_n_lines (TextyFolding *self)
+{
+  return gtk_text_buffer_get_line_count (self->buffer);
+}
+
+/* the region 'line' heads, or else the innermost one it is in */
+static const Region *
+find_region (TextyFolding *self,
+             int line)
+{
+  const Region *found = NULL;
+  int n_lines;
+
+  /* folding needs an answer now, not once the idle scan gets there */
+  if (self->scan_id != 0)
+    {
+      scan (self, 0);
+      g_clear_handle_id (&self->scan_id, g_source_remove);
+    }
+
+  n_lines = get_n_lines (self);
+  for (guint i = 0; i < self->regions->len; i++)
+    {
+      const Region *region = &g_array_index (self->regions, Region, i);
+
+      if (region->start > line || region->end <= region->start || region->end >= n_lines)
+        continue;
+      if (region->start < line && region->end < line)
+        continue;
+      if (found == NULL ||
+          region->start > found->start ||
+          (region->start == found->start && region->kind < found->kind))
+        found = region;
+    }
+
+  return found;
+}
+
+static void
+get_hidden_range (TextyFolding *self,
+                  const Region *region,
+                  GtkTextIter *start,
+                  GtkTextIter *end)
+{
+  gtk_text_buffer_get_iter_at_line (self->buffer, start, region->start + 1);
+  if (region->end + 1 < get_n_lines (self))
+    gtk_text_buffer_get_iter_at_line (self->buffer, end, region->end + 1);
+  else
+    gtk_text_buffer_get_end_iter (self->buffer, end);
+}
+
+static void
+fold (TextyFolding *self,
+      const Region *region)
+{
+  GtkTextIter start;
+  GtkTextIter end;
+  GtkTextIter insert;
+
+  get_hidden_range (self, region, &start, &end);
+  gtk_text_buffer_apply_tag (self->buffer, self->fold_tag, &start, &end);
+
+  gtk_text_buffer_get_iter_at_line (self->buffer, &start, region->start);
+  end = start;
+  if (!gtk_text_iter_ends_line (&end))
+    gtk_text_iter_forward_to_line_end (&end);
+  gtk_text_buffer_apply_tag (self->buffer, self->header_tag, &start, &end);
+
+  /* the cursor can't stay in text that isn't there to show it */
+  gtk_text_buffer_get_iter_at_mark (self->buffer, &insert, gtk_text_buffer_get_insert (self->buffer));
+  if (gtk_text_iter_has_tag (&insert, self->fold_tag))
+    gtk_text_buffer_place_cursor (self->buffer, &end);
+}
+
+/* shows what 'line' hides, leaving folds nested inside it folded */
+static gboolean
+unfold (TextyFolding *self,
+        int line)
+{
+  g_autoptr (GArray) headers = NULL;
+  GtkTextIter start;
+  GtkTextIter end;
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_iter_at_line (self->buffer, &iter, line);
+  if (!gtk_text_iter_has_tag (&iter, self->header_tag))
+    return FALSE;
+  start = iter;
+  if (!gtk_text_iter_forward_line (&start) || !gtk_text_iter_has_tag (&start, self->fold_tag))
+    return FALSE;
+  end = start;
+  gtk_text_iter_forward_to_tag_toggle (&end, self->fold_tag);
+
+  /* the folds inside, collected first as changing tags invalidates iters */
+  headers = g_array_new (FALSE, FALSE, sizeof (int));
+  iter = start;
+  do
+    {
+      if (gtk_text_iter_starts_tag (&iter, self->header_tag))
+        {
+          int header = gtk_text_iter_get_line (&iter);
+
+          g_array_append_val (headers, header);
+        }
+    }
+  while (gtk_text_iter_forward_to_tag_toggle (&iter, self->header_tag) &&
+         gtk_text_iter_compare (&iter, &end) < 0);
+
+  gtk_text_buffer_remove_tag (self->buffer, self->fold_tag, &start, &end);
+  gtk_text_buffer_get_iter_at_line (self->buffer, &iter, line);
+  gtk_text_buffer_get_iter_at_line (self->buffer, &start, line + 1);
+  gtk_text_buffer_remove_tag (self->buffer, self->header_tag, &iter, &start);
+
+  for (guint i = 0; i < headers->len; i++)
+    {
+      int header = g_array_index (headers, int, i);
+      const Region *region = find_region (self, header);
+
+      if (region != NULL && region->start == header)
+        fold (self, region);
+    }
+
+  return TRUE;
+}
+
+/**********************************/
+/* Folding 👆️                     */
+/**********************************/
+
+static void
+texty_folding_finalize (GObject *object)
+{
+  TextyFolding *self = TEXTY_FOLDING (object);
+
+  g_clear_handle_id (&self->scan_id, g_source_remove);
+  g_clear_pointer (&self->regions, g_array_unref);
+  g_clear_pointer (&self->braces, g_array_unref);
+  g_clear_pointer (&self->indents, g_array_unref);
+  g_clear_pointer (&self->headings, g_array_unref);
+
+  G_OBJECT_CLASS (texty_folding_parent_class)->finalize (object);
+}
+
+static void
+texty_folding_class_init (TextyFoldingClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = texty_folding_finalize;
+}
+
+static void
+texty_folding_init (TextyFolding *self)
+{
+  self->regions = g_array_new (FALSE, FALSE, sizeof (Region));
+  self->braces = g_array_new (FALSE, FALSE, sizeof (Region));
+  self->indents = g_array_new (FALSE, FALSE, sizeof (Region));
+  self->headings = g_array_new (FALSE, FALSE, sizeof (Region));
+  self->dirty_line = G_MAXINT;
+  self->last_nonblank = -1;
+}
+
+/*
+ * Finds the regions of 'buffer' that can be folded: blocks of deeper
+ * indentation, bracket pairs spanning lines and, for Markdown, sections
+ * under a heading. They are scanned for on idle, resuming from the first
+ * edited line. Folded text is tagged invisible so the view doesn't lay it
+ * out at all. The buffer is expected to own the result, as object data.
+ */
+TextyFolding *
+texty_folding_new (GtkTextBuffer *buffer)
+{
+  TextyFolding *self;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+  self = g_object_new (TEXTY_TYPE_FOLDING, NULL);
+  self->buffer = buffer;
+  self->fold_tag = gtk_text_buffer_create_tag (buffer, NULL, "invisible", TRUE, NULL);
+  self->header_tag = gtk_text_buffer_create_tag (buffer, NULL,
+                                                 "paragraph-background-rgba",
+                                                 &(GdkRGBA){ 0.21, 0.52, 0.89, 0.15 },
+                                                 NULL);
+
+  /* where the text goes before it is inserted, where it was after deletion */
+  g_signal_connect (buffer, "insert-text", G_CALLBACK (on_insert_text), self);
+  g_signal_connect_after (buffer, "delete-range", G_CALLBACK (on_delete_range), self);
+  queue_scan (self, 0);
+
+  return self;
+}
+
+/* Markdown headings fold the sections under them */
+void
+texty_folding_set_markdown (TextyFolding *self,
+                            gboolean markdown)
+{
+  g_return_if_fail (TEXTY_IS_FOLDING (self));
+
+  if (self->markdown == markdown)
+    return;
+  self->markdown = markdown;
+
+  queue_scan (self, 0);
+}
+
+/*
+ * Folds the region 'line' heads or is in, or unfolds it when 'line' is an
+ * already folded one. Returns FALSE when there is nothing to fold there.
+ */
+gboolean
+texty_folding_toggle (TextyFolding *self,
+                      int line)
+{
+  const Region *region;
+
+  g_return_val_if_fail (TEXTY_IS_FOLDING (self), FALSE);
+
+  if (unfold (self, line))
+    return TRUE;
+
+  region = find_region (self, line);
+  if (region == NULL)
+    return FALSE;
+
+  fold (self, region);
+  return TRUE;
+}
+
+void
+texty_folding_unfold_all (TextyFolding *self)
+{
+  GtkTextIter start;
+  GtkTextIter end;
+
+  g_return_if_fail (TEXTY_IS_FOLDING (self));
+
+  gtk_text_buffer_get_bounds (self->buffer, &start, &end);
+  gtk_text_buffer_remove_tag (self->buffer, self->fold_tag, &start, &end);
+  gtk_text_buffer_remove_tag (self->buffer, self->header_tag, &start, &end);
+}
+
+/*
+ * Returns all of the text of 'buffer', folded lines included, for anything
+ * that saves, rewrites or compares the document. The text a view shows
+ * leaves folds out, as they are tagged invisible.
+ */
+GBytes *
+texty_folding_get_document (GtkTextBuffer *buffer)
+{
+  GtkTextIter start;
+  GtkTextIter end;
+  char *text;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+
+  return g_bytes_new_take (text, strlen (text));
+}
@@ -0,0 +1,606 @@
+/* texty-grep.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-grep.h"
+
+#include <string.h>
+
+/* a label doesn't need more of a line than this */
+#define MAX_DISPLAY_LENGTH 4096
+/* the smallest piece of text worth giving to another thread */
+#define MIN_CHUNK_SIZE (1024 * 1024)
+#define MIN_CHUNK_MATCHES 4096
+
+/* a line that matched, the offset being where it starts in the text */
+typedef struct
+{
+  gsize offset;
+  gsize length;
+  guint line;
+} Match;
+
+/* a line shown in the view, either a match or context around one */
+typedef struct
+{
+  gsize offset;
+  gsize length;
+  guint line;
+  gboolean match;
+} Row;
+
+struct _TextyGrepLine
+{
+  GObject parent_instance;
+
+  guint number;
+  char *text;
+  gboolean match;
+};
+
+G_DEFINE_FINAL_TYPE (TextyGrepLine, texty_grep_line, G_TYPE_OBJECT)
+
+static void
+texty_grep_line_finalize (GObject *object)
+{
+  TextyGrepLine *self = TEXTY_GREP_LINE (object);
+
+  g_free (self->text);
+
+  G_OBJECT_CLASS (texty_grep_line_parent_class)->finalize (object);
+}
+
+static void
+texty_grep_line_class_init (TextyGrepLineClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = texty_grep_line_finalize;
+}
+
+static void
+texty_grep_line_init (TextyGrepLine *self)
+{
+}
+
+static TextyGrepLine *
+texty_grep_line_new (const Row *row,
+                     const char *text)
+{
+  TextyGrepLine *self;
+  gsize length = row->length;
+
+  /* cut very long lines short, on a character boundary */
+  if (length > MAX_DISPLAY_LENGTH)
+    {
+      length = MAX_DISPLAY_LENGTH;
+      while (length > 0 && (text[row->offset + length] & 0xc0) == 0x80)
+        length--;
+    }
+
+  self = g_object_new (TEXTY_TYPE_GREP_LINE, NULL);
+  self->number = row->line;
+  self->text = g_strndup (text + row->offset, length);
+  self->match = row->match;
+
+  return self;
+}
+
+/* zero based, as GtkTextBuffer counts lines */
+guint
+texty_grep_line_get_number (TextyGrepLine *self)
+{
+  g_return_val_if_fail (TEXTY_IS_GREP_LINE (self), 0);
+
+  return self->number;
+}
+
+const char *
+texty_grep_line_get_text (TextyGrepLine *self)
+{
+  g_return_val_if_fail (TEXTY_IS_GREP_LINE (self), NULL);
+
+  return self->text;
+}
+
+/* FALSE for the context lines around a match */
+gboolean
+texty_grep_line_is_match (TextyGrepLine *self)
+{
+  g_return_val_if_fail (TEXTY_IS_GREP_LINE (self), FALSE);
+
+  return self->match;
+}
+
+/**********************************/
+/* Line 👆️                        */
+/**********************************/
+
+struct _TextyGrepModel
+{
+  GObject parent_instance;
+
+  /* the snapshot searched, rows only point into it */
+  GBytes *text;
+  char *pattern;
+  GArray *matches;
+  GArray *rows;
+};
+
+static void texty_grep_model_list_model_init (GListModelInterface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE (TextyGrepModel,
+                               texty_grep_model,
+                               G_TYPE_OBJECT,
+                               G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL,
+                                                      texty_grep_model_list_model_init))
+
+static GType
+texty_grep_model_get_item_type (GListModel *list)
+{
+  return TEXTY_TYPE_GREP_LINE;
+}
+
+static guint
+texty_grep_model_get_n_items (GListModel *list)
+{
+  return TEXTY_GREP_MODEL (list)->rows->len;
+}
+
+/* items are only made for the rows the view asks for, as it scrolls */
+static gpointer
+texty_grep_model_get_item (GListModel *list,
+                           guint position)
+{
+  TextyGrepModel *self = TEXTY_GREP_MODEL (list);
+
+  if (position >= self->rows->len)
+    return NULL;
+
+  return texty_grep_line_new (&g_array_index (self->rows, Row, position),
+                              g_bytes_get_data (self->text, NULL));
+}
+
+static void
+texty_grep_model_list_model_init (GListModelInterface *iface)
+{
+  iface->get_item_type = texty_grep_model_get_item_type;
+  iface->get_n_items = texty_grep_model_get_n_items;
+  iface->get_item = texty_grep_model_get_item;
+}
+
+static void
+texty_grep_model_finalize (GObject *object)
+{
+  TextyGrepModel *self = TEXTY_GREP_MODEL (object);
+
+  g_bytes_unref (self->text);
+  g_free (self->pattern);
+  g_array_unref (self->matches);
+  g_array_unref (self->rows);
+
+  G_OBJECT_CLASS (texty_grep_model_parent_class)->finalize (object);
+}
+
+static void
+texty_grep_model_class_init (TextyGrepModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = texty_grep_model_finalize;
+}
+
+static void
+texty_grep_model_init (TextyGrepModel *self)
+{
+}
+
+guint
+texty_grep_model_get_n_matches (TextyGrepModel *self)
+{
+  g_return_val_if_fail (TEXTY_IS_GREP_MODEL (self), 0);
+
+  return self->matches->len;
+}
+
+/**********************************/
+/* Model 👆️                       */
+/**********************************/
+
+typedef struct
+{
+  GMutex mutex;
+  GCond cond;
+  guint pending;
+} Batch;
+
+typedef struct
+{
+  GRegex *regex;
+  const char *text;
+  /* a range of the text to search... */
+  gsize begin;
+  gsize end;
+  /* ...or the matches of a previous search to narrow down */
+  const Match *candidates;
+  gsize n_candidates;
+  GArray *matches;
+  guint n_lines;
+  GCancellable *cancellable;
+  Batch *batch;
+} Chunk;
+
+/* a CR left over from a CRLF isn't part of the line */
+static gsize
+strip_cr (const char *line,
+          gsize length)
+{
+  if (length > 0 && line[length - 1] == '\r')
+    length--;
+  return length;
+}
+
+static void
+search_chunk (gpointer data,
+              gpointer user_data)
+{
+  Chunk *chunk = data;
+  const char *p = chunk->text + chunk->begin;
+  const char *end = chunk->text + chunk->end;
+  guint line = 0;
+
+  if (chunk->candidates != NULL)
+    {
+      for (gsize i = 0; i < chunk->n_candidates; i++)
+        {
+          const Match *match = &chunk->candidates[i];
+
+          if (g_regex_match_full (chunk->regex, chunk->text + match->offset, match->length,
+                                  0, 0, NULL, NULL))
+            g_array_append_val (chunk->matches, *match);
+        }
+    }
+  else
+    {
+      while (p < end)
+        {
+          const char *eol = memchr (p, '\n', end - p);
+          gsize length;
+
+          if (eol == NULL)
+            eol = end;
+          length = strip_cr (p, eol - p);
+
+          if (g_regex_match_full (chunk->regex, p, length, 0, 0, NULL, NULL))
+            {
+              Match match = { p - chunk->text, length, line };
+
+              g_array_append_val (chunk->matches, match);
+            }
+
+          line++;
+          p = eol + 1;
+          if ((line & 0xfff) == 0 && g_cancellable_is_cancelled (chunk->cancellable))
+            break;
+        }
+    }
+  chunk->n_lines = line;
+
+  g_mutex_lock (&chunk->batch->mutex);
+  if (--chunk->batch->pending == 0)
+    g_cond_signal (&chunk->batch->cond);
+  g_mutex_unlock (&chunk->batch->mutex);
+}
+
+/* shared by every search, one thread per processor */
+static GThreadPool *
+get_pool (void)
+{
+  static GThreadPool *pool = NULL;
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      pool = g_thread_pool_new (search_chunk, NULL, g_get_num_processors (), FALSE, NULL);
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return pool;
+}
+
+static gboolean
+is_literal (const char *pattern)
+{
+  g_autofree char *escaped = g_regex_escape_string (pattern, -1);
+
+  return g_str_equal (escaped, pattern);
+}
+
+/*
+ * Typing more of a plain word can only drop lines, so only the lines that
+ * matched before need another look.
+ */
+static gboolean
+can_narrow (TextyGrepModel *previous,
+            GBytes *text,
+            const char *pattern)
+{
+  return previous != NULL
+         && previous->text == text
+         && is_literal (previous->pattern)
+         && is_literal (pattern)
+         && strstr (pattern, previous->pattern) != NULL;
+}
+
+/* 'offset' is where the line starts in 'text' */
+static void
+append_row (GArray *rows,
+            const char *text,
+            gsize offset,
+            gsize length,
+            guint line,
+            gboolean match)
+{
+  Row row = { offset, strip_cr (text + offset, length), line, match };
+
+  g_array_append_val (rows, row);
+}
+
+/* each match preceded and followed by up to 'context' lines, none twice */
+static GArray *
+build_rows (const char *text,
+            gsize length,
+            GArray *matches,
+            guint context)
+{
+  GArray *rows;
+  gint64 last = -1;
+
+  rows = g_array_sized_new (FALSE, FALSE, sizeof (Row), matches->len);
+
+  for (guint i = 0; i < matches->len; i++)
+    {
+      const Match *match = &g_array_index (matches, Match, i);
+      guint next = i + 1 < matches->len ? g_array_index (matches, Match, i + 1).line : G_MAXUINT;
+      gsize start = match->offset;
+      guint n_before = 0;
+      const char *eol;
+      gsize pos;
+
+      /* walk back over the lines before it that aren't shown yet */
+      while (n_before < context && (gint64) match->line - n_before - 1 > last && start > 0)
+        {
+          start--;
+          while (start > 0 && text[start - 1] != '\n')
+            start--;
+          n_before++;
+        }
+      for (guint k = 0; k < n_before; k++)
+        {
+          eol = memchr (text + start, '\n', length - start);
+          append_row (rows, text, start, eol - (text + start), match->line - n_before + k, FALSE);
+          start = eol - text + 1;
+        }
+
+      append_row (rows, text, match->offset, match->length, match->line, TRUE);
+      last = match->line;
+
+      /* and the lines after it, up to the next match */
+      eol = memchr (text + match->offset, '\n', length - match->offset);
+      pos = eol != NULL ? (gsize) (eol - text) + 1 : length;
+      for (guint k = 1; k <= context && match->line + k < next && pos < length; k++)
+        {
+          gsize line_length;
+
+          eol = memchr (text + pos, '\n', length - pos);
+          line_length = eol != NULL ? (gsize) (eol - (text + pos)) : length - pos;
+          append_row (rows, text, pos, line_length, match->line + k, FALSE);
+          last = match->line + k;
+          pos += line_length + 1;
+        }
+    }
+
+  return rows;
+}
+
+/*
+ * Finds the lines of 'text' matching the regular expression 'pattern',
+ * splitting the work across a thread pool. When 'previous' searched the
+ * same snapshot for a word this pattern extends, only its matches are
+ * searched again.
+ */
+TextyGrepModel *
+texty_grep (GBytes *text,
+            const char *pattern,
+            guint context,
+            TextyGrepModel *previous,
+            GCancellable *cancellable,
+            GError **error)
+{
+  TextyGrepModel *self;
+  g_autoptr (GRegex) regex = NULL;
+  const char *data;
+  gsize length;
+  gboolean narrow;
+  guint n_chunks;
+  Chunk *chunks;
+  Batch batch;
+  GArray *matches;
+  guint base = 0;
+
+  g_return_val_if_fail (text != NULL, NULL);
+  g_return_val_if_fail (pattern != NULL, NULL);
+  g_return_val_if_fail (previous == NULL || TEXTY_IS_GREP_MODEL (previous), NULL);
+
+  regex = g_regex_new (pattern, G_REGEX_OPTIMIZE, 0, error);
+  if (regex == NULL)
+    return NULL;
+
+  data = g_bytes_get_data (text, &length);
+  narrow = can_narrow (previous, text, pattern);
+  if (narrow)
+    n_chunks = CLAMP (previous->matches->len / MIN_CHUNK_MATCHES, 1, g_get_num_processors () * 4);
+  else
+    n_chunks = CLAMP (length / MIN_CHUNK_SIZE, 1, g_get_num_processors () * 4);
+
+  chunks = g_new0 (Chunk, n_chunks);
+  g_mutex_init (&batch.mutex);
+  g_cond_init (&batch.cond);
+  batch.pending = n_chunks;
+
+  for (guint i = 0; i < n_chunks; i++)
+    {
+      Chunk *chunk = &chunks[i];
+
+      chunk->regex = regex;
+      chunk->text = data;
+      chunk->matches = g_array_new (FALSE, FALSE, sizeof (Match));
+      chunk->cancellable = cancellable;
+      chunk->batch = &batch;
+
+      if (narrow)
+        {
+          gsize first = previous->matches->len * (gsize) i / n_chunks;
+          gsize last = previous->matches->len * (gsize) (i + 1) / n_chunks;
+
+          chunk->candidates = &g_array_index (previous->matches, Match, 0) + first;
+          chunk->n_candidates = last - first;
+        }
+      else
+        {
+          gsize begin = i > 0 ? chunks[i - 1].end : 0;
+          gsize end = MAX (length / n_chunks * (i + 1), begin);
+          const char *eol = end < length ? memchr (data + end, '\n', length - end) : NULL;
+
+          /* chunks end just after a newline, so no line is split */
+          chunk->begin = begin;
+          chunk->end = eol != NULL && i + 1 < n_chunks ? (gsize) (eol - data) + 1 : length;
+        }
+    }
+
+  for (guint i = 0; i < n_chunks; i++)
+    g_thread_pool_push (get_pool (), &chunks[i], NULL);
+
+  g_mutex_lock (&batch.mutex);
+  while (batch.pending > 0)
+    g_cond_wait (&batch.cond, &batch.mutex);
+  g_mutex_unlock (&batch.mutex);
+  g_mutex_clear (&batch.mutex);
+  g_cond_clear (&batch.cond);
+
+  /* number the lines of each chunk after those of the chunks before it */
+  matches = g_array_new (FALSE, FALSE, sizeof (Match));
+  for (guint i = 0; i < n_chunks; i++)
+    {
+      if (!narrow)
+        {
+          for (guint j = 0; j < chunks[i].matches->len; j++)
+            g_array_index (chunks[i].matches, Match, j).line += base;
+          base += chunks[i].n_lines;
+        }
+      g_array_append_vals (matches, chunks[i].matches->data, chunks[i].matches->len);
+      g_array_unref (chunks[i].matches);
+    }
+  g_free (chunks);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+      g_array_unref (matches);
+      return NULL;
+    }
+
+  self = g_object_new (TEXTY_TYPE_GREP_MODEL, NULL);
+  self->text = g_bytes_ref (text);
+  self->pattern = g_strdup (pattern);
+  self->matches = matches;
+  self->rows = build_rows (data, length, matches, context);
+
+  return self;
+}
+
+typedef struct
+{
+  GBytes *text;
+  char *pattern;
+  guint context;
+  TextyGrepModel *previous;
+} GrepData;
+
+static void
+grep_data_free (GrepData *data)
+{
+  g_bytes_unref (data->text);
+  g_free (data->pattern);
+  g_clear_object (&data->previous);
+  g_free (data);
+}
+
+static void
+grep_thread (GTask *task,
+             gpointer source_object,
+             gpointer task_data,
+             GCancellable *cancellable)
+{
+  GrepData *data = task_data;
+  GError *error = NULL;
+  TextyGrepModel *model;
+
+  model = texty_grep (data->text, data->pattern, data->context, data->previous, cancellable, &error);
+  if (model != NULL)
+    g_task_return_pointer (task, model, g_object_unref);
+  else
+    g_task_return_error (task, error);
+}
+
+void
+texty_grep_async (GBytes *text,
+                  const char *pattern,
+                  guint context,
+                  TextyGrepModel *previous,
+                  GCancellable *cancellable,
+                  GAsyncReadyCallback callback,
+                  gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  GrepData *data;
+
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (pattern != NULL);
+
+  data = g_new0 (GrepData, 1);
+  data->text = g_bytes_ref (text);
+  data->pattern = g_strdup (pattern);
+  data->context = context;
+  data->previous = previous != NULL ? g_object_ref (previous) : NULL;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, texty_grep_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) grep_data_free);
+  g_task_run_in_thread (task, grep_thread);
+}
+
+TextyGrepModel *
+texty_grep_finish (GAsyncResult *result,
+                   GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
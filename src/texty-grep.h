@@ -0,0 +1,57 @@
+/* texty-grep.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define TEXTY_TYPE_GREP_LINE (texty_grep_line_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyGrepLine, texty_grep_line, TEXTY, GREP_LINE, GObject)
+
+guint           texty_grep_line_get_number    (TextyGrepLine        *self);
+const char     *texty_grep_line_get_text      (TextyGrepLine        *self);
+gboolean        texty_grep_line_is_match      (TextyGrepLine        *self);
+
+#define TEXTY_TYPE_GREP_MODEL (texty_grep_model_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyGrepModel, texty_grep_model, TEXTY, GREP_MODEL, GObject)
+
+guint           texty_grep_model_get_n_matches (TextyGrepModel      *self);
+
+TextyGrepModel *texty_grep                    (GBytes               *text,
+                                               const char           *pattern,
+                                               guint                 context,
+                                               TextyGrepModel       *previous,
+                                               GCancellable         *cancellable,
+                                               GError              **error);
+void            texty_grep_async              (GBytes               *text,
+                                               const char           *pattern,
+                                               guint                 context,
+                                               TextyGrepModel       *previous,
+                                               GCancellable         *cancellable,
+                                               GAsyncReadyCallback   callback,
+                                               gpointer              user_data);
+TextyGrepModel *texty_grep_finish             (GAsyncResult         *result,
+                                               GError              **error);
+
+G_END_DECLS
@@ -0,0 +1,505 @@
+/* texty-json.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-json.h"
+
+#include <string.h>
+
+#define INDENT_WIDTH 2
+/* how much text goes by between looks at the cancellable */
+#define CANCEL_INTERVAL (4 * 1024 * 1024)
+
+typedef enum
+{
+  EXPECT_VALUE,
+  EXPECT_KEY,
+  EXPECT_COLON,
+  /* a ',' or the end of the container */
+  EXPECT_NEXT,
+  EXPECT_END,
+} Expect;
+
+typedef struct
+{
+  const char *p;
+  const char *end;
+  /* NULL when only validating */
+  GString *out;
+  gboolean pretty;
+  /* the containers still open, as their opening brackets */
+  GByteArray *stack;
+  const char *message;
+} Parser;
+
+gboolean
+texty_json_op_from_string (const char *str,
+                           TextyJsonOp *op)
+{
+  static const char *names[] = {
+    [TEXTY_JSON_OP_FORMAT] = "format",
+    [TEXTY_JSON_OP_MINIFY] = "minify",
+    [TEXTY_JSON_OP_VALIDATE] = "validate",
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      if (g_strcmp0 (str, names[i]) == 0)
+        {
+          *op = i;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/* leaves 'p' where the problem is */
+static gboolean
+fail (Parser *parser,
+      const char *message)
+{
+  parser->message = message;
+  return FALSE;
+}
+
+static inline void
+emit (Parser *parser,
+      const char *text,
+      gsize length)
+{
+  if (parser->out != NULL)
+    g_string_append_len (parser->out, text, length);
+}
+
+static inline void
+emit_c (Parser *parser,
+        char c)
+{
+  if (parser->out != NULL)
+    g_string_append_c (parser->out, c);
+}
+
+static void
+emit_newline (Parser *parser)
+{
+  gsize indent;
+
+  if (parser->out == NULL || !parser->pretty)
+    return;
+
+  indent = parser->stack->len * INDENT_WIDTH;
+  g_string_append_c (parser->out, '\n');
+  /* grows the string once, then fills the indent in place */
+  g_string_set_size (parser->out, parser->out->len + indent);
+  memset (parser->out->str + parser->out->len - indent, ' ', indent);
+}
+
+static inline void
+skip_whitespace (Parser *parser)
+{
+  while (parser->p < parser->end
+         && (*parser->p == ' ' || *parser->p == '\n' || *parser->p == '\r' || *parser->p == '\t'))
+    parser->p++;
+}
+
+/* strings are checked, then copied with their escapes as they are */
+static gboolean
+scan_string (Parser *parser)
+{
+  const char *start = parser->p++;
+
+  while (parser->p < parser->end)
+    {
+      guchar c = *parser->p;
+
+      if (G_LIKELY (c >= 0x20 && c != '"' && c != '\\'))
+        {
+          parser->p++;
+          continue;
+        }
+      if (c == '"')
+        {
+          parser->p++;
+          emit (parser, start, parser->p - start);
+          return TRUE;
+        }
+      if (c != '\\')
+        return fail (parser, "Unescaped control character in string");
+
+      parser->p++;
+      if (parser->p == parser->end)
+        break;
+      switch (*parser->p)
+        {
+        case '"':
+        case '\\':
+        case '/':
+        case 'b':
+        case 'f':
+        case 'n':
+        case 'r':
+        case 't':
+          parser->p++;
+          break;
+        case 'u':
+          parser->p++;
+          for (int i = 0; i < 4; i++, parser->p++)
+            if (parser->p == parser->end || !g_ascii_isxdigit (*parser->p))
+              return fail (parser, "Invalid Unicode escape");
+          break;
+        default:
+          return fail (parser, "Invalid escape");
+        }
+    }
+
+  parser->p = start;
+  return fail (parser, "Unterminated string");
+}
+
+static gboolean
+skip_digits (Parser *parser)
+{
+  const char *start = parser->p;
+
+  while (parser->p < parser->end && g_ascii_isdigit (*parser->p))
+    parser->p++;
+
+  return parser->p > start;
+}
+
+static gboolean
+scan_number (Parser *parser)
+{
+  const char *start = parser->p;
+
+  if (*parser->p == '-')
+    parser->p++;
+  /* no leading zeros */
+  if (parser->p < parser->end && *parser->p == '0')
+    parser->p++;
+  else if (!skip_digits (parser))
+    return fail (parser, "Invalid number");
+
+  if (parser->p < parser->end && *parser->p == '.')
+    {
+      parser->p++;
+      if (!skip_digits (parser))
+        return fail (parser, "Invalid number");
+    }
+
+  if (parser->p < parser->end && (*parser->p == 'e' || *parser->p == 'E'))
+    {
+      parser->p++;
+      if (parser->p < parser->end && (*parser->p == '+' || *parser->p == '-'))
+        parser->p++;
+      if (!skip_digits (parser))
+        return fail (parser, "Invalid number");
+    }
+
+  emit (parser, start, parser->p - start);
+  return TRUE;
+}
+
+static gboolean
+scan_literal (Parser *parser)
+{
+  static const char *literals[] = { "true", "false", "null" };
+
+  for (guint i = 0; i < G_N_ELEMENTS (literals); i++)
+    {
+      gsize length = strlen (literals[i]);
+
+      if ((gsize) (parser->end - parser->p) >= length
+          && memcmp (parser->p, literals[i], length) == 0)
+        {
+          emit (parser, parser->p, length);
+          parser->p += length;
+          return TRUE;
+        }
+    }
+
+  return fail (parser, "Expected a value");
+}
+
+static inline char
+closing_bracket (char opening)
+{
+  return opening == '{' ? '}' : ']';
+}
+
+/*
+ * Walks the tokens once, keeping only the stack of open containers, and
+ * writes each one straight to the output with the whitespace asked for.
+ * Nothing like a parse tree is ever built, so any size of document only
+ * costs its output.
+ */
+static gboolean
+parse (Parser *parser,
+       GCancellable *cancellable,
+       GError **error)
+{
+  Expect expect = EXPECT_VALUE;
+  const char *next_check = parser->p + CANCEL_INTERVAL;
+
+  for (;;)
+    {
+      char c;
+
+      skip_whitespace (parser);
+      if (parser->p >= next_check)
+        {
+          if (g_cancellable_set_error_if_cancelled (cancellable, error))
+            return FALSE;
+          next_check = parser->p + CANCEL_INTERVAL;
+        }
+
+      if (parser->p == parser->end)
+        {
+          if (expect == EXPECT_END)
+            return TRUE;
+          return fail (parser, "Unexpected end of the document");
+        }
+
+      c = *parser->p;
+      switch (expect)
+        {
+        case EXPECT_END:
+          return fail (parser, "Unexpected text after the document");
+
+        case EXPECT_KEY:
+          if (c != '"')
+            return fail (parser, "Expected a string for the key");
+          if (!scan_string (parser))
+            return FALSE;
+          expect = EXPECT_COLON;
+          continue;
+
+        case EXPECT_COLON:
+          if (c != ':')
+            return fail (parser, "Expected ‘:’");
+          parser->p++;
+          if (parser->pretty)
+            emit (parser, ": ", 2);
+          else
+            emit_c (parser, ':');
+          expect = EXPECT_VALUE;
+          continue;
+
+        case EXPECT_NEXT:
+          {
+            char opening = parser->stack->data[parser->stack->len - 1];
+
+            if (c == ',')
+              {
+                parser->p++;
+                emit_c (parser, ',');
+                emit_newline (parser);
+                expect = opening == '{' ? EXPECT_KEY : EXPECT_VALUE;
+                continue;
+              }
+            if (c != closing_bracket (opening))
+              return fail (parser, opening == '{' ? "Expected ‘,’ or ‘}’" : "Expected ‘,’ or ‘]’");
+
+            parser->p++;
+            g_byte_array_set_size (parser->stack, parser->stack->len - 1);
+            emit_newline (parser);
+            emit_c (parser, c);
+            break;
+          }
+
+        case EXPECT_VALUE:
+        default:
+          if (c == '{' || c == '[')
+            {
+              parser->p++;
+              emit_c (parser, c);
+              /* empty containers stay on one line */
+              skip_whitespace (parser);
+              if (parser->p < parser->end && *parser->p == closing_bracket (c))
+                {
+                  parser->p++;
+                  emit_c (parser, closing_bracket (c));
+                  break;
+                }
+              g_byte_array_append (parser->stack, (guint8 *) &c, 1);
+              emit_newline (parser);
+              expect = c == '{' ? EXPECT_KEY : EXPECT_VALUE;
+              continue;
+            }
+          if (c == '"')
+            {
+              if (!scan_string (parser))
+                return FALSE;
+            }
+          else if (c == '-' || g_ascii_isdigit (c))
+            {
+              if (!scan_number (parser))
+                return FALSE;
+            }
+          else if (!scan_literal (parser))
+            {
+              return FALSE;
+            }
+          break;
+        }
+
+      /* a value just ended */
+      expect = parser->stack->len > 0 ? EXPECT_NEXT : EXPECT_END;
+    }
+}
+
+static void
+find_position (const char *text,
+               const char *p,
+               TextyJsonPosition *position)
+{
+  const char *line_start = text;
+  const char *newline;
+
+  position->line = 0;
+  while ((newline = memchr (line_start, '\n', p - line_start)) != NULL)
+    {
+      position->line++;
+      line_start = newline + 1;
+    }
+  position->column = p - line_start;
+}
+
+/*
+ * Checks that 'text' is a single JSON value, then returns it indented
+ * for TEXTY_JSON_OP_FORMAT or without any whitespace for
+ * TEXTY_JSON_OP_MINIFY. TEXTY_JSON_OP_VALIDATE returns NULL without an
+ * error. Invalid JSON sets a G_IO_ERROR_INVALID_DATA error and, unless
+ * it is NULL, 'error_position' to where it went wrong.
+ */
+GBytes *
+texty_json_run (GBytes *text,
+                TextyJsonOp op,
+                TextyJsonPosition *error_position,
+                GCancellable *cancellable,
+                GError **error)
+{
+  g_autoptr (GByteArray) stack = NULL;
+  Parser parser = { 0 };
+  const char *data;
+  gsize length;
+
+  g_return_val_if_fail (text != NULL, NULL);
+
+  data = g_bytes_get_data (text, &length);
+  stack = g_byte_array_new ();
+  parser.p = data;
+  parser.end = data + length;
+  parser.stack = stack;
+  parser.pretty = op == TEXTY_JSON_OP_FORMAT;
+  if (op != TEXTY_JSON_OP_VALIDATE)
+    parser.out = g_string_sized_new (parser.pretty ? length + length / 2 : length);
+
+  if (!parse (&parser, cancellable, error))
+    {
+      if (parser.out != NULL)
+        g_string_free (parser.out, TRUE);
+      /* cancelled */
+      if (parser.message == NULL)
+        return NULL;
+
+      if (error_position != NULL)
+        find_position (data, parser.p, error_position);
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, parser.message);
+      return NULL;
+    }
+
+  if (parser.out == NULL)
+    return NULL;
+  if (parser.pretty)
+    g_string_append_c (parser.out, '\n');
+
+  return g_string_free_to_bytes (parser.out);
+}
+
+typedef struct
+{
+  GBytes *text;
+  TextyJsonOp op;
+  TextyJsonPosition error_position;
+} RunData;
+
+static void
+run_data_free (RunData *data)
+{
+  g_bytes_unref (data->text);
+  g_free (data);
+}
+
+static void
+run_thread (GTask *task,
+            gpointer source_object,
+            gpointer task_data,
+            GCancellable *cancellable)
+{
+  RunData *data = task_data;
+  GError *error = NULL;
+  GBytes *result;
+
+  result = texty_json_run (data->text, data->op, &data->error_position, cancellable, &error);
+  if (error == NULL)
+    g_task_return_pointer (task, result, (GDestroyNotify) g_bytes_unref);
+  else
+    g_task_return_error (task, error);
+}
+
+void
+texty_json_run_async (GBytes *text,
+                      TextyJsonOp op,
+                      GCancellable *cancellable,
+                      GAsyncReadyCallback callback,
+                      gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  RunData *data;
+
+  g_return_if_fail (text != NULL);
+
+  data = g_new0 (RunData, 1);
+  data->text = g_bytes_ref (text);
+  data->op = op;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, texty_json_run_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) run_data_free);
+  g_task_run_in_thread (task, run_thread);
+}
+
+GBytes *
+texty_json_run_finish (GAsyncResult *result,
+                       TextyJsonPosition *error_position,
+                       GError **error)
+{
+  RunData *data;
+
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+  data = g_task_get_task_data (G_TASK (result));
+  if (error_position != NULL)
+    *error_position = data->error_position;
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
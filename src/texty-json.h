@@ -0,0 +1,58 @@
+/* texty-json.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  TEXTY_JSON_OP_FORMAT,
+  TEXTY_JSON_OP_MINIFY,
+  TEXTY_JSON_OP_VALIDATE,
+} TextyJsonOp;
+
+/* where a document stops being valid JSON, from zero, the column in bytes */
+typedef struct
+{
+  gsize line;
+  gsize column;
+} TextyJsonPosition;
+
+gboolean  texty_json_op_from_string   (const char           *str,
+                                       TextyJsonOp          *op);
+
+GBytes   *texty_json_run              (GBytes               *text,
+                                       TextyJsonOp           op,
+                                       TextyJsonPosition    *error_position,
+                                       GCancellable         *cancellable,
+                                       GError              **error);
+void      texty_json_run_async        (GBytes               *text,
+                                       TextyJsonOp           op,
+                                       GCancellable         *cancellable,
+                                       GAsyncReadyCallback   callback,
+                                       gpointer              user_data);
+GBytes   *texty_json_run_finish       (GAsyncResult         *result,
+                                       TextyJsonPosition    *error_position,
+                                       GError              **error);
+
+G_END_DECLS
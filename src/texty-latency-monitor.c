@@ -0,0 +1,379 @@
+/* texty-latency-monitor.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-latency-monitor.h"
+
+#include <string.h>
+
+/* one millisecond per bucket, the last one holds everything longer */
+#define BUCKET_USEC 1000
+#define N_BUCKETS 250
+/* when the compositor doesn't say */
+#define DEFAULT_REFRESH_USEC 16667
+
+typedef struct
+{
+  gint64 time;
+  /* the frame being drawn when the key came, it shows in a later one */
+  gint64 frame;
+} Keystroke;
+
+struct _TextyLatencyMonitor
+{
+  GObject parent_instance;
+
+  GtkTextView *view;
+  GdkFrameClock *frame_clock;
+  gboolean enabled;
+
+  /* Keystroke, waiting for the frame that shows them to be presented */
+  GArray *pending;
+  /* the oldest frame whose timings haven't been looked at yet */
+  gint64 next_frame;
+  gint64 last_presentation;
+
+  guint latency[N_BUCKETS];
+  guint frame_interval[N_BUCKETS];
+  guint n_keystrokes;
+  gint64 max_latency;
+  guint dropped_frames;
+};
+
+G_DEFINE_FINAL_TYPE (TextyLatencyMonitor, texty_latency_monitor, G_TYPE_OBJECT)
+
+enum
+{
+  UPDATED,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+static void
+add_sample (guint *histogram,
+            gint64 usec)
+{
+  histogram[MIN (MAX (usec, 0) / BUCKET_USEC, N_BUCKETS - 1)]++;
+}
+
+/* the upper end, in milliseconds, of the bucket 'fraction' of the samples fall in */
+static guint
+get_percentile (const guint *histogram,
+                guint n_samples,
+                double fraction)
+{
+  guint64 wanted = (guint64) (n_samples * fraction + 0.5);
+  guint64 seen = 0;
+
+  for (guint i = 0; i < N_BUCKETS; i++)
+    {
+      seen += histogram[i];
+      if (seen >= MAX (wanted, 1))
+        return (i + 1) * BUCKET_USEC / 1000;
+    }
+
+  return N_BUCKETS * BUCKET_USEC / 1000;
+}
+
+static void
+reset (TextyLatencyMonitor *self)
+{
+  g_array_set_size (self->pending, 0);
+  self->next_frame = 0;
+  self->last_presentation = 0;
+  memset (self->latency, 0, sizeof self->latency);
+  memset (self->frame_interval, 0, sizeof self->frame_interval);
+  self->n_keystrokes = 0;
+  self->max_latency = 0;
+  self->dropped_frames = 0;
+}
+
+/*
+ * Settles the keystrokes 'timings' shows. How long the frame took from
+ * the previous one, or from the first of those keys if that came later,
+ * is the frame interval. A key handled at once shows within two refresh
+ * intervals, so each one past that is counted as a dropped frame.
+ */
+static gboolean
+add_frame (TextyLatencyMonitor *self,
+           GdkFrameTimings *timings)
+{
+  gint64 frame = gdk_frame_timings_get_frame_counter (timings);
+  gint64 presentation = gdk_frame_timings_get_presentation_time (timings);
+  gint64 refresh = gdk_frame_timings_get_refresh_interval (timings);
+  gint64 first_key = G_MAXINT64;
+  guint i = 0;
+
+  /* not every compositor reports when frames reach the screen */
+  if (presentation == 0)
+    presentation = gdk_frame_timings_get_predicted_presentation_time (timings);
+  if (presentation == 0)
+    presentation = gdk_frame_timings_get_frame_time (timings);
+  if (refresh == 0)
+    refresh = DEFAULT_REFRESH_USEC;
+
+  while (i < self->pending->len)
+    {
+      Keystroke *keystroke = &g_array_index (self->pending, Keystroke, i);
+      gint64 latency;
+
+      if (keystroke->frame >= frame)
+        {
+          i++;
+          continue;
+        }
+
+      latency = presentation - keystroke->time;
+      add_sample (self->latency, latency);
+      self->max_latency = MAX (self->max_latency, latency);
+      self->n_keystrokes++;
+      first_key = MIN (first_key, keystroke->time);
+      g_array_remove_index (self->pending, i);
+    }
+
+  if (first_key != G_MAXINT64)
+    {
+      gint64 interval = presentation - MAX (first_key, self->last_presentation);
+
+      add_sample (self->frame_interval, interval);
+      if (interval > 2 * refresh)
+        self->dropped_frames += (interval - refresh - 1) / refresh;
+    }
+  self->last_presentation = presentation;
+
+  return first_key != G_MAXINT64;
+}
+
+/* timings only complete once the frame was presented, frames later */
+static void
+on_after_paint (GdkFrameClock *frame_clock,
+                TextyLatencyMonitor *self)
+{
+  gint64 current = gdk_frame_clock_get_frame_counter (frame_clock);
+  gboolean updated = FALSE;
+
+  self->next_frame = MAX (self->next_frame, gdk_frame_clock_get_history_start (frame_clock));
+  for (; self->next_frame <= current; self->next_frame++)
+    {
+      GdkFrameTimings *timings = gdk_frame_clock_get_timings (frame_clock, self->next_frame);
+
+      if (timings == NULL)
+        continue;
+      if (!gdk_frame_timings_get_complete (timings))
+        break;
+      updated |= add_frame (self, timings);
+    }
+
+  if (updated)
+    g_signal_emit (self, signals[UPDATED], 0);
+}
+
+static gboolean
+on_key_pressed (GtkEventControllerKey *controller,
+                guint keyval,
+                guint keycode,
+                GdkModifierType state,
+                TextyLatencyMonitor *self)
+{
+  GdkEvent *event = gtk_event_controller_get_current_event (GTK_EVENT_CONTROLLER (controller));
+  Keystroke keystroke;
+
+  /* a modifier on its own draws nothing, it would wait for the cursor to blink */
+  if (self->frame_clock == NULL || gdk_key_event_is_modifier (event))
+    return FALSE;
+
+  keystroke.time = g_get_monotonic_time ();
+  keystroke.frame = gdk_frame_clock_get_frame_counter (self->frame_clock);
+  g_array_append_val (self->pending, keystroke);
+
+  return FALSE;
+}
+
+static void
+set_frame_clock (TextyLatencyMonitor *self,
+                 GdkFrameClock *frame_clock)
+{
+  if (self->frame_clock == frame_clock)
+    return;
+
+  if (self->frame_clock != NULL)
+    g_signal_handlers_disconnect_by_func (self->frame_clock, on_after_paint, self);
+  g_set_object (&self->frame_clock, frame_clock);
+  if (self->frame_clock != NULL)
+    g_signal_connect (self->frame_clock, "after-paint", G_CALLBACK (on_after_paint), self);
+
+  /* keystrokes waiting on another clock's frames would never settle */
+  g_array_set_size (self->pending, 0);
+  self->next_frame = 0;
+  self->last_presentation = 0;
+}
+
+/* the view only has a frame clock while it is realized */
+static void
+update_frame_clock (TextyLatencyMonitor *self)
+{
+  set_frame_clock (self,
+                   self->enabled && self->view != NULL
+                       ? gtk_widget_get_frame_clock (GTK_WIDGET (self->view))
+                       : NULL);
+}
+
+static void
+texty_latency_monitor_dispose (GObject *object)
+{
+  TextyLatencyMonitor *self = TEXTY_LATENCY_MONITOR (object);
+
+  if (self->view != NULL)
+    g_signal_handlers_disconnect_by_data (self->view, self);
+  self->view = NULL;
+  set_frame_clock (self, NULL);
+
+  G_OBJECT_CLASS (texty_latency_monitor_parent_class)->dispose (object);
+}
+
+static void
+texty_latency_monitor_finalize (GObject *object)
+{
+  TextyLatencyMonitor *self = TEXTY_LATENCY_MONITOR (object);
+
+  g_array_unref (self->pending);
+
+  G_OBJECT_CLASS (texty_latency_monitor_parent_class)->finalize (object);
+}
+
+static void
+texty_latency_monitor_class_init (TextyLatencyMonitorClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = texty_latency_monitor_dispose;
+  object_class->finalize = texty_latency_monitor_finalize;
+
+  /* emitted when keystrokes were settled, for showing the summary again */
+  signals[UPDATED] = g_signal_new ("updated",
+                                   G_TYPE_FROM_CLASS (klass),
+                                   G_SIGNAL_RUN_LAST,
+                                   0,
+                                   NULL, NULL,
+                                   NULL,
+                                   G_TYPE_NONE, 0);
+}
+
+static void
+texty_latency_monitor_init (TextyLatencyMonitor *self)
+{
+  self->pending = g_array_new (FALSE, FALSE, sizeof (Keystroke));
+}
+
+/*
+ * Measures, while enabled, how long each key pressed in 'view' takes to
+ * show on screen: from when the view gets the key until the first frame
+ * drawn after it is presented, as its frame clock reports. The view must
+ * outlive the monitor.
+ */
+TextyLatencyMonitor *
+texty_latency_monitor_new (GtkTextView *view)
+{
+  TextyLatencyMonitor *self;
+  GtkEventController *controller;
+
+  g_return_val_if_fail (GTK_IS_TEXT_VIEW (view), NULL);
+
+  self = g_object_new (TEXTY_TYPE_LATENCY_MONITOR, NULL);
+  self->view = view;
+
+  /* ahead of the view, which handles most keys itself */
+  controller = gtk_event_controller_key_new ();
+  gtk_event_controller_set_propagation_phase (controller, GTK_PHASE_CAPTURE);
+  g_signal_connect_object (controller, "key-pressed", G_CALLBACK (on_key_pressed), self, 0);
+  gtk_widget_add_controller (GTK_WIDGET (view), controller);
+
+  g_signal_connect_data (view, "realize", G_CALLBACK (update_frame_clock), self,
+                         NULL, G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+  g_signal_connect_data (view, "unrealize", G_CALLBACK (update_frame_clock), self,
+                         NULL, G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+
+  return self;
+}
+
+/* starting again from nothing each time it is enabled */
+void
+texty_latency_monitor_set_enabled (TextyLatencyMonitor *self,
+                                   gboolean enabled)
+{
+  g_return_if_fail (TEXTY_IS_LATENCY_MONITOR (self));
+
+  if (self->enabled == enabled)
+    return;
+
+  self->enabled = enabled;
+  reset (self);
+  update_frame_clock (self);
+}
+
+char *
+texty_latency_monitor_get_summary (TextyLatencyMonitor *self)
+{
+  g_return_val_if_fail (TEXTY_IS_LATENCY_MONITOR (self), NULL);
+
+  if (self->n_keystrokes == 0)
+    return g_strdup ("Type to measure latency");
+
+  return g_strdup_printf ("p50 %u ms · p99 %u ms · max %.1f ms · %u dropped frames · %u keys",
+                          get_percentile (self->latency, self->n_keystrokes, 0.5),
+                          get_percentile (self->latency, self->n_keystrokes, 0.99),
+                          self->max_latency / 1000.0,
+                          self->dropped_frames,
+                          self->n_keystrokes);
+}
+
+/*
+ * Writes both histograms to 'file' as CSV: how many keystrokes took, and
+ * how many of the frames showing them had as frame interval, each
+ * millisecond. The last row counts everything longer too.
+ */
+gboolean
+texty_latency_monitor_export (TextyLatencyMonitor *self,
+                              GFile *file,
+                              GError **error)
+{
+  g_autoptr (GString) csv = NULL;
+
+  g_return_val_if_fail (TEXTY_IS_LATENCY_MONITOR (self), FALSE);
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+
+  csv = g_string_new ("milliseconds,keystrokes,frames\n");
+  for (guint i = 0; i < N_BUCKETS; i++)
+    g_string_append_printf (csv, "%u,%u,%u\n",
+                            i * BUCKET_USEC / 1000,
+                            self->latency[i],
+                            self->frame_interval[i]);
+
+  return g_file_replace_contents (file,
+                                  csv->str,
+                                  csv->len,
+                                  NULL,
+                                  FALSE,
+                                  G_FILE_CREATE_NONE,
+                                  NULL,
+                                  NULL,
+                                  error);
+}
@@ -0,0 +1,39 @@
+/* texty-latency-monitor.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define TEXTY_TYPE_LATENCY_MONITOR (texty_latency_monitor_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyLatencyMonitor, texty_latency_monitor, TEXTY, LATENCY_MONITOR, GObject)
+
+TextyLatencyMonitor *texty_latency_monitor_new         (GtkTextView          *view);
+void                 texty_latency_monitor_set_enabled (TextyLatencyMonitor  *self,
+                                                        gboolean              enabled);
+char                *texty_latency_monitor_get_summary (TextyLatencyMonitor  *self);
+gboolean             texty_latency_monitor_export      (TextyLatencyMonitor  *self,
+                                                        GFile                *file,
+                                                        GError              **error);
+
+G_END_DECLS
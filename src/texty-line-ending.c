@@ -0,0 +1,352 @@
+/* texty-line-ending.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-line-ending.h"
+
+#include <string.h>
+
+#define LOW_BITS G_GUINT64_CONSTANT (0x7f7f7f7f7f7f7f7f)
+
+/* one byte of 'c' in every lane of a 64 bit word */
+#define SPLAT(c) (G_GUINT64_CONSTANT (0x0101010101010101) * (guint8) (c))
+
+/*
+ * Returns a word with the high bit set in every byte lane of 'word' that
+ * equals the byte splatted in 'pattern'. Unlike the classic haszero() trick
+ * this is exact, so the lanes can be counted.
+ */
+static inline guint64
+match_bytes (guint64 word,
+             guint64 pattern)
+{
+  guint64 x = word ^ pattern;
+
+  return ~(((x & LOW_BITS) + LOW_BITS) | x | LOW_BITS);
+}
+
+void
+texty_line_ending_count (const char *text,
+                         gsize length,
+                         TextyLineEndingCounts *counts)
+{
+  gsize lf = 0;
+  gsize cr = 0;
+  gsize crlf = 0;
+  gsize i = 0;
+  gboolean prev_cr = FALSE;
+
+  g_return_if_fail (text != NULL || length == 0);
+  g_return_if_fail (counts != NULL);
+
+  /* scan eight bytes at a time, counting matching lanes with popcount */
+  for (; i + sizeof (guint64) <= length; i += sizeof (guint64))
+    {
+      guint64 word;
+      guint64 lf_mask;
+      guint64 cr_mask;
+
+      memcpy (&word, text + i, sizeof word);
+      word = GUINT64_FROM_LE (word);
+      lf_mask = match_bytes (word, SPLAT ('\n'));
+      cr_mask = match_bytes (word, SPLAT ('\r'));
+
+      if (lf_mask == 0 && cr_mask == 0)
+        {
+          prev_cr = FALSE;
+          continue;
+        }
+
+      lf += __builtin_popcountll (lf_mask);
+      cr += __builtin_popcountll (cr_mask);
+      /* a CR lane immediately followed by an LF lane, within the word... */
+      crlf += __builtin_popcountll (cr_mask & (lf_mask >> 8));
+      /* ...or straddling the previous word */
+      if (prev_cr && (lf_mask & 0x80))
+        crlf++;
+      prev_cr = (cr_mask >> 63) != 0;
+    }
+
+  for (; i < length; i++)
+    {
+      if (text[i] == '\n')
+        {
+          lf++;
+          if (prev_cr)
+            crlf++;
+        }
+      else if (text[i] == '\r')
+        {
+          cr++;
+        }
+      prev_cr = text[i] == '\r';
+    }
+
+  counts->lf = lf - crlf;
+  counts->crlf = crlf;
+  counts->cr = cr - crlf;
+}
+
+TextyLineEnding
+texty_line_ending_detect (const char *text,
+                          gsize length,
+                          gboolean *mixed)
+{
+  TextyLineEndingCounts counts;
+  TextyLineEnding dominant;
+  int kinds;
+
+  texty_line_ending_count (text, length, &counts);
+
+  kinds = (counts.lf > 0) + (counts.crlf > 0) + (counts.cr > 0);
+  if (mixed != NULL)
+    *mixed = kinds > 1;
+
+  /* ties, and files without any line break, go to LF */
+  dominant = TEXTY_LINE_ENDING_LF;
+  if (counts.crlf > counts.lf && counts.crlf >= counts.cr)
+    dominant = TEXTY_LINE_ENDING_CRLF;
+  else if (counts.cr > counts.lf && counts.cr > counts.crlf)
+    dominant = TEXTY_LINE_ENDING_CR;
+
+  return dominant;
+}
+
+const char *
+texty_line_ending_to_string (TextyLineEnding line_ending)
+{
+  switch (line_ending)
+    {
+    case TEXTY_LINE_ENDING_CRLF:
+      return "crlf";
+    case TEXTY_LINE_ENDING_CR:
+      return "cr";
+    case TEXTY_LINE_ENDING_MIXED:
+      return "mixed";
+    case TEXTY_LINE_ENDING_LF:
+    default:
+      return "lf";
+    }
+}
+
+TextyLineEnding
+texty_line_ending_from_string (const char *str)
+{
+  if (g_strcmp0 (str, "crlf") == 0)
+    return TEXTY_LINE_ENDING_CRLF;
+  if (g_strcmp0 (str, "cr") == 0)
+    return TEXTY_LINE_ENDING_CR;
+  if (g_strcmp0 (str, "mixed") == 0)
+    return TEXTY_LINE_ENDING_MIXED;
+  return TEXTY_LINE_ENDING_LF;
+}
+
+const char *
+texty_line_ending_to_label (TextyLineEnding line_ending)
+{
+  switch (line_ending)
+    {
+    case TEXTY_LINE_ENDING_CRLF:
+      return "CRLF";
+    case TEXTY_LINE_ENDING_CR:
+      return "CR";
+    case TEXTY_LINE_ENDING_MIXED:
+      return "Mixed";
+    case TEXTY_LINE_ENDING_LF:
+    default:
+      return "LF";
+    }
+}
+
+/**********************************/
+/* Detection 👆️                   */
+/**********************************/
+
+struct _TextyLineEndingConverter
+{
+  GObject parent_instance;
+
+  TextyLineEnding line_ending;
+  /* the last byte converted was a CR, so a leading LF belongs to it */
+  gboolean after_cr;
+};
+
+static void texty_line_ending_converter_iface_init (GConverterIface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE (TextyLineEndingConverter,
+                               texty_line_ending_converter,
+                               G_TYPE_OBJECT,
+                               G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER,
+                                                      texty_line_ending_converter_iface_init))
+
+static const char *
+get_sequence (TextyLineEnding line_ending)
+{
+  switch (line_ending)
+    {
+    case TEXTY_LINE_ENDING_CRLF:
+      return "\r\n";
+    case TEXTY_LINE_ENDING_CR:
+      return "\r";
+    case TEXTY_LINE_ENDING_LF:
+    case TEXTY_LINE_ENDING_MIXED:
+    default:
+      return "\n";
+    }
+}
+
+/* find the next byte that may need rewriting, using the vectorized memchr */
+static const char *
+find_break (const char *p,
+            const char *end,
+            gboolean lf_target)
+{
+  const char *cr;
+  const char *lf;
+
+  cr = memchr (p, '\r', end - p);
+  /* an LF is already correct when converting to LF */
+  if (lf_target)
+    return cr != NULL ? cr : end;
+
+  lf = memchr (p, '\n', (cr != NULL ? cr : end) - p);
+  if (lf != NULL)
+    return lf;
+  return cr != NULL ? cr : end;
+}
+
+static GConverterResult
+texty_line_ending_converter_convert (GConverter *converter,
+                                     const void *inbuf,
+                                     gsize inbuf_size,
+                                     void *outbuf,
+                                     gsize outbuf_size,
+                                     GConverterFlags flags,
+                                     gsize *bytes_read,
+                                     gsize *bytes_written,
+                                     GError **error)
+{
+  TextyLineEndingConverter *self = TEXTY_LINE_ENDING_CONVERTER (converter);
+  const char *in = inbuf;
+  const char *in_end = in + inbuf_size;
+  char *out = outbuf;
+  char *out_end = out + outbuf_size;
+  const char *sequence = get_sequence (self->line_ending);
+  gsize sequence_len = strlen (sequence);
+  gboolean lf_target = self->line_ending == TEXTY_LINE_ENDING_LF;
+
+  while (in < in_end)
+    {
+      const char *run_end;
+      gsize run;
+
+      /* the LF of a CRLF pair was already written along with its CR */
+      if (self->after_cr && *in == '\n')
+        {
+          self->after_cr = FALSE;
+          in++;
+          continue;
+        }
+      self->after_cr = FALSE;
+
+      if (*in == '\r' || (*in == '\n' && !lf_target))
+        {
+          if ((gsize) (out_end - out) < sequence_len)
+            break;
+          self->after_cr = *in == '\r';
+          memcpy (out, sequence, sequence_len);
+          out += sequence_len;
+          in++;
+          continue;
+        }
+
+      run_end = find_break (in + 1, in_end, lf_target);
+      run = MIN ((gsize) (run_end - in), (gsize) (out_end - out));
+      if (run == 0)
+        break;
+      memcpy (out, in, run);
+      in += run;
+      out += run;
+    }
+
+  *bytes_read = in - (const char *) inbuf;
+  *bytes_written = out - (char *) outbuf;
+
+  if (*bytes_read == 0 && inbuf_size > 0)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+                           "Not enough space in output buffer");
+      return G_CONVERTER_ERROR;
+    }
+
+  if (in == in_end)
+    {
+      if (flags & G_CONVERTER_INPUT_AT_END)
+        return G_CONVERTER_FINISHED;
+      if (flags & G_CONVERTER_FLUSH)
+        return G_CONVERTER_FLUSHED;
+    }
+
+  return G_CONVERTER_CONVERTED;
+}
+
+static void
+texty_line_ending_converter_reset (GConverter *converter)
+{
+  TEXTY_LINE_ENDING_CONVERTER (converter)->after_cr = FALSE;
+}
+
+static void
+texty_line_ending_converter_iface_init (GConverterIface *iface)
+{
+  iface->convert = texty_line_ending_converter_convert;
+  iface->reset = texty_line_ending_converter_reset;
+}
+
+static void
+texty_line_ending_converter_class_init (TextyLineEndingConverterClass *klass)
+{
+}
+
+static void
+texty_line_ending_converter_init (TextyLineEndingConverter *self)
+{
+}
+
+/*
+ * Rewrites every CRLF, CR or LF passing through it into 'line_ending'.
+ * Used on the save stream so the buffer itself never has to be edited.
+ */
+GConverter *
+texty_line_ending_converter_new (TextyLineEnding line_ending)
+{
+  TextyLineEndingConverter *self;
+
+  g_return_val_if_fail (line_ending != TEXTY_LINE_ENDING_MIXED, NULL);
+
+  self = g_object_new (TEXTY_TYPE_LINE_ENDING_CONVERTER, NULL);
+  self->line_ending = line_ending;
+
+  return G_CONVERTER (self);
+}
+
+/**********************************/
+/* Converter 👆️                   */
+/**********************************/
@@ -0,0 +1,59 @@
+/* texty-line-ending.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* LF is first so that a buffer without a recorded line ending defaults to it */
+typedef enum
+{
+  TEXTY_LINE_ENDING_LF,
+  TEXTY_LINE_ENDING_CRLF,
+  TEXTY_LINE_ENDING_CR,
+  TEXTY_LINE_ENDING_MIXED,
+} TextyLineEnding;
+
+typedef struct
+{
+  gsize lf;
+  gsize crlf;
+  gsize cr;
+} TextyLineEndingCounts;
+
+void             texty_line_ending_count       (const char            *text,
+                                                gsize                  length,
+                                                TextyLineEndingCounts *counts);
+TextyLineEnding  texty_line_ending_detect      (const char            *text,
+                                                gsize                  length,
+                                                gboolean              *mixed);
+const char      *texty_line_ending_to_string   (TextyLineEnding        line_ending);
+TextyLineEnding  texty_line_ending_from_string (const char            *str);
+const char      *texty_line_ending_to_label    (TextyLineEnding        line_ending);
+
+#define TEXTY_TYPE_LINE_ENDING_CONVERTER (texty_line_ending_converter_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyLineEndingConverter, texty_line_ending_converter, TEXTY, LINE_ENDING_CONVERTER, GObject)
+
+GConverter *texty_line_ending_converter_new (TextyLineEnding line_ending);
+
+G_END_DECLS
@@ -0,0 +1,753 @@
+/* texty-line-ops.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-line-ops.h"
+
+#include "texty-line-ending.h"
+
+#include <string.h>
+
+/* below this many lines a sort isn't worth another thread */
+#define PARALLEL_THRESHOLD 16384
+#define INSERTION_THRESHOLD 16
+
+typedef struct
+{
+  const char *text;
+  /* without the '\n' */
+  gsize length;
+  /* the leading number, for numeric sorts */
+  double number;
+} Line;
+
+typedef int (*LineCompare) (const Line *a,
+                            const Line *b);
+
+gboolean
+texty_line_op_from_string (const char *str,
+                           TextyLineOp *op)
+{
+  static const char *names[] = {
+    [TEXTY_LINE_OP_SORT] = "sort",
+    [TEXTY_LINE_OP_SORT_NUMERIC] = "sort-numeric",
+    [TEXTY_LINE_OP_SORT_NATURAL] = "sort-natural",
+    [TEXTY_LINE_OP_SORT_CASELESS] = "sort-caseless",
+    [TEXTY_LINE_OP_UNIQUE] = "unique",
+    [TEXTY_LINE_OP_COUNT] = "count",
+    [TEXTY_LINE_OP_REVERSE] = "reverse",
+    [TEXTY_LINE_OP_TRIM] = "trim",
+    [TEXTY_LINE_OP_FILTER] = "filter",
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      if (g_strcmp0 (str, names[i]) == 0)
+        {
+          *op = i;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/*
+ * Points a Line at every line of 'data', the text is not copied. Returns
+ * the number of lines, a final '\n' doesn't start another one.
+ */
+static Line *
+split_lines (const char *data,
+             gsize length,
+             gsize *n_lines,
+             gboolean *final_newline)
+{
+  TextyLineEndingCounts counts;
+  const char *p = data;
+  const char *end = data + length;
+  Line *lines;
+  gsize n = 0;
+
+  /* every CRLF and LF ends a line, which gives the exact size up front */
+  texty_line_ending_count (data, length, &counts);
+  lines = g_new (Line, counts.lf + counts.crlf + 1);
+
+  while (p < end)
+    {
+      const char *eol = memchr (p, '\n', end - p);
+
+      if (eol == NULL)
+        eol = end;
+      lines[n].text = p;
+      lines[n].length = eol - p;
+      lines[n].number = 0;
+      n++;
+      p = eol + 1;
+    }
+
+  *n_lines = n;
+  *final_newline = length > 0 && data[length - 1] == '\n';
+
+  return lines;
+}
+
+static GBytes *
+join_lines (const Line *lines,
+            gsize n_lines,
+            gboolean final_newline)
+{
+  gsize size = 0;
+  char *out;
+  char *p;
+
+  for (gsize i = 0; i < n_lines; i++)
+    size += lines[i].length + 1;
+  if (n_lines > 0 && !final_newline)
+    size--;
+
+  p = out = g_malloc (size + 1);
+  for (gsize i = 0; i < n_lines; i++)
+    {
+      memcpy (p, lines[i].text, lines[i].length);
+      p += lines[i].length;
+      if (i + 1 < n_lines || final_newline)
+        *p++ = '\n';
+    }
+  *p = '\0';
+
+  return g_bytes_new_take (out, size);
+}
+
+/**********************************/
+/* Lines 👆️                       */
+/**********************************/
+
+typedef void (*RangeFunc) (Line *lines,
+                           gsize n_lines,
+                           gpointer user_data);
+
+typedef struct
+{
+  RangeFunc func;
+  Line *lines;
+  gsize n_lines;
+  gpointer user_data;
+} Range;
+
+static gpointer
+run_range (gpointer data)
+{
+  Range *range = data;
+
+  range->func (range->lines, range->n_lines, range->user_data);
+
+  return NULL;
+}
+
+/* splits the lines into one slice per processor and waits for them all */
+static void
+parallel_for (Line *lines,
+              gsize n_lines,
+              RangeFunc func,
+              gpointer user_data)
+{
+  guint n_threads;
+  Range *ranges;
+  GThread **threads;
+
+  n_threads = CLAMP (n_lines / PARALLEL_THRESHOLD, 1, g_get_num_processors ());
+  ranges = g_new (Range, n_threads);
+  threads = g_new0 (GThread *, n_threads);
+
+  for (guint i = 0; i < n_threads; i++)
+    {
+      gsize begin = n_lines * i / n_threads;
+      gsize end = n_lines * (i + 1) / n_threads;
+
+      ranges[i].func = func;
+      ranges[i].lines = lines + begin;
+      ranges[i].n_lines = end - begin;
+      ranges[i].user_data = user_data;
+      if (i > 0)
+        threads[i] = g_thread_new ("texty-line-ops", run_range, &ranges[i]);
+    }
+
+  /* this thread takes the first slice rather than sitting idle */
+  run_range (&ranges[0]);
+  for (guint i = 1; i < n_threads; i++)
+    g_thread_join (threads[i]);
+
+  g_free (threads);
+  g_free (ranges);
+}
+
+/**********************************/
+/* Threads 👆️                     */
+/**********************************/
+
+static int
+compare_text (const Line *a,
+              const Line *b)
+{
+  int result = memcmp (a->text, b->text, MIN (a->length, b->length));
+
+  if (result != 0)
+    return result;
+  return (a->length > b->length) - (a->length < b->length);
+}
+
+static int
+compare_numeric (const Line *a,
+                 const Line *b)
+{
+  return (a->number > b->number) - (a->number < b->number);
+}
+
+/* folds case a character at a time, without allocating a folded copy */
+static int
+compare_caseless (const Line *a,
+                  const Line *b)
+{
+  const char *p = a->text;
+  const char *q = b->text;
+  const char *p_end = p + a->length;
+  const char *q_end = q + b->length;
+
+  while (p < p_end && q < q_end)
+    {
+      gunichar c;
+      gunichar d;
+
+      if ((guchar) *p < 0x80 && (guchar) *q < 0x80)
+        {
+          c = g_ascii_tolower (*p++);
+          d = g_ascii_tolower (*q++);
+        }
+      else
+        {
+          c = g_unichar_tolower (g_utf8_get_char (p));
+          d = g_unichar_tolower (g_utf8_get_char (q));
+          p = g_utf8_next_char (p);
+          q = g_utf8_next_char (q);
+        }
+
+      if (c != d)
+        return (c > d) - (c < d);
+    }
+
+  return (p < p_end) - (q < q_end);
+}
+
+/* compares runs of digits by their value, so "file9" sorts before "file10" */
+static int
+compare_natural (const Line *a,
+                 const Line *b)
+{
+  gsize i = 0;
+  gsize j = 0;
+
+  while (i < a->length && j < b->length)
+    {
+      if (g_ascii_isdigit (a->text[i]) && g_ascii_isdigit (b->text[j]))
+        {
+          gsize i_end;
+          gsize j_end;
+          int result;
+
+          while (i < a->length && a->text[i] == '0')
+            i++;
+          while (j < b->length && b->text[j] == '0')
+            j++;
+          for (i_end = i; i_end < a->length && g_ascii_isdigit (a->text[i_end]); i_end++)
+            ;
+          for (j_end = j; j_end < b->length && g_ascii_isdigit (b->text[j_end]); j_end++)
+            ;
+
+          /* without leading zeros the longer run is the larger number */
+          if (i_end - i != j_end - j)
+            return i_end - i < j_end - j ? -1 : 1;
+          result = memcmp (a->text + i, b->text + j, i_end - i);
+          if (result != 0)
+            return result;
+
+          i = i_end;
+          j = j_end;
+          continue;
+        }
+
+      if (a->text[i] != b->text[j])
+        return (guchar) a->text[i] - (guchar) b->text[j];
+      i++;
+      j++;
+    }
+
+  return (i < a->length) - (j < b->length);
+}
+
+/* the leading number of a line, like sort -n anything else counts as 0 */
+static double
+parse_number (const char *text,
+              gsize length)
+{
+  gsize i = 0;
+  double value = 0;
+  double scale = 0.1;
+  gboolean negative = FALSE;
+
+  while (i < length && (text[i] == ' ' || text[i] == '\t'))
+    i++;
+  if (i < length && (text[i] == '-' || text[i] == '+'))
+    negative = text[i++] == '-';
+
+  for (; i < length && g_ascii_isdigit (text[i]); i++)
+    value = value * 10 + (text[i] - '0');
+  if (i < length && text[i] == '.')
+    {
+      for (i++; i < length && g_ascii_isdigit (text[i]); i++)
+        {
+          value += (text[i] - '0') * scale;
+          scale /= 10;
+        }
+    }
+
+  return negative ? -value : value;
+}
+
+static void
+parse_numbers (Line *lines,
+               gsize n_lines,
+               gpointer user_data)
+{
+  for (gsize i = 0; i < n_lines; i++)
+    lines[i].number = parse_number (lines[i].text, lines[i].length);
+}
+
+/**********************************/
+/* Comparators 👆️                 */
+/**********************************/
+
+typedef struct
+{
+  Line *lines;
+  Line *scratch;
+  gsize n_lines;
+  LineCompare compare;
+  /* how many more levels may fork a thread */
+  guint depth;
+  GCancellable *cancellable;
+} SortJob;
+
+/* merges the two sorted halves in place, ties keep their order */
+static void
+merge (Line *lines,
+       Line *scratch,
+       gsize mid,
+       gsize n_lines,
+       LineCompare compare)
+{
+  gsize i = 0;
+  gsize j = mid;
+  gsize k = 0;
+
+  /* already in order, common for logs that are mostly sorted */
+  if (compare (&lines[mid - 1], &lines[mid]) <= 0)
+    return;
+
+  memcpy (scratch, lines, mid * sizeof (Line));
+  while (i < mid && j < n_lines)
+    {
+      if (compare (&lines[j], &scratch[i]) < 0)
+        lines[k++] = lines[j++];
+      else
+        lines[k++] = scratch[i++];
+    }
+  while (i < mid)
+    lines[k++] = scratch[i++];
+}
+
+static gpointer
+sort_job (gpointer data)
+{
+  SortJob *job = data;
+  SortJob left;
+  SortJob right;
+  gsize mid;
+
+  if (job->n_lines < INSERTION_THRESHOLD)
+    {
+      for (gsize i = 1; i < job->n_lines; i++)
+        {
+          Line line = job->lines[i];
+          gsize j = i;
+
+          for (; j > 0 && job->compare (&line, &job->lines[j - 1]) < 0; j--)
+            job->lines[j] = job->lines[j - 1];
+          job->lines[j] = line;
+        }
+      return NULL;
+    }
+  if (g_cancellable_is_cancelled (job->cancellable))
+    return NULL;
+
+  mid = job->n_lines / 2;
+  left = *job;
+  left.n_lines = mid;
+  left.depth = job->depth > 0 ? job->depth - 1 : 0;
+  right = left;
+  right.lines = job->lines + mid;
+  right.scratch = job->scratch + mid;
+  right.n_lines = job->n_lines - mid;
+
+  /* the halves use disjoint lines and scratch, so they can sort side by side */
+  if (job->depth > 0 && job->n_lines >= PARALLEL_THRESHOLD)
+    {
+      GThread *thread = g_thread_new ("texty-sort", sort_job, &left);
+
+      sort_job (&right);
+      g_thread_join (thread);
+    }
+  else
+    {
+      sort_job (&left);
+      sort_job (&right);
+    }
+
+  merge (job->lines, job->scratch, mid, job->n_lines, job->compare);
+
+  return NULL;
+}
+
+static void
+sort_lines (Line *lines,
+            gsize n_lines,
+            LineCompare compare,
+            GCancellable *cancellable)
+{
+  SortJob job;
+
+  job.lines = lines;
+  job.scratch = g_new (Line, n_lines);
+  job.n_lines = n_lines;
+  job.compare = compare;
+  /* enough levels to give every processor a slice */
+  job.depth = g_bit_storage (g_get_num_processors ());
+  job.cancellable = cancellable;
+
+  sort_job (&job);
+
+  g_free (job.scratch);
+}
+
+/**********************************/
+/* Sort 👆️                        */
+/**********************************/
+
+static guint
+hash_line (gconstpointer key)
+{
+  const Line *line = key;
+  guint hash = 5381;
+
+  for (gsize i = 0; i < line->length; i++)
+    hash = hash * 33 + (guchar) line->text[i];
+
+  return hash;
+}
+
+static gboolean
+equal_line (gconstpointer a,
+            gconstpointer b)
+{
+  return compare_text (a, b) == 0;
+}
+
+/* keeps the first of each distinct line, in order, optionally counting them */
+static GBytes *
+unique_lines (Line *lines,
+              gsize n_lines,
+              gboolean final_newline,
+              gboolean count)
+{
+  g_autoptr (GHashTable) seen = NULL;
+  g_autofree guint *counts = NULL;
+  GString *out;
+  gsize n_unique = 0;
+
+  seen = g_hash_table_new (hash_line, equal_line);
+  counts = g_new0 (guint, n_lines);
+
+  for (gsize i = 0; i < n_lines; i++)
+    {
+      gpointer index;
+
+      if (g_hash_table_lookup_extended (seen, &lines[i], NULL, &index))
+        {
+          counts[GPOINTER_TO_SIZE (index)]++;
+          continue;
+        }
+      /* compact the distinct lines to the front as they are found */
+      lines[n_unique] = lines[i];
+      counts[n_unique] = 1;
+      g_hash_table_insert (seen, &lines[n_unique], GSIZE_TO_POINTER (n_unique));
+      n_unique++;
+    }
+
+  if (!count)
+    return join_lines (lines, n_unique, final_newline);
+
+  /* laid out like uniq -c */
+  out = g_string_new (NULL);
+  for (gsize i = 0; i < n_unique; i++)
+    {
+      g_string_append_printf (out, "%7u ", counts[i]);
+      g_string_append_len (out, lines[i].text, lines[i].length);
+      if (i + 1 < n_unique || final_newline)
+        g_string_append_c (out, '\n');
+    }
+
+  return g_string_free_to_bytes (out);
+}
+
+/* drops trailing blanks, leaving the CR of a CRLF line alone */
+static GBytes *
+trim_lines (const Line *lines,
+            gsize n_lines,
+            gboolean final_newline,
+            gsize length)
+{
+  GString *out = g_string_sized_new (length);
+
+  for (gsize i = 0; i < n_lines; i++)
+    {
+      gsize end = lines[i].length;
+      gboolean cr = end > 0 && lines[i].text[end - 1] == '\r';
+
+      if (cr)
+        end--;
+      while (end > 0 && (lines[i].text[end - 1] == ' ' || lines[i].text[end - 1] == '\t'))
+        end--;
+
+      g_string_append_len (out, lines[i].text, end);
+      if (cr)
+        g_string_append_c (out, '\r');
+      if (i + 1 < n_lines || final_newline)
+        g_string_append_c (out, '\n');
+    }
+
+  return g_string_free_to_bytes (out);
+}
+
+typedef struct
+{
+  GRegex *regex;
+  /* one flag per line, set when the line is to be dropped */
+  guint8 *drop;
+  Line *first;
+} FilterData;
+
+static void
+match_lines (Line *lines,
+             gsize n_lines,
+             gpointer user_data)
+{
+  FilterData *data = user_data;
+  guint8 *drop = data->drop + (lines - data->first);
+
+  /* a GRegex can be matched from several threads at once */
+  for (gsize i = 0; i < n_lines; i++)
+    drop[i] = g_regex_match_full (data->regex, lines[i].text, lines[i].length,
+                                  0, 0, NULL, NULL);
+}
+
+static GBytes *
+filter_lines (Line *lines,
+              gsize n_lines,
+              gboolean final_newline,
+              const char *pattern,
+              GError **error)
+{
+  FilterData data;
+  gsize n_kept = 0;
+
+  data.regex = g_regex_new (pattern, G_REGEX_OPTIMIZE, 0, error);
+  if (data.regex == NULL)
+    return NULL;
+  data.drop = g_new (guint8, n_lines);
+  data.first = lines;
+
+  parallel_for (lines, n_lines, match_lines, &data);
+
+  for (gsize i = 0; i < n_lines; i++)
+    {
+      if (!data.drop[i])
+        lines[n_kept++] = lines[i];
+    }
+
+  g_free (data.drop);
+  g_regex_unref (data.regex);
+
+  return join_lines (lines, n_kept, final_newline);
+}
+
+/**********************************/
+/* Rewrite 👆️                     */
+/**********************************/
+
+/*
+ * Applies 'op' to every line of 'text' and returns the new text. The work
+ * happens on a snapshot, the caller replaces the document with the result.
+ * 'pattern' is the regular expression for TEXTY_LINE_OP_FILTER.
+ */
+GBytes *
+texty_line_ops_run (GBytes *text,
+                    TextyLineOp op,
+                    const char *pattern,
+                    GCancellable *cancellable,
+                    GError **error)
+{
+  g_autofree Line *lines = NULL;
+  const char *data;
+  gsize length;
+  gsize n_lines;
+  gboolean final_newline;
+  GBytes *result = NULL;
+
+  g_return_val_if_fail (text != NULL, NULL);
+  g_return_val_if_fail (op != TEXTY_LINE_OP_FILTER || pattern != NULL, NULL);
+
+  data = g_bytes_get_data (text, &length);
+  lines = split_lines (data, length, &n_lines, &final_newline);
+
+  switch (op)
+    {
+    case TEXTY_LINE_OP_SORT:
+      sort_lines (lines, n_lines, compare_text, cancellable);
+      break;
+    case TEXTY_LINE_OP_SORT_NUMERIC:
+      parallel_for (lines, n_lines, parse_numbers, NULL);
+      sort_lines (lines, n_lines, compare_numeric, cancellable);
+      break;
+    case TEXTY_LINE_OP_SORT_NATURAL:
+      sort_lines (lines, n_lines, compare_natural, cancellable);
+      break;
+    case TEXTY_LINE_OP_SORT_CASELESS:
+      sort_lines (lines, n_lines, compare_caseless, cancellable);
+      break;
+    case TEXTY_LINE_OP_UNIQUE:
+    case TEXTY_LINE_OP_COUNT:
+      result = unique_lines (lines, n_lines, final_newline, op == TEXTY_LINE_OP_COUNT);
+      break;
+    case TEXTY_LINE_OP_REVERSE:
+      for (gsize i = 0; i < n_lines / 2; i++)
+        {
+          Line line = lines[i];
+
+          lines[i] = lines[n_lines - 1 - i];
+          lines[n_lines - 1 - i] = line;
+        }
+      break;
+    case TEXTY_LINE_OP_TRIM:
+      result = trim_lines (lines, n_lines, final_newline, length);
+      break;
+    case TEXTY_LINE_OP_FILTER:
+      result = filter_lines (lines, n_lines, final_newline, pattern, error);
+      if (result == NULL)
+        return NULL;
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+      g_clear_pointer (&result, g_bytes_unref);
+      return NULL;
+    }
+
+  if (result == NULL)
+    result = join_lines (lines, n_lines, final_newline);
+
+  return result;
+}
+
+typedef struct
+{
+  GBytes *text;
+  TextyLineOp op;
+  char *pattern;
+} RunData;
+
+static void
+run_data_free (RunData *data)
+{
+  g_bytes_unref (data->text);
+  g_free (data->pattern);
+  g_free (data);
+}
+
+static void
+run_thread (GTask *task,
+            gpointer source_object,
+            gpointer task_data,
+            GCancellable *cancellable)
+{
+  RunData *data = task_data;
+  GError *error = NULL;
+  GBytes *result;
+
+  result = texty_line_ops_run (data->text, data->op, data->pattern, cancellable, &error);
+  if (result != NULL)
+    g_task_return_pointer (task, result, (GDestroyNotify) g_bytes_unref);
+  else
+    g_task_return_error (task, error);
+}
+
+void
+texty_line_ops_run_async (GBytes *text,
+                          TextyLineOp op,
+                          const char *pattern,
+                          GCancellable *cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  RunData *data;
+
+  g_return_if_fail (text != NULL);
+
+  data = g_new0 (RunData, 1);
+  data->text = g_bytes_ref (text);
+  data->op = op;
+  data->pattern = g_strdup (pattern);
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, texty_line_ops_run_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) run_data_free);
+  g_task_run_in_thread (task, run_thread);
+}
+
+GBytes *
+texty_line_ops_run_finish (GAsyncResult *result,
+                           GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,57 @@
+/* texty-line-ops.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  TEXTY_LINE_OP_SORT,
+  TEXTY_LINE_OP_SORT_NUMERIC,
+  TEXTY_LINE_OP_SORT_NATURAL,
+  TEXTY_LINE_OP_SORT_CASELESS,
+  TEXTY_LINE_OP_UNIQUE,
+  TEXTY_LINE_OP_COUNT,
+  TEXTY_LINE_OP_REVERSE,
+  TEXTY_LINE_OP_TRIM,
+  TEXTY_LINE_OP_FILTER,
+} TextyLineOp;
+
+gboolean  texty_line_op_from_string   (const char           *str,
+                                       TextyLineOp          *op);
+
+GBytes   *texty_line_ops_run          (GBytes               *text,
+                                       TextyLineOp           op,
+                                       const char           *pattern,
+                                       GCancellable         *cancellable,
+                                       GError              **error);
+void      texty_line_ops_run_async    (GBytes               *text,
+                                       TextyLineOp           op,
+                                       const char           *pattern,
+                                       GCancellable         *cancellable,
+                                       GAsyncReadyCallback   callback,
+                                       gpointer              user_data);
+GBytes   *texty_line_ops_run_finish   (GAsyncResult         *result,
+                                       GError              **error);
+
+G_END_DECLS
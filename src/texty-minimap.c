@@ -0,0 +1,718 @@
+/* texty-minimap.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-minimap.h"
+
+#include <string.h>
+
+#define MAP_WIDTH 80
+/* text columns squeezed into each pixel, so 160 columns fit across */
+#define COLUMNS_PER_PIXEL 2
+/* the strip along the right edge marking lines that match the pattern */
+#define MATCH_WIDTH 6
+/* short documents aren't stretched taller than this per line */
+#define MAX_LINE_HEIGHT 3.0
+/* rows of pixels in a block when it was created, each its own texture */
+#define BLOCK_ROWS 16
+/* time spent rendering blocks per idle, so frames aren't held up */
+#define RENDER_BUDGET_USEC 4000
+
+typedef struct
+{
+  int n_lines;
+  GdkTexture *texture;
+  gboolean dirty;
+} Block;
+
+struct _TextyMinimap
+{
+  GtkWidget parent_instance;
+
+  GtkTextView *view;
+  GtkTextBuffer *buffer;
+  GtkAdjustment *vadjustment;
+  GRegex *regex;
+
+  /* the document from top to bottom, their n_lines add up to total_lines */
+  GArray *blocks;
+  int total_lines;
+  /* how many lines are averaged into one row of pixels, a power of two */
+  int lines_per_row;
+  /* the colour the textures were rendered with */
+  GdkRGBA color;
+  guint render_id;
+  double drag_start_y;
+};
+
+G_DEFINE_FINAL_TYPE (TextyMinimap, texty_minimap, GTK_TYPE_WIDGET)
+
+static const GdkRGBA match_color = { 0.21, 0.52, 0.89, 1.0 };
+
+static void
+block_clear (Block *block)
+{
+  g_clear_object (&block->texture);
+}
+
+static void
+queue_render (TextyMinimap *self);
+
+/* few enough rows that the textures never take much more than the screen */
+static int
+choose_lines_per_row (TextyMinimap *self)
+{
+  int rows = MAX (gtk_widget_get_height (GTK_WIDGET (self)), 512) * 2;
+  int lines_per_row = 1;
+
+  while ((gint64) lines_per_row * rows < self->total_lines)
+    lines_per_row *= 2;
+
+  return lines_per_row;
+}
+
+static void
+reset_blocks (TextyMinimap *self)
+{
+  int block_lines;
+
+  g_array_set_size (self->blocks, 0);
+  if (self->buffer == NULL)
+    return;
+
+  self->total_lines = gtk_text_buffer_get_line_count (self->buffer);
+  self->lines_per_row = choose_lines_per_row (self);
+  block_lines = BLOCK_ROWS * self->lines_per_row;
+
+  for (int line = 0; line < self->total_lines; line += block_lines)
+    {
+      Block block = { MIN (block_lines, self->total_lines - line), NULL, TRUE };
+
+      g_array_append_val (self->blocks, block);
+    }
+
+  queue_render (self);
+}
+
+static void
+invalidate_all (TextyMinimap *self)
+{
+  for (guint i = 0; i < self->blocks->len; i++)
+    g_array_index (self->blocks, Block, i).dirty = TRUE;
+
+  queue_render (self);
+}
+
+/* the block holding 'line', with the number of its first line */
+static guint
+find_block (TextyMinimap *self,
+            int line,
+            int *first_line)
+{
+  int first = 0;
+  guint i;
+
+  for (i = 0; i + 1 < self->blocks->len; i++)
+    {
+      int n_lines = g_array_index (self->blocks, Block, i).n_lines;
+
+      if (line < first + n_lines)
+        break;
+      first += n_lines;
+    }
+
+  *first_line = first;
+  return i;
+}
+
+static void
+on_insert_text (GtkTextBuffer *buffer,
+                GtkTextIter *location,
+                char *text,
+                int length,
+                TextyMinimap *self)
+{
+  int added = gtk_text_buffer_get_line_count (buffer) - self->total_lines;
+  int line = gtk_text_iter_get_line (location) - added;
+  int first;
+  Block *block;
+
+  if (self->blocks->len == 0)
+    return;
+
+  /* new lines join the block the insertion started in */
+  block = &g_array_index (self->blocks, Block, find_block (self, line, &first));
+  block->n_lines += added;
+  block->dirty = TRUE;
+  self->total_lines += added;
+
+  queue_render (self);
+}
+
+static void
+on_delete_range (GtkTextBuffer *buffer,
+                 GtkTextIter *start,
+                 GtkTextIter *end,
+                 TextyMinimap *self)
+{
+  int removed = self->total_lines - gtk_text_buffer_get_line_count (buffer);
+  int line = gtk_text_iter_get_line (start);
+  int first;
+  guint i;
+
+  if (self->blocks->len == 0)
+    return;
+
+  /* the lines after 'line' that were joined onto it are gone */
+  i = find_block (self, line, &first);
+  g_array_index (self->blocks, Block, i).dirty = TRUE;
+  line++;
+  while (removed > 0 && i < self->blocks->len)
+    {
+      Block *block = &g_array_index (self->blocks, Block, i);
+      int count = CLAMP (first + block->n_lines - line, 0, removed);
+
+      first += block->n_lines;
+      block->n_lines -= count;
+      block->dirty = TRUE;
+      removed -= count;
+      self->total_lines -= count;
+
+      if (block->n_lines == 0)
+        g_array_remove_index (self->blocks, i);
+      else
+        i++;
+      line = first;
+    }
+
+  queue_render (self);
+}
+
+/**********************************/
+/* Blocks 👆️                      */
+/**********************************/
+
+/* paints every line's extent, from its indent to its last visible character */
+static void
+measure_line (const char *text,
+              int *coverage)
+{
+  int max_columns = MAP_WIDTH * COLUMNS_PER_PIXEL;
+  int column = 0;
+  int indent = -1;
+  int last = 0;
+
+  for (const char *p = text; *p != '\0' && column < max_columns; p = g_utf8_next_char (p))
+    {
+      if (*p == '\t')
+        {
+          column = (column / 8 + 1) * 8;
+          continue;
+        }
+      if (*p != ' ' && indent < 0)
+        indent = column;
+      column++;
+      if (*p != ' ')
+        last = column;
+    }
+
+  if (indent < 0)
+    return;
+
+  coverage[indent / COLUMNS_PER_PIXEL]++;
+  coverage[MIN ((last + COLUMNS_PER_PIXEL - 1) / COLUMNS_PER_PIXEL, MAP_WIDTH)]--;
+}
+
+static void
+put_pixel (guint8 *pixel,
+           const GdkRGBA *color,
+           double alpha)
+{
+  alpha *= color->alpha;
+
+  /* GDK_MEMORY_DEFAULT is premultiplied BGRA */
+  pixel[0] = color->blue * alpha * 255;
+  pixel[1] = color->green * alpha * 255;
+  pixel[2] = color->red * alpha * 255;
+  pixel[3] = alpha * 255;
+}
+
+static GdkTexture *
+render_block (TextyMinimap *self,
+              int first_line,
+              int n_lines)
+{
+  g_autoptr (GBytes) bytes = NULL;
+  g_autofree int *coverage = g_new (int, MAP_WIDTH + 1);
+  int rows = (n_lines + self->lines_per_row - 1) / self->lines_per_row;
+  gsize stride = MAP_WIDTH * 4;
+  guint8 *pixels = g_malloc0 (stride * rows);
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_iter_at_line (self->buffer, &iter, first_line);
+
+  for (int row = 0; row < rows; row++)
+    {
+      int lines = MIN (self->lines_per_row, n_lines - row * self->lines_per_row);
+      int matches = 0;
+      int level = 0;
+
+      memset (coverage, 0, sizeof (int) * (MAP_WIDTH + 1));
+      for (int i = 0; i < lines; i++)
+        {
+          GtkTextIter line_end = iter;
+          g_autofree char *text = NULL;
+
+          if (!gtk_text_iter_ends_line (&line_end))
+            gtk_text_iter_forward_to_line_end (&line_end);
+          text = gtk_text_iter_get_slice (&iter, &line_end);
+
+          measure_line (text, coverage);
+          if (self->regex != NULL && g_regex_match (self->regex, text, 0, NULL))
+            matches++;
+
+          gtk_text_iter_forward_line (&iter);
+        }
+
+      /* averaged over the row, so dense regions come out darker */
+      for (int x = 0; x < MAP_WIDTH; x++)
+        {
+          level += coverage[x];
+          if (level > 0)
+            put_pixel (pixels + row * stride + x * 4, &self->color, 0.15 + 0.55 * level / lines);
+        }
+
+      if (matches > 0)
+        {
+          for (int x = MAP_WIDTH - MATCH_WIDTH; x < MAP_WIDTH; x++)
+            put_pixel (pixels + row * stride + x * 4, &match_color, 0.4 + 0.6 * matches / lines);
+        }
+    }
+
+  bytes = g_bytes_new_take (pixels, stride * rows);
+  return gdk_memory_texture_new (MAP_WIDTH, rows, GDK_MEMORY_DEFAULT, bytes, stride);
+}
+
+/* keeps blocks that grew from edits small enough to repaint quickly */
+static void
+split_blocks (TextyMinimap *self)
+{
+  int block_lines = BLOCK_ROWS * self->lines_per_row;
+
+  for (guint i = 0; i < self->blocks->len; i++)
+    {
+      Block *block = &g_array_index (self->blocks, Block, i);
+      Block rest = { block->n_lines - block_lines, NULL, TRUE };
+
+      if (block->n_lines <= 2 * block_lines)
+        continue;
+
+      block->n_lines = block_lines;
+      block->dirty = TRUE;
+      g_array_insert_val (self->blocks, i + 1, rest);
+    }
+}
+
+static gboolean
+render_blocks (gpointer user_data)
+{
+  TextyMinimap *self = user_data;
+  gint64 deadline = g_get_monotonic_time () + RENDER_BUDGET_USEC;
+  int lines_per_row = choose_lines_per_row (self);
+  int first_line = 0;
+
+  gtk_widget_get_color (GTK_WIDGET (self), &self->color);
+
+  /* the document or the map changed size enough to need another scale */
+  if (lines_per_row > self->lines_per_row * 2 || lines_per_row * 2 < self->lines_per_row)
+    {
+      self->render_id = 0;
+      reset_blocks (self);
+      return G_SOURCE_REMOVE;
+    }
+  split_blocks (self);
+
+  for (guint i = 0; i < self->blocks->len; i++)
+    {
+      Block *block = &g_array_index (self->blocks, Block, i);
+
+      if (block->dirty)
+        {
+          g_clear_object (&block->texture);
+          block->texture = render_block (self, first_line, block->n_lines);
+          block->dirty = FALSE;
+
+          if (g_get_monotonic_time () > deadline)
+            {
+              gtk_widget_queue_draw (GTK_WIDGET (self));
+              return G_SOURCE_CONTINUE;
+            }
+        }
+      first_line += block->n_lines;
+    }
+
+  self->render_id = 0;
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+  return G_SOURCE_REMOVE;
+}
+
+static void
+queue_render (TextyMinimap *self)
+{
+  if (self->render_id != 0 || self->buffer == NULL)
+    return;
+  if (!gtk_widget_get_mapped (GTK_WIDGET (self)))
+    return;
+
+  /* below redrawing, so typing stays smooth while the map catches up */
+  self->render_id = g_idle_add_full (G_PRIORITY_LOW, render_blocks, self, NULL);
+}
+
+/**********************************/
+/* Rendering 👆️                   */
+/**********************************/
+
+static double
+get_line_height (TextyMinimap *self)
+{
+  double height = gtk_widget_get_height (GTK_WIDGET (self));
+
+  return MIN (MAX_LINE_HEIGHT, height / MAX (self->total_lines, 1));
+}
+
+static void
+texty_minimap_snapshot (GtkWidget *widget,
+                        GtkSnapshot *snapshot)
+{
+  TextyMinimap *self = TEXTY_MINIMAP (widget);
+  double line_height = get_line_height (self);
+  GdkRGBA color;
+  double y = 0;
+
+  /* the theme changed, the blocks catch up while the old ones are shown */
+  gtk_widget_get_color (widget, &color);
+  if (!gdk_rgba_equal (&color, &self->color))
+    {
+      self->color = color;
+      invalidate_all (self);
+    }
+
+  for (guint i = 0; i < self->blocks->len; i++)
+    {
+      Block *block = &g_array_index (self->blocks, Block, i);
+      double height = block->n_lines * line_height;
+
+      if (block->texture != NULL)
+        gtk_snapshot_append_scaled_texture (snapshot,
+                                            block->texture,
+                                            GSK_SCALING_FILTER_LINEAR,
+                                            &GRAPHENE_RECT_INIT (0, y, MAP_WIDTH, height));
+      y += height;
+    }
+
+  /* the part of the document that is on screen */
+  if (self->vadjustment != NULL && gtk_adjustment_get_upper (self->vadjustment) > 0)
+    {
+      double upper = gtk_adjustment_get_upper (self->vadjustment);
+      double top = gtk_adjustment_get_value (self->vadjustment) / upper * y;
+      double height = gtk_adjustment_get_page_size (self->vadjustment) / upper * y;
+
+      color.alpha *= 0.12;
+      gtk_snapshot_append_color (snapshot,
+                                 &color,
+                                 &GRAPHENE_RECT_INIT (0, top, MAP_WIDTH, MAX (height, 2)));
+    }
+}
+
+static void
+texty_minimap_measure (GtkWidget *widget,
+                       GtkOrientation orientation,
+                       int for_size,
+                       int *minimum,
+                       int *natural,
+                       int *minimum_baseline,
+                       int *natural_baseline)
+{
+  if (orientation == GTK_ORIENTATION_HORIZONTAL)
+    *minimum = *natural = MAP_WIDTH;
+  else
+    *minimum = *natural = 0;
+}
+
+static void
+texty_minimap_size_allocate (GtkWidget *widget,
+                             int width,
+                             int height,
+                             int baseline)
+{
+  /* taller or shorter, the scale may have to change */
+  queue_render (TEXTY_MINIMAP (widget));
+}
+
+static void
+texty_minimap_map (GtkWidget *widget)
+{
+  GTK_WIDGET_CLASS (texty_minimap_parent_class)->map (widget);
+
+  queue_render (TEXTY_MINIMAP (widget));
+}
+
+static void
+texty_minimap_unmap (GtkWidget *widget)
+{
+  TextyMinimap *self = TEXTY_MINIMAP (widget);
+
+  g_clear_handle_id (&self->render_id, g_source_remove);
+
+  GTK_WIDGET_CLASS (texty_minimap_parent_class)->unmap (widget);
+}
+
+/**********************************/
+/* Drawing 👆️                     */
+/**********************************/
+
+/* centres the view on the line under 'y' */
+static void
+scroll_to (TextyMinimap *self,
+           double y)
+{
+  double map_height = self->total_lines * get_line_height (self);
+  double upper;
+  double page_size;
+
+  if (self->vadjustment == NULL || map_height <= 0)
+    return;
+
+  upper = gtk_adjustment_get_upper (self->vadjustment);
+  page_size = gtk_adjustment_get_page_size (self->vadjustment);
+  gtk_adjustment_set_value (self->vadjustment,
+                            CLAMP (y / map_height, 0, 1) * upper - page_size / 2);
+}
+
+static void
+on_drag_begin (GtkGestureDrag *gesture,
+               double x,
+               double y,
+               TextyMinimap *self)
+{
+  self->drag_start_y = y;
+  scroll_to (self, y);
+}
+
+static void
+on_drag_update (GtkGestureDrag *gesture,
+                double offset_x,
+                double offset_y,
+                TextyMinimap *self)
+{
+  scroll_to (self, self->drag_start_y + offset_y);
+}
+
+static void
+set_vadjustment (TextyMinimap *self,
+                 GtkAdjustment *vadjustment)
+{
+  if (self->vadjustment == vadjustment)
+    return;
+
+  if (self->vadjustment != NULL)
+    g_signal_handlers_disconnect_by_data (self->vadjustment, self);
+  g_set_object (&self->vadjustment, vadjustment);
+  if (vadjustment != NULL)
+    {
+      g_signal_connect_swapped (vadjustment, "value-changed", G_CALLBACK (gtk_widget_queue_draw), self);
+      g_signal_connect_swapped (vadjustment, "changed", G_CALLBACK (gtk_widget_queue_draw), self);
+    }
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void
+set_buffer (TextyMinimap *self,
+            GtkTextBuffer *buffer)
+{
+  if (self->buffer == buffer)
+    return;
+
+  if (self->buffer != NULL)
+    g_signal_handlers_disconnect_by_data (self->buffer, self);
+  g_clear_handle_id (&self->render_id, g_source_remove);
+  g_set_object (&self->buffer, buffer);
+
+  /* after the default handlers, once the line count has changed */
+  if (buffer != NULL)
+    {
+      g_signal_connect_after (buffer, "insert-text", G_CALLBACK (on_insert_text), self);
+      g_signal_connect_after (buffer, "delete-range", G_CALLBACK (on_delete_range), self);
+    }
+  reset_blocks (self);
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void
+on_view_notify (GtkTextView *view,
+                GParamSpec *pspec,
+                TextyMinimap *self)
+{
+  set_buffer (self, gtk_text_view_get_buffer (view));
+  set_vadjustment (self, gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (view)));
+}
+
+/**********************************/
+/* Following the view 👆️          */
+/**********************************/
+
+static void
+texty_minimap_dispose (GObject *object)
+{
+  TextyMinimap *self = TEXTY_MINIMAP (object);
+
+  if (self->view != NULL)
+    g_signal_handlers_disconnect_by_data (self->view, self);
+  g_clear_object (&self->view);
+  set_buffer (self, NULL);
+  set_vadjustment (self, NULL);
+  g_clear_pointer (&self->regex, g_regex_unref);
+
+  G_OBJECT_CLASS (texty_minimap_parent_class)->dispose (object);
+}
+
+static void
+texty_minimap_finalize (GObject *object)
+{
+  TextyMinimap *self = TEXTY_MINIMAP (object);
+
+  g_clear_pointer (&self->blocks, g_array_unref);
+
+  G_OBJECT_CLASS (texty_minimap_parent_class)->finalize (object);
+}
+
+static void
+texty_minimap_class_init (TextyMinimapClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->dispose = texty_minimap_dispose;
+  object_class->finalize = texty_minimap_finalize;
+
+  widget_class->snapshot = texty_minimap_snapshot;
+  widget_class->measure = texty_minimap_measure;
+  widget_class->size_allocate = texty_minimap_size_allocate;
+  widget_class->map = texty_minimap_map;
+  widget_class->unmap = texty_minimap_unmap;
+
+  gtk_widget_class_set_css_name (widget_class, "minimap");
+}
+
+static void
+texty_minimap_init (TextyMinimap *self)
+{
+  GtkGesture *drag;
+
+  self->blocks = g_array_new (FALSE, TRUE, sizeof (Block));
+  g_array_set_clear_func (self->blocks, (GDestroyNotify) block_clear);
+  self->lines_per_row = 1;
+
+  drag = gtk_gesture_drag_new ();
+  g_signal_connect (drag, "drag-begin", G_CALLBACK (on_drag_begin), self);
+  g_signal_connect (drag, "drag-update", G_CALLBACK (on_drag_update), self);
+  gtk_widget_add_controller (GTK_WIDGET (self), GTK_EVENT_CONTROLLER (drag));
+
+  gtk_widget_set_cursor_from_name (GTK_WIDGET (self), "pointer");
+}
+
+/*
+ * An overview of the whole document beside it: every line drawn from its
+ * indent to its end, with lines matching a pattern marked along the right
+ * edge and the visible part shaded. The overview is kept as one texture
+ * per block of lines, and edits only repaint the blocks they touch.
+ */
+GtkWidget *
+texty_minimap_new (void)
+{
+  return g_object_new (TEXTY_TYPE_MINIMAP, NULL);
+}
+
+/* follows 'view', along with the buffers it is given and its scrolling */
+void
+texty_minimap_set_view (TextyMinimap *self,
+                        GtkTextView *view)
+{
+  g_return_if_fail (TEXTY_IS_MINIMAP (self));
+  g_return_if_fail (view == NULL || GTK_IS_TEXT_VIEW (view));
+
+  if (self->view != NULL)
+    g_signal_handlers_disconnect_by_data (self->view, self);
+  g_set_object (&self->view, view);
+
+  if (view == NULL)
+    {
+      set_buffer (self, NULL);
+      set_vadjustment (self, NULL);
+      return;
+    }
+
+  g_signal_connect (view, "notify::buffer", G_CALLBACK (on_view_notify), self);
+  g_signal_connect (view, "notify::vadjustment", G_CALLBACK (on_view_notify), self);
+  on_view_notify (view, NULL, self);
+}
+
+/* marks the lines matching 'pattern', or none when it is NULL or invalid */
+void
+texty_minimap_set_pattern (TextyMinimap *self,
+                           const char *pattern)
+{
+  g_return_if_fail (TEXTY_IS_MINIMAP (self));
+
+  g_clear_pointer (&self->regex, g_regex_unref);
+  if (pattern != NULL && *pattern != '\0')
+    self->regex = g_regex_new (pattern, G_REGEX_OPTIMIZE, 0, NULL);
+
+  invalidate_all (self);
+}
+
+/*
+ * Frees the rendered blocks of a hidden minimap, which are drawn again
+ * once it is shown. Returns about how many bytes that released.
+ */
+gsize
+texty_minimap_drop_textures (TextyMinimap *self)
+{
+  gsize dropped = 0;
+
+  g_return_val_if_fail (TEXTY_IS_MINIMAP (self), 0);
+
+  /* a minimap in sight would only render them again */
+  if (gtk_widget_get_mapped (GTK_WIDGET (self)))
+    return 0;
+
+  for (guint i = 0; i < self->blocks->len; i++)
+    {
+      Block *block = &g_array_index (self->blocks, Block, i);
+
+      if (block->texture == NULL)
+        continue;
+      dropped += (gsize) gdk_texture_get_width (block->texture) * gdk_texture_get_height (block->texture) * 4;
+      g_clear_object (&block->texture);
+      block->dirty = TRUE;
+    }
+
+  return dropped;
+}
@@ -0,0 +1,38 @@
+/* texty-minimap.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define TEXTY_TYPE_MINIMAP (texty_minimap_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyMinimap, texty_minimap, TEXTY, MINIMAP, GtkWidget)
+
+GtkWidget *texty_minimap_new           (void);
+void       texty_minimap_set_view      (TextyMinimap *self,
+                                        GtkTextView  *view);
+void       texty_minimap_set_pattern   (TextyMinimap *self,
+                                        const char   *pattern);
+gsize      texty_minimap_drop_textures (TextyMinimap *self);
+
+G_END_DECLS
@@ -0,0 +1,426 @@
+/* texty-paste.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-paste.h"
+
+#include <string.h>
+
+/* read ahead of the inserts, but not unboundedly */
+#define READ_SIZE (1024 * 1024)
+#define MAX_PENDING (8 * READ_SIZE)
+
+/* inserts are done in slices until a frame's time budget is spent */
+#define INSERT_SLICE (64 * 1024)
+#define TICK_BUDGET_USEC 8000
+
+/* progress is only reported for pastes still going after this long */
+#define PROGRESS_DELAY_USEC (250 * 1000)
+
+struct _TextyPaste
+{
+  GObject parent_instance;
+
+  GtkTextView *text_view;
+  GtkTextBuffer *buffer;
+  GCancellable *cancellable;
+  GInputStream *stream;
+  /* bytes read from the clipboard, those before pending_pos are inserted */
+  GByteArray *pending;
+  gsize pending_pos;
+  /* where the paste started, and where the next chunk goes */
+  GtkTextMark *start_mark;
+  GtkTextMark *insert_mark;
+  guint tick_id;
+  gint64 start_time;
+  guint64 bytes_inserted;
+  gboolean editable;
+  gboolean reading;
+  gboolean at_eof;
+  gboolean running;
+};
+
+G_DEFINE_FINAL_TYPE (TextyPaste, texty_paste, G_TYPE_OBJECT)
+
+enum
+{
+  PROGRESS,
+  FINISHED,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+static void read_next (TextyPaste *self);
+
+static void
+finish (TextyPaste *self,
+        gboolean cancelled)
+{
+  GtkTextIter start;
+  GtkTextIter iter;
+
+  if (!self->running)
+    return;
+  self->running = FALSE;
+
+  if (self->tick_id != 0)
+    {
+      gtk_widget_remove_tick_callback (GTK_WIDGET (self->text_view), self->tick_id);
+      self->tick_id = 0;
+    }
+  g_cancellable_cancel (self->cancellable);
+  g_clear_object (&self->stream);
+
+  /* nothing was inserted yet while still waiting for the clipboard */
+  if (self->start_mark != NULL)
+    {
+      gtk_text_buffer_get_iter_at_mark (self->buffer, &start, self->start_mark);
+      gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, self->insert_mark);
+      /* a cancelled paste leaves nothing half inserted behind */
+      if (cancelled)
+        gtk_text_buffer_delete (self->buffer, &start, &iter);
+      gtk_text_buffer_place_cursor (self->buffer, &iter);
+      gtk_text_buffer_end_user_action (self->buffer);
+
+      gtk_text_buffer_delete_mark (self->buffer, self->start_mark);
+      gtk_text_buffer_delete_mark (self->buffer, self->insert_mark);
+      self->start_mark = NULL;
+      self->insert_mark = NULL;
+
+      gtk_text_view_set_editable (self->text_view, self->editable);
+      gtk_text_view_scroll_mark_onscreen (self->text_view,
+                                          gtk_text_buffer_get_insert (self->buffer));
+    }
+
+  g_signal_emit (self, signals[FINISHED], 0, cancelled);
+}
+
+/* inserts the next slice, holding back a character split across reads */
+static gsize
+insert_slice (TextyPaste *self)
+{
+  const char *data = (const char *) self->pending->data + self->pending_pos;
+  gsize available = self->pending->len - self->pending_pos;
+  gsize length = MIN (available, INSERT_SLICE);
+  gboolean more_follows = length < available || !self->at_eof;
+  g_autofree char *fixed = NULL;
+  const char *end;
+  GtkTextIter iter;
+
+  if (!g_utf8_validate_len (data, length, &end))
+    {
+      gsize rest = data + length - end;
+
+      /* a character cut by the slice or the read is completed by what follows */
+      if (more_follows && g_utf8_get_char_validated (end, rest) == (gunichar) -2)
+        {
+          length = end - data;
+          if (length == 0)
+            return 0;
+        }
+      else
+        {
+          fixed = g_utf8_make_valid (data, length);
+        }
+    }
+
+  gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, self->insert_mark);
+  gtk_text_buffer_insert (self->buffer, &iter, fixed != NULL ? fixed : data, fixed != NULL ? -1 : (int) length);
+  self->pending_pos += length;
+  if (self->pending_pos == self->pending->len)
+    {
+      g_byte_array_set_size (self->pending, 0);
+      self->pending_pos = 0;
+    }
+
+  return length;
+}
+
+static gboolean
+on_tick (GtkWidget *widget,
+         GdkFrameClock *frame_clock,
+         gpointer user_data)
+{
+  TextyPaste *self = TEXTY_PASTE (user_data);
+  gint64 deadline = g_get_monotonic_time () + TICK_BUDGET_USEC;
+  guint64 before = self->bytes_inserted;
+
+  while (self->pending->len > self->pending_pos && g_get_monotonic_time () < deadline)
+    {
+      gsize inserted = insert_slice (self);
+
+      if (inserted == 0)
+        break;
+      self->bytes_inserted += inserted;
+    }
+
+  if (self->bytes_inserted != before
+      && g_get_monotonic_time () - self->start_time >= PROGRESS_DELAY_USEC)
+    g_signal_emit (self, signals[PROGRESS], 0);
+
+  if (self->at_eof && self->pending->len == self->pending_pos)
+    {
+      self->tick_id = 0;
+      finish (self, FALSE);
+      return G_SOURCE_REMOVE;
+    }
+
+  /* room again for more clipboard data */
+  if (!self->reading && !self->at_eof && self->pending->len - self->pending_pos < MAX_PENDING)
+    read_next (self);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+on_read_bytes (GObject *source_object,
+               GAsyncResult *result,
+               gpointer user_data)
+{
+  g_autoptr (TextyPaste) self = user_data;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GError) error = NULL;
+  const guint8 *data;
+  gsize length;
+
+  /* a cancelled read may belong to an earlier paste */
+  bytes = g_input_stream_read_bytes_finish (G_INPUT_STREAM (source_object), result, &error);
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) || !self->running)
+    return;
+  self->reading = FALSE;
+
+  if (bytes == NULL)
+    {
+      g_warning ("Unable to read the clipboard: %s", error->message);
+      finish (self, TRUE);
+      return;
+    }
+
+  /* drop what was inserted once it makes up most of the array */
+  if (self->pending_pos > self->pending->len / 2)
+    {
+      g_byte_array_remove_range (self->pending, 0, self->pending_pos);
+      self->pending_pos = 0;
+    }
+
+  data = g_bytes_get_data (bytes, &length);
+  if (length == 0)
+    self->at_eof = TRUE;
+  else
+    g_byte_array_append (self->pending, data, length);
+
+  if (!self->at_eof && self->pending->len - self->pending_pos < MAX_PENDING)
+    read_next (self);
+}
+
+static void
+read_next (TextyPaste *self)
+{
+  self->reading = TRUE;
+  g_input_stream_read_bytes_async (self->stream,
+                                   READ_SIZE,
+                                   G_PRIORITY_DEFAULT,
+                                   self->cancellable,
+                                   on_read_bytes,
+                                   g_object_ref (self));
+}
+
+static void
+on_clipboard_read (GObject *source_object,
+                   GAsyncResult *result,
+                   gpointer user_data)
+{
+  g_autoptr (TextyPaste) self = user_data;
+  g_autoptr (GError) error = NULL;
+  GInputStream *stream;
+  GtkTextIter iter;
+
+  stream = gdk_clipboard_read_finish (GDK_CLIPBOARD (source_object), result, NULL, &error);
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) || !self->running)
+    {
+      g_clear_object (&stream);
+      return;
+    }
+  if (stream == NULL)
+    {
+      /* nothing offered as UTF-8 text, let the buffer try its own way */
+      self->running = FALSE;
+      gtk_text_buffer_paste_clipboard (self->buffer,
+                                       GDK_CLIPBOARD (source_object),
+                                       NULL,
+                                       self->editable);
+      g_signal_emit (self, signals[FINISHED], 0, FALSE);
+      return;
+    }
+  self->stream = stream;
+
+  /* everything from here on is one undo step */
+  gtk_text_buffer_begin_user_action (self->buffer);
+  gtk_text_buffer_delete_selection (self->buffer, TRUE, self->editable);
+  gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, gtk_text_buffer_get_insert (self->buffer));
+  self->start_mark = gtk_text_buffer_create_mark (self->buffer, NULL, &iter, TRUE);
+  self->insert_mark = gtk_text_buffer_create_mark (self->buffer, NULL, &iter, FALSE);
+
+  /* keep the user from typing into the middle of the paste */
+  gtk_text_view_set_editable (self->text_view, FALSE);
+
+  self->tick_id = gtk_widget_add_tick_callback (GTK_WIDGET (self->text_view),
+                                                on_tick,
+                                                self,
+                                                NULL);
+  read_next (self);
+}
+
+/**********************************/
+/* Pasting 👆️                     */
+/**********************************/
+
+static void
+texty_paste_dispose (GObject *object)
+{
+  TextyPaste *self = TEXTY_PASTE (object);
+
+  finish (self, TRUE);
+  g_clear_object (&self->text_view);
+  g_clear_object (&self->buffer);
+
+  G_OBJECT_CLASS (texty_paste_parent_class)->dispose (object);
+}
+
+static void
+texty_paste_finalize (GObject *object)
+{
+  TextyPaste *self = TEXTY_PASTE (object);
+
+  g_clear_object (&self->cancellable);
+  g_clear_pointer (&self->pending, g_byte_array_unref);
+
+  G_OBJECT_CLASS (texty_paste_parent_class)->finalize (object);
+}
+
+static void
+texty_paste_class_init (TextyPasteClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = texty_paste_dispose;
+  object_class->finalize = texty_paste_finalize;
+
+  /*
+   * emitted once per frame in which text was inserted, once the paste has
+   * gone on for long enough to be worth showing
+   */
+  signals[PROGRESS] = g_signal_new ("progress",
+                                    G_TYPE_FROM_CLASS (klass),
+                                    G_SIGNAL_RUN_LAST,
+                                    0,
+                                    NULL, NULL,
+                                    NULL,
+                                    G_TYPE_NONE, 0);
+
+  /* emitted when done, with whether the paste was cancelled */
+  signals[FINISHED] = g_signal_new ("finished",
+                                    G_TYPE_FROM_CLASS (klass),
+                                    G_SIGNAL_RUN_LAST,
+                                    0,
+                                    NULL, NULL,
+                                    NULL,
+                                    G_TYPE_NONE, 1,
+                                    G_TYPE_BOOLEAN);
+}
+
+static void
+texty_paste_init (TextyPaste *self)
+{
+  self->pending = g_byte_array_new ();
+}
+
+/*
+ * Pastes the clipboard into 'text_view' without blocking: the clipboard is
+ * read as a stream and inserted a slice at a time on each frame tick. One
+ * instance can be started again once the previous paste has finished.
+ */
+TextyPaste *
+texty_paste_new (GtkTextView *text_view)
+{
+  TextyPaste *self;
+
+  g_return_val_if_fail (GTK_IS_TEXT_VIEW (text_view), NULL);
+
+  self = g_object_new (TEXTY_TYPE_PASTE, NULL);
+  self->text_view = g_object_ref (text_view);
+
+  return self;
+}
+
+void
+texty_paste_start (TextyPaste *self,
+                   GdkClipboard *clipboard)
+{
+  static const char *mime_types[] = { "text/plain;charset=utf-8", NULL };
+
+  g_return_if_fail (TEXTY_IS_PASTE (self));
+  g_return_if_fail (!self->running);
+
+  /* the view may have been given another buffer since the last paste */
+  g_set_object (&self->buffer, gtk_text_view_get_buffer (self->text_view));
+  g_clear_object (&self->cancellable);
+  self->cancellable = g_cancellable_new ();
+  g_byte_array_set_size (self->pending, 0);
+  self->pending_pos = 0;
+  self->bytes_inserted = 0;
+  self->start_time = g_get_monotonic_time ();
+  self->reading = FALSE;
+  self->at_eof = FALSE;
+
+  self->running = TRUE;
+  self->editable = gtk_text_view_get_editable (self->text_view);
+  gdk_clipboard_read_async (clipboard,
+                            mime_types,
+                            G_PRIORITY_DEFAULT,
+                            self->cancellable,
+                            on_clipboard_read,
+                            g_object_ref (self));
+}
+
+void
+texty_paste_cancel (TextyPaste *self)
+{
+  g_return_if_fail (TEXTY_IS_PASTE (self));
+
+  finish (self, TRUE);
+}
+
+gboolean
+texty_paste_is_running (TextyPaste *self)
+{
+  g_return_val_if_fail (TEXTY_IS_PASTE (self), FALSE);
+
+  return self->running;
+}
+
+guint64
+texty_paste_get_bytes_inserted (TextyPaste *self)
+{
+  g_return_val_if_fail (TEXTY_IS_PASTE (self), 0);
+
+  return self->bytes_inserted;
+}
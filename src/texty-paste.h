@@ -0,0 +1,38 @@
+/* texty-paste.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define TEXTY_TYPE_PASTE (texty_paste_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyPaste, texty_paste, TEXTY, PASTE, GObject)
+
+TextyPaste *texty_paste_new                (GtkTextView  *text_view);
+void        texty_paste_start              (TextyPaste   *self,
+                                            GdkClipboard *clipboard);
+void        texty_paste_cancel             (TextyPaste   *self);
+gboolean    texty_paste_is_running         (TextyPaste   *self);
+guint64     texty_paste_get_bytes_inserted (TextyPaste   *self);
+
+G_END_DECLS
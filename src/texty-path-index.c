@@ -0,0 +1,1008 @@
+/* texty-path-index.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-path-index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ATTRIBUTES                   \
+  G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+  G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+  G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN
+
+/* directories read at once; the crawl mostly waits on the disk */
+#define N_CRAWLERS 4
+/* paths gathered before taking the lock to add them */
+#define BATCH_SIZE 256
+/*
+ * Watches are a scarce, per user resource, so only the first directories
+ * crawled get one. The crawl is roughly breadth first, so those are the
+ * shallow ones, where new files are most likely to turn up.
+ */
+#define MAX_MONITORS 512
+/* keeps a root like / from eating all memory */
+#define MAX_PATHS 4000000
+/* milliseconds between reports that the index grew */
+#define CHANGED_INTERVAL 100
+/* fewer candidates than this are not worth handing to another thread */
+#define MIN_SLICE 16384
+/* set in the mask of every path still on disk, and in that of every query */
+#define PRESENT_BIT (G_GUINT64_CONSTANT (1) << 63)
+
+/* scoring, tuned by hand */
+#define SCORE_MATCH 16
+#define SCORE_BOUNDARY 24
+#define SCORE_CONSECUTIVE 20
+#define SCORE_BASENAME 32
+#define PENALTY_GAP 2
+
+typedef struct
+{
+  /* relative to the root, as is and ASCII lowercased */
+  const char *path;
+  const char *folded;
+  guint32 length;
+  guint32 basename;
+} Entry;
+
+typedef struct
+{
+  int score;
+  guint length;
+  guint index;
+} Match;
+
+typedef struct
+{
+  GMutex mutex;
+  GCond cond;
+  guint pending;
+} Scan;
+
+/* a share of the candidates of a query, scanned by one thread */
+typedef struct
+{
+  TextyPathIndex *self;
+  Scan *scan;
+  const char *query;
+  gsize query_len;
+  guint64 mask;
+  /* positions in 'entries', or NULL for all of them */
+  const guint *candidates;
+  guint start;
+  guint end;
+
+  Match *heap;
+  guint n_heap;
+  guint size;
+  GArray *matches;
+} Slice;
+
+struct _TextyPathIndex
+{
+  GObject parent_instance;
+
+  GFile *root;
+  GCancellable *cancellable;
+  GThreadPool *crawlers;
+  /* main thread only */
+  GPtrArray *monitors;
+  /* atomic */
+  int n_monitors;
+  int changed_pending;
+
+  /* everything below is shared with the crawlers */
+  GMutex mutex;
+  gboolean stopping;
+  GStringChunk *strings;
+  GArray *entries;
+  /* a bit for each kind of character in each entry, see char_bit(), kept
+   * apart so the scan over them stays in cache */
+  GArray *masks;
+  /* path -> position in 'entries' + 1 */
+  GHashTable *lookup;
+  /* bumped whenever an existing entry comes or goes */
+  guint generation;
+
+  /*
+   * The previous query and a superset of its matches. A query that starts
+   * with it can only match among those, so typing on narrows the previous
+   * results instead of scanning everything again.
+   */
+  char *last_query;
+  GArray *last_matches;
+  guint last_n_entries;
+  guint last_generation;
+};
+
+G_DEFINE_FINAL_TYPE (TextyPathIndex, texty_path_index, G_TYPE_OBJECT)
+
+enum
+{
+  CHANGED,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+static void add_monitor_later (TextyPathIndex *self,
+                               GFile *directory);
+
+/*
+ * Letters and digits get a bit each, the usual separators get one more
+ * each and anything beyond ASCII shares the last. A path can only match
+ * a query whose bits are all among its own, which a single AND decides
+ * for most paths without reading a byte of them.
+ */
+static inline guint64
+char_bit (guchar c)
+{
+  if (c >= 'a' && c <= 'z')
+    return G_GUINT64_CONSTANT (1) << (c - 'a');
+  if (c >= '0' && c <= '9')
+    return G_GUINT64_CONSTANT (1) << (26 + c - '0');
+
+  switch (c)
+    {
+    case '.':
+      return G_GUINT64_CONSTANT (1) << 36;
+    case '_':
+      return G_GUINT64_CONSTANT (1) << 37;
+    case '-':
+      return G_GUINT64_CONSTANT (1) << 38;
+    case '/':
+      return G_GUINT64_CONSTANT (1) << 39;
+    case ' ':
+      return G_GUINT64_CONSTANT (1) << 40;
+    default:
+      return c >= 0x80 ? G_GUINT64_CONSTANT (1) << 41 : 0;
+    }
+}
+
+/* lowercases 'text' in place, returning its mask */
+static guint64
+fold (char *text)
+{
+  guint64 mask = 0;
+
+  for (; *text != '\0'; text++)
+    {
+      *text = g_ascii_tolower (*text);
+      mask |= char_bit (*text);
+    }
+
+  return mask;
+}
+
+static inline gboolean
+is_boundary (const char *path,
+             gsize position)
+{
+  char previous;
+
+  if (position == 0)
+    return TRUE;
+
+  previous = path[position - 1];
+  if (previous == '/' || previous == '_' || previous == '-' || previous == '.' || previous == ' ')
+    return TRUE;
+
+  /* camelCase */
+  return g_ascii_islower (previous) && g_ascii_isupper (path[position]);
+}
+
+/*
+ * Finds the shortest stretch of 'text' after 'from' that holds 'query' as a
+ * subsequence and ends soonest. The forward pass hops from one candidate
+ * byte to the next with memchr(), which is vectorized, and the backward
+ * pass then pulls the start as far right as it will go.
+ */
+static gboolean
+find_window (const char *text,
+             gsize from,
+             gsize length,
+             const char *query,
+             gsize query_len,
+             gsize *start,
+             gsize *end)
+{
+  const char *p = text + from;
+  const char *hit;
+  gsize i;
+  gsize j;
+
+  for (i = 0; i < query_len; i++)
+    {
+      hit = memchr (p, query[i], text + length - p);
+      if (hit == NULL)
+        return FALSE;
+      p = hit + 1;
+    }
+  *end = p - text;
+
+  j = *end;
+  for (i = query_len; i > 0; i--)
+    {
+      do
+        j--;
+      while (text[j] != query[i - 1]);
+    }
+  *start = j;
+
+  return TRUE;
+}
+
+/*
+ * Scores 'entry' against the folded 'query', or returns FALSE when it does
+ * not match at all. Matches score more at the start of a word and when they
+ * follow one another, less the further apart they are, and a match entirely
+ * inside the file name beats one strung across the directories.
+ */
+static gboolean
+score_entry (const Entry *entry,
+             const char *query,
+             gsize query_len,
+             int *score)
+{
+  gsize start;
+  gsize end;
+  gsize next = G_MAXSIZE;
+  gsize i;
+  gsize j;
+  int total = 0;
+
+  if (query_len == 0)
+    {
+      *score = 0;
+      return TRUE;
+    }
+
+  if (find_window (entry->folded, entry->basename, entry->length, query, query_len, &start, &end))
+    total += SCORE_BASENAME;
+  else if (entry->basename == 0 ||
+           !find_window (entry->folded, 0, entry->length, query, query_len, &start, &end))
+    return FALSE;
+
+  for (i = 0, j = start; i < query_len; j++)
+    {
+      if (entry->folded[j] != query[i])
+        continue;
+
+      total += SCORE_MATCH;
+      if (is_boundary (entry->path, j))
+        total += SCORE_BOUNDARY;
+      if (j == next)
+        total += SCORE_CONSECUTIVE;
+      next = j + 1;
+      i++;
+    }
+
+  total -= (int) (end - start - query_len) * PENALTY_GAP;
+  *score = total;
+
+  return TRUE;
+}
+
+/* 'a' should be listed before 'b' */
+static inline gboolean
+is_better (const Match *a,
+           const Match *b)
+{
+  if (a->score != b->score)
+    return a->score > b->score;
+  if (a->length != b->length)
+    return a->length < b->length;
+  return a->index < b->index;
+}
+
+static int
+compare_matches (gconstpointer a,
+                 gconstpointer b)
+{
+  return is_better (a, b) ? -1 : 1;
+}
+
+/*
+ * Keeps the best 'size' matches seen so far in 'heap', with the worst of
+ * them at the root, so each candidate costs one comparison unless it gets in.
+ */
+static void
+offer_match (Match *heap,
+             guint *n_heap,
+             guint size,
+             const Match *match)
+{
+  guint i;
+
+  if (*n_heap < size)
+    {
+      i = (*n_heap)++;
+      while (i > 0 && is_better (&heap[(i - 1) / 2], match))
+        {
+          heap[i] = heap[(i - 1) / 2];
+          i = (i - 1) / 2;
+        }
+      heap[i] = *match;
+      return;
+    }
+
+  if (!is_better (match, &heap[0]))
+    return;
+
+  i = 0;
+  for (;;)
+    {
+      guint child = 2 * i + 1;
+
+      if (child >= size)
+        break;
+      if (child + 1 < size && is_better (&heap[child], &heap[child + 1]))
+        child++;
+      if (!is_better (match, &heap[child]))
+        break;
+      heap[i] = heap[child];
+      i = child;
+    }
+  heap[i] = *match;
+}
+
+/**********************************/
+/* Scoring 👆️                     */
+/**********************************/
+
+static gboolean
+emit_changed (gpointer user_data)
+{
+  TextyPathIndex *self = user_data;
+
+  g_atomic_int_set (&self->changed_pending, FALSE);
+  if (!g_cancellable_is_cancelled (self->cancellable))
+    g_signal_emit (self, signals[CHANGED], 0);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* callable from any thread; bursts of changes are reported once */
+static void
+queue_changed (TextyPathIndex *self)
+{
+  if (g_atomic_int_compare_and_exchange (&self->changed_pending, FALSE, TRUE))
+    g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE,
+                        CHANGED_INTERVAL,
+                        emit_changed,
+                        g_object_ref (self),
+                        g_object_unref);
+}
+
+static void
+insert_locked (TextyPathIndex *self,
+               const char *path)
+{
+  gpointer value;
+  const char *slash;
+  Entry entry;
+  guint64 mask;
+  gsize length;
+  char *folded;
+
+  if (g_hash_table_lookup_extended (self->lookup, path, NULL, &value))
+    {
+      g_array_index (self->masks, guint64, GPOINTER_TO_UINT (value) - 1) |= PRESENT_BIT;
+      self->generation++;
+      return;
+    }
+
+  if (self->entries->len >= MAX_PATHS)
+    return;
+
+  length = strlen (path);
+  folded = g_string_chunk_insert_len (self->strings, path, length);
+  slash = strrchr (path, '/');
+
+  entry.path = g_string_chunk_insert_len (self->strings, path, length);
+  entry.folded = folded;
+  entry.length = length;
+  entry.basename = slash != NULL ? slash + 1 - path : 0;
+  g_array_append_val (self->entries, entry);
+  mask = fold (folded) | PRESENT_BIT;
+  g_array_append_val (self->masks, mask);
+
+  g_hash_table_insert (self->lookup, (char *) entry.path, GUINT_TO_POINTER (self->entries->len));
+}
+
+static void
+remove_locked (TextyPathIndex *self,
+               const char *path)
+{
+  g_autofree char *prefix = g_strconcat (path, "/", NULL);
+  gpointer value;
+
+  self->generation++;
+
+  if (g_hash_table_lookup_extended (self->lookup, path, NULL, &value))
+    {
+      g_array_index (self->masks, guint64, GPOINTER_TO_UINT (value) - 1) &= ~PRESENT_BIT;
+      return;
+    }
+
+  /* not a file, so maybe a directory taking everything under it along */
+  for (guint i = 0; i < self->entries->len; i++)
+    {
+      if (g_str_has_prefix (g_array_index (self->entries, Entry, i).path, prefix))
+        g_array_index (self->masks, guint64, i) &= ~PRESENT_BIT;
+    }
+}
+
+static void
+insert_paths (TextyPathIndex *self,
+              GPtrArray *paths)
+{
+  if (paths->len == 0)
+    return;
+
+  g_mutex_lock (&self->mutex);
+  for (guint i = 0; i < paths->len; i++)
+    insert_locked (self, g_ptr_array_index (paths, i));
+  g_mutex_unlock (&self->mutex);
+
+  g_ptr_array_set_size (paths, 0);
+  queue_changed (self);
+}
+
+static void
+queue_directory (TextyPathIndex *self,
+                 GFile *directory)
+{
+  g_mutex_lock (&self->mutex);
+  /* pushing to a pool that is being freed is an error */
+  if (!self->stopping)
+    g_thread_pool_push (self->crawlers, g_object_ref (directory), NULL);
+  g_mutex_unlock (&self->mutex);
+}
+
+/*
+ * Runs in a crawler thread: adds the files of 'directory' to the index and
+ * queues its subdirectories behind the ones already waiting. Hidden entries
+ * and symbolic links are left out, which also keeps the crawl out of loops.
+ */
+static void
+crawl_directory (gpointer data,
+                 gpointer user_data)
+{
+  g_autoptr (GFile) directory = data;
+  TextyPathIndex *self = user_data;
+  g_autoptr (GFileEnumerator) enumerator = NULL;
+  g_autoptr (GPtrArray) paths = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr (GPtrArray) directories = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autofree char *prefix = NULL;
+
+  enumerator = g_file_enumerate_children (directory,
+                                          ATTRIBUTES,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          self->cancellable,
+                                          NULL);
+  /* unreadable directories are simply left out */
+  if (enumerator == NULL)
+    return;
+
+  prefix = g_file_get_relative_path (self->root, directory);
+
+  for (;;)
+    {
+      GFileInfo *info;
+      GFile *child;
+      const char *name;
+
+      if (!g_file_enumerator_iterate (enumerator, &info, &child, self->cancellable, NULL) ||
+          info == NULL)
+        break;
+      if (g_file_info_get_is_hidden (info))
+        continue;
+
+      name = g_file_info_get_name (info);
+      switch (g_file_info_get_file_type (info))
+        {
+        case G_FILE_TYPE_DIRECTORY:
+          g_ptr_array_add (directories, g_object_ref (child));
+          break;
+
+        case G_FILE_TYPE_REGULAR:
+          g_ptr_array_add (paths,
+                           prefix != NULL ? g_build_filename (prefix, name, NULL) : g_strdup (name));
+          if (paths->len == BATCH_SIZE)
+            insert_paths (self, paths);
+          break;
+
+        default:
+          break;
+        }
+    }
+  insert_paths (self, paths);
+
+  for (guint i = 0; i < directories->len; i++)
+    queue_directory (self, g_ptr_array_index (directories, i));
+
+  if (g_atomic_int_add (&self->n_monitors, 1) < MAX_MONITORS)
+    add_monitor_later (self, directory);
+}
+
+/**********************************/
+/* Crawling 👆️                    */
+/**********************************/
+
+static void
+add_file (TextyPathIndex *self,
+          GFile *file)
+{
+  g_autoptr (GFileInfo) info = NULL;
+  g_autofree char *path = NULL;
+
+  path = g_file_get_relative_path (self->root, file);
+  if (path == NULL)
+    return;
+
+  /* one stat, and only when something changed on disk */
+  info = g_file_query_info (file, ATTRIBUTES, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+  if (info == NULL || g_file_info_get_is_hidden (info))
+    return;
+
+  switch (g_file_info_get_file_type (info))
+    {
+    case G_FILE_TYPE_DIRECTORY:
+      queue_directory (self, file);
+      break;
+
+    case G_FILE_TYPE_REGULAR:
+      g_mutex_lock (&self->mutex);
+      insert_locked (self, path);
+      g_mutex_unlock (&self->mutex);
+      queue_changed (self);
+      break;
+
+    default:
+      break;
+    }
+}
+
+static void
+remove_file (TextyPathIndex *self,
+             GFile *file)
+{
+  g_autofree char *path = g_file_get_relative_path (self->root, file);
+
+  if (path == NULL)
+    return;
+
+  g_mutex_lock (&self->mutex);
+  remove_locked (self, path);
+  g_mutex_unlock (&self->mutex);
+  queue_changed (self);
+}
+
+static void
+on_monitor_changed (GFileMonitor *monitor,
+                    GFile *file,
+                    GFile *other_file,
+                    GFileMonitorEvent event,
+                    TextyPathIndex *self)
+{
+  switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+      add_file (self, file);
+      break;
+
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+      remove_file (self, file);
+      break;
+
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      remove_file (self, file);
+      add_file (self, other_file);
+      break;
+
+    default:
+      break;
+    }
+}
+
+typedef struct
+{
+  TextyPathIndex *self;
+  GFile *directory;
+} MonitorData;
+
+static void
+monitor_data_free (MonitorData *data)
+{
+  g_object_unref (data->self);
+  g_object_unref (data->directory);
+  g_free (data);
+}
+
+static gboolean
+add_monitor (gpointer user_data)
+{
+  MonitorData *data = user_data;
+  TextyPathIndex *self = data->self;
+  GFileMonitor *monitor;
+
+  if (g_cancellable_is_cancelled (self->cancellable))
+    return G_SOURCE_REMOVE;
+
+  monitor = g_file_monitor_directory (data->directory, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+  if (monitor == NULL)
+    return G_SOURCE_REMOVE;
+
+  g_signal_connect (monitor, "changed", G_CALLBACK (on_monitor_changed), self);
+  g_ptr_array_add (self->monitors, monitor);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* monitors report to the thread they were made in, so make them on the main one */
+static void
+add_monitor_later (TextyPathIndex *self,
+                   GFile *directory)
+{
+  MonitorData *data = g_new0 (MonitorData, 1);
+
+  data->self = g_object_ref (self);
+  data->directory = g_object_ref (directory);
+  g_main_context_invoke_full (NULL,
+                              G_PRIORITY_DEFAULT_IDLE,
+                              add_monitor,
+                              data,
+                              (GDestroyNotify) monitor_data_free);
+}
+
+/**********************************/
+/* Monitoring 👆️                  */
+/**********************************/
+
+static void
+texty_path_index_dispose (GObject *object)
+{
+  TextyPathIndex *self = TEXTY_PATH_INDEX (object);
+
+  g_cancellable_cancel (self->cancellable);
+
+  if (self->crawlers != NULL)
+    {
+      g_mutex_lock (&self->mutex);
+      self->stopping = TRUE;
+      g_mutex_unlock (&self->mutex);
+      /* drops the directories still queued, waiting only for those being read */
+      g_thread_pool_free (g_steal_pointer (&self->crawlers), TRUE, TRUE);
+    }
+
+  if (self->monitors != NULL)
+    {
+      for (guint i = 0; i < self->monitors->len; i++)
+        {
+          GFileMonitor *monitor = g_ptr_array_index (self->monitors, i);
+
+          g_signal_handlers_disconnect_by_data (monitor, self);
+          g_file_monitor_cancel (monitor);
+        }
+      g_clear_pointer (&self->monitors, g_ptr_array_unref);
+    }
+
+  G_OBJECT_CLASS (texty_path_index_parent_class)->dispose (object);
+}
+
+static void
+texty_path_index_finalize (GObject *object)
+{
+  TextyPathIndex *self = TEXTY_PATH_INDEX (object);
+
+  g_clear_object (&self->root);
+  g_clear_object (&self->cancellable);
+  g_clear_pointer (&self->last_query, g_free);
+  g_clear_pointer (&self->last_matches, g_array_unref);
+  g_hash_table_unref (self->lookup);
+  g_array_unref (self->masks);
+  g_array_unref (self->entries);
+  g_string_chunk_free (self->strings);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (texty_path_index_parent_class)->finalize (object);
+}
+
+static void
+texty_path_index_class_init (TextyPathIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = texty_path_index_dispose;
+  object_class->finalize = texty_path_index_finalize;
+
+  /* emitted on the main thread, at most every CHANGED_INTERVAL */
+  signals[CHANGED] = g_signal_new ("changed",
+                                   G_TYPE_FROM_CLASS (klass),
+                                   G_SIGNAL_RUN_LAST,
+                                   0,
+                                   NULL, NULL,
+                                   NULL,
+                                   G_TYPE_NONE, 0);
+}
+
+static void
+texty_path_index_init (TextyPathIndex *self)
+{
+  g_mutex_init (&self->mutex);
+  self->cancellable = g_cancellable_new ();
+  self->monitors = g_ptr_array_new_with_free_func (g_object_unref);
+  self->strings = g_string_chunk_new (64 * 1024);
+  self->entries = g_array_new (FALSE, FALSE, sizeof (Entry));
+  self->masks = g_array_new (FALSE, FALSE, sizeof (guint64));
+  self->lookup = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+/*
+ * Indexes the paths of the regular files under 'root', crawling it on a few
+ * worker threads and then following changes with file monitors. The index
+ * is usable, and searchable, while the crawl is still going.
+ */
+TextyPathIndex *
+texty_path_index_new (GFile *root)
+{
+  TextyPathIndex *self;
+
+  g_return_val_if_fail (G_IS_FILE (root), NULL);
+
+  self = g_object_new (TEXTY_TYPE_PATH_INDEX, NULL);
+  self->root = g_object_ref (root);
+  self->crawlers = g_thread_pool_new_full (crawl_directory,
+                                           self,
+                                           g_object_unref,
+                                           N_CRAWLERS,
+                                           FALSE,
+                                           NULL);
+  queue_directory (self, root);
+
+  return self;
+}
+
+GFile *
+texty_path_index_get_root (TextyPathIndex *self)
+{
+  g_return_val_if_fail (TEXTY_IS_PATH_INDEX (self), NULL);
+
+  return self->root;
+}
+
+/* the number of paths indexed so far, removed ones included */
+guint
+texty_path_index_get_n_paths (TextyPathIndex *self)
+{
+  guint n_paths;
+
+  g_return_val_if_fail (TEXTY_IS_PATH_INDEX (self), 0);
+
+  g_mutex_lock (&self->mutex);
+  n_paths = self->entries->len;
+  g_mutex_unlock (&self->mutex);
+
+  return n_paths;
+}
+
+
+/*
+ * Scores the slice's share of the candidates into its own heap. Once the
+ * heap is full, a path that could not get in even with a perfect score is
+ * passed over unscored; it still counts as a possible match for narrowing.
+ */
+static void
+scan_slice (Slice *slice)
+{
+  const Entry *entries = (const Entry *) slice->self->entries->data;
+  const guint64 *masks = (const guint64 *) slice->self->masks->data;
+  int best_possible = 0;
+
+  if (slice->query_len > 0)
+    best_possible = (int) slice->query_len * (SCORE_MATCH + SCORE_BOUNDARY + SCORE_CONSECUTIVE) -
+                    SCORE_CONSECUTIVE + SCORE_BASENAME;
+
+  for (guint k = slice->start; k < slice->end; k++)
+    {
+      guint i = slice->candidates != NULL ? slice->candidates[k] : k;
+      Match match;
+
+      if ((masks[i] & slice->mask) != slice->mask)
+        continue;
+
+      if (slice->n_heap == slice->size &&
+          (best_possible < slice->heap[0].score ||
+           (best_possible == slice->heap[0].score && entries[i].length >= slice->heap[0].length)))
+        {
+          if (slice->matches != NULL)
+            g_array_append_val (slice->matches, i);
+          continue;
+        }
+
+      if (!score_entry (&entries[i], slice->query, slice->query_len, &match.score))
+        continue;
+
+      if (slice->matches != NULL)
+        g_array_append_val (slice->matches, i);
+      match.length = entries[i].length;
+      match.index = i;
+      offer_match (slice->heap, &slice->n_heap, slice->size, &match);
+    }
+}
+
+static void
+scan_thread (gpointer data,
+             gpointer user_data)
+{
+  Slice *slice = data;
+
+  scan_slice (slice);
+
+  g_mutex_lock (&slice->scan->mutex);
+  if (--slice->scan->pending == 0)
+    g_cond_signal (&slice->scan->cond);
+  g_mutex_unlock (&slice->scan->mutex);
+}
+
+/* shared by every index, one thread short of the processors as the caller scans too */
+static GThreadPool *
+get_scanners (void)
+{
+  static GThreadPool *scanners;
+  static gsize initialized;
+
+  if (g_once_init_enter (&initialized))
+    {
+      scanners = g_thread_pool_new (scan_thread,
+                                    NULL,
+                                    MAX (g_get_num_processors () - 1, 1),
+                                    FALSE,
+                                    NULL);
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return scanners;
+}
+
+/*
+ * Returns up to 'max_results' paths, relative to the root, that contain the
+ * characters of 'query' in order, best first. Case and whitespace in the
+ * query are ignored.
+ *
+ * Most paths are turned away by their character mask alone. The rest are
+ * split between the processors, each keeping its own best results, which
+ * are merged at the end. When the query only adds to the previous one, just
+ * the previous matches and the paths indexed since are looked at, so this
+ * is cheap enough to run on every key press.
+ */
+char **
+texty_path_index_query (TextyPathIndex *self,
+                        const char *query,
+                        guint max_results)
+{
+  g_autoptr (GStrvBuilder) builder = g_strv_builder_new ();
+  g_autoptr (GString) folded = g_string_new (NULL);
+  g_autoptr (GArray) candidates = NULL;
+  g_autofree Match *heap = NULL;
+  g_autofree Slice *slices = NULL;
+  Scan scan;
+  guint n_candidates;
+  guint n_slices;
+  guint n_heap = 0;
+  guint64 mask;
+
+  g_return_val_if_fail (TEXTY_IS_PATH_INDEX (self), NULL);
+  g_return_val_if_fail (query != NULL, NULL);
+
+  if (max_results == 0)
+    return g_strv_builder_end (builder);
+
+  for (; *query != '\0'; query++)
+    if (!g_ascii_isspace (*query))
+      g_string_append_c (folded, *query);
+  mask = fold (folded->str) | PRESENT_BIT;
+
+  g_mutex_lock (&self->mutex);
+
+  if (folded->len > 0 &&
+      self->last_query != NULL &&
+      self->last_generation == self->generation &&
+      g_str_has_prefix (folded->str, self->last_query))
+    {
+      candidates = g_steal_pointer (&self->last_matches);
+      for (guint i = self->last_n_entries; i < self->entries->len; i++)
+        g_array_append_val (candidates, i);
+      n_candidates = candidates->len;
+    }
+  else
+    {
+      n_candidates = self->entries->len;
+    }
+
+  n_slices = CLAMP (n_candidates / MIN_SLICE, 1, g_get_num_processors ());
+  slices = g_new0 (Slice, n_slices);
+  for (guint s = 0; s < n_slices; s++)
+    {
+      slices[s].self = self;
+      slices[s].scan = &scan;
+      slices[s].query = folded->str;
+      slices[s].query_len = folded->len;
+      slices[s].mask = mask;
+      slices[s].candidates = candidates != NULL ? (const guint *) candidates->data : NULL;
+      slices[s].start = (guint64) n_candidates * s / n_slices;
+      slices[s].end = (guint64) n_candidates * (s + 1) / n_slices;
+      slices[s].heap = g_new (Match, max_results);
+      slices[s].size = max_results;
+      /* an empty query matches everything, which is not worth keeping */
+      if (folded->len > 0)
+        slices[s].matches = g_array_new (FALSE, FALSE, sizeof (guint));
+    }
+
+  g_mutex_init (&scan.mutex);
+  g_cond_init (&scan.cond);
+  scan.pending = n_slices - 1;
+  for (guint s = 1; s < n_slices; s++)
+    g_thread_pool_push (get_scanners (), &slices[s], NULL);
+  scan_slice (&slices[0]);
+  g_mutex_lock (&scan.mutex);
+  while (scan.pending > 0)
+    g_cond_wait (&scan.cond, &scan.mutex);
+  g_mutex_unlock (&scan.mutex);
+  g_cond_clear (&scan.cond);
+  g_mutex_clear (&scan.mutex);
+
+  /* merge the slices, in order, so the matches stay sorted for narrowing */
+  g_clear_pointer (&self->last_query, g_free);
+  g_clear_pointer (&self->last_matches, g_array_unref);
+  if (folded->len > 0)
+    {
+      self->last_query = g_strdup (folded->str);
+      self->last_matches = g_array_sized_new (FALSE, FALSE, sizeof (guint), n_candidates);
+      self->last_n_entries = self->entries->len;
+      self->last_generation = self->generation;
+    }
+
+  heap = g_new (Match, max_results);
+  for (guint s = 0; s < n_slices; s++)
+    {
+      for (guint i = 0; i < slices[s].n_heap; i++)
+        offer_match (heap, &n_heap, max_results, &slices[s].heap[i]);
+      if (slices[s].matches != NULL)
+        {
+          g_array_append_vals (self->last_matches, slices[s].matches->data, slices[s].matches->len);
+          g_array_unref (slices[s].matches);
+        }
+      g_free (slices[s].heap);
+    }
+
+  qsort (heap, n_heap, sizeof (Match), compare_matches);
+  for (guint i = 0; i < n_heap; i++)
+    g_strv_builder_add (builder, g_array_index (self->entries, Entry, heap[i].index).path);
+
+  g_mutex_unlock (&self->mutex);
+
+  return g_strv_builder_end (builder);
+}
@@ -0,0 +1,38 @@
+/* texty-path-index.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define TEXTY_TYPE_PATH_INDEX (texty_path_index_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyPathIndex, texty_path_index, TEXTY, PATH_INDEX, GObject)
+
+TextyPathIndex  *texty_path_index_new         (GFile          *root);
+GFile           *texty_path_index_get_root    (TextyPathIndex *self);
+guint            texty_path_index_get_n_paths (TextyPathIndex *self);
+char           **texty_path_index_query       (TextyPathIndex *self,
+                                               const char     *query,
+                                               guint           max_results);
+
+G_END_DECLS
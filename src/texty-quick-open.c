@@ -0,0 +1,309 @@
+/* texty-quick-open.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-quick-open.h"
+
+#include <string.h>
+
+/* more than fit on screen, few enough to list instantly */
+#define MAX_RESULTS 100
+
+struct _TextyQuickOpen
+{
+  AdwDialog parent_instance;
+
+  /* Template widgets */
+  GtkSearchEntry *search_entry;
+  GtkStack *stack;
+  GtkListView *list_view;
+  GtkLabel *status_label;
+
+  TextyPathIndex *index;
+  GtkStringList *results;
+  GtkSingleSelection *selection;
+};
+
+G_DEFINE_FINAL_TYPE (TextyQuickOpen, texty_quick_open, ADW_TYPE_DIALOG)
+
+enum
+{
+  FILE_ACTIVATED,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+static void
+setup_row (GtkSignalListItemFactory *factory,
+           GtkListItem *item,
+           gpointer user_data)
+{
+  GtkWidget *box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 12);
+  GtkWidget *name = gtk_label_new (NULL);
+  GtkWidget *folder = gtk_label_new (NULL);
+
+  gtk_label_set_xalign (GTK_LABEL (folder), 1);
+  gtk_label_set_ellipsize (GTK_LABEL (folder), PANGO_ELLIPSIZE_START);
+  gtk_widget_set_hexpand (folder, TRUE);
+  gtk_widget_add_css_class (folder, "dim-label");
+  gtk_box_append (GTK_BOX (box), name);
+  gtk_box_append (GTK_BOX (box), folder);
+  gtk_list_item_set_child (item, box);
+}
+
+static void
+bind_row (GtkSignalListItemFactory *factory,
+          GtkListItem *item,
+          gpointer user_data)
+{
+  GtkWidget *box = gtk_list_item_get_child (item);
+  GtkWidget *name = gtk_widget_get_first_child (box);
+  GtkWidget *folder = gtk_widget_get_last_child (box);
+  const char *path = gtk_string_object_get_string (gtk_list_item_get_item (item));
+  const char *slash = strrchr (path, '/');
+  g_autofree char *directory = NULL;
+
+  if (slash != NULL)
+    directory = g_strndup (path, slash - path);
+
+  gtk_label_set_label (GTK_LABEL (name), slash != NULL ? slash + 1 : path);
+  gtk_label_set_label (GTK_LABEL (folder), directory);
+}
+
+/*
+ * Lists the best matches for the search text and selects the best of them,
+ * which is the one Enter opens, or with 'keep_selection' the path that was
+ * selected, if it is still listed.
+ */
+static void
+update_results (TextyQuickOpen *self,
+                gboolean keep_selection)
+{
+  g_auto (GStrv) paths = NULL;
+  g_autofree char *selected = NULL;
+  g_autofree char *status = NULL;
+  GtkStringObject *item;
+  guint n_paths;
+  guint position = 0;
+
+  item = gtk_single_selection_get_selected_item (self->selection);
+  if (keep_selection && item != NULL)
+    selected = g_strdup (gtk_string_object_get_string (item));
+
+  paths = texty_path_index_query (self->index,
+                                  gtk_editable_get_text (GTK_EDITABLE (self->search_entry)),
+                                  MAX_RESULTS);
+  gtk_string_list_splice (self->results,
+                          0,
+                          g_list_model_get_n_items (G_LIST_MODEL (self->results)),
+                          (const char *const *) paths);
+
+  if (selected != NULL)
+    {
+      for (guint i = 0; paths[i] != NULL; i++)
+        {
+          if (g_strcmp0 (paths[i], selected) == 0)
+            {
+              position = i;
+              break;
+            }
+        }
+    }
+
+  if (paths[0] != NULL)
+    {
+      gtk_single_selection_set_selected (self->selection, position);
+      gtk_list_view_scroll_to (self->list_view, position, GTK_LIST_SCROLL_NONE, NULL);
+    }
+  gtk_stack_set_visible_child_name (self->stack, paths[0] != NULL ? "results" : "empty");
+
+  n_paths = texty_path_index_get_n_paths (self->index);
+  status = g_strdup_printf (n_paths == 1 ? "%u file" : "%u files", n_paths);
+  gtk_label_set_label (self->status_label, status);
+}
+
+static void
+on_search_changed (GtkSearchEntry *entry,
+                   TextyQuickOpen *self)
+{
+  update_results (self, FALSE);
+}
+
+/* the index grows while the first crawl is going */
+static void
+on_index_changed (TextyPathIndex *index,
+                  TextyQuickOpen *self)
+{
+  update_results (self, TRUE);
+}
+
+static void
+activate_position (TextyQuickOpen *self,
+                   guint position)
+{
+  g_autoptr (GtkStringObject) item = NULL;
+  g_autoptr (GFile) file = NULL;
+
+  item = g_list_model_get_item (G_LIST_MODEL (self->results), position);
+  if (item == NULL)
+    return;
+
+  file = g_file_resolve_relative_path (texty_path_index_get_root (self->index),
+                                       gtk_string_object_get_string (item));
+  g_signal_emit (self, signals[FILE_ACTIVATED], 0, file);
+  adw_dialog_close (ADW_DIALOG (self));
+}
+
+static void
+on_entry_activate (GtkSearchEntry *entry,
+                   TextyQuickOpen *self)
+{
+  activate_position (self, gtk_single_selection_get_selected (self->selection));
+}
+
+static void
+on_list_activate (GtkListView *list_view,
+                  guint position,
+                  TextyQuickOpen *self)
+{
+  activate_position (self, position);
+}
+
+/* the arrow keys walk the results while typing goes on in the entry */
+static gboolean
+on_key_pressed (GtkEventControllerKey *controller,
+                guint keyval,
+                guint keycode,
+                GdkModifierType state,
+                TextyQuickOpen *self)
+{
+  guint n_items = g_list_model_get_n_items (G_LIST_MODEL (self->results));
+  guint position = gtk_single_selection_get_selected (self->selection);
+
+  if (n_items == 0 || position == GTK_INVALID_LIST_POSITION)
+    return GDK_EVENT_PROPAGATE;
+
+  switch (keyval)
+    {
+    case GDK_KEY_Down:
+    case GDK_KEY_KP_Down:
+      position = MIN (position + 1, n_items - 1);
+      break;
+
+    case GDK_KEY_Up:
+    case GDK_KEY_KP_Up:
+      position = position > 0 ? position - 1 : 0;
+      break;
+
+    default:
+      return GDK_EVENT_PROPAGATE;
+    }
+
+  gtk_single_selection_set_selected (self->selection, position);
+  gtk_list_view_scroll_to (self->list_view, position, GTK_LIST_SCROLL_NONE, NULL);
+
+  return GDK_EVENT_STOP;
+}
+
+static void
+texty_quick_open_dispose (GObject *object)
+{
+  TextyQuickOpen *self = TEXTY_QUICK_OPEN (object);
+
+  if (self->index != NULL)
+    g_signal_handlers_disconnect_by_data (self->index, self);
+  g_clear_object (&self->index);
+  g_clear_object (&self->selection);
+  g_clear_object (&self->results);
+
+  G_OBJECT_CLASS (texty_quick_open_parent_class)->dispose (object);
+}
+
+static void
+texty_quick_open_class_init (TextyQuickOpenClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->dispose = texty_quick_open_dispose;
+
+  signals[FILE_ACTIVATED] = g_signal_new ("file-activated",
+                                          G_TYPE_FROM_CLASS (klass),
+                                          G_SIGNAL_RUN_LAST,
+                                          0,
+                                          NULL, NULL,
+                                          NULL,
+                                          G_TYPE_NONE, 1,
+                                          G_TYPE_FILE);
+
+  gtk_widget_class_set_template_from_resource (widget_class,
+                                               "/ca/footeware/c/texty/texty-quick-open.ui");
+  gtk_widget_class_bind_template_child (widget_class, TextyQuickOpen, search_entry);
+  gtk_widget_class_bind_template_child (widget_class, TextyQuickOpen, stack);
+  gtk_widget_class_bind_template_child (widget_class, TextyQuickOpen, list_view);
+  gtk_widget_class_bind_template_child (widget_class, TextyQuickOpen, status_label);
+}
+
+static void
+texty_quick_open_init (TextyQuickOpen *self)
+{
+  g_autoptr (GtkListItemFactory) factory = gtk_signal_list_item_factory_new ();
+  GtkEventController *controller;
+
+  gtk_widget_init_template (GTK_WIDGET (self));
+
+  self->results = gtk_string_list_new (NULL);
+  self->selection = gtk_single_selection_new (g_object_ref (G_LIST_MODEL (self->results)));
+  gtk_list_view_set_model (self->list_view, GTK_SELECTION_MODEL (self->selection));
+
+  g_signal_connect (factory, "setup", G_CALLBACK (setup_row), NULL);
+  g_signal_connect (factory, "bind", G_CALLBACK (bind_row), NULL);
+  gtk_list_view_set_factory (self->list_view, factory);
+
+  g_signal_connect (self->search_entry, "search-changed", G_CALLBACK (on_search_changed), self);
+  g_signal_connect (self->search_entry, "activate", G_CALLBACK (on_entry_activate), self);
+  g_signal_connect (self->list_view, "activate", G_CALLBACK (on_list_activate), self);
+
+  controller = gtk_event_controller_key_new ();
+  gtk_event_controller_set_propagation_phase (controller, GTK_PHASE_CAPTURE);
+  g_signal_connect (controller, "key-pressed", G_CALLBACK (on_key_pressed), self);
+  gtk_widget_add_controller (GTK_WIDGET (self->search_entry), controller);
+}
+
+/*
+ * A search over the paths in 'index', opening the chosen one through the
+ * "file-activated" signal. The results follow the index as it grows, so
+ * the dialog is useful while the first crawl is still going.
+ */
+AdwDialog *
+texty_quick_open_new (TextyPathIndex *index)
+{
+  TextyQuickOpen *self;
+
+  g_return_val_if_fail (TEXTY_IS_PATH_INDEX (index), NULL);
+
+  self = g_object_new (TEXTY_TYPE_QUICK_OPEN, NULL);
+  self->index = g_object_ref (index);
+  g_signal_connect (index, "changed", G_CALLBACK (on_index_changed), self);
+  update_results (self, FALSE);
+
+  return ADW_DIALOG (self);
+}
@@ -0,0 +1,35 @@
+/* texty-quick-open.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <adwaita.h>
+
+#include "texty-path-index.h"
+
+G_BEGIN_DECLS
+
+#define TEXTY_TYPE_QUICK_OPEN (texty_quick_open_get_type())
+
+G_DECLARE_FINAL_TYPE (TextyQuickOpen, texty_quick_open, TEXTY, QUICK_OPEN, AdwDialog)
+
+AdwDialog *texty_quick_open_new (TextyPathIndex *index);
+
+G_END_DECLS
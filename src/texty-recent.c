@@ -0,0 +1,104 @@
+/* texty-recent.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-recent.h"
+
+#include "texty-application.h"
+#include "texty-file-loader.h"
+
+/* the files most likely to be opened next, read ahead of being asked for */
+#define N_PREFETCH 3
+/* of a large log, the start is what gets shown first */
+#define MAX_PREFETCH_LENGTH (256 * 1024 * 1024)
+
+static int
+compare_modified (gconstpointer a,
+                  gconstpointer b)
+{
+  return -g_date_time_compare (gtk_recent_info_get_modified ((GtkRecentInfo *) a),
+                               gtk_recent_info_get_modified ((GtkRecentInfo *) b));
+}
+
+/*
+ * Returns up to 'max_files' of the files texty opened or saved, as GFiles,
+ * the latest first. Files since deleted are left out.
+ */
+GList *
+texty_recent_get_files (guint max_files)
+{
+  GtkRecentManager *manager = gtk_recent_manager_get_default ();
+  const char *application = g_get_application_name ();
+  GList *items;
+  GList *files = NULL;
+  guint n_files = 0;
+
+  items = g_list_sort (gtk_recent_manager_get_items (manager), compare_modified);
+  for (GList *l = items; l != NULL && n_files < max_files; l = l->next)
+    {
+      GtkRecentInfo *info = l->data;
+
+      if (!gtk_recent_info_has_application (info, application)
+          || !gtk_recent_info_is_local (info)
+          || !gtk_recent_info_exists (info))
+        continue;
+
+      files = g_list_prepend (files, g_file_new_for_uri (gtk_recent_info_get_uri (info)));
+      n_files++;
+    }
+  g_list_free_full (items, (GDestroyNotify) gtk_recent_info_unref);
+
+  return g_list_reverse (files);
+}
+
+void
+texty_recent_add (GFile *file)
+{
+  g_autofree char *uri = NULL;
+
+  g_return_if_fail (G_IS_FILE (file));
+
+  uri = g_file_get_uri (file);
+  gtk_recent_manager_add_item (gtk_recent_manager_get_default (), uri);
+}
+
+/*
+ * Has the latest files that aren't open already read into the page cache,
+ * so opening one of them after a cold start doesn't wait on the disk.
+ */
+void
+texty_recent_prefetch (void)
+{
+  TextyApplication *app = TEXTY_APPLICATION (g_application_get_default ());
+  GList *files;
+  guint n_prefetched = 0;
+
+  /* a few extra, in case some of the latest are open */
+  files = texty_recent_get_files (N_PREFETCH * 2);
+  for (GList *l = files; l != NULL && n_prefetched < N_PREFETCH; l = l->next)
+    {
+      if (texty_application_lookup_document (app, l->data) != NULL)
+        continue;
+
+      texty_file_prefetch (l->data, MAX_PREFETCH_LENGTH);
+      n_prefetched++;
+    }
+  g_list_free_full (files, g_object_unref);
+}
@@ -0,0 +1,313 @@
+/* texty-sidebar.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-sidebar.h"
+
+#define ATTRIBUTES                          \
+  G_FILE_ATTRIBUTE_STANDARD_TYPE ","        \
+  G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+  G_FILE_ATTRIBUTE_STANDARD_SYMBOLIC_ICON "," \
+  G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN
+
+struct _TextySidebar
+{
+  AdwBin parent_instance;
+
+  /* Template widgets */
+  GtkLabel *root_label;
+  GtkListView *list_view;
+
+  GFile *root;
+  GtkTreeListModel *tree;
+  /* shared by the models of every directory */
+  GtkFilter *filter;
+  GtkSorter *sorter;
+};
+
+G_DEFINE_FINAL_TYPE (TextySidebar, texty_sidebar, ADW_TYPE_BIN)
+
+enum
+{
+  FILE_ACTIVATED,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+static gboolean
+is_directory (GFileInfo *info)
+{
+  return g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY;
+}
+
+/* the closure marshaller takes ownership of the returned string */
+static char *
+get_display_name (GFileInfo *info)
+{
+  return g_strdup (g_file_info_get_display_name (info));
+}
+
+static gboolean
+is_shown (gpointer item,
+          gpointer user_data)
+{
+  return !g_file_info_get_is_hidden (G_FILE_INFO (item));
+}
+
+/*
+ * The entries of 'directory', enumerated in batches on a low priority and
+ * kept up to date by a file monitor, then filtered and sorted a slice at a
+ * time so that huge directories never block a frame.
+ */
+static GListModel *
+create_directory_model (TextySidebar *self,
+                        GFile *directory)
+{
+  GtkDirectoryList *list;
+  GtkFilterListModel *filtered;
+  GtkSortListModel *sorted;
+
+  list = gtk_directory_list_new (ATTRIBUTES, directory);
+  gtk_directory_list_set_io_priority (list, G_PRIORITY_LOW);
+  gtk_directory_list_set_monitored (list, TRUE);
+
+  filtered = gtk_filter_list_model_new (G_LIST_MODEL (list), g_object_ref (self->filter));
+  gtk_filter_list_model_set_incremental (filtered, TRUE);
+
+  sorted = gtk_sort_list_model_new (G_LIST_MODEL (filtered), g_object_ref (self->sorter));
+  gtk_sort_list_model_set_incremental (sorted, TRUE);
+
+  return G_LIST_MODEL (sorted);
+}
+
+/* directories are only enumerated once they are expanded */
+static GListModel *
+create_child_model (gpointer item,
+                    gpointer user_data)
+{
+  TextySidebar *self = user_data;
+  GFileInfo *info = item;
+  GFile *file;
+
+  if (!is_directory (info))
+    return NULL;
+
+  file = G_FILE (g_file_info_get_attribute_object (info, "standard::file"));
+  return create_directory_model (self, file);
+}
+
+/**********************************/
+/* Models 👆️                      */
+/**********************************/
+
+static void
+setup_row (GtkSignalListItemFactory *factory,
+           GtkListItem *item,
+           gpointer user_data)
+{
+  GtkWidget *expander = gtk_tree_expander_new ();
+  GtkWidget *box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+  GtkWidget *label = gtk_label_new (NULL);
+
+  gtk_label_set_xalign (GTK_LABEL (label), 0);
+  gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_MIDDLE);
+  gtk_box_append (GTK_BOX (box), gtk_image_new ());
+  gtk_box_append (GTK_BOX (box), label);
+  gtk_tree_expander_set_child (GTK_TREE_EXPANDER (expander), box);
+
+  gtk_list_item_set_child (item, expander);
+}
+
+static void
+bind_row (GtkSignalListItemFactory *factory,
+          GtkListItem *item,
+          gpointer user_data)
+{
+  GtkTreeListRow *row = gtk_list_item_get_item (item);
+  GtkWidget *expander = gtk_list_item_get_child (item);
+  GtkWidget *box = gtk_tree_expander_get_child (GTK_TREE_EXPANDER (expander));
+  GtkWidget *image = gtk_widget_get_first_child (box);
+  GtkWidget *label = gtk_widget_get_last_child (box);
+  g_autoptr (GFileInfo) info = gtk_tree_list_row_get_item (row);
+
+  gtk_tree_expander_set_list_row (GTK_TREE_EXPANDER (expander), row);
+  gtk_image_set_from_gicon (GTK_IMAGE (image), g_file_info_get_symbolic_icon (info));
+  gtk_label_set_text (GTK_LABEL (label), g_file_info_get_display_name (info));
+}
+
+static void
+unbind_row (GtkSignalListItemFactory *factory,
+            GtkListItem *item,
+            gpointer user_data)
+{
+  gtk_tree_expander_set_list_row (GTK_TREE_EXPANDER (gtk_list_item_get_child (item)), NULL);
+}
+
+static void
+on_activate (GtkListView *list_view,
+             guint position,
+             TextySidebar *self)
+{
+  g_autoptr (GtkTreeListRow) row = NULL;
+  g_autoptr (GFileInfo) info = NULL;
+  GFile *file;
+
+  row = g_list_model_get_item (G_LIST_MODEL (self->tree), position);
+  if (row == NULL)
+    return;
+
+  if (gtk_tree_list_row_is_expandable (row))
+    {
+      gtk_tree_list_row_set_expanded (row, !gtk_tree_list_row_get_expanded (row));
+      return;
+    }
+
+  info = gtk_tree_list_row_get_item (row);
+  file = G_FILE (g_file_info_get_attribute_object (info, "standard::file"));
+  g_signal_emit (self, signals[FILE_ACTIVATED], 0, file);
+}
+
+/**********************************/
+/* Rows 👆️                        */
+/**********************************/
+
+static void
+texty_sidebar_dispose (GObject *object)
+{
+  TextySidebar *self = TEXTY_SIDEBAR (object);
+
+  gtk_list_view_set_model (self->list_view, NULL);
+  g_clear_object (&self->tree);
+  g_clear_object (&self->root);
+  g_clear_object (&self->filter);
+  g_clear_object (&self->sorter);
+
+  G_OBJECT_CLASS (texty_sidebar_parent_class)->dispose (object);
+}
+
+static void
+texty_sidebar_class_init (TextySidebarClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->dispose = texty_sidebar_dispose;
+
+  /* emitted with the GFile of a file row that was activated */
+  signals[FILE_ACTIVATED] = g_signal_new ("file-activated",
+                                          G_TYPE_FROM_CLASS (klass),
+                                          G_SIGNAL_RUN_LAST,
+                                          0,
+                                          NULL, NULL,
+                                          NULL,
+                                          G_TYPE_NONE, 1,
+                                          G_TYPE_FILE);
+
+  gtk_widget_class_set_template_from_resource (widget_class,
+                                               "/ca/footeware/c/texty/texty-sidebar.ui");
+  gtk_widget_class_bind_template_child (widget_class, TextySidebar, root_label);
+  gtk_widget_class_bind_template_child (widget_class, TextySidebar, list_view);
+}
+
+static void
+texty_sidebar_init (TextySidebar *self)
+{
+  g_autoptr (GtkListItemFactory) factory = NULL;
+  GtkExpression *expression;
+  GtkSorter *directories_first;
+  GtkSorter *by_name;
+
+  gtk_widget_init_template (GTK_WIDGET (self));
+
+  self->filter = GTK_FILTER (gtk_custom_filter_new (is_shown, NULL, NULL));
+
+  /* directories first, then by name as a file manager would order them */
+  expression = gtk_cclosure_expression_new (G_TYPE_BOOLEAN, NULL, 0, NULL,
+                                            G_CALLBACK (is_directory), NULL, NULL);
+  directories_first = GTK_SORTER (gtk_numeric_sorter_new (expression));
+  gtk_numeric_sorter_set_sort_order (GTK_NUMERIC_SORTER (directories_first), GTK_SORT_DESCENDING);
+  expression = gtk_cclosure_expression_new (G_TYPE_STRING, NULL, 0, NULL,
+                                            G_CALLBACK (get_display_name), NULL, NULL);
+  by_name = GTK_SORTER (gtk_string_sorter_new (expression));
+  gtk_string_sorter_set_collation (GTK_STRING_SORTER (by_name), GTK_COLLATION_FILENAME);
+  self->sorter = GTK_SORTER (gtk_multi_sorter_new ());
+  gtk_multi_sorter_append (GTK_MULTI_SORTER (self->sorter), directories_first);
+  gtk_multi_sorter_append (GTK_MULTI_SORTER (self->sorter), by_name);
+
+  factory = gtk_signal_list_item_factory_new ();
+  g_signal_connect (factory, "setup", G_CALLBACK (setup_row), NULL);
+  g_signal_connect (factory, "bind", G_CALLBACK (bind_row), NULL);
+  g_signal_connect (factory, "unbind", G_CALLBACK (unbind_row), NULL);
+  gtk_list_view_set_factory (self->list_view, factory);
+
+  g_signal_connect (self->list_view, "activate", G_CALLBACK (on_activate), self);
+}
+
+/*
+ * A tree of the files under a root folder, for opening them without a
+ * dialog. Only expanded directories are read, so large trees cost nothing
+ * until they are browsed.
+ */
+GtkWidget *
+texty_sidebar_new (void)
+{
+  return g_object_new (TEXTY_TYPE_SIDEBAR, NULL);
+}
+
+GFile *
+texty_sidebar_get_root (TextySidebar *self)
+{
+  g_return_val_if_fail (TEXTY_IS_SIDEBAR (self), NULL);
+
+  return self->root;
+}
+
+void
+texty_sidebar_set_root (TextySidebar *self,
+                        GFile *root)
+{
+  g_autoptr (GtkSingleSelection) selection = NULL;
+  g_autofree char *name = NULL;
+
+  g_return_if_fail (TEXTY_IS_SIDEBAR (self));
+  g_return_if_fail (G_IS_FILE (root));
+
+  if (self->root != NULL && g_file_equal (self->root, root))
+    return;
+  g_set_object (&self->root, root);
+
+  g_clear_object (&self->tree);
+  self->tree = gtk_tree_list_model_new (create_directory_model (self, root),
+                                        FALSE,
+                                        FALSE,
+                                        create_child_model,
+                                        self,
+                                        NULL);
+
+  selection = gtk_single_selection_new (G_LIST_MODEL (g_object_ref (self->tree)));
+  gtk_single_selection_set_autoselect (selection, FALSE);
+  gtk_single_selection_set_can_unselect (selection, TRUE);
+  gtk_list_view_set_model (self->list_view, GTK_SELECTION_MODEL (selection));
+
+  name = g_file_get_basename (root);
+  gtk_label_set_text (self->root_label, name);
+  gtk_widget_set_tooltip_text (GTK_WIDGET (self->root_label), g_file_peek_path (root));
+}
@@ -0,0 +1,459 @@
+/* texty-spell-checker.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-spell-checker.h"
+
+#include <string.h>
+
+#ifdef HAVE_ENCHANT
+#include <enchant.h>
+#endif
+
+#define CHECK_BUDGET_USEC 2000
+/* lines checked past the top and bottom of the view, for smooth scrolling */
+#define MARGIN_LINES 40
+/* longer lines are data rather than prose */
+#define MAX_LINE_CHARS 10000
+#define MAX_WORD 64
+/* the verdicts are dropped all at once past this many words */
+#define MAX_VERDICTS 100000
+
+#define VERDICT_CORRECT GINT_TO_POINTER (1)
+#define VERDICT_MISSPELLED GINT_TO_POINTER (2)
+
+struct _TextySpellChecker
+{
+  GObject parent_instance;
+
+  GtkTextView *view;
+  GtkTextBuffer *buffer;
+  GtkAdjustment *vadjustment;
+  /* both belong to the buffer's tag table, shared by every view of it */
+  GtkTextTag *misspelled_tag;
+  GtkTextTag *checked_tag;
+
+  gboolean enabled;
+  guint check_id;
+};
+
+G_DEFINE_FINAL_TYPE (TextySpellChecker, texty_spell_checker, G_TYPE_OBJECT)
+
+/* word -> VERDICT_*, shared by every view and only used from the main thread */
+static GHashTable *verdicts;
+
+#ifdef HAVE_ENCHANT
+
+/* the first of the user's languages that has a dictionary */
+static EnchantDict *
+request_dictionary (EnchantBroker *broker)
+{
+  const char * const *languages = g_get_language_names ();
+
+  for (guint i = 0; languages[i] != NULL; i++)
+    {
+      g_autofree char *tag = NULL;
+      char *suffix;
+
+      if (g_str_equal (languages[i], "C") || g_str_equal (languages[i], "POSIX"))
+        continue;
+
+      /* en_CA.UTF-8@euro is looked up as en_CA */
+      tag = g_strdup (languages[i]);
+      suffix = strpbrk (tag, ".@");
+      if (suffix != NULL)
+        *suffix = '\0';
+      if (enchant_broker_dict_exists (broker, tag))
+        return enchant_broker_request_dict (broker, tag);
+    }
+
+  if (enchant_broker_dict_exists (broker, "en_US"))
+    return enchant_broker_request_dict (broker, "en_US");
+
+  return NULL;
+}
+
+static EnchantDict *
+get_dictionary (void)
+{
+  static EnchantDict *dictionary;
+  static gsize initialized;
+
+  if (g_once_init_enter (&initialized))
+    {
+      /* kept for the lifetime of the process */
+      dictionary = request_dictionary (enchant_broker_init ());
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return dictionary;
+}
+
+#endif
+
+/* whether 'word' is spelled right, asking the dictionary only once per word */
+static gboolean
+check_word (const char *word)
+{
+  gpointer verdict;
+
+  if (verdicts == NULL)
+    verdicts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  verdict = g_hash_table_lookup (verdicts, word);
+  if (verdict == NULL)
+    {
+#ifdef HAVE_ENCHANT
+      verdict = enchant_dict_check (get_dictionary (), word, -1) == 0 ? VERDICT_CORRECT : VERDICT_MISSPELLED;
+#else
+      verdict = VERDICT_CORRECT;
+#endif
+      if (g_hash_table_size (verdicts) >= MAX_VERDICTS)
+        g_hash_table_remove_all (verdicts);
+      g_hash_table_insert (verdicts, g_strdup (word), verdict);
+    }
+
+  return verdict == VERDICT_CORRECT;
+}
+
+/*
+ * Drops the cached verdicts, the dictionary is asked again as words come
+ * into view. Returns about how many bytes that released.
+ */
+gsize
+texty_spell_checker_forget_verdicts (void)
+{
+  GHashTableIter iter;
+  gpointer word;
+  gsize forgotten = 0;
+
+  if (verdicts == NULL)
+    return 0;
+
+  g_hash_table_iter_init (&iter, verdicts);
+  while (g_hash_table_iter_next (&iter, &word, NULL))
+    forgotten += strlen (word) + 1 + 3 * sizeof (gpointer);
+  g_hash_table_remove_all (verdicts);
+
+  return forgotten;
+}
+
+gboolean
+texty_spell_checker_is_available (void)
+{
+#ifdef HAVE_ENCHANT
+  return get_dictionary () != NULL;
+#else
+  return FALSE;
+#endif
+}
+
+/* identifiers, numbers and the like are left alone */
+static gboolean
+is_checkable (const char *word)
+{
+  gsize length = 0;
+
+  for (const char *p = word; *p != '\0'; p = g_utf8_next_char (p))
+    {
+      gunichar c = g_utf8_get_char (p);
+
+      if (c == '_' || g_unichar_isdigit (c))
+        return FALSE;
+      length++;
+    }
+
+  return length > 1;
+}
+
+static void
+check_line (TextySpellChecker *self,
+            const GtkTextIter *start,
+            const GtkTextIter *end)
+{
+  GtkTextIter word_end = *start;
+
+  gtk_text_buffer_remove_tag (self->buffer, self->misspelled_tag, start, end);
+
+  if (gtk_text_iter_get_chars_in_line (start) <= MAX_LINE_CHARS)
+    {
+      while (gtk_text_iter_forward_word_end (&word_end) && gtk_text_iter_compare (&word_end, end) <= 0)
+        {
+          GtkTextIter word_start = word_end;
+          g_autofree char *word = NULL;
+
+          gtk_text_iter_backward_word_start (&word_start);
+          word = gtk_text_iter_get_slice (&word_start, &word_end);
+          if (strlen (word) <= MAX_WORD && is_checkable (word) && !check_word (word))
+            gtk_text_buffer_apply_tag (self->buffer, self->misspelled_tag, &word_start, &word_end);
+        }
+    }
+
+  gtk_text_buffer_apply_tag (self->buffer, self->checked_tag, start, end);
+}
+
+/* whether the whole of the line was checked since it last changed */
+static gboolean
+is_checked (TextySpellChecker *self,
+            const GtkTextIter *start,
+            const GtkTextIter *end)
+{
+  GtkTextIter toggle = *start;
+
+  if (!gtk_text_iter_has_tag (start, self->checked_tag))
+    return FALSE;
+
+  gtk_text_iter_forward_to_tag_toggle (&toggle, self->checked_tag);
+  return gtk_text_iter_compare (&toggle, end) >= 0;
+}
+
+/*
+ * Checks the lines in and around the view that changed or were never
+ * checked, for a little while at a time. The rest of the document is left
+ * until it is scrolled to, so the size of the file does not matter.
+ */
+static gboolean
+check_step (gpointer user_data)
+{
+  TextySpellChecker *self = user_data;
+  gint64 deadline = g_get_monotonic_time () + CHECK_BUDGET_USEC;
+  GdkRectangle rect;
+  GtkTextIter line;
+  GtkTextIter end;
+
+  gtk_text_view_get_visible_rect (self->view, &rect);
+  gtk_text_view_get_line_at_y (self->view, &line, rect.y, NULL);
+  gtk_text_view_get_line_at_y (self->view, &end, rect.y + rect.height, NULL);
+  gtk_text_iter_backward_lines (&line, MARGIN_LINES);
+  gtk_text_iter_set_line_offset (&line, 0);
+  gtk_text_iter_forward_lines (&end, MARGIN_LINES + 1);
+
+  while (gtk_text_iter_compare (&line, &end) < 0)
+    {
+      GtkTextIter next = line;
+
+      gtk_text_iter_forward_line (&next);
+      if (!is_checked (self, &line, &next))
+        {
+          check_line (self, &line, &next);
+          if (g_get_monotonic_time () > deadline)
+            return G_SOURCE_CONTINUE;
+        }
+      line = next;
+    }
+
+  self->check_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
+static void
+queue_check (TextySpellChecker *self)
+{
+  if (self->enabled && self->buffer != NULL && self->check_id == 0)
+    self->check_id = g_idle_add_full (G_PRIORITY_LOW, check_step, self, NULL);
+}
+
+/* the lines an edit touched are checked again, nothing else is */
+static void
+uncheck_lines (TextySpellChecker *self,
+               GtkTextIter *start,
+               GtkTextIter *end)
+{
+  gtk_text_iter_set_line_offset (start, 0);
+  gtk_text_iter_forward_line (end);
+  gtk_text_buffer_remove_tag (self->buffer, self->checked_tag, start, end);
+  queue_check (self);
+}
+
+static void
+after_insert_text (GtkTextBuffer *buffer,
+                   GtkTextIter *location,
+                   char *text,
+                   int length,
+                   TextySpellChecker *self)
+{
+  GtkTextIter start = *location;
+  GtkTextIter end = *location;
+
+  gtk_text_iter_backward_chars (&start, g_utf8_strlen (text, length));
+  uncheck_lines (self, &start, &end);
+}
+
+static void
+after_delete_range (GtkTextBuffer *buffer,
+                    GtkTextIter *start,
+                    GtkTextIter *end,
+                    TextySpellChecker *self)
+{
+  GtkTextIter line_start = *start;
+  GtkTextIter line_end = *start;
+
+  uncheck_lines (self, &line_start, &line_end);
+}
+
+static GtkTextTag *
+get_tag (GtkTextBuffer *buffer,
+         const char *name)
+{
+  GtkTextTag *tag;
+
+  tag = gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (buffer), name);
+  if (tag == NULL)
+    tag = gtk_text_buffer_create_tag (buffer, name, NULL);
+
+  return tag;
+}
+
+/* forgets every verdict in the buffer, for when checking is turned off */
+static void
+clear_tags (TextySpellChecker *self)
+{
+  GtkTextIter start;
+  GtkTextIter end;
+
+  gtk_text_buffer_get_bounds (self->buffer, &start, &end);
+  gtk_text_buffer_remove_tag (self->buffer, self->misspelled_tag, &start, &end);
+  gtk_text_buffer_remove_tag (self->buffer, self->checked_tag, &start, &end);
+}
+
+static void
+set_buffer (TextySpellChecker *self,
+            GtkTextBuffer *buffer)
+{
+  if (self->buffer == buffer)
+    return;
+
+  if (self->buffer != NULL)
+    g_signal_handlers_disconnect_by_data (self->buffer, self);
+  g_clear_handle_id (&self->check_id, g_source_remove);
+  g_set_object (&self->buffer, buffer);
+  self->misspelled_tag = NULL;
+  self->checked_tag = NULL;
+  if (buffer == NULL)
+    return;
+
+  self->misspelled_tag = get_tag (buffer, "texty-misspelled");
+  g_object_set (self->misspelled_tag, "underline", PANGO_UNDERLINE_ERROR, NULL);
+  self->checked_tag = get_tag (buffer, "texty-spell-checked");
+
+  /* after the default handlers, so the iters point past the edit */
+  g_signal_connect_after (buffer, "insert-text", G_CALLBACK (after_insert_text), self);
+  g_signal_connect_after (buffer, "delete-range", G_CALLBACK (after_delete_range), self);
+  queue_check (self);
+}
+
+static void
+set_vadjustment (TextySpellChecker *self,
+                 GtkAdjustment *vadjustment)
+{
+  if (self->vadjustment == vadjustment)
+    return;
+
+  if (self->vadjustment != NULL)
+    g_signal_handlers_disconnect_by_data (self->vadjustment, self);
+  g_set_object (&self->vadjustment, vadjustment);
+  if (vadjustment != NULL)
+    {
+      g_signal_connect_swapped (vadjustment, "value-changed", G_CALLBACK (queue_check), self);
+      g_signal_connect_swapped (vadjustment, "changed", G_CALLBACK (queue_check), self);
+    }
+  queue_check (self);
+}
+
+static void
+on_view_notify (GtkTextView *view,
+                GParamSpec *pspec,
+                TextySpellChecker *self)
+{
+  set_buffer (self, gtk_text_view_get_buffer (view));
+  set_vadjustment (self, gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (view)));
+}
+
+static void
+texty_spell_checker_dispose (GObject *object)
+{
+  TextySpellChecker *self = TEXTY_SPELL_CHECKER (object);
+
+  if (self->view != NULL)
+    g_signal_handlers_disconnect_by_data (self->view, self);
+  self->view = NULL;
+  set_buffer (self, NULL);
+  set_vadjustment (self, NULL);
+
+  G_OBJECT_CLASS (texty_spell_checker_parent_class)->dispose (object);
+}
+
+static void
+texty_spell_checker_class_init (TextySpellCheckerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = texty_spell_checker_dispose;
+}
+
+static void
+texty_spell_checker_init (TextySpellChecker *self)
+{
+}
+
+/*
+ * Underlines misspelled words in 'view', only ever checking the lines in
+ * and around sight, in idle time, so typing costs no more than marking
+ * the edited lines. Does nothing unless enabled and a dictionary for the
+ * user's language is found. The view must outlive the checker.
+ */
+TextySpellChecker *
+texty_spell_checker_new (GtkTextView *view)
+{
+  TextySpellChecker *self;
+
+  g_return_val_if_fail (GTK_IS_TEXT_VIEW (view), NULL);
+
+  self = g_object_new (TEXTY_TYPE_SPELL_CHECKER, NULL);
+  self->view = view;
+
+  g_signal_connect (view, "notify::buffer", G_CALLBACK (on_view_notify), self);
+  g_signal_connect (view, "notify::vadjustment", G_CALLBACK (on_view_notify), self);
+  on_view_notify (view, NULL, self);
+
+  return self;
+}
+
+void
+texty_spell_checker_set_enabled (TextySpellChecker *self,
+                                 gboolean enabled)
+{
+  g_return_if_fail (TEXTY_IS_SPELL_CHECKER (self));
+
+  enabled = enabled && texty_spell_checker_is_available ();
+  if (self->enabled == enabled)
+    return;
+
+  self->enabled = enabled;
+  if (enabled)
+    {
+      queue_check (self);
+      return;
+    }
+
+  g_clear_handle_id (&self->check_id, g_source_remove);
+  if (self->buffer != NULL)
+    clear_tags (self);
+}
@@ -0,0 +1,37 @@
+/* texty-spell-checker.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define TEXTY_TYPE_SPELL_CHECKER (texty_spell_checker_get_type())
+
+G_DECLARE_FINAL_TYPE (TextySpellChecker, texty_spell_checker, TEXTY, SPELL_CHECKER, GObject)
+
+gboolean           texty_spell_checker_is_available    (void);
+TextySpellChecker *texty_spell_checker_new             (GtkTextView       *view);
+void               texty_spell_checker_set_enabled     (TextySpellChecker *self,
+                                                        gboolean           enabled);
+gsize              texty_spell_checker_forget_verdicts (void);
+
+G_END_DECLS
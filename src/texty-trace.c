@@ -0,0 +1,211 @@
+/* texty-trace.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Spans of time spent in the phases of loading, saving and editing, for
+ * finding out where a slow open or save went without a debug build. They
+ * end up as marks in a sysprof capture when texty runs under sysprof, and
+ * in a Chrome trace file, which Perfetto and chrome://tracing show, when
+ * started with --trace=FILE.
+ */
+
+#include "config.h"
+#include "texty-trace.h"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYSPROF
+#include <sysprof-capture.h>
+#endif
+
+static GMutex lock;
+static FILE *trace_file;
+/* timestamps in the file count from here, where they are small enough to read */
+static gint64 trace_origin;
+static gboolean first_event;
+static int pid;
+
+/* small numbers for threads, handed out as they first leave a mark */
+static GPrivate thread_id;
+static int n_threads;
+
+static int
+get_thread_id (void)
+{
+  int id = GPOINTER_TO_INT (g_private_get (&thread_id));
+
+  if (id == 0)
+    {
+      id = g_atomic_int_add (&n_threads, 1) + 1;
+      g_private_set (&thread_id, GINT_TO_POINTER (id));
+    }
+
+  return id;
+}
+
+static void
+write_json_string (const char *str)
+{
+  fputc ('"', trace_file);
+  for (const char *p = str; *p != '\0'; p++)
+    {
+      if (*p == '"' || *p == '\\')
+        fprintf (trace_file, "\\%c", *p);
+      else if ((guchar) *p < 0x20)
+        fprintf (trace_file, "\\u%04x", (guchar) *p);
+      else
+        fputc (*p, trace_file);
+    }
+  fputc ('"', trace_file);
+}
+
+/*
+ * Starts writing every span to 'path' as a Chrome trace, in its JSON array
+ * form, which stays readable even when texty stops without closing it:
+ * every event is flushed out as soon as it is written.
+ */
+gboolean
+texty_trace_start (const char *path,
+                   GError **error)
+{
+  FILE *file;
+
+  g_return_val_if_fail (path != NULL, FALSE);
+
+  file = g_fopen (path, "w");
+  if (file == NULL)
+    {
+      int saved_errno = errno;
+
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   g_file_error_from_errno (saved_errno),
+                   "Unable to write the trace to %s: %s",
+                   path,
+                   g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  g_mutex_lock (&lock);
+  if (trace_file != NULL)
+    fclose (trace_file);
+  fputs ("[", file);
+  trace_origin = g_get_monotonic_time ();
+  first_event = TRUE;
+  pid = getpid ();
+  g_atomic_pointer_set (&trace_file, file);
+  g_mutex_unlock (&lock);
+
+  return TRUE;
+}
+
+void
+texty_trace_stop (void)
+{
+  g_mutex_lock (&lock);
+  if (trace_file != NULL)
+    {
+      fputs ("\n]\n", trace_file);
+      fclose (trace_file);
+      g_atomic_pointer_set (&trace_file, NULL);
+    }
+  g_mutex_unlock (&lock);
+}
+
+/* whether marks go anywhere, to skip gathering what they would say */
+gboolean
+texty_trace_is_enabled (void)
+{
+#ifdef HAVE_SYSPROF
+  if (sysprof_collector_is_active ())
+    return TRUE;
+#endif
+
+  return g_atomic_pointer_get (&trace_file) != NULL;
+}
+
+/*
+ * Records a span named 'name' from 'begin_time', taken with
+ * TEXTY_TRACE_CURRENT_TIME, until now. 'detail_format' may be NULL, and is
+ * only formatted when tracing is enabled, so marks cost next to nothing
+ * otherwise.
+ */
+void
+texty_trace_mark (gint64 begin_time,
+                  const char *name,
+                  const char *detail_format,
+                  ...)
+{
+  g_autofree char *detail = NULL;
+  gint64 end_time = TEXTY_TRACE_CURRENT_TIME;
+
+  g_return_if_fail (name != NULL);
+
+  if (!texty_trace_is_enabled ())
+    return;
+
+  if (detail_format != NULL)
+    {
+      va_list args;
+
+      va_start (args, detail_format);
+      detail = g_strdup_vprintf (detail_format, args);
+      va_end (args);
+    }
+
+#ifdef HAVE_SYSPROF
+  /* both clocks are CLOCK_MONOTONIC, sysprof counts in nanoseconds */
+  sysprof_collector_mark (begin_time * 1000,
+                          (end_time - begin_time) * 1000,
+                          "texty",
+                          name,
+                          detail);
+#endif
+
+  g_mutex_lock (&lock);
+  if (trace_file != NULL)
+    {
+      fprintf (trace_file,
+               "%s\n{\"name\":",
+               first_event ? "" : ",");
+      write_json_string (name);
+      fprintf (trace_file,
+               ",\"cat\":\"texty\",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT
+               ",\"dur\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%d",
+               begin_time - trace_origin,
+               end_time - begin_time,
+               pid,
+               get_thread_id ());
+      if (detail != NULL)
+        {
+          fputs (",\"args\":{\"detail\":", trace_file);
+          write_json_string (detail);
+          fputc ('}', trace_file);
+        }
+      fputc ('}', trace_file);
+      /* nothing waits in the buffer should texty crash before the next one */
+      fflush (trace_file);
+      first_event = FALSE;
+    }
+  g_mutex_unlock (&lock);
+}
@@ -0,0 +1,39 @@
+/* texty-trace.h
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* when a span starts, to be handed to texty_trace_mark() once it ends */
+#define TEXTY_TRACE_CURRENT_TIME g_get_monotonic_time ()
+
+gboolean texty_trace_start      (const char  *path,
+                                 GError     **error);
+void     texty_trace_stop       (void);
+gboolean texty_trace_is_enabled (void);
+void     texty_trace_mark       (gint64       begin_time,
+                                 const char  *name,
+                                 const char  *detail_format,
+                                 ...) G_GNUC_PRINTF (3, 4);
+
+G_END_DECLS
@@ -21,6 +21,29 @@
 #include "config.h"
 #include "texty-window.h"
 
+#include "texty-application.h"
+#include "texty-clipboard.h"
+#include "texty-compare-dialog.h"
+#include "texty-completion.h"
+#include "texty-csv.h"
+#include "texty-file-follower.h"
+#include "texty-file-loader.h"
+#include "texty-file-saver.h"
+#include "texty-folding.h"
+#include "texty-grep.h"
+#include "texty-json.h"
+#include "texty-latency-monitor.h"
+#include "texty-line-ending.h"
+#include "texty-line-ops.h"
+#include "texty-minimap.h"
+#include "texty-paste.h"
+#include "texty-path-index.h"
+#include "texty-quick-open.h"
+#include "texty-recent.h"
+#include "texty-sidebar.h"
+#include "texty-spell-checker.h"
+#include "texty-trace.h"
+
 struct _TextyWindow
 {
   AdwApplicationWindow parent_instance;
@@ -31,7 +54,55 @@ struct _TextyWindow
   GtkTextBuffer *buffer;
   GtkButton *save_button;
   GtkLabel *cursor_pos;
+  GtkMenuButton *line_ending_button;
   AdwToastOverlay *toast_overlay;
+  AdwBanner *paste_banner;
+  GtkStack *view_stack;
+  GtkSearchBar *filter_bar;
+  GtkSearchEntry *filter_entry;
+  GtkSpinButton *filter_context;
+  GtkLabel *filter_status;
+  GtkListView *filter_view;
+  GtkColumnView *table_view;
+  TextyMinimap *minimap;
+  AdwOverlaySplitView *split_view;
+  TextySidebar *sidebar;
+  GtkWidget *latency_overlay;
+  GtkLabel *latency_label;
+  GMenu *recent_menu;
+
+  /* streams large pastes in without blocking */
+  TextyPaste *paste;
+
+  /* set while a line or JSON operation works on a snapshot of the buffer */
+  GCancellable *line_op_cancellable;
+
+  /* the text being filtered, taken again once the buffer changes */
+  GBytes *filter_snapshot;
+  TextyGrepModel *filter_model;
+  GCancellable *filter_cancellable;
+
+  /* the document as CSV, while shown as a table */
+  TextyCsvModel *table_model;
+
+  /* proposes words from the open documents while typing */
+  TextyCompletion *completion;
+  TextySpellChecker *spell_checker;
+
+  /* typing latency, for the developer overlay */
+  TextyLatencyMonitor *latency_monitor;
+
+  /* the files under the sidebar's folder, for quick open */
+  TextyPathIndex *path_index;
+
+  /* how the file being opened fits the memory budget */
+  TextyLoadMode load_mode;
+  /* when it was asked for, for tracing */
+  gint64 open_begin_time;
+
+  /* this view's selection, the buffer's own cursor is shared by all views */
+  GtkTextMark *cursor_mark;
+  GtkTextMark *bound_mark;
 };
 
 G_DEFINE_FINAL_TYPE (TextyWindow, texty_window, ADW_TYPE_APPLICATION_WINDOW)
@@ -45,9 +116,67 @@ get_current_file (GtkTextBuffer *buffer)
 static void
 set_current_file (GtkTextBuffer *buffer, GFile *file)
 {
+  TextyApplication *app = TEXTY_APPLICATION (g_application_get_default ());
+
   if (file)
     file = g_file_dup (file);
   g_object_set_data_full (G_OBJECT (buffer), "current-file", file, g_object_unref);
+
+  /* let other windows opening the same file find this buffer */
+  if (file)
+    texty_application_register_document (app, file, buffer);
+  else
+    texty_application_unregister_document (app, buffer);
+}
+
+/* how many windows are showing the buffer */
+static int
+get_views (GtkTextBuffer *buffer)
+{
+  return GPOINTER_TO_INT (g_object_get_data (G_OBJECT (buffer), "views"));
+}
+
+static void
+set_views (GtkTextBuffer *buffer,
+           int views)
+{
+  g_object_set_data (G_OBJECT (buffer), "views", GINT_TO_POINTER (views));
+}
+
+static TextyCompression
+get_compression (GtkTextBuffer *buffer)
+{
+  return GPOINTER_TO_INT (g_object_get_data (G_OBJECT (buffer), "compression"));
+}
+
+static void
+set_compression (GtkTextBuffer *buffer,
+                 TextyCompression compression)
+{
+  g_object_set_data (G_OBJECT (buffer), "compression", GINT_TO_POINTER (compression));
+}
+
+static TextyLineEnding
+get_line_ending (GtkTextBuffer *buffer)
+{
+  return GPOINTER_TO_INT (g_object_get_data (G_OBJECT (buffer), "line-ending"));
+}
+
+static void
+set_line_ending (TextyWindow *self,
+                 TextyLineEnding line_ending)
+{
+  GAction *action;
+
+  g_object_set_data (G_OBJECT (self->buffer), "line-ending", GINT_TO_POINTER (line_ending));
+
+  /* reflect it in the header and the conversion menu */
+  gtk_menu_button_set_label (self->line_ending_button,
+                             texty_line_ending_to_label (line_ending));
+  action = g_action_map_lookup_action (G_ACTION_MAP (self), "set-line-ending");
+  if (action != NULL)
+    g_simple_action_set_state (G_SIMPLE_ACTION (action),
+                               g_variant_new_string (texty_line_ending_to_string (line_ending)));
 }
 
 static void
@@ -96,6 +225,118 @@ get_text_wrap (void)
   return value;
 }
 
+static guint
+get_follow_max_lines (void)
+{
+  GSettings *settings;
+  int value;
+
+  settings = g_settings_new ("ca.footeware.c.texty");
+  value = g_settings_get_int (settings, "follow-max-lines");
+  g_object_unref (settings);
+
+  return MAX (value, 0);
+}
+
+static void
+save_backups (gboolean value)
+{
+  GSettings *settings;
+
+  settings = g_settings_new ("ca.footeware.c.texty");
+  g_settings_set_boolean (settings, "backups", value);
+  g_object_unref (settings);
+}
+
+static void
+save_show_minimap (gboolean value)
+{
+  GSettings *settings;
+
+  settings = g_settings_new ("ca.footeware.c.texty");
+  g_settings_set_boolean (settings, "show-minimap", value);
+  g_object_unref (settings);
+}
+
+static gboolean
+get_show_minimap (void)
+{
+  GSettings *settings;
+  gboolean value;
+
+  settings = g_settings_new ("ca.footeware.c.texty");
+  value = g_settings_get_boolean (settings, "show-minimap");
+  g_object_unref (settings);
+
+  return value;
+}
+
+static void
+save_spell_check (gboolean value)
+{
+  GSettings *settings;
+
+  settings = g_settings_new ("ca.footeware.c.texty");
+  g_settings_set_boolean (settings, "spell-check", value);
+  g_object_unref (settings);
+}
+
+static gboolean
+get_spell_check (void)
+{
+  GSettings *settings;
+  gboolean value;
+
+  settings = g_settings_new ("ca.footeware.c.texty");
+  value = g_settings_get_boolean (settings, "spell-check");
+  g_object_unref (settings);
+
+  return value;
+}
+
+static gboolean
+get_backups (void)
+{
+  GSettings *settings;
+  gboolean value;
+
+  settings = g_settings_new ("ca.footeware.c.texty");
+  value = g_settings_get_boolean (settings, "backups");
+  g_object_unref (settings);
+
+  return value;
+}
+
+/* how many backups to keep when saving, 0 when they are turned off */
+static guint
+get_backup_count (void)
+{
+  GSettings *settings;
+  int value;
+
+  if (!get_backups ())
+    return 0;
+
+  settings = g_settings_new ("ca.footeware.c.texty");
+  value = g_settings_get_int (settings, "backup-count");
+  g_object_unref (settings);
+
+  return MAX (value, 0);
+}
+
+static gsize
+get_memory_budget (void)
+{
+  GSettings *settings;
+  int value;
+
+  settings = g_settings_new ("ca.footeware.c.texty");
+  value = g_settings_get_int (settings, "memory-budget");
+  g_object_unref (settings);
+
+  return (gsize) MAX (value, 1) * 1024 * 1024;
+}
+
 static void
 load_window_size (TextyWindow *self)
 {
@@ -126,155 +367,645 @@ save_window_size (TextyWindow *self)
   g_object_unref (settings);
 }
 
+/* the buffer holds only part of its file, saving over it would lose the rest */
+static gboolean
+is_partial (GtkTextBuffer *buffer)
+{
+  return g_object_get_data (G_OBJECT (buffer), "partial") != NULL;
+}
+
+static void
+set_partial (GtkTextBuffer *buffer,
+             gboolean partial)
+{
+  g_object_set_data (G_OBJECT (buffer), "partial", partial ? GINT_TO_POINTER (TRUE) : NULL);
+}
+
+static void
+set_read_only (TextyWindow *self,
+               gboolean read_only)
+{
+  g_object_set_data (G_OBJECT (self->buffer), "read-only", read_only ? GINT_TO_POINTER (TRUE) : NULL);
+  gtk_text_view_set_editable (self->text_view, !read_only);
+}
+
+static gboolean
+refuse_partial_save (TextyWindow *self)
+{
+  g_autofree char *basename = NULL;
+  g_autofree char *msg = NULL;
+
+  if (!is_partial (self->buffer))
+    return FALSE;
+
+  basename = g_file_get_basename (get_current_file (self->buffer));
+  msg = g_strdup_printf ("Only part of “%s” is loaded, use Save As", basename);
+  adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+
+  return TRUE;
+}
+
+static TextyFileFollower *
+get_follower (GtkTextBuffer *buffer)
+{
+  return g_object_get_data (G_OBJECT (buffer), "follower");
+}
+
+/* a followed document only changes by what gets appended to its file */
+static void
+update_editable (TextyWindow *self)
+{
+  gtk_text_view_set_editable (self->text_view,
+                              g_object_get_data (G_OBJECT (self->buffer), "read-only") == NULL
+                              && get_follower (self->buffer) == NULL);
+}
+
+/* every document gets its folds when first shown */
+static TextyFolding *
+get_folding (GtkTextBuffer *buffer)
+{
+  TextyFolding *folding = g_object_get_data (G_OBJECT (buffer), "folding");
+
+  if (folding == NULL)
+    {
+      folding = texty_folding_new (buffer);
+      g_object_set_data_full (G_OBJECT (buffer), "folding", folding, g_object_unref);
+    }
+
+  return folding;
+}
+
+/* a read in flight keeps the follower alive, make sure it lets go of the buffer */
+static void
+free_follower (TextyFileFollower *follower)
+{
+  texty_file_follower_stop (follower);
+  g_object_unref (follower);
+}
+
+static void
+stop_following (TextyWindow *self)
+{
+  GAction *action;
+  TextyFileFollower *follower;
+
+  follower = get_follower (self->buffer);
+  if (follower != NULL)
+    texty_file_follower_stop (follower);
+  g_object_set_data (G_OBJECT (self->buffer), "follower", NULL);
+  update_editable (self);
+
+  action = g_action_map_lookup_action (G_ACTION_MAP (self), "follow");
+  if (action != NULL)
+    g_simple_action_set_state (G_SIMPLE_ACTION (action), g_variant_new_boolean (FALSE));
+}
+
 /**********************************/
 /* Preferences 👆️                 */
 /**********************************/
 
+static void texty_window__update_cursor_position (GtkTextBuffer *buffer,
+                                                  GParamSpec *pspec,
+                                                  TextyWindow *self);
+static void on_follower_appended (TextyFileFollower *follower,
+                                  gboolean trimmed,
+                                  TextyWindow *self);
+static void on_buffer_changed (GtkTextBuffer *buffer,
+                               TextyWindow *self);
+static void hide_table (TextyWindow *self);
+static void reload_document (TextyWindow *self);
+
+/* bring the header and actions in line with the document being shown */
 static void
-save_file_complete (GObject *source_object,
-                    GAsyncResult *result,
-                    gpointer user_data)
+sync_document (TextyWindow *self)
 {
-  g_autofree char *display_name;
-  g_autoptr (GFileInfo) info;
-  g_autofree char *file_path;
-  g_autofree char *msg;
-  TextyWindow *self;
-  GtkTextBuffer *buffer;
-  g_autoptr (GError) error;
-
-  self = user_data;
-  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (self->text_view));
-  error = NULL;
-
-  /* the save function will prompt to replace if exists */
-  g_file_replace_contents_finish (get_current_file (buffer), result, NULL, &error);
+  GFile *file;
+  GAction *action;
+  gboolean markdown = FALSE;
 
-  self = TEXTY_WINDOW (user_data);
+  file = get_current_file (self->buffer);
+  if (file != NULL)
+    {
+      g_autofree char *basename = g_file_get_basename (file);
+      g_autofree char *file_path = g_file_get_path (file);
 
-  /* mark textview as having no changes to save */
-  gtk_text_buffer_set_modified (buffer, FALSE);
+      adw_window_title_set_title (self->window_title, basename);
+      adw_window_title_set_subtitle (self->window_title, file_path);
+      markdown = g_str_has_suffix (basename, ".md") || g_str_has_suffix (basename, ".markdown");
 
-  /* Query the file for its display name */
-  display_name = NULL;
-  info = g_file_query_info (get_current_file (buffer),
-                            "standard::display-name",
-                            G_FILE_QUERY_INFO_NONE,
-                            NULL,
-                            NULL);
-  file_path = g_file_get_path (get_current_file (self->buffer));
+      /* the sidebar starts out in the folder of the first file opened */
+      if (texty_sidebar_get_root (self->sidebar) == NULL)
+        {
+          g_autoptr (GFile) parent = g_file_get_parent (file);
 
-  if (info != NULL)
-    display_name =
-        g_strdup (g_file_info_get_attribute_string (info,
-                                                    "standard::display-name"));
+          if (parent != NULL)
+            texty_sidebar_set_root (self->sidebar, parent);
+        }
+    }
   else
-    display_name = g_file_get_basename (get_current_file (buffer));
+    {
+      adw_window_title_set_title (self->window_title, "texty");
+      adw_window_title_set_subtitle (self->window_title, "a minimal text editor");
+    }
 
-  /* display name & path in window title */
-  adw_window_title_set_title (self->window_title, display_name);
-  adw_window_title_set_subtitle (self->window_title, file_path);
+  texty_folding_set_markdown (get_folding (self->buffer), markdown);
+  set_line_ending (self, get_line_ending (self->buffer));
+  update_editable (self);
 
-  /* display toast */
-  msg = NULL;
-  if (error != NULL)
-    msg = g_strdup_printf ("Unable to save “%s”", display_name);
-  else
-    msg = g_strdup_printf ("Saved “%s”", display_name);
+  action = g_action_map_lookup_action (G_ACTION_MAP (self), "follow");
+  if (action != NULL)
+    g_simple_action_set_state (G_SIMPLE_ACTION (action),
+                               g_variant_new_boolean (get_follower (self->buffer) != NULL));
+}
 
-  adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
-  /* put cursor in text_view */
-  gtk_widget_grab_focus (GTK_WIDGET (self->text_view));
+static void
+release_buffer (TextyWindow *self)
+{
+  TextyFileFollower *follower;
+
+  if (self->buffer == NULL)
+    return;
+
+  /* a line operation's result belongs to the buffer it was taken from */
+  g_cancellable_cancel (self->line_op_cancellable);
+  g_clear_pointer (&self->filter_snapshot, g_bytes_unref);
+  hide_table (self);
+  g_signal_handlers_disconnect_by_data (self->buffer, self);
+  follower = get_follower (self->buffer);
+  if (follower != NULL)
+    g_signal_handlers_disconnect_by_data (follower, self);
+
+  if (self->cursor_mark != NULL)
+    gtk_text_buffer_delete_mark (self->buffer, self->cursor_mark);
+  if (self->bound_mark != NULL)
+    gtk_text_buffer_delete_mark (self->buffer, self->bound_mark);
+  self->cursor_mark = NULL;
+  self->bound_mark = NULL;
+
+  set_views (self->buffer, get_views (self->buffer) - 1);
+  /* nothing on the clipboard may depend on a document no window shows */
+  if (get_views (self->buffer) == 0)
+    texty_clipboard_release_buffer (self->buffer);
+  self->buffer = NULL;
 }
 
+/*
+ * Shows 'buffer' in this window. Several windows may show the same buffer,
+ * each keeps its own scroll position through its text view and its own
+ * selection through a pair of marks swapped in when the window is focused.
+ */
 static void
-save_file (TextyWindow *self)
+texty_window_set_buffer (TextyWindow *self,
+                         GtkTextBuffer *buffer)
 {
-  GtkTextBuffer *buffer;
-  GtkTextIter start;
-  GtkTextIter end;
-  char *text;
-  g_autoptr (GBytes) bytes;
+  GtkTextIter insert;
+  GtkTextIter bound;
+  TextyFileFollower *follower;
 
-  GFile *file = get_current_file (self->buffer);
-  buffer = gtk_text_view_get_buffer (self->text_view);
+  if (buffer == self->buffer)
+    return;
 
-  /* retrieve the iterators at the start and end of the buffer */
-  gtk_text_buffer_get_start_iter (buffer, &start);
-  gtk_text_buffer_get_end_iter (buffer, &end);
+  if (self->paste != NULL)
+    texty_paste_cancel (self->paste);
+  release_buffer (self);
+
+  /* the view holds the reference, self->buffer merely points at it */
+  gtk_text_view_set_buffer (self->text_view, buffer);
+  self->buffer = buffer;
+  set_views (buffer, get_views (buffer) + 1);
 
-  /* Retrieve all the visible text between the two bounds */
-  text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+  g_signal_connect (buffer,
+                    "notify::cursor-position",
+                    G_CALLBACK (texty_window__update_cursor_position),
+                    self);
+  g_signal_connect (buffer,
+                    "changed",
+                    G_CALLBACK (on_buffer_changed),
+                    self);
+  follower = get_follower (buffer);
+  if (follower != NULL)
+    g_signal_connect_object (follower,
+                             "appended",
+                             G_CALLBACK (on_follower_appended),
+                             self,
+                             0);
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &insert, gtk_text_buffer_get_insert (buffer));
+  gtk_text_buffer_get_iter_at_mark (buffer, &bound, gtk_text_buffer_get_selection_bound (buffer));
+  self->cursor_mark = gtk_text_buffer_create_mark (buffer, NULL, &insert, FALSE);
+  self->bound_mark = gtk_text_buffer_create_mark (buffer, NULL, &bound, FALSE);
+
+  sync_document (self);
+  texty_window__update_cursor_position (buffer, NULL, self);
+}
 
-  bytes = g_bytes_new_take (text, strlen (text));
+/* start over on a buffer of our own, leaving the shared one to the other windows */
+static void
+detach_document (TextyWindow *self)
+{
+  g_autoptr (GtkTextBuffer) buffer = gtk_text_buffer_new (NULL);
 
-  /* start the asynchronous operation to save the data into the file */
-  g_file_replace_contents_bytes_async (file,
-                                       bytes,
-                                       NULL,
-                                       FALSE,
-                                       G_FILE_CREATE_NONE,
-                                       NULL,
-                                       save_file_complete,
-                                       self);
+  texty_window_set_buffer (self, buffer);
 }
 
 static void
-on_save_response (GObject *source,
-                  GAsyncResult *result,
-                  gpointer user_data)
+clear_document (TextyWindow *self)
 {
-  GtkFileDialog *dialog = GTK_FILE_DIALOG (source);
-  TextyWindow *self = user_data;
+  GtkTextIter start;
+  GtkTextIter end;
+  gint64 begin_time;
 
-  /* get the selected file and save buffer contents into it */
-  g_autoptr (GFile) file = gtk_file_dialog_save_finish (dialog, result, NULL);
-  if (file != NULL)
+  if (get_views (self->buffer) > 1)
     {
-      set_current_file (self->buffer, file);
-      save_file (self);
+      detach_document (self);
+      return;
     }
+
+  /* clear buffer */
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  gtk_text_buffer_get_start_iter (self->buffer, &start);
+  gtk_text_buffer_get_end_iter (self->buffer, &end);
+  gtk_text_buffer_delete (self->buffer, &start, &end);
+  texty_trace_mark (begin_time, "clear", NULL);
+  gtk_text_buffer_set_modified (self->buffer, FALSE);
+
+  /* set window title */
+  adw_window_title_set_title (self->window_title, "texty");
+  adw_window_title_set_subtitle (self->window_title, "a minimal text editor");
+
+  /* clear file ref */
+  set_current_file (self->buffer, NULL);
+  set_compression (self->buffer, TEXTY_COMPRESSION_NONE);
+  set_line_ending (self, TEXTY_LINE_ENDING_LF);
+  set_partial (self->buffer, FALSE);
+  g_object_set_data (G_OBJECT (self->buffer), "unloaded", NULL);
+  set_read_only (self, FALSE);
+  stop_following (self);
 }
 
 static void
-texty_window__save (GAction *action G_GNUC_UNUSED,
-                    GVariant *param G_GNUC_UNUSED,
-                    TextyWindow *self)
+on_is_active_changed (TextyWindow *self,
+                      GParamSpec *pspec,
+                      gpointer user_data)
 {
-  /* check if we have a file yet */
-  if (get_current_file (self->buffer) != NULL)
+  GtkTextIter insert;
+  GtkTextIter bound;
+
+  if (gtk_window_is_active (GTK_WINDOW (self)))
     {
-      save_file (self);
+      /* put back this view's selection and whatever other windows changed */
+      gtk_text_buffer_get_iter_at_mark (self->buffer, &insert, self->cursor_mark);
+      gtk_text_buffer_get_iter_at_mark (self->buffer, &bound, self->bound_mark);
+      gtk_text_buffer_select_range (self->buffer, &insert, &bound);
+      sync_document (self);
+      /* the document was let go of while memory was low */
+      reload_document (self);
     }
   else
     {
-      /* prompt user for file */
-      g_autoptr (GtkFileDialog) dialog;
-      dialog = gtk_file_dialog_new ();
-
-      /* present save file dialog */
-      gtk_file_dialog_save (dialog,
-                            GTK_WINDOW (self),
-                            NULL,
-                            on_save_response,
-                            self);
+      gtk_text_buffer_get_iter_at_mark (self->buffer, &insert, gtk_text_buffer_get_insert (self->buffer));
+      gtk_text_buffer_get_iter_at_mark (self->buffer, &bound, gtk_text_buffer_get_selection_bound (self->buffer));
+      gtk_text_buffer_move_mark (self->buffer, self->cursor_mark, &insert);
+      gtk_text_buffer_move_mark (self->buffer, self->bound_mark, &bound);
     }
 }
 
 /**********************************/
-/* Save File 👆️                     */
+/* Shared documents 👆️            */
 /**********************************/
 
-static void
-save_modified_file_complete (GObject *source_object,
-                             GAsyncResult *result,
-                             gpointer user_data)
+/* undo steps each document keeps once memory runs low */
+#define MIN_UNDO_LEVELS 20
+
+/* a document let go of under memory pressure, until its window is used again */
+typedef struct
 {
-  TextyWindow *self;
+  /* where the cursor was, put back after reloading */
+  int line;
+  gboolean reloading;
+} Unloaded;
+
+static Unloaded *
+get_unloaded (GtkTextBuffer *buffer)
+{
+  return g_object_get_data (G_OBJECT (buffer), "unloaded");
+}
+
+static void
+reload_complete (GObject *source_object,
+                 GAsyncResult *result,
+                 gpointer user_data)
+{
+  g_autoptr (TextyWindow) self = user_data;
+  GFile *file = G_FILE (source_object);
+  g_autoptr (GBytes) bytes = NULL;
+  Unloaded *unloaded;
+  GtkTextIter iter;
+  const char *contents;
+  gsize length;
+  gint64 begin_time;
+
+  bytes = texty_file_load_finish (file, result, NULL, NULL, NULL);
+
+  /* the window went away or moved on to another document meanwhile */
+  if (self->buffer == NULL
+      || (unloaded = get_unloaded (self->buffer)) == NULL
+      || get_current_file (self->buffer) == NULL
+      || !g_file_equal (get_current_file (self->buffer), file))
+    return;
+  unloaded->reloading = FALSE;
+
+  if (bytes == NULL || !texty_file_validate_utf8 (bytes, NULL))
+    {
+      g_autofree char *basename = g_file_get_basename (file);
+      g_autofree char *msg = g_strdup_printf ("Unable to reload “%s”, open it again", basename);
+
+      adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+      return;
+    }
+
+  /* nothing to undo, it is the text as it was */
+  contents = g_bytes_get_data (bytes, &length);
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  gtk_text_buffer_begin_irreversible_action (self->buffer);
+  gtk_text_buffer_set_text (self->buffer, contents, length);
+  gtk_text_buffer_end_irreversible_action (self->buffer);
+  texty_trace_mark (begin_time, "set-text", "%" G_GSIZE_FORMAT " bytes reloaded", length);
+  gtk_text_buffer_set_modified (self->buffer, FALSE);
+
+  gtk_text_buffer_get_iter_at_line (self->buffer, &iter, unloaded->line);
+  g_object_set_data (G_OBJECT (self->buffer), "unloaded", NULL);
+  set_partial (self->buffer, FALSE);
+  set_read_only (self, FALSE);
+
+  gtk_text_buffer_place_cursor (self->buffer, &iter);
+  gtk_text_view_scroll_to_mark (self->text_view,
+                                gtk_text_buffer_get_insert (self->buffer),
+                                0.0, TRUE, 0.0, 0.5);
+}
+
+static void
+reload_document (TextyWindow *self)
+{
+  Unloaded *unloaded = get_unloaded (self->buffer);
+
+  if (unloaded == NULL || unloaded->reloading)
+    return;
+
+  unloaded->reloading = TRUE;
+  texty_file_load_async (get_current_file (self->buffer),
+                         G_MAXSIZE,
+                         NULL,
+                         reload_complete,
+                         g_object_ref (self));
+}
+
+/*
+ * Empties the document of a window in the background when it can simply
+ * be read from its file again, which happens once the window is used.
+ * Returns about how many bytes that released.
+ */
+static gsize
+unload_document (TextyWindow *self)
+{
+  Unloaded *unloaded;
+  GtkTextIter iter;
+  gsize size;
+  gint64 begin_time;
+
+  if (gtk_window_is_active (GTK_WINDOW (self))
+      || get_unloaded (self->buffer) != NULL
+      || get_current_file (self->buffer) == NULL
+      || gtk_text_buffer_get_modified (self->buffer)
+      || get_views (self->buffer) > 1
+      || is_partial (self->buffer)
+      || g_object_get_data (G_OBJECT (self->buffer), "read-only") != NULL
+      || get_follower (self->buffer) != NULL
+      || self->line_op_cancellable != NULL)
+    return 0;
+
+  unloaded = g_new0 (Unloaded, 1);
+  gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, self->cursor_mark);
+  unloaded->line = gtk_text_iter_get_line (&iter);
+  /* at least a byte per character */
+  size = gtk_text_buffer_get_char_count (self->buffer);
+
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  gtk_text_buffer_begin_irreversible_action (self->buffer);
+  gtk_text_buffer_set_text (self->buffer, "", 0);
+  gtk_text_buffer_end_irreversible_action (self->buffer);
+  texty_trace_mark (begin_time, "unload", "%" G_GSIZE_FORMAT " characters", size);
+  gtk_text_buffer_set_modified (self->buffer, FALSE);
+
+  /* like a partial load, so nothing saves the empty buffer over the file */
+  set_partial (self->buffer, TRUE);
+  set_read_only (self, TRUE);
+  g_object_set_data_full (G_OBJECT (self->buffer), "unloaded", unloaded, g_free);
+
+  return size;
+}
+
+/*
+ * Lets go of what the window can do without or get back later, more of
+ * it the more pressing 'level' is, and returns about how many bytes that
+ * released. The undo history is trimmed from medium pressure on, though
+ * GTK doesn't tell how much that frees, and the documents of windows in
+ * the background are unloaded when it gets critical.
+ */
+gsize
+texty_window_reclaim_memory (TextyWindow *self,
+                             GMemoryMonitorWarningLevel level)
+{
+  gsize reclaimed = 0;
+  guint max_undo_levels;
+
+  g_return_val_if_fail (TEXTY_IS_WINDOW (self), 0);
+
+  reclaimed += texty_minimap_drop_textures (self->minimap);
+  if (level < G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM)
+    return reclaimed;
+
+  /* lowering the limit drops the oldest steps, raising it again keeps the rest */
+  max_undo_levels = gtk_text_buffer_get_max_undo_levels (self->buffer);
+  if (max_undo_levels == 0 || max_undo_levels > MIN_UNDO_LEVELS)
+    {
+      gtk_text_buffer_set_max_undo_levels (self->buffer, MIN_UNDO_LEVELS);
+      gtk_text_buffer_set_max_undo_levels (self->buffer, max_undo_levels);
+    }
+
+  /* the filter and the table are taken again when next asked for */
+  if (!gtk_window_is_active (GTK_WINDOW (self)))
+    {
+      if (self->filter_snapshot != NULL)
+        reclaimed += g_bytes_get_size (self->filter_snapshot);
+      gtk_search_bar_set_search_mode (self->filter_bar, FALSE);
+      hide_table (self);
+    }
+
+  if (level < G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL)
+    return reclaimed;
+
+  return reclaimed + unload_document (self);
+}
+
+/**********************************/
+/* Memory pressure 👆️             */
+/**********************************/
+
+/* the name to show for 'file', which may have to ask a remote filesystem */
+static char *
+query_display_name (GFile *file)
+{
+  g_autoptr (GFileInfo) info = NULL;
+  gint64 begin_time = TEXTY_TRACE_CURRENT_TIME;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            NULL);
+  texty_trace_mark (begin_time, "query-info", "%s", g_file_peek_path (file));
+
+  if (info == NULL)
+    return g_file_get_basename (file);
+  return g_strdup (g_file_info_get_display_name (info));
+}
+
+static void
+save_file_complete (GObject *source_object,
+                    GAsyncResult *result,
+                    gpointer user_data)
+{
+  g_autofree char *display_name;
+  g_autofree char *file_path;
+  g_autofree char *msg;
+  TextyWindow *self;
+  GtkTextBuffer *buffer;
+  g_autoptr (GError) error;
+
+  self = user_data;
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (self->text_view));
+  error = NULL;
+
+  /* the save function will prompt to replace if exists */
+  texty_file_save_finish (get_current_file (buffer), result, &error);
+
+  self = TEXTY_WINDOW (user_data);
+
+  /* mark textview as having no changes to save */
+  gtk_text_buffer_set_modified (buffer, FALSE);
+
+  /* Query the file for its display name */
+  display_name = query_display_name (get_current_file (buffer));
+  file_path = g_file_get_path (get_current_file (self->buffer));
+
+  /* display name & path in window title */
+  adw_window_title_set_title (self->window_title, display_name);
+  adw_window_title_set_subtitle (self->window_title, file_path);
+
+  /* display toast */
+  msg = NULL;
+  if (error != NULL)
+    {
+      msg = g_strdup_printf ("Unable to save “%s”", display_name);
+    }
+  else
+    {
+      msg = g_strdup_printf ("Saved “%s”", display_name);
+      texty_recent_add (get_current_file (buffer));
+    }
+
+  adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+  /* put cursor in text_view */
+  gtk_widget_grab_focus (GTK_WIDGET (self->text_view));
+}
+
+static void
+save_file (TextyWindow *self)
+{
+  GtkTextBuffer *buffer;
+  g_autoptr (GBytes) bytes;
+  gint64 begin_time;
+
+  GFile *file = get_current_file (self->buffer);
+  buffer = gtk_text_view_get_buffer (self->text_view);
+
+  if (refuse_partial_save (self))
+    return;
+
+  /* Retrieve all the text, folded lines too */
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  bytes = texty_folding_get_document (buffer);
+  texty_trace_mark (begin_time, "get-text", NULL);
+
+  /* start the asynchronous operation to save the data into the file */
+  texty_file_save_async (file,
+                         bytes,
+                         get_line_ending (buffer),
+                         get_compression (buffer),
+                         NULL,
+                         get_backup_count (),
+                         NULL,
+                         save_file_complete,
+                         self);
+}
+
+static void
+on_save_response (GObject *source,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+  GtkFileDialog *dialog = GTK_FILE_DIALOG (source);
+  TextyWindow *self = user_data;
+
+  /* get the selected file and save buffer contents into it */
+  g_autoptr (GFile) file = gtk_file_dialog_save_finish (dialog, result, NULL);
+  if (file != NULL)
+    {
+      set_current_file (self->buffer, file);
+      set_compression (self->buffer, texty_compression_from_file (file));
+      save_file (self);
+    }
+}
+
+static void
+texty_window__save (GAction *action G_GNUC_UNUSED,
+                    GVariant *param G_GNUC_UNUSED,
+                    TextyWindow *self)
+{
+  /* check if we have a file yet */
+  if (get_current_file (self->buffer) != NULL)
+    {
+      save_file (self);
+    }
+  else
+    {
+      /* prompt user for file */
+      g_autoptr (GtkFileDialog) dialog;
+      dialog = gtk_file_dialog_new ();
+
+      /* present save file dialog */
+      gtk_file_dialog_save (dialog,
+                            GTK_WINDOW (self),
+                            NULL,
+                            on_save_response,
+                            self);
+    }
+}
+
+/**********************************/
+/* Save File 👆️                     */
+/**********************************/
+
+static void
+save_modified_file_complete (GObject *source_object,
+                             GAsyncResult *result,
+                             gpointer user_data)
+{
+  TextyWindow *self;
   g_autoptr (GError) error;
   GtkTextBuffer *buffer;
   g_autofree char *display_name;
-  g_autoptr (GFileInfo) info;
   g_autofree char *msg;
 
   /* the selected file */
@@ -283,7 +1014,7 @@ save_modified_file_complete (GObject *source_object,
   error = NULL;
 
   /* the main save function will prompt to replace if exists */
-  g_file_replace_contents_finish (file, result, NULL, &error);
+  texty_file_save_finish (file, result, &error);
   /* store a reference to the file, duplicated */
   set_current_file (self->buffer, file);
   /* mark textview as having no changes to save */
@@ -291,22 +1022,7 @@ save_modified_file_complete (GObject *source_object,
   gtk_text_buffer_set_modified (buffer, FALSE);
 
   /* get the display name of the file */
-  display_name = NULL;
-  info = g_file_query_info (file,
-                            "standard::display-name",
-                            G_FILE_QUERY_INFO_NONE,
-                            NULL,
-                            NULL);
-  if (info != NULL)
-    {
-      display_name =
-          g_strdup (g_file_info_get_attribute_string (info,
-                                                      "standard::display-name"));
-    }
-  else
-    {
-      display_name = g_file_get_basename (file);
-    }
+  display_name = query_display_name (file);
 
   /* In case of error, show a toast */
   if (error != NULL)
@@ -317,6 +1033,7 @@ save_modified_file_complete (GObject *source_object,
     }
   msg = g_strdup_printf ("Saved “%s”", display_name);
   adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+  texty_recent_add (file);
   /* put cursor in textview */
   gtk_widget_grab_focus (GTK_WIDGET (self->text_view));
 }
@@ -325,30 +1042,29 @@ static void
 save_modified_file (TextyWindow *self)
 {
   GtkTextBuffer *buffer;
-  GtkTextIter start;
-  GtkTextIter end;
-  char *text;
   g_autoptr (GBytes) bytes;
+  gint64 begin_time;
 
   buffer = gtk_text_view_get_buffer (self->text_view);
 
-  /* Retrieve the iterators at the start and end of the buffer */
-  gtk_text_buffer_get_start_iter (buffer, &start);
-  gtk_text_buffer_get_end_iter (buffer, &end);
+  if (refuse_partial_save (self))
+    return;
 
-  /* Retrieve all the visible text between the two bounds */
-  text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
-  bytes = g_bytes_new_take (text, strlen (text));
+  /* Retrieve all the text, folded lines too */
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  bytes = texty_folding_get_document (buffer);
+  texty_trace_mark (begin_time, "get-text", NULL);
 
   /* Start the asynchronous operation to save the data into the file */
-  g_file_replace_contents_bytes_async (get_current_file (buffer),
-                                       bytes,
-                                       NULL,
-                                       FALSE,
-                                       G_FILE_CREATE_NONE,
-                                       NULL,
-                                       save_modified_file_complete,
-                                       self);
+  texty_file_save_async (get_current_file (buffer),
+                         bytes,
+                         get_line_ending (buffer),
+                         get_compression (buffer),
+                         NULL,
+                         get_backup_count (),
+                         NULL,
+                         save_modified_file_complete,
+                         self);
 }
 
 static void
@@ -364,6 +1080,7 @@ on_save_modified_dialog_response (GObject *source,
   if (file != NULL)
     {
       set_current_file (self->buffer, file);
+      set_compression (self->buffer, texty_compression_from_file (file));
       save_modified_file (self);
     }
 }
@@ -374,8 +1091,6 @@ on_save_modified_response (AdwAlertDialog *dialog,
                            TextyWindow *self)
 {
   GtkTextBuffer *buffer;
-  GtkTextIter start;
-  GtkTextIter end;
 
   const char *response = adw_alert_dialog_choose_finish (dialog, result);
   buffer = gtk_text_view_get_buffer (self->text_view);
@@ -386,18 +1101,7 @@ on_save_modified_response (AdwAlertDialog *dialog,
     }
   if (g_str_equal (response, "discard"))
     {
-      /* clear buffer */
-      gtk_text_buffer_get_start_iter (buffer, &start);
-      gtk_text_buffer_get_end_iter (buffer, &end);
-      gtk_text_buffer_delete (buffer, &start, &end);
-      gtk_text_buffer_set_modified (buffer, FALSE);
-
-      /* set window title */
-      adw_window_title_set_title (self->window_title, "texty");
-      adw_window_title_set_subtitle (self->window_title, "a minimal text editor");
-
-      /* clear file ref */
-      set_current_file (buffer, NULL);
+      clear_document (self);
     }
   else if (g_str_equal (response, "save"))
     {
@@ -431,12 +1135,10 @@ texty_window__new (GAction *action,
 {
   GtkTextBuffer *buffer;
   gboolean modified;
-  GtkTextIter start;
-  GtkTextIter end;
 
-  /* check if text buffer has been changed */
+  /* check if text buffer has been changed, other windows keep a shared one */
   buffer = gtk_text_view_get_buffer (self->text_view);
-  modified = gtk_text_buffer_get_modified (buffer);
+  modified = gtk_text_buffer_get_modified (buffer) && get_views (buffer) == 1;
   if (modified)
     {
       /* prompt user to save file */
@@ -466,13 +1168,7 @@ texty_window__new (GAction *action,
   else
     {
       /* clear buffer and ref to file */
-      gtk_text_buffer_get_start_iter (buffer, &start);
-      gtk_text_buffer_get_end_iter (buffer, &end);
-      gtk_text_buffer_delete (buffer, &start, &end);
-      adw_window_title_set_title (self->window_title, "texty");
-      adw_window_title_set_subtitle (self->window_title, "a minimal text editor");
-      gtk_text_buffer_set_modified (buffer, FALSE);
-      set_current_file (buffer, NULL);
+      clear_document (self);
     }
 
   /* put cursor in textview */
@@ -492,59 +1188,50 @@ open_file_complete (GObject *source_object,
   GtkTextIter start;
   g_autofree char *display_name;
   g_autofree char *file_path;
-  g_autoptr (GFileInfo) info;
+  TextyLineEnding line_ending;
+  gboolean mixed;
 
   GFile *file = G_FILE (source_object);
 
-  g_autofree char *contents = NULL;
+  g_autoptr (GBytes) bytes = NULL;
+  const char *contents = NULL;
   gsize length = 0;
+  TextyCompression compression = TEXTY_COMPRESSION_NONE;
+  gboolean truncated = FALSE;
+  gint64 begin_time;
 
   g_autoptr (GError) error = NULL;
 
   /*
    * Complete the asynchronous operation; this function will either
-   * give you the contents of the file as a byte array, or will
+   * give you the contents of the file, already decompressed, or will
    * set the error argument.
    */
-  g_file_load_contents_finish (file,
-                               result,
-                               &contents,
-                               &length,
-                               NULL,
-                               &error);
+  bytes = texty_file_load_finish (file, result, &compression, &truncated, &error);
+  if (bytes != NULL)
+    contents = g_bytes_get_data (bytes, &length);
 
   /* get the display name of the file */
-  display_name = NULL;
-  info = g_file_query_info (file,
-                            "standard::display-name",
-                            G_FILE_QUERY_INFO_NONE,
-                            NULL,
-                            NULL);
-  file_path = g_file_get_path (get_current_file (self->buffer));
-
-  if (info != NULL)
-    {
-      display_name =
-          g_strdup (g_file_info_get_attribute_string (info,
-                                                      "standard::display-name"));
-    }
-  else
-    {
-      display_name = g_file_get_basename (file);
-    }
+  display_name = query_display_name (file);
+  file_path = g_file_get_path (file);
 
   /* In case of error, show a toast */
   if (error != NULL)
     {
-      g_autofree char *msg =
-          g_strdup_printf ("Unable to open “%s”", display_name);
+      g_autofree char *msg = NULL;
+
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA))
+        msg = g_strdup_printf ("“%s” looks like a binary file", display_name);
+      else
+        msg = g_strdup_printf ("Unable to open “%s”", display_name);
 
       adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
       return;
     }
 
   /* Ensure that the file is encoded with UTF-8 */
-  if (!g_utf8_validate (contents, length, NULL))
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  if (!texty_file_validate_utf8 (bytes, NULL))
     {
       g_autofree char *msg =
           g_strdup_printf ("Invalid text encoding for “%s”", display_name);
@@ -552,6 +1239,13 @@ open_file_complete (GObject *source_object,
       adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
       return;
     }
+  texty_trace_mark (begin_time, "validate-utf8", "%" G_GSIZE_FORMAT " bytes", length);
+
+  /* reloading updates every window, but don't replace their document with another */
+  if (get_views (self->buffer) > 1
+      && (get_current_file (self->buffer) == NULL
+          || !g_file_equal (get_current_file (self->buffer), file)))
+    detach_document (self);
 
   /*
    * Retrieve the GtkTextBuffer instance that stores the
@@ -559,8 +1253,16 @@ open_file_complete (GObject *source_object,
    */
   buffer = gtk_text_view_get_buffer (self->text_view);
 
+  /* stop appending to the buffer before it is replaced */
+  stop_following (self);
+
   /* Set the text using the contents of the file */
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
   gtk_text_buffer_set_text (buffer, contents, length);
+  texty_trace_mark (begin_time, "set-text", "%" G_GSIZE_FORMAT " bytes", length);
+  g_object_set_data (G_OBJECT (buffer), "unloaded", NULL);
+  set_partial (buffer, truncated);
+  set_read_only (self, truncated || self->load_mode != TEXTY_LOAD_MODE_NORMAL);
 
   /* Reposition the cursor so it's at the start of the text */
   gtk_text_buffer_get_start_iter (buffer, &start);
@@ -569,20 +1271,116 @@ open_file_complete (GObject *source_object,
   gtk_text_buffer_set_modified (buffer, FALSE);
   /* keep a pointer to the file */
   set_current_file (self->buffer, file);
+  /* and how to compress it again */
+  set_compression (self->buffer, compression);
+  texty_recent_add (file);
+
+  /* remember the line endings so saving writes them back the same way */
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  line_ending = texty_line_ending_detect (contents, length, &mixed);
+  texty_trace_mark (begin_time, "detect-line-endings", NULL);
+  set_line_ending (self, mixed ? TEXTY_LINE_ENDING_MIXED : line_ending);
+  if (mixed)
+    {
+      g_autofree char *tooltip =
+          g_strdup_printf ("Mixed line endings, mostly %s",
+                           texty_line_ending_to_label (line_ending));
+
+      gtk_widget_set_tooltip_text (GTK_WIDGET (self->line_ending_button), tooltip);
+    }
 
   /* Set the title using the display name */
   adw_window_title_set_title (self->window_title, display_name);
   adw_window_title_set_subtitle (self->window_title, file_path);
+
+  /* explain why the file can't be edited */
+  if (truncated)
+    {
+      g_autofree char *msg =
+          g_strdup_printf ("“%s” is too large, showing its start and end read-only", display_name);
+
+      adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+    }
+  else if (self->load_mode != TEXTY_LOAD_MODE_NORMAL)
+    {
+      g_autofree char *msg =
+          g_strdup_printf ("“%s” is large, opened read-only", display_name);
+
+      adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+    }
+
+  /* from asking for the file to showing it */
+  texty_trace_mark (self->open_begin_time, "open", "%s, %" G_GSIZE_FORMAT " bytes",
+                    file_path, length);
+}
+
+static void
+open_file_query_complete (GObject *source_object,
+                          GAsyncResult *result,
+                          TextyWindow *self)
+{
+  g_autoptr (GFileInfo) info = NULL;
+  GFile *file = G_FILE (source_object);
+  gsize budget;
+  gsize max_length = G_MAXSIZE;
+
+  budget = get_memory_budget ();
+  self->load_mode = TEXTY_LOAD_MODE_NORMAL;
+
+  /* without any info, let the load itself report what is wrong */
+  info = g_file_query_info_finish (file, result, NULL);
+  texty_trace_mark (self->open_begin_time, "query-info", "%s", g_file_peek_path (file));
+  if (info != NULL)
+    self->load_mode = texty_file_choose_load_mode (g_file_info_get_size (info),
+                                                   g_file_info_get_content_type (info),
+                                                   budget);
+
+  if (self->load_mode == TEXTY_LOAD_MODE_REFUSE)
+    {
+      g_autofree char *msg =
+          g_strdup_printf ("“%s” is too large and not text, not opening it",
+                           g_file_info_get_display_name (info));
+
+      adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+      return;
+    }
+  if (self->load_mode == TEXTY_LOAD_MODE_PREVIEW)
+    max_length = budget;
+
+  /* gzip and zstd files are decompressed while they are read */
+  texty_file_load_async (file,
+                         max_length,
+                         NULL,
+                         (GAsyncReadyCallback) open_file_complete,
+                         self);
 }
 
 static void
 open_file (TextyWindow *self,
            GFile *file)
 {
-  g_file_load_contents_async (file,
-                              NULL,
-                              (GAsyncReadyCallback) open_file_complete,
-                              self);
+  TextyApplication *app = TEXTY_APPLICATION (g_application_get_default ());
+  GtkTextBuffer *shared;
+
+  /* another window already has it, show that buffer rather than a second copy */
+  shared = texty_application_lookup_document (app, file);
+  if (shared != NULL && shared != self->buffer)
+    {
+      texty_window_set_buffer (self, shared);
+      return;
+    }
+
+  /* look before loading, a stray multi-gigabyte file would exhaust memory */
+  self->open_begin_time = TEXTY_TRACE_CURRENT_TIME;
+  g_file_query_info_async (file,
+                           G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                           G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
+                           G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME,
+                           G_FILE_QUERY_INFO_NONE,
+                           G_PRIORITY_DEFAULT,
+                           NULL,
+                           (GAsyncReadyCallback) open_file_query_complete,
+                           self);
 }
 
 static void
@@ -610,9 +1408,9 @@ texty_window__open (GAction *action,
   GtkTextBuffer *buffer;
   gboolean modified;
 
-  /* check if text buffer has been changed */
+  /* check if text buffer has been changed, other windows keep a shared one */
   buffer = gtk_text_view_get_buffer (self->text_view);
-  modified = gtk_text_buffer_get_modified (buffer);
+  modified = gtk_text_buffer_get_modified (buffer) && get_views (buffer) == 1;
   if (modified)
     {
       /* prompt user to save file */
@@ -654,6 +1452,166 @@ texty_window__open (GAction *action,
 /* Open File 👆️                   */
 /**********************************/
 
+/* opens a file picked from the folder, without asking about unsaved changes */
+static void
+open_folder_file (TextyWindow *self,
+                  GFile *file)
+{
+  GFile *current = get_current_file (self->buffer);
+  TextyWindow *window;
+
+  if (current != NULL && g_file_equal (current, file))
+    return;
+
+  /* rather than asking about unsaved changes, leave them be in this window */
+  if (gtk_text_buffer_get_modified (self->buffer) && get_views (self->buffer) == 1)
+    {
+      window = g_object_new (TEXTY_TYPE_WINDOW,
+                             "application", gtk_window_get_application (GTK_WINDOW (self)),
+                             NULL);
+      texty_sidebar_set_root (window->sidebar, texty_sidebar_get_root (self->sidebar));
+      adw_overlay_split_view_set_show_sidebar (window->split_view,
+                                               adw_overlay_split_view_get_show_sidebar (self->split_view));
+      gtk_window_present (GTK_WINDOW (window));
+      open_file (window, file);
+      return;
+    }
+
+  open_file (self, file);
+}
+
+static void
+on_sidebar_file_activated (TextySidebar *sidebar,
+                           GFile *file,
+                           TextyWindow *self)
+{
+  open_folder_file (self, file);
+}
+
+static void
+on_open_folder_response (GObject *source,
+                         GAsyncResult *result,
+                         gpointer user_data)
+{
+  g_autoptr (TextyWindow) self = user_data;
+  g_autoptr (GFile) folder = NULL;
+
+  folder = gtk_file_dialog_select_folder_finish (GTK_FILE_DIALOG (source), result, NULL);
+  if (folder == NULL)
+    return;
+
+  texty_sidebar_set_root (self->sidebar, folder);
+  adw_overlay_split_view_set_show_sidebar (self->split_view, TRUE);
+}
+
+static void
+texty_window__open_folder (GAction *action,
+                           GVariant *parameter,
+                           TextyWindow *self)
+{
+  g_autoptr (GtkFileDialog) dialog = gtk_file_dialog_new ();
+
+  gtk_file_dialog_set_initial_folder (dialog, texty_sidebar_get_root (self->sidebar));
+  gtk_file_dialog_select_folder (dialog,
+                                 GTK_WINDOW (self),
+                                 NULL,
+                                 on_open_folder_response,
+                                 g_object_ref (self));
+}
+
+/**********************************/
+/* Sidebar 👆️                     */
+/**********************************/
+
+static void
+on_quick_open_file_activated (TextyQuickOpen *quick_open,
+                              GFile *file,
+                              TextyWindow *self)
+{
+  open_folder_file (self, file);
+}
+
+static void
+texty_window__quick_open (GAction *action,
+                          GVariant *parameter,
+                          TextyWindow *self)
+{
+  GFile *root = texty_sidebar_get_root (self->sidebar);
+  AdwDialog *dialog;
+
+  if (root == NULL)
+    {
+      adw_toast_overlay_add_toast (self->toast_overlay,
+                                   adw_toast_new ("Open a folder to search its files"));
+      return;
+    }
+
+  /* the index outlives the dialog, so the crawl is only done once per folder */
+  if (self->path_index == NULL || !g_file_equal (texty_path_index_get_root (self->path_index), root))
+    {
+      g_clear_object (&self->path_index);
+      self->path_index = texty_path_index_new (root);
+    }
+
+  dialog = texty_quick_open_new (self->path_index);
+  g_signal_connect_object (dialog,
+                           "file-activated",
+                           G_CALLBACK (on_quick_open_file_activated),
+                           self,
+                           0);
+  adw_dialog_present (dialog, GTK_WIDGET (self));
+}
+
+/**********************************/
+/* Quick Open 👆️                  */
+/**********************************/
+
+#define MAX_RECENT 10
+
+/* rebuilt each time the menu opens, when the likeliest are read ahead too */
+static void
+update_recent_menu (TextyWindow *self)
+{
+  GList *files = texty_recent_get_files (MAX_RECENT);
+
+  g_menu_remove_all (self->recent_menu);
+  for (GList *l = files; l != NULL; l = l->next)
+    {
+      g_autoptr (GMenuItem) item = NULL;
+      g_autoptr (GString) label = NULL;
+      g_autofree char *basename = g_filename_display_basename (g_file_peek_path (l->data));
+      g_autofree char *uri = g_file_get_uri (l->data);
+
+      /* an underscore in the name isn't a mnemonic */
+      label = g_string_new (basename);
+      g_string_replace (label, "_", "__", 0);
+      item = g_menu_item_new (label->str, NULL);
+      g_menu_item_set_action_and_target_value (item, "win.open-recent", g_variant_new_string (uri));
+      g_menu_append_item (self->recent_menu, item);
+    }
+
+  /* without an action it shows greyed out */
+  if (files == NULL)
+    g_menu_append (self->recent_menu, "No Recent Files", NULL);
+  g_list_free_full (files, g_object_unref);
+
+  texty_recent_prefetch ();
+}
+
+static void
+texty_window__open_recent (GSimpleAction *action,
+                           GVariant *parameter,
+                           TextyWindow *self)
+{
+  g_autoptr (GFile) file = g_file_new_for_uri (g_variant_get_string (parameter, NULL));
+
+  open_folder_file (self, file);
+}
+
+/**********************************/
+/* Open Recent 👆️                 */
+/**********************************/
+
 static void
 save_file_as_complete (GObject *source_object,
                        GAsyncResult *result,
@@ -661,7 +1619,6 @@ save_file_as_complete (GObject *source_object,
 {
   g_autofree char *display_name;
   g_autofree char *file_path;
-  g_autoptr (GFileInfo) info;
   g_autofree char *msg;
   TextyWindow *self;
   GtkTextBuffer *buffer;
@@ -671,202 +1628,1268 @@ save_file_as_complete (GObject *source_object,
 
   g_autoptr (GError) error = NULL;
   /* the main save function will prompt to replace if exists */
-  g_file_replace_contents_finish (file, result, NULL, &error);
+  texty_file_save_finish (file, result, &error);
 
   self = TEXTY_WINDOW (user_data);
   /* store a reference to the file, duplicated */
   set_current_file (self->buffer, file);
+  set_compression (self->buffer, texty_compression_from_file (file));
+  /* the new file holds exactly what the buffer does */
+  if (error == NULL)
+    {
+      set_partial (self->buffer, FALSE);
+      stop_following (self);
+    }
 
   /* mark textview as having no changes to save */
   buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (self->text_view));
   gtk_text_buffer_set_modified (buffer, FALSE);
 
   /* Query the file for its display name */
-  display_name = NULL;
-  info = g_file_query_info (get_current_file (self->buffer),
-                            "standard::display-name",
-                            G_FILE_QUERY_INFO_NONE,
-                            NULL,
-                            NULL);
+  display_name = query_display_name (get_current_file (self->buffer));
   file_path = g_file_get_path (get_current_file (self->buffer));
 
-  if (info != NULL)
-    display_name =
-        g_strdup (g_file_info_get_attribute_string (info,
-                                                    "standard::display-name"));
-  else
-    display_name = g_file_get_basename (get_current_file (self->buffer));
-
   /* display name in window title */
   adw_window_title_set_title (self->window_title, display_name);
   adw_window_title_set_subtitle (self->window_title, file_path);
 
-  /* display toast */
-  msg = NULL;
-  if (error != NULL)
-    msg = g_strdup_printf ("Unable to save “%s”", display_name);
-  else
-    msg = g_strdup_printf ("Saved “%s”", display_name);
+  /* display toast */
+  msg = NULL;
+  if (error != NULL)
+    {
+      msg = g_strdup_printf ("Unable to save “%s”", display_name);
+    }
+  else
+    {
+      msg = g_strdup_printf ("Saved “%s”", display_name);
+      texty_recent_add (get_current_file (buffer));
+    }
+
+  adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+  /* put cursor in textview */
+  gtk_widget_grab_focus (GTK_WIDGET (self->text_view));
+}
+
+static void
+save_file_as (TextyWindow *self,
+              GFile *file)
+{
+  GtkTextBuffer *buffer;
+  g_autoptr (GBytes) bytes;
+  gint64 begin_time;
+
+  buffer = gtk_text_view_get_buffer (self->text_view);
+
+  /* Retrieve all the text, folded lines too */
+  begin_time = TEXTY_TRACE_CURRENT_TIME;
+  bytes = texty_folding_get_document (buffer);
+  texty_trace_mark (begin_time, "get-text", NULL);
+
+  /* Start the asynchronous operation to save the data into the file */
+  texty_file_save_async (file,
+                         bytes,
+                         get_line_ending (buffer),
+                         texty_compression_from_file (file),
+                         NULL,
+                         get_backup_count (),
+                         NULL,
+                         save_file_as_complete,
+                         self);
+}
+
+static void
+on_save_as_response (GObject *source,
+                     GAsyncResult *result,
+                     gpointer user_data)
+{
+  GtkFileDialog *dialog = GTK_FILE_DIALOG (source);
+  TextyWindow *self = user_data;
+
+  /* get the selected file and write the buffer contents into it */
+  g_autoptr (GFile) file = gtk_file_dialog_save_finish (dialog, result, NULL);
+  if (file != NULL)
+    {
+      save_file_as (self, file);
+    }
+}
+
+static void
+texty_window__save_as (GAction *action,
+                       GVariant *parameter,
+                       TextyWindow *self)
+{
+  g_autoptr (GtkFileDialog) dialog = gtk_file_dialog_new ();
+  /* present save file dialog */
+  gtk_file_dialog_save (dialog,
+                        GTK_WINDOW (self),
+                        NULL,
+                        on_save_as_response,
+                        self);
+}
+
+/**********************************/
+/* Save As 👆️                     */
+/**********************************/
+
+static void
+texty_window__update_cursor_position (GtkTextBuffer *buffer,
+                                      GParamSpec *pspec,
+                                      TextyWindow *self)
+{
+  GtkTextIter iter;
+  g_autofree char *cursor_str;
+
+  int cursor_pos = 0;
+
+  /* the cursor is shared, only follow it while it is this view's */
+  if (pspec != NULL && !gtk_window_is_active (GTK_WINDOW (self)))
+    return;
+
+  /* Retrieve the value of the "cursor-position" property */
+  g_object_get (buffer, "cursor-position", &cursor_pos, NULL);
+
+  /* Construct the text iterator for the position of the cursor */
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, cursor_pos);
+
+  /* Set the new contents of the label */
+  cursor_str = g_strdup_printf ("Ln %d, Col %d",
+                                gtk_text_iter_get_line (&iter) + 1,
+                                gtk_text_iter_get_line_offset (&iter) + 1);
+
+  gtk_label_set_text (self->cursor_pos, cursor_str);
+}
+
+/**********************************/
+/* Update Cursor Position 👆️      */
+/**********************************/
+
+static void
+texty_window__toggle_text_wrap (GSimpleAction *action,
+                                GVariant *parameter,
+                                TextyWindow *self)
+{
+  GVariant *state;
+  gboolean current_state;
+
+  state = g_action_get_state (G_ACTION (action));
+  current_state = g_variant_get_boolean (state);
+  g_variant_unref (state);
+
+  current_state = !current_state;
+
+  gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (self->text_view),
+                               current_state ? GTK_WRAP_WORD : GTK_WRAP_NONE);
+
+  g_simple_action_set_state (action, g_variant_new_boolean (current_state));
+  save_text_wrap (current_state);
+}
+
+/**********************************/
+/* Toggle text wrap 👆️            */
+/**********************************/
+
+static void
+texty_window__toggle_backups (GSimpleAction *action,
+                              GVariant *parameter,
+                              TextyWindow *self)
+{
+  GVariant *state;
+  gboolean current_state;
+
+  state = g_action_get_state (G_ACTION (action));
+  current_state = !g_variant_get_boolean (state);
+  g_variant_unref (state);
+
+  g_simple_action_set_state (action, g_variant_new_boolean (current_state));
+  save_backups (current_state);
+}
+
+/**********************************/
+/* Toggle backups 👆️              */
+/**********************************/
+
+static void
+texty_window__toggle_minimap (GSimpleAction *action,
+                              GVariant *parameter,
+                              TextyWindow *self)
+{
+  GVariant *state;
+  gboolean current_state;
+
+  state = g_action_get_state (G_ACTION (action));
+  current_state = !g_variant_get_boolean (state);
+  g_variant_unref (state);
+
+  /* an unmapped minimap stops rendering, and catches up when shown */
+  gtk_widget_set_visible (GTK_WIDGET (self->minimap), current_state);
+
+  g_simple_action_set_state (action, g_variant_new_boolean (current_state));
+  save_show_minimap (current_state);
+}
+
+/**********************************/
+/* Toggle minimap 👆️              */
+/**********************************/
+
+static void
+texty_window__toggle_spell_check (GSimpleAction *action,
+                                  GVariant *parameter,
+                                  TextyWindow *self)
+{
+  GVariant *state;
+  gboolean current_state;
+
+  state = g_action_get_state (G_ACTION (action));
+  current_state = !g_variant_get_boolean (state);
+  g_variant_unref (state);
+
+  texty_spell_checker_set_enabled (self->spell_checker, current_state);
+
+  g_simple_action_set_state (action, g_variant_new_boolean (current_state));
+  save_spell_check (current_state);
+}
+
+/**********************************/
+/* Toggle spell check 👆️          */
+/**********************************/
+
+static void
+on_latency_updated (TextyLatencyMonitor *monitor,
+                    TextyWindow *self)
+{
+  g_autofree char *summary = texty_latency_monitor_get_summary (monitor);
+
+  gtk_label_set_text (self->latency_label, summary);
+}
+
+/* a developer tool, so it is neither in a menu nor remembered */
+static void
+texty_window__toggle_latency_overlay (GSimpleAction *action,
+                                      GVariant *parameter,
+                                      TextyWindow *self)
+{
+  GVariant *state;
+  gboolean current_state;
+
+  state = g_action_get_state (G_ACTION (action));
+  current_state = !g_variant_get_boolean (state);
+  g_variant_unref (state);
+
+  texty_latency_monitor_set_enabled (self->latency_monitor, current_state);
+  on_latency_updated (self->latency_monitor, self);
+  gtk_widget_set_visible (self->latency_overlay, current_state);
+
+  g_simple_action_set_state (action, g_variant_new_boolean (current_state));
+}
+
+static void
+on_export_latency_response (GObject *source,
+                            GAsyncResult *result,
+                            gpointer user_data)
+{
+  g_autoptr (TextyWindow) self = user_data;
+  g_autoptr (GFile) file = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree char *basename = NULL;
+  g_autofree char *msg = NULL;
+
+  file = gtk_file_dialog_save_finish (GTK_FILE_DIALOG (source), result, NULL);
+  if (file == NULL)
+    return;
+
+  basename = g_file_get_basename (file);
+  if (texty_latency_monitor_export (self->latency_monitor, file, &error))
+    msg = g_strdup_printf ("Saved the latency histograms to “%s”", basename);
+  else
+    msg = g_strdup_printf ("Unable to save “%s”", basename);
+  adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+}
+
+static void
+texty_window__export_latency (GSimpleAction *action,
+                              GVariant *parameter,
+                              TextyWindow *self)
+{
+  g_autoptr (GtkFileDialog) dialog = gtk_file_dialog_new ();
+
+  gtk_file_dialog_set_initial_name (dialog, "texty-latency.csv");
+  gtk_file_dialog_save (dialog,
+                        GTK_WINDOW (self),
+                        NULL,
+                        on_export_latency_response,
+                        g_object_ref (self));
+}
+
+/**********************************/
+/* Latency overlay 👆️             */
+/**********************************/
+
+static void
+texty_window__fold (GSimpleAction *action,
+                    GVariant *parameter,
+                    TextyWindow *self)
+{
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, gtk_text_buffer_get_insert (self->buffer));
+  if (!texty_folding_toggle (get_folding (self->buffer), gtk_text_iter_get_line (&iter)))
+    gtk_widget_error_bell (GTK_WIDGET (self->text_view));
+}
+
+static void
+texty_window__unfold_all (GSimpleAction *action,
+                          GVariant *parameter,
+                          TextyWindow *self)
+{
+  texty_folding_unfold_all (get_folding (self->buffer));
+}
+
+/**********************************/
+/* Folding 👆️                     */
+/**********************************/
+
+static void
+texty_window__set_font_size (GSimpleAction *action,
+                             GVariant *parameter,
+                             TextyWindow *self)
+{
+  gint font_size;
+  char *css_class_name;
+  const char *css_classes[2];
+  GtkCssProvider *provider;
+  char *css;
+  GdkDisplay *display;
+
+  font_size = g_variant_get_int32 (parameter);
+
+  css_class_name = g_strdup_printf ("font-size-%d", font_size);
+  css_classes[0] = css_class_name;
+  css_classes[1] = NULL; // Null-terminate the array
+  gtk_widget_set_css_classes (GTK_WIDGET (self->text_view), css_classes);
+  provider = gtk_css_provider_new ();
+  css = g_strdup_printf ("textview.%s { font-size: %dpx; font-family: monospace; }", css_class_name, font_size);
+  gtk_css_provider_load_from_string (provider, css);
+  display = gdk_display_get_default ();
+  gtk_style_context_add_provider_for_display (display,
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+  g_free (css);
+  g_free (css_class_name);
+  g_object_unref (provider);
+
+  g_simple_action_set_state (action, parameter);
+  save_font_size (g_variant_get_int32 (parameter));
+}
+
+/**********************************/
+/* Set font size 👆️               */
+/**********************************/
+
+static void
+texty_window__set_line_ending (GSimpleAction *action,
+                               GVariant *parameter,
+                               TextyWindow *self)
+{
+  TextyLineEnding line_ending;
+
+  line_ending = texty_line_ending_from_string (g_variant_get_string (parameter, NULL));
+  if (line_ending == get_line_ending (self->buffer))
+    return;
+
+  /*
+   * the buffer is left as it is, the endings are rewritten while
+   * streaming the next save, so flag it as needing one
+   */
+  set_line_ending (self, line_ending);
+  gtk_text_buffer_set_modified (self->buffer, TRUE);
+}
+
+/**********************************/
+/* Set line ending 👆️             */
+/**********************************/
+
+static void
+on_buffer_changed (GtkTextBuffer *buffer,
+                   TextyWindow *self)
+{
+  /* the snapshot being worked on is out of date */
+  g_cancellable_cancel (self->line_op_cancellable);
+  g_clear_pointer (&self->filter_snapshot, g_bytes_unref);
+  hide_table (self);
+}
+
+/* a single user action, so one undo puts the whole document back */
+static void
+replace_text (TextyWindow *self,
+              GBytes *bytes)
+{
+  GtkTextIter start;
+  GtkTextIter end;
+  const char *text;
+  gsize length;
+  gint64 begin_time = TEXTY_TRACE_CURRENT_TIME;
+
+  text = g_bytes_get_data (bytes, &length);
+  gtk_text_buffer_begin_user_action (self->buffer);
+  gtk_text_buffer_get_bounds (self->buffer, &start, &end);
+  gtk_text_buffer_delete (self->buffer, &start, &end);
+  gtk_text_buffer_get_start_iter (self->buffer, &start);
+  gtk_text_buffer_insert (self->buffer, &start, text, length);
+  gtk_text_buffer_end_user_action (self->buffer);
+  texty_trace_mark (begin_time, "replace-text", "%" G_GSIZE_FORMAT " bytes", length);
+
+  gtk_text_buffer_get_start_iter (self->buffer, &start);
+  gtk_text_buffer_place_cursor (self->buffer, &start);
+}
+
+static void
+line_op_complete (GObject *source_object,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+  g_autoptr (TextyWindow) self = user_data;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GError) error = NULL;
+
+  bytes = texty_line_ops_run_finish (result, &error);
+  g_clear_object (&self->line_op_cancellable);
+
+  /* the window went away meanwhile */
+  if (self->buffer == NULL)
+    return;
+
+  if (error != NULL)
+    {
+      g_autofree char *msg = NULL;
+
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        msg = g_strdup ("The document changed, line operation cancelled");
+      else if (error->domain == G_REGEX_ERROR)
+        msg = g_strdup_printf ("Invalid pattern: %s", error->message);
+      else
+        msg = g_strdup ("Unable to change the lines");
+
+      adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+      return;
+    }
+
+  replace_text (self, bytes);
+}
+
+static void
+run_line_op (TextyWindow *self,
+             TextyLineOp op,
+             const char *pattern)
+{
+  g_autoptr (GBytes) bytes = NULL;
+
+  if (!gtk_text_view_get_editable (self->text_view))
+    {
+      adw_toast_overlay_add_toast (self->toast_overlay,
+                                   adw_toast_new ("The document is read-only"));
+      return;
+    }
+  if (self->line_op_cancellable != NULL)
+    return;
+
+  /* the worker gets a copy, so the view stays usable meanwhile */
+  bytes = texty_folding_get_document (self->buffer);
+
+  self->line_op_cancellable = g_cancellable_new ();
+  texty_line_ops_run_async (bytes,
+                            op,
+                            pattern,
+                            self->line_op_cancellable,
+                            line_op_complete,
+                            g_object_ref (self));
+}
+
+static void
+on_filter_lines_response (AdwAlertDialog *dialog,
+                          GAsyncResult *result,
+                          TextyWindow *self)
+{
+  const char *response = adw_alert_dialog_choose_finish (dialog, result);
+  GtkEditable *entry = GTK_EDITABLE (adw_alert_dialog_get_extra_child (dialog));
+
+  if (g_str_equal (response, "drop") && *gtk_editable_get_text (entry) != '\0')
+    run_line_op (self, TEXTY_LINE_OP_FILTER, gtk_editable_get_text (entry));
+}
+
+static void
+texty_window__line_op (GSimpleAction *action,
+                       GVariant *parameter,
+                       TextyWindow *self)
+{
+  TextyLineOp op;
+  AdwDialog *dialog;
+  GtkWidget *entry;
+
+  if (!texty_line_op_from_string (g_variant_get_string (parameter, NULL), &op))
+    return;
+  if (op != TEXTY_LINE_OP_FILTER)
+    {
+      run_line_op (self, op, NULL);
+      return;
+    }
+
+  /* ask which lines to drop */
+  dialog = adw_alert_dialog_new ("Drop Matching Lines",
+                                 "Lines matching this regular expression are removed.");
+  entry = gtk_entry_new ();
+  gtk_entry_set_activates_default (GTK_ENTRY (entry), TRUE);
+  adw_alert_dialog_set_extra_child (ADW_ALERT_DIALOG (dialog), entry);
+  adw_alert_dialog_set_close_response (ADW_ALERT_DIALOG (dialog), "cancel");
+  adw_alert_dialog_set_default_response (ADW_ALERT_DIALOG (dialog), "drop");
+  adw_alert_dialog_add_responses (ADW_ALERT_DIALOG (dialog),
+                                  "cancel", "_Cancel",
+                                  "drop", "_Drop",
+                                  NULL);
+  adw_alert_dialog_set_response_appearance (ADW_ALERT_DIALOG (dialog),
+                                            "drop",
+                                            ADW_RESPONSE_DESTRUCTIVE);
+
+  adw_alert_dialog_choose (ADW_ALERT_DIALOG (dialog),
+                           GTK_WIDGET (self),
+                           NULL,
+                           (GAsyncReadyCallback) on_filter_lines_response,
+                           self);
+}
+
+/**********************************/
+/* Line operations 👆️             */
+/**********************************/
+
+static void
+json_complete (GObject *source_object,
+               GAsyncResult *result,
+               gpointer user_data)
+{
+  g_autoptr (TextyWindow) self = user_data;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree char *msg = NULL;
+  TextyJsonPosition position;
+  GtkTextIter iter;
+
+  bytes = texty_json_run_finish (result, &position, &error);
+  g_clear_object (&self->line_op_cancellable);
+
+  /* the window went away meanwhile */
+  if (self->buffer == NULL)
+    return;
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      adw_toast_overlay_add_toast (self->toast_overlay,
+                                   adw_toast_new ("The document changed, JSON operation cancelled"));
+      return;
+    }
+
+  if (error != NULL)
+    {
+      /* put the cursor where the document stops being JSON */
+      gtk_text_buffer_get_iter_at_line_index (self->buffer, &iter, position.line, position.column);
+      gtk_text_buffer_place_cursor (self->buffer, &iter);
+      gtk_text_view_scroll_to_mark (self->text_view,
+                                    gtk_text_buffer_get_insert (self->buffer),
+                                    0.0, TRUE, 0.0, 0.5);
+      msg = g_strdup_printf ("Invalid JSON at line %" G_GSIZE_FORMAT ", column %d: %s",
+                             position.line + 1,
+                             gtk_text_iter_get_line_offset (&iter) + 1,
+                             error->message);
+      adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+      return;
+    }
+
+  /* only validating */
+  if (bytes == NULL)
+    {
+      adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new ("Valid JSON"));
+      return;
+    }
+
+  replace_text (self, bytes);
+}
+
+static void
+texty_window__json (GSimpleAction *action,
+                    GVariant *parameter,
+                    TextyWindow *self)
+{
+  TextyJsonOp op;
+  g_autoptr (GBytes) bytes = NULL;
+
+  if (!texty_json_op_from_string (g_variant_get_string (parameter, NULL), &op))
+    return;
+  if (op != TEXTY_JSON_OP_VALIDATE && !gtk_text_view_get_editable (self->text_view))
+    {
+      adw_toast_overlay_add_toast (self->toast_overlay,
+                                   adw_toast_new ("The document is read-only"));
+      return;
+    }
+  if (self->line_op_cancellable != NULL)
+    return;
+
+  bytes = texty_folding_get_document (self->buffer);
+
+  self->line_op_cancellable = g_cancellable_new ();
+  texty_json_run_async (bytes,
+                        op,
+                        self->line_op_cancellable,
+                        json_complete,
+                        g_object_ref (self));
+}
+
+/**********************************/
+/* JSON 👆️                        */
+/**********************************/
+
+static void
+set_filter_model (TextyWindow *self,
+                  TextyGrepModel *model)
+{
+  GtkNoSelection *selection;
+
+  g_set_object (&self->filter_model, model);
+  selection = model != NULL ? gtk_no_selection_new (G_LIST_MODEL (g_object_ref (model))) : NULL;
+  gtk_list_view_set_model (self->filter_view, GTK_SELECTION_MODEL (selection));
+  g_clear_object (&selection);
+}
+
+static void
+filter_complete (GObject *source_object,
+                 GAsyncResult *result,
+                 gpointer user_data)
+{
+  g_autoptr (TextyWindow) self = user_data;
+  g_autoptr (TextyGrepModel) model = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree char *status = NULL;
+
+  model = texty_grep_finish (result, &error);
+  /* a newer pattern took over */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+  g_clear_object (&self->filter_cancellable);
+
+  if (error != NULL)
+    {
+      gtk_label_set_text (self->filter_status, "Invalid pattern");
+      return;
+    }
+
+  set_filter_model (self, model);
+  status = g_strdup_printf ("%u matching lines", texty_grep_model_get_n_matches (model));
+  gtk_label_set_text (self->filter_status, status);
+}
+
+static void
+run_filter (TextyWindow *self)
+{
+  const char *pattern;
+
+  g_cancellable_cancel (self->filter_cancellable);
+  g_clear_object (&self->filter_cancellable);
+
+  pattern = gtk_editable_get_text (GTK_EDITABLE (self->filter_entry));
+  /* the matches stay marked on the minimap after going back to the text */
+  texty_minimap_set_pattern (self->minimap, pattern);
+  if (*pattern == '\0')
+    {
+      set_filter_model (self, NULL);
+      gtk_label_set_text (self->filter_status, "");
+      return;
+    }
+
+  /* folded lines are filtered too, keeping line numbers those of the buffer */
+  if (self->filter_snapshot == NULL)
+    self->filter_snapshot = texty_folding_get_document (self->buffer);
+
+  /* the previous result lets a longer word only recheck its lines */
+  self->filter_cancellable = g_cancellable_new ();
+  texty_grep_async (self->filter_snapshot,
+                    pattern,
+                    gtk_spin_button_get_value_as_int (self->filter_context),
+                    self->filter_model,
+                    self->filter_cancellable,
+                    filter_complete,
+                    g_object_ref (self));
+}
+
+static void
+on_filter_changed (TextyWindow *self)
+{
+  run_filter (self);
+}
+
+static void
+on_filter_mode_changed (GtkSearchBar *bar,
+                        GParamSpec *pspec,
+                        TextyWindow *self)
+{
+  if (gtk_search_bar_get_search_mode (bar))
+    {
+      hide_table (self);
+      gtk_stack_set_visible_child_name (self->view_stack, "filter");
+      run_filter (self);
+      return;
+    }
+
+  /* back to the document, letting go of the snapshot */
+  g_cancellable_cancel (self->filter_cancellable);
+  g_clear_object (&self->filter_cancellable);
+  g_clear_pointer (&self->filter_snapshot, g_bytes_unref);
+  set_filter_model (self, NULL);
+  gtk_stack_set_visible_child_name (self->view_stack, "text");
+  gtk_widget_grab_focus (GTK_WIDGET (self->text_view));
+}
+
+static void
+on_filter_activate (GtkListView *list_view,
+                    guint position,
+                    TextyWindow *self)
+{
+  g_autoptr (TextyGrepLine) line = NULL;
+  GtkTextIter iter;
+
+  line = g_list_model_get_item (G_LIST_MODEL (self->filter_model), position);
+  if (line == NULL)
+    return;
+
+  /* jump to the line in the document */
+  gtk_search_bar_set_search_mode (self->filter_bar, FALSE);
+  gtk_text_buffer_get_iter_at_line (self->buffer, &iter, texty_grep_line_get_number (line));
+  gtk_text_buffer_place_cursor (self->buffer, &iter);
+  gtk_text_view_scroll_to_mark (self->text_view,
+                                gtk_text_buffer_get_insert (self->buffer),
+                                0.0, TRUE, 0.0, 0.5);
+}
+
+static void
+setup_filter_row (GtkSignalListItemFactory *factory,
+                  GtkListItem *item,
+                  gpointer user_data)
+{
+  GtkWidget *box;
+  GtkWidget *number;
+  GtkWidget *text;
+
+  box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 12);
+  number = gtk_label_new (NULL);
+  gtk_label_set_xalign (GTK_LABEL (number), 1);
+  gtk_label_set_width_chars (GTK_LABEL (number), 7);
+  gtk_widget_add_css_class (number, "dim-label");
+  gtk_widget_add_css_class (number, "numeric");
+  text = gtk_label_new (NULL);
+  gtk_label_set_xalign (GTK_LABEL (text), 0);
+  gtk_label_set_ellipsize (GTK_LABEL (text), PANGO_ELLIPSIZE_END);
+  gtk_label_set_single_line_mode (GTK_LABEL (text), TRUE);
+  gtk_widget_set_hexpand (text, TRUE);
+  gtk_widget_add_css_class (text, "monospace");
+
+  gtk_box_append (GTK_BOX (box), number);
+  gtk_box_append (GTK_BOX (box), text);
+  gtk_list_item_set_child (item, box);
+}
+
+static void
+bind_filter_row (GtkSignalListItemFactory *factory,
+                 GtkListItem *item,
+                 gpointer user_data)
+{
+  TextyGrepLine *line = gtk_list_item_get_item (item);
+  GtkWidget *number = gtk_widget_get_first_child (gtk_list_item_get_child (item));
+  GtkWidget *text = gtk_widget_get_next_sibling (number);
+  g_autofree char *str = NULL;
+
+  str = g_strdup_printf ("%u", texty_grep_line_get_number (line) + 1);
+  gtk_label_set_text (GTK_LABEL (number), str);
+  gtk_label_set_text (GTK_LABEL (text), texty_grep_line_get_text (line));
+  /* context lines are dimmed */
+  if (texty_grep_line_is_match (line))
+    gtk_widget_remove_css_class (text, "dim-label");
+  else
+    gtk_widget_add_css_class (text, "dim-label");
+}
+
+static void
+texty_window__filter (GAction *action G_GNUC_UNUSED,
+                      GVariant *param G_GNUC_UNUSED,
+                      TextyWindow *self)
+{
+  gtk_search_bar_set_search_mode (self->filter_bar,
+                                  !gtk_search_bar_get_search_mode (self->filter_bar));
+}
+
+/**********************************/
+/* Filter 👆️                      */
+/**********************************/
+
+static GBytes *
+get_buffer_bytes (TextyWindow *self)
+{
+  return texty_folding_get_document (self->buffer);
+}
+
+/* loads 'file' to be compared with the document, NULL after a toast */
+static GBytes *
+compare_load_finish (TextyWindow *self,
+                     GFile *file,
+                     GAsyncResult *result)
+{
+  g_autoptr (GError) error = NULL;
+  GBytes *bytes;
+
+  bytes = texty_file_load_finish (file, result, NULL, NULL, &error);
+  if (bytes != NULL && !texty_file_validate_utf8 (bytes, NULL))
+    g_clear_pointer (&bytes, g_bytes_unref);
+  if (bytes == NULL)
+    {
+      g_autofree char *basename = g_file_get_basename (file);
+      g_autofree char *msg = g_strdup_printf ("Unable to open “%s”", basename);
+
+      adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
+    }
+
+  return bytes;
+}
+
+static void
+compare_saved_complete (GObject *source_object,
+                        GAsyncResult *result,
+                        gpointer user_data)
+{
+  g_autoptr (TextyWindow) self = user_data;
+  GFile *file = G_FILE (source_object);
+  g_autoptr (GBytes) saved = NULL;
+  g_autoptr (GBytes) current = NULL;
+  g_autofree char *basename = NULL;
+  g_autofree char *saved_title = NULL;
+
+  saved = compare_load_finish (self, file, result);
+  if (saved == NULL || self->buffer == NULL)
+    return;
+
+  /* what is on disk on the left, the unsaved document on the right */
+  current = get_buffer_bytes (self);
+  basename = g_file_get_basename (file);
+  saved_title = g_strdup_printf ("%s (saved)", basename);
+  adw_dialog_present (texty_compare_dialog_new (saved, saved_title, current, basename),
+                      GTK_WIDGET (self));
+}
+
+static void
+compare_file_complete (GObject *source_object,
+                       GAsyncResult *result,
+                       gpointer user_data)
+{
+  g_autoptr (TextyWindow) self = user_data;
+  GFile *file = G_FILE (source_object);
+  GFile *current_file;
+  g_autoptr (GBytes) other = NULL;
+  g_autoptr (GBytes) current = NULL;
+  g_autofree char *current_title = NULL;
+  g_autofree char *other_title = NULL;
+
+  other = compare_load_finish (self, file, result);
+  if (other == NULL || self->buffer == NULL)
+    return;
+
+  /* the document on the left, the other file on the right */
+  current = get_buffer_bytes (self);
+  current_file = get_current_file (self->buffer);
+  current_title = current_file != NULL ? g_file_get_basename (current_file) : g_strdup ("Untitled");
+  other_title = g_file_get_basename (file);
+  adw_dialog_present (texty_compare_dialog_new (current, current_title, other, other_title),
+                      GTK_WIDGET (self));
+}
+
+static void
+on_compare_file_response (GObject *source,
+                          GAsyncResult *result,
+                          gpointer user_data)
+{
+  GtkFileDialog *dialog = GTK_FILE_DIALOG (source);
+  TextyWindow *self = user_data;
+
+  g_autoptr (GFile) file = gtk_file_dialog_open_finish (dialog, result, NULL);
+  if (file != NULL)
+    texty_file_load_async (file, G_MAXSIZE, NULL, compare_file_complete, g_object_ref (self));
+}
+
+static void
+texty_window__compare (GSimpleAction *action,
+                       GVariant *parameter,
+                       TextyWindow *self)
+{
+  GFile *file;
+
+  if (g_str_equal (g_variant_get_string (parameter, NULL), "saved"))
+    {
+      file = get_current_file (self->buffer);
+      if (file == NULL)
+        {
+          adw_toast_overlay_add_toast (self->toast_overlay,
+                                       adw_toast_new ("The document hasn’t been saved yet"));
+          return;
+        }
+      texty_file_load_async (file, G_MAXSIZE, NULL, compare_saved_complete, g_object_ref (self));
+    }
+  else
+    {
+      g_autoptr (GtkFileDialog) dialog = gtk_file_dialog_new ();
+
+      gtk_file_dialog_set_title (dialog, "Compare With");
+      gtk_file_dialog_open (dialog,
+                            GTK_WINDOW (self),
+                            NULL,
+                            on_compare_file_response,
+                            self);
+    }
+}
+
+/**********************************/
+/* Compare 👆️                     */
+/**********************************/
+
+/* columns past these are left out, wide files would be unusable anyway */
+#define MAX_TABLE_COLUMNS 256
+
+static void
+set_table_state (TextyWindow *self,
+                 gboolean shown)
+{
+  GAction *action;
+
+  action = g_action_map_lookup_action (G_ACTION_MAP (self), "show-table");
+  if (action != NULL)
+    g_simple_action_set_state (G_SIMPLE_ACTION (action), g_variant_new_boolean (shown));
+}
+
+static void
+setup_table_cell (GtkSignalListItemFactory *factory,
+                  GtkListItem *item,
+                  gpointer user_data)
+{
+  GtkWidget *cell;
+
+  /* inscriptions are cheap to recycle while scrolling through many rows */
+  cell = gtk_inscription_new (NULL);
+  gtk_inscription_set_nat_chars (GTK_INSCRIPTION (cell), 16);
+  gtk_inscription_set_text_overflow (GTK_INSCRIPTION (cell), GTK_INSCRIPTION_OVERFLOW_ELLIPSIZE_END);
+  gtk_list_item_set_child (item, cell);
+}
+
+static void
+setup_table_number (GtkSignalListItemFactory *factory,
+                    GtkListItem *item,
+                    gpointer user_data)
+{
+  GtkWidget *cell;
+
+  cell = gtk_inscription_new (NULL);
+  gtk_inscription_set_nat_chars (GTK_INSCRIPTION (cell), 7);
+  gtk_inscription_set_xalign (GTK_INSCRIPTION (cell), 1);
+  gtk_widget_add_css_class (cell, "dim-label");
+  gtk_widget_add_css_class (cell, "numeric");
+  gtk_list_item_set_child (item, cell);
+}
+
+/* fields are only split out of the rows being shown */
+static void
+bind_table_cell (GtkSignalListItemFactory *factory,
+                 GtkListItem *item,
+                 gpointer user_data)
+{
+  TextyCsvRow *row = gtk_list_item_get_item (item);
+  g_autofree char *field = NULL;
+
+  field = texty_csv_row_get_field (row, GPOINTER_TO_UINT (user_data));
+  gtk_inscription_set_text (GTK_INSCRIPTION (gtk_list_item_get_child (item)), field);
+}
+
+static void
+bind_table_number (GtkSignalListItemFactory *factory,
+                   GtkListItem *item,
+                   gpointer user_data)
+{
+  TextyCsvRow *row = gtk_list_item_get_item (item);
+  g_autofree char *str = NULL;
 
-  adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new (msg));
-  /* put cursor in textview */
-  gtk_widget_grab_focus (GTK_WIDGET (self->text_view));
+  str = g_strdup_printf ("%u", texty_csv_row_get_number (row));
+  gtk_inscription_set_text (GTK_INSCRIPTION (gtk_list_item_get_child (item)), str);
 }
 
 static void
-save_file_as (TextyWindow *self,
-              GFile *file)
+append_table_column (TextyWindow *self,
+                     const char *title,
+                     GCallback setup,
+                     GCallback bind,
+                     gpointer user_data)
 {
-  GtkTextBuffer *buffer;
-  GtkTextIter start;
-  GtkTextIter end;
-  char *text;
-  g_autoptr (GBytes) bytes;
+  GtkListItemFactory *factory;
+  GtkColumnViewColumn *column;
+
+  factory = gtk_signal_list_item_factory_new ();
+  g_signal_connect (factory, "setup", setup, NULL);
+  g_signal_connect (factory, "bind", bind, user_data);
+  column = gtk_column_view_column_new (title, factory);
+  gtk_column_view_column_set_resizable (column, TRUE);
+  gtk_column_view_append_column (self->table_view, column);
+  g_object_unref (column);
+}
 
-  buffer = gtk_text_view_get_buffer (self->text_view);
+static void
+hide_table (TextyWindow *self)
+{
+  GListModel *columns;
 
-  /* Retrieve the iterators at the start and end of the buffer */
-  gtk_text_buffer_get_start_iter (buffer, &start);
-  gtk_text_buffer_get_end_iter (buffer, &end);
+  if (self->table_model == NULL)
+    return;
 
-  /* Retrieve all the visible text between the two bounds */
-  text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+  columns = gtk_column_view_get_columns (self->table_view);
+  while (g_list_model_get_n_items (columns) > 0)
+    {
+      g_autoptr (GtkColumnViewColumn) column = g_list_model_get_item (columns, 0);
 
-  bytes = g_bytes_new_take (text, strlen (text));
+      gtk_column_view_remove_column (self->table_view, column);
+    }
+  gtk_column_view_set_model (self->table_view, NULL);
+  /* stops the chunks still being scanned */
+  g_clear_object (&self->table_model);
 
-  /* Start the asynchronous operation to save the data into the file */
-  g_file_replace_contents_bytes_async (file,
-                                       bytes,
-                                       NULL,
-                                       FALSE,
-                                       G_FILE_CREATE_NONE,
-                                       NULL,
-                                       save_file_as_complete,
-                                       self);
+  if (g_strcmp0 (gtk_stack_get_visible_child_name (self->view_stack), "table") == 0)
+    gtk_stack_set_visible_child_name (self->view_stack, "text");
+  set_table_state (self, FALSE);
 }
 
 static void
-on_save_as_response (GObject *source,
-                     GAsyncResult *result,
-                     gpointer user_data)
+show_table (TextyWindow *self)
 {
-  GtkFileDialog *dialog = GTK_FILE_DIALOG (source);
-  TextyWindow *self = user_data;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GtkNoSelection) selection = NULL;
+  g_autofree char *name = NULL;
+  GFile *file;
+  guint n_columns;
 
-  /* get the selected file and write the buffer contents into it */
-  g_autoptr (GFile) file = gtk_file_dialog_save_finish (dialog, result, NULL);
+  /* the filter and the table share the space below the header bar */
+  gtk_search_bar_set_search_mode (self->filter_bar, FALSE);
+
+  file = get_current_file (self->buffer);
   if (file != NULL)
+    name = g_file_get_basename (file);
+  /*
+   * taken from the buffer rather than mapped from disk, where a followed
+   * file may be truncated under the mapping
+   */
+  bytes = texty_folding_get_document (self->buffer);
+  self->table_model = texty_csv_model_new (bytes, texty_csv_guess_delimiter (bytes, name));
+
+  append_table_column (self, "#", G_CALLBACK (setup_table_number), G_CALLBACK (bind_table_number), NULL);
+  n_columns = MIN (texty_csv_model_get_n_columns (self->table_model), MAX_TABLE_COLUMNS);
+  for (guint i = 0; i < n_columns; i++)
     {
-      save_file_as (self, file);
+      g_autofree char *title = texty_csv_model_get_title (self->table_model, i);
+
+      append_table_column (self,
+                           title,
+                           G_CALLBACK (setup_table_cell),
+                           G_CALLBACK (bind_table_cell),
+                           GUINT_TO_POINTER (i));
     }
+
+  /* rows appear as the chunks before them are scanned */
+  selection = gtk_no_selection_new (G_LIST_MODEL (g_object_ref (self->table_model)));
+  gtk_column_view_set_model (self->table_view, GTK_SELECTION_MODEL (selection));
+  gtk_stack_set_visible_child_name (self->view_stack, "table");
+  set_table_state (self, TRUE);
 }
 
 static void
-texty_window__save_as (GAction *action,
-                       GVariant *parameter,
-                       TextyWindow *self)
+texty_window__show_table (GSimpleAction *action,
+                          GVariant *parameter,
+                          TextyWindow *self)
 {
-  g_autoptr (GtkFileDialog) dialog = gtk_file_dialog_new ();
-  /* present save file dialog */
-  gtk_file_dialog_save (dialog,
-                        GTK_WINDOW (self),
-                        NULL,
-                        on_save_as_response,
-                        self);
+  if (self->table_model != NULL)
+    {
+      hide_table (self);
+      gtk_widget_grab_focus (GTK_WIDGET (self->text_view));
+    }
+  else
+    {
+      show_table (self);
+    }
 }
 
 /**********************************/
-/* Save As 👆️                     */
+/* Table 👆️                       */
 /**********************************/
 
 static void
-texty_window__update_cursor_position (GtkTextBuffer *buffer,
-                                      GParamSpec *pspec,
-                                      TextyWindow *self)
+on_follower_appended (TextyFileFollower *follower,
+                      gboolean trimmed,
+                      TextyWindow *self)
 {
-  GtkTextIter iter;
-  g_autofree char *cursor_str;
+  GtkTextIter end;
+  GtkTextMark *mark;
 
-  int cursor_pos = 0;
+  /* the buffer no longer holds the whole file */
+  if (trimmed)
+    set_partial (self->buffer, TRUE);
 
-  /* Retrieve the value of the "cursor-position" property */
-  g_object_get (buffer, "cursor-position", &cursor_pos, NULL);
+  /* keep the newest lines in view */
+  gtk_text_buffer_get_end_iter (self->buffer, &end);
+  mark = gtk_text_buffer_get_mark (self->buffer, "follow-end");
+  if (mark == NULL)
+    mark = gtk_text_buffer_create_mark (self->buffer, "follow-end", &end, FALSE);
+  else
+    gtk_text_buffer_move_mark (self->buffer, mark, &end);
+  gtk_text_view_scroll_mark_onscreen (self->text_view, mark);
+}
 
-  /* Construct the text iterator for the position of the cursor */
-  gtk_text_buffer_get_iter_at_offset (buffer, &iter, cursor_pos);
+static void
+texty_window__follow (GSimpleAction *action,
+                      GVariant *parameter,
+                      TextyWindow *self)
+{
+  TextyFileFollower *follower;
+  GFile *file;
 
-  /* Set the new contents of the label */
-  cursor_str = g_strdup_printf ("Ln %d, Col %d",
-                                gtk_text_iter_get_line (&iter) + 1,
-                                gtk_text_iter_get_line_offset (&iter) + 1);
+  if (get_follower (self->buffer) != NULL)
+    {
+      stop_following (self);
+      return;
+    }
 
-  gtk_label_set_text (self->cursor_pos, cursor_str);
+  file = get_current_file (self->buffer);
+  if (file == NULL)
+    {
+      adw_toast_overlay_add_toast (self->toast_overlay,
+                                   adw_toast_new ("Open a file to follow it"));
+      return;
+    }
+  if (get_compression (self->buffer) != TEXTY_COMPRESSION_NONE)
+    {
+      adw_toast_overlay_add_toast (self->toast_overlay,
+                                   adw_toast_new ("Compressed files can’t be followed"));
+      return;
+    }
+
+  /* the buffer owns the follower so it stops along with the document */
+  follower = texty_file_follower_new (self->buffer, file, get_follow_max_lines ());
+  g_object_set_data_full (G_OBJECT (self->buffer), "follower", follower, (GDestroyNotify) free_follower);
+  g_signal_connect_object (follower,
+                           "appended",
+                           G_CALLBACK (on_follower_appended),
+                           self,
+                           0);
+
+  g_simple_action_set_state (action, g_variant_new_boolean (TRUE));
+  update_editable (self);
+  on_follower_appended (follower, FALSE, self);
 }
 
 /**********************************/
-/* Update Cursor Position 👆️      */
+/* Follow 👆️                      */
 /**********************************/
 
 static void
-texty_window__toggle_text_wrap (GSimpleAction *action,
-                                GVariant *parameter,
-                                TextyWindow *self)
+on_paste_progress (TextyPaste *paste,
+                   TextyWindow *self)
 {
-  GVariant *state;
-  gboolean current_state;
+  g_autofree char *size = NULL;
+  g_autofree char *title = NULL;
+
+  /* only pastes that take a while report progress, so short ones don't flash the banner */
+  size = g_format_size (texty_paste_get_bytes_inserted (paste));
+  title = g_strdup_printf ("Pasting… %s", size);
+  adw_banner_set_title (self->paste_banner, title);
+  adw_banner_set_revealed (self->paste_banner, TRUE);
+}
 
-  state = g_action_get_state (G_ACTION (action));
-  current_state = g_variant_get_boolean (state);
-  g_variant_unref (state);
+static void
+on_paste_finished (TextyPaste *paste,
+                   gboolean cancelled,
+                   TextyWindow *self)
+{
+  adw_banner_set_revealed (self->paste_banner, FALSE);
+  if (cancelled)
+    adw_toast_overlay_add_toast (self->toast_overlay, adw_toast_new ("Paste cancelled"));
+}
 
-  current_state = !current_state;
+static void
+on_paste_cancel_clicked (AdwBanner *banner,
+                         TextyWindow *self)
+{
+  texty_paste_cancel (self->paste);
+}
 
-  gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (self->text_view),
-                               current_state ? GTK_WRAP_WORD : GTK_WRAP_NONE);
+static void
+on_paste_clipboard (GtkTextView *text_view,
+                    TextyWindow *self)
+{
+  /* replace the blocking default handler */
+  g_signal_stop_emission_by_name (text_view, "paste-clipboard");
 
-  g_simple_action_set_state (action, g_variant_new_boolean (current_state));
-  save_text_wrap (current_state);
+  if (texty_paste_is_running (self->paste))
+    return;
+  /* the chunks are inserted as they come, not as typed, so refuse up front */
+  if (!gtk_text_view_get_editable (text_view))
+    {
+      gtk_widget_error_bell (GTK_WIDGET (text_view));
+      return;
+    }
+  texty_paste_start (self->paste, gtk_widget_get_clipboard (GTK_WIDGET (text_view)));
 }
 
 /**********************************/
-/* Toggle text wrap 👆️            */
+/* Paste 👆️                       */
 /**********************************/
 
+/* puts the selection on the clipboard without copying it out of the buffer */
+static gboolean
+copy_selection (TextyWindow *self)
+{
+  g_autoptr (GdkContentProvider) provider = NULL;
+  GtkTextIter start;
+  GtkTextIter end;
+
+  if (!gtk_text_buffer_get_selection_bounds (self->buffer, &start, &end))
+    return FALSE;
+
+  provider = texty_clipboard_new (self->buffer, &start, &end);
+  gdk_clipboard_set_content (gtk_widget_get_clipboard (GTK_WIDGET (self->text_view)), provider);
+
+  return TRUE;
+}
+
 static void
-texty_window__set_font_size (GSimpleAction *action,
-                             GVariant *parameter,
-                             TextyWindow *self)
+on_copy_clipboard (GtkTextView *text_view,
+                   TextyWindow *self)
 {
-  gint font_size;
-  char *css_class_name;
-  const char *css_classes[2];
-  GtkCssProvider *provider;
-  char *css;
-  GdkDisplay *display;
+  /* replace the default handler, which copies the whole selection */
+  g_signal_stop_emission_by_name (text_view, "copy-clipboard");
 
-  font_size = g_variant_get_int32 (parameter);
+  copy_selection (self);
+}
 
-  css_class_name = g_strdup_printf ("font-size-%d", font_size);
-  css_classes[0] = css_class_name;
-  css_classes[1] = NULL; // Null-terminate the array
-  gtk_widget_set_css_classes (GTK_WIDGET (self->text_view), css_classes);
-  provider = gtk_css_provider_new ();
-  css = g_strdup_printf ("textview.%s { font-size: %dpx; font-family: monospace; }", css_class_name, font_size);
-  gtk_css_provider_load_from_string (provider, css);
-  display = gdk_display_get_default ();
-  gtk_style_context_add_provider_for_display (display,
-                                              GTK_STYLE_PROVIDER (provider),
-                                              GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-  g_free (css);
-  g_free (css_class_name);
-  g_object_unref (provider);
+static void
+on_cut_clipboard (GtkTextView *text_view,
+                  TextyWindow *self)
+{
+  g_signal_stop_emission_by_name (text_view, "cut-clipboard");
 
-  g_simple_action_set_state (action, parameter);
-  save_font_size (g_variant_get_int32 (parameter));
+  if (!copy_selection (self))
+    return;
+
+  /* the provider keeps its own copy of the text once it is deleted */
+  gtk_text_buffer_delete_selection (self->buffer, TRUE, gtk_text_view_get_editable (text_view));
+  gtk_text_view_scroll_mark_onscreen (text_view, gtk_text_buffer_get_insert (self->buffer));
 }
 
 /**********************************/
-/* Set font size 👆️               */
+/* Copy 👆️                        */
 /**********************************/
 
 static void
@@ -882,6 +2905,7 @@ on_close_save_response (GObject *source,
   if (file != NULL)
     {
       set_current_file (self->buffer, file);
+      set_compression (self->buffer, texty_compression_from_file (file));
       save_file (self);
     }
 }
@@ -958,9 +2982,9 @@ on_close_request (TextyWindow *self,
 
   save_window_size (self);
 
-  /* check if text buffer has been changed */
+  /* check if text buffer has been changed, the changes live on in other windows */
   buffer = gtk_text_view_get_buffer (self->text_view);
-  modified = gtk_text_buffer_get_modified (buffer);
+  modified = gtk_text_buffer_get_modified (buffer) && get_views (buffer) == 1;
   if (modified)
     {
       /* prompt user to save file */
@@ -993,11 +3017,41 @@ on_close_request (TextyWindow *self,
 /* Closing 👆️                     */
 /**********************************/
 
+static void
+texty_window_dispose (GObject *object)
+{
+  TextyWindow *self = TEXTY_WINDOW (object);
+
+  if (self->paste != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (self->paste, self);
+      texty_paste_cancel (self->paste);
+    }
+  g_clear_object (&self->paste);
+  release_buffer (self);
+  g_clear_object (&self->line_op_cancellable);
+  g_cancellable_cancel (self->filter_cancellable);
+  g_clear_object (&self->filter_cancellable);
+  g_clear_object (&self->filter_model);
+  g_clear_object (&self->path_index);
+  g_clear_object (&self->completion);
+  g_clear_object (&self->spell_checker);
+  g_clear_object (&self->latency_monitor);
+
+  G_OBJECT_CLASS (texty_window_parent_class)->dispose (object);
+}
+
 static void
 texty_window_class_init (TextyWindowClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+  object_class->dispose = texty_window_dispose;
+
+  g_type_ensure (TEXTY_TYPE_MINIMAP);
+  g_type_ensure (TEXTY_TYPE_SIDEBAR);
+
   gtk_widget_class_set_template_from_resource (widget_class,
                                                "/ca/footeware/c/texty/texty-window.ui");
 
@@ -1013,9 +3067,54 @@ texty_window_class_init (TextyWindowClass *klass)
   gtk_widget_class_bind_template_child (widget_class,
                                         TextyWindow,
                                         cursor_pos);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        line_ending_button);
   gtk_widget_class_bind_template_child (widget_class,
                                         TextyWindow,
                                         toast_overlay);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        paste_banner);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        view_stack);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        filter_bar);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        filter_entry);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        filter_context);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        filter_status);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        filter_view);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        table_view);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        minimap);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        split_view);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        sidebar);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        latency_overlay);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        latency_label);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        TextyWindow,
+                                        recent_menu);
 }
 
 static void
@@ -1026,8 +3125,26 @@ texty_window_init (TextyWindow *self)
   g_autoptr (GSimpleAction) open_action;
   g_autoptr (GSimpleAction) save_as_action;
   g_autoptr (GSimpleAction) toggle_text_wrap_action;
+  g_autoptr (GSimpleAction) toggle_backups_action;
+  g_autoptr (GSimpleAction) toggle_minimap_action;
+  g_autoptr (GSimpleAction) toggle_spell_check_action;
+  g_autoptr (GSimpleAction) toggle_latency_overlay_action;
+  g_autoptr (GSimpleAction) export_latency_action;
+  g_autoptr (GSimpleAction) fold_action;
+  g_autoptr (GSimpleAction) open_folder_action;
+  g_autoptr (GPropertyAction) toggle_sidebar_action;
+  g_autoptr (GSimpleAction) quick_open_action;
+  g_autoptr (GSimpleAction) open_recent_action;
+  g_autoptr (GSimpleAction) unfold_all_action;
   g_autoptr (GSimpleAction) set_font_size_action;
-  GtkTextBuffer *buffer;
+  g_autoptr (GSimpleAction) set_line_ending_action;
+  g_autoptr (GSimpleAction) follow_action;
+  g_autoptr (GSimpleAction) line_op_action;
+  g_autoptr (GSimpleAction) json_action;
+  g_autoptr (GSimpleAction) filter_action;
+  g_autoptr (GSimpleAction) compare_action;
+  g_autoptr (GSimpleAction) show_table_action;
+  g_autoptr (GtkListItemFactory) filter_factory;
   GtkCssProvider *css_provider;
   gboolean text_wrap;
   int font_size;
@@ -1038,8 +3155,7 @@ texty_window_init (TextyWindow *self)
 
   gtk_widget_init_template (GTK_WIDGET (self));
 
-  self->buffer = gtk_text_view_get_buffer (self->text_view);
-  g_object_set_data (G_OBJECT (self->buffer), "current-file", NULL);
+  texty_window_set_buffer (self, gtk_text_view_get_buffer (self->text_view));
 
   /* save */
   save_action = g_simple_action_new ("save", NULL);
@@ -1091,12 +3207,113 @@ texty_window_init (TextyWindow *self)
                                text_wrap ? GTK_WRAP_WORD : GTK_WRAP_NONE);
   g_simple_action_set_state (toggle_text_wrap_action, g_variant_new_boolean (text_wrap));
 
-  /* cursor position */
-  buffer = gtk_text_view_get_buffer (self->text_view);
-  g_signal_connect (buffer,
-                    "notify::cursor-position",
-                    G_CALLBACK (texty_window__update_cursor_position),
+  /* backups */
+  toggle_backups_action = g_simple_action_new_stateful ("toggle-backups",
+                                                        NULL,
+                                                        g_variant_new_boolean (get_backups ()));
+  g_signal_connect (toggle_backups_action,
+                    "activate",
+                    G_CALLBACK (texty_window__toggle_backups),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (toggle_backups_action));
+
+  /* minimap */
+  toggle_minimap_action = g_simple_action_new_stateful ("toggle-minimap",
+                                                        NULL,
+                                                        g_variant_new_boolean (get_show_minimap ()));
+  g_signal_connect (toggle_minimap_action,
+                    "activate",
+                    G_CALLBACK (texty_window__toggle_minimap),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (toggle_minimap_action));
+  gtk_widget_set_visible (GTK_WIDGET (self->minimap), get_show_minimap ());
+  texty_minimap_set_view (self->minimap, self->text_view);
+
+  /* word completion */
+  self->completion = texty_completion_new (self->text_view);
+
+  /* spell checking, greyed out without a dictionary */
+  self->spell_checker = texty_spell_checker_new (self->text_view);
+  toggle_spell_check_action = g_simple_action_new_stateful ("toggle-spell-check",
+                                                            NULL,
+                                                            g_variant_new_boolean (get_spell_check ()));
+  g_signal_connect (toggle_spell_check_action,
+                    "activate",
+                    G_CALLBACK (texty_window__toggle_spell_check),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (toggle_spell_check_action));
+  g_simple_action_set_enabled (toggle_spell_check_action, texty_spell_checker_is_available ());
+  texty_spell_checker_set_enabled (self->spell_checker, get_spell_check ());
+
+  /* latency overlay */
+  self->latency_monitor = texty_latency_monitor_new (self->text_view);
+  g_signal_connect_object (self->latency_monitor,
+                           "updated",
+                           G_CALLBACK (on_latency_updated),
+                           self,
+                           0);
+  toggle_latency_overlay_action = g_simple_action_new_stateful ("toggle-latency-overlay",
+                                                                NULL,
+                                                                g_variant_new_boolean (FALSE));
+  g_signal_connect (toggle_latency_overlay_action,
+                    "activate",
+                    G_CALLBACK (texty_window__toggle_latency_overlay),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (toggle_latency_overlay_action));
+  export_latency_action = g_simple_action_new ("export-latency", NULL);
+  g_signal_connect (export_latency_action,
+                    "activate",
+                    G_CALLBACK (texty_window__export_latency),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (export_latency_action));
+
+  /* sidebar */
+  toggle_sidebar_action = g_property_action_new ("toggle-sidebar", self->split_view, "show-sidebar");
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (toggle_sidebar_action));
+  open_folder_action = g_simple_action_new ("open-folder", NULL);
+  g_signal_connect (open_folder_action,
+                    "activate",
+                    G_CALLBACK (texty_window__open_folder),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (open_folder_action));
+  g_signal_connect (self->sidebar,
+                    "file-activated",
+                    G_CALLBACK (on_sidebar_file_activated),
+                    self);
+
+  /* quick open */
+  quick_open_action = g_simple_action_new ("quick-open", NULL);
+  g_signal_connect (quick_open_action,
+                    "activate",
+                    G_CALLBACK (texty_window__quick_open),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (quick_open_action));
+
+  /* open recent */
+  open_recent_action = g_simple_action_new ("open-recent", G_VARIANT_TYPE_STRING);
+  g_signal_connect (open_recent_action,
+                    "activate",
+                    G_CALLBACK (texty_window__open_recent),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (open_recent_action));
+  g_signal_connect_swapped (adw_split_button_get_popover (ADW_SPLIT_BUTTON (self->save_button)),
+                            "show",
+                            G_CALLBACK (update_recent_menu),
+                            self);
+
+  /* folding */
+  fold_action = g_simple_action_new ("fold", NULL);
+  g_signal_connect (fold_action,
+                    "activate",
+                    G_CALLBACK (texty_window__fold),
                     self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (fold_action));
+  unfold_all_action = g_simple_action_new ("unfold-all", NULL);
+  g_signal_connect (unfold_all_action,
+                    "activate",
+                    G_CALLBACK (texty_window__unfold_all),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (unfold_all_action));
 
   /* set font size */
   set_font_size_action = g_simple_action_new_stateful ("set-font-size",
@@ -1125,9 +3342,125 @@ texty_window_init (TextyWindow *self)
   g_free (css_class_name);
   g_object_unref (css_provider);
 
+  /* line endings */
+  set_line_ending_action = g_simple_action_new_stateful ("set-line-ending",
+                                                         G_VARIANT_TYPE_STRING,
+                                                         g_variant_new_string ("lf"));
+  g_signal_connect (set_line_ending_action,
+                    "activate",
+                    G_CALLBACK (texty_window__set_line_ending),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (set_line_ending_action));
+  set_line_ending (self, TEXTY_LINE_ENDING_LF);
+
+  /* follow */
+  follow_action = g_simple_action_new_stateful ("follow",
+                                                NULL,
+                                                g_variant_new_boolean (FALSE));
+  g_signal_connect (follow_action,
+                    "activate",
+                    G_CALLBACK (texty_window__follow),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (follow_action));
+
+  /* line operations */
+  line_op_action = g_simple_action_new ("line-op", G_VARIANT_TYPE_STRING);
+  g_signal_connect (line_op_action,
+                    "activate",
+                    G_CALLBACK (texty_window__line_op),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (line_op_action));
+
+  /* json */
+  json_action = g_simple_action_new ("json", G_VARIANT_TYPE_STRING);
+  g_signal_connect (json_action,
+                    "activate",
+                    G_CALLBACK (texty_window__json),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (json_action));
+
+  /* filter */
+  filter_action = g_simple_action_new ("filter", NULL);
+  g_signal_connect (filter_action,
+                    "activate",
+                    G_CALLBACK (texty_window__filter),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (filter_action));
+  filter_factory = gtk_signal_list_item_factory_new ();
+  g_signal_connect (filter_factory, "setup", G_CALLBACK (setup_filter_row), NULL);
+  g_signal_connect (filter_factory, "bind", G_CALLBACK (bind_filter_row), NULL);
+  gtk_list_view_set_factory (self->filter_view, filter_factory);
+  gtk_search_bar_connect_entry (self->filter_bar, GTK_EDITABLE (self->filter_entry));
+  g_signal_connect (self->filter_bar,
+                    "notify::search-mode-enabled",
+                    G_CALLBACK (on_filter_mode_changed),
+                    self);
+  g_signal_connect_swapped (self->filter_entry,
+                            "search-changed",
+                            G_CALLBACK (on_filter_changed),
+                            self);
+  g_signal_connect_swapped (self->filter_context,
+                            "value-changed",
+                            G_CALLBACK (on_filter_changed),
+                            self);
+  g_signal_connect (self->filter_view,
+                    "activate",
+                    G_CALLBACK (on_filter_activate),
+                    self);
+
+  /* compare */
+  compare_action = g_simple_action_new ("compare", G_VARIANT_TYPE_STRING);
+  g_signal_connect (compare_action,
+                    "activate",
+                    G_CALLBACK (texty_window__compare),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (compare_action));
+
+  /* table */
+  show_table_action = g_simple_action_new_stateful ("show-table",
+                                                    NULL,
+                                                    g_variant_new_boolean (FALSE));
+  g_signal_connect (show_table_action,
+                    "activate",
+                    G_CALLBACK (texty_window__show_table),
+                    self);
+  g_action_map_add_action (G_ACTION_MAP (self), G_ACTION (show_table_action));
+
+  /* paste */
+  self->paste = texty_paste_new (self->text_view);
+  g_signal_connect_object (self->paste,
+                           "progress",
+                           G_CALLBACK (on_paste_progress),
+                           self,
+                           0);
+  g_signal_connect_object (self->paste,
+                           "finished",
+                           G_CALLBACK (on_paste_finished),
+                           self,
+                           0);
+  g_signal_connect (self->paste_banner,
+                    "button-clicked",
+                    G_CALLBACK (on_paste_cancel_clicked),
+                    self);
+  g_signal_connect (self->text_view,
+                    "paste-clipboard",
+                    G_CALLBACK (on_paste_clipboard),
+                    self);
+  g_signal_connect (self->text_view,
+                    "copy-clipboard",
+                    G_CALLBACK (on_copy_clipboard),
+                    self);
+  g_signal_connect (self->text_view,
+                    "cut-clipboard",
+                    G_CALLBACK (on_cut_clipboard),
+                    self);
+
   /* init window-size */
   load_window_size (self);
 
+  /* swap this view's selection in and out of the shared buffer */
+  g_signal_connect (self, "notify::is-active", G_CALLBACK (on_is_active_changed), NULL);
+
   /* Listen for window close and prompt if modified */
   g_signal_connect (self, "close-request", G_CALLBACK (on_close_request), NULL);
 }
@@ -28,4 +28,7 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (TextyWindow, texty_window, TEXTY, WINDOW, AdwApplicationWindow)
 
+gsize texty_window_reclaim_memory (TextyWindow                *self,
+                                   GMemoryMonitorWarningLevel  level);
+
 G_END_DECLS
@@ -0,0 +1,513 @@
+/* texty-word-index.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "texty-word-index.h"
+
+#include <string.h>
+
+/* in bytes; shorter words are not worth completing */
+#define MIN_WORD 3
+/* longer runs are hashes, base64 and the like */
+#define MAX_WORD 64
+/* text beyond this many bytes is counted in a worker thread */
+#define ASYNC_THRESHOLD (256 * 1024)
+
+/* a count and its word in one allocation, the word doubling as the key */
+typedef struct
+{
+  int count;
+  char word[];
+} Word;
+
+struct _TextyWordIndex
+{
+  GObject parent_instance;
+
+  /* the words of every watched buffer, sorted so a prefix is a range */
+  GTree *words;
+};
+
+G_DEFINE_FINAL_TYPE (TextyWordIndex, texty_word_index, G_TYPE_OBJECT)
+
+typedef struct
+{
+  TextyWordIndex *index;
+  /* this buffer's share of the index */
+  GHashTable *counts;
+  /* where the text being inserted starts */
+  int insert_offset;
+  /* cancelled when the buffer's share is dropped wholesale */
+  GCancellable *cancellable;
+} BufferWords;
+
+static Word *
+word_new (const char *text,
+          gsize length)
+{
+  Word *word = g_malloc (sizeof (Word) + length + 1);
+
+  word->count = 0;
+  memcpy (word->word, text, length);
+  word->word[length] = '\0';
+
+  return word;
+}
+
+static int
+compare_words (gconstpointer a,
+               gconstpointer b,
+               gpointer user_data)
+{
+  return strcmp (a, b);
+}
+
+static inline gboolean
+is_word_char (gunichar c)
+{
+  return c == '_' || g_unichar_isalnum (c);
+}
+
+static inline gboolean
+is_word_at (const char *p)
+{
+  guchar c = *p;
+
+  if (c < 0x80)
+    return c == '_' || g_ascii_isalnum (c);
+  return g_unichar_isalnum (g_utf8_get_char (p));
+}
+
+/* the words of 'text', as a table of Word */
+static GHashTable *
+count_words (const char *text,
+             gsize length)
+{
+  GHashTable *counts = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+  const char *end = text + length;
+  const char *p = text;
+  char key[MAX_WORD + 1];
+
+  while (p < end)
+    {
+      const char *start;
+      Word *word;
+
+      while (p < end && !is_word_at (p))
+        p = g_utf8_next_char (p);
+      start = p;
+      while (p < end && is_word_at (p))
+        p = g_utf8_next_char (p);
+
+      if (p - start < MIN_WORD || p - start > MAX_WORD)
+        continue;
+
+      memcpy (key, start, p - start);
+      key[p - start] = '\0';
+      word = g_hash_table_lookup (counts, key);
+      if (word == NULL)
+        {
+          word = word_new (start, p - start);
+          g_hash_table_insert (counts, word->word, word);
+        }
+      word->count++;
+    }
+
+  return counts;
+}
+
+/*
+ * Adds 'delta' to the count of 'word' in the index. Counts may go below
+ * zero for a while, when text is removed before a worker has finished
+ * counting it in, so a word is only dropped once it is back at zero.
+ */
+static void
+adjust_index (TextyWordIndex *self,
+              const char *text,
+              int delta)
+{
+  Word *word = g_tree_lookup (self->words, text);
+
+  if (word == NULL)
+    {
+      word = word_new (text, strlen (text));
+      g_tree_insert (self->words, word->word, word);
+    }
+
+  word->count += delta;
+  if (word->count == 0)
+    g_tree_remove (self->words, text);
+}
+
+static void
+apply_counts (BufferWords *words,
+              GHashTable *counts,
+              int sign)
+{
+  GHashTableIter iter;
+  Word *change;
+
+  g_hash_table_iter_init (&iter, counts);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &change))
+    {
+      int delta = sign * change->count;
+      Word *word = g_hash_table_lookup (words->counts, change->word);
+
+      if (word == NULL)
+        {
+          word = word_new (change->word, strlen (change->word));
+          g_hash_table_insert (words->counts, word->word, word);
+        }
+      word->count += delta;
+      if (word->count == 0)
+        g_hash_table_remove (words->counts, change->word);
+
+      adjust_index (words->index, change->word, delta);
+    }
+}
+
+/* takes the buffer's whole share out of the index, without looking at its text */
+static void
+forget_words (BufferWords *words)
+{
+  GHashTableIter iter;
+  Word *word;
+
+  g_cancellable_cancel (words->cancellable);
+  g_clear_object (&words->cancellable);
+  words->cancellable = g_cancellable_new ();
+
+  g_hash_table_iter_init (&iter, words->counts);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &word))
+    adjust_index (words->index, word->word, -word->count);
+  g_hash_table_remove_all (words->counts);
+}
+
+static void
+buffer_words_free (BufferWords *words)
+{
+  forget_words (words);
+  g_clear_object (&words->cancellable);
+  g_hash_table_unref (words->counts);
+  g_object_unref (words->index);
+  g_free (words);
+}
+
+/**********************************/
+/* Counting 👆️                    */
+/**********************************/
+
+typedef struct
+{
+  char *text;
+  gsize length;
+  int sign;
+} CountData;
+
+static void
+count_data_free (CountData *data)
+{
+  g_free (data->text);
+  g_free (data);
+}
+
+static void
+count_thread (GTask *task,
+              gpointer source_object,
+              gpointer task_data,
+              GCancellable *cancellable)
+{
+  CountData *data = task_data;
+
+  g_task_return_pointer (task,
+                         count_words (data->text, data->length),
+                         (GDestroyNotify) g_hash_table_unref);
+}
+
+static void
+count_complete (GObject *source_object,
+                GAsyncResult *result,
+                gpointer user_data)
+{
+  BufferWords *words = user_data;
+  CountData *data = g_task_get_task_data (G_TASK (result));
+  g_autoptr (GHashTable) counts = NULL;
+
+  /* the cancellable outlives 'words', and is cancelled when it goes */
+  if (g_cancellable_is_cancelled (g_task_get_cancellable (G_TASK (result))))
+    return;
+
+  counts = g_task_propagate_pointer (G_TASK (result), NULL);
+  if (counts != NULL)
+    apply_counts (words, counts, data->sign);
+}
+
+/*
+ * Counts the words between 'start' and 'end' in or out of the index. Large
+ * stretches, like a file being loaded, are counted from a copy in a worker
+ * thread so they don't hold up the edit; every change is a delta, so it
+ * does not matter that edits may be counted before them.
+ */
+static void
+count_range (BufferWords *words,
+             const GtkTextIter *start,
+             const GtkTextIter *end,
+             int sign)
+{
+  g_autoptr (GHashTable) counts = NULL;
+  g_autofree char *text = NULL;
+  gsize length;
+
+  if (gtk_text_iter_equal (start, end))
+    return;
+
+  text = gtk_text_iter_get_slice (start, end);
+  length = strlen (text);
+
+  if (length >= ASYNC_THRESHOLD)
+    {
+      g_autoptr (GTask) task = NULL;
+      CountData *data = g_new0 (CountData, 1);
+
+      data->text = g_steal_pointer (&text);
+      data->length = length;
+      data->sign = sign;
+
+      task = g_task_new (NULL, words->cancellable, count_complete, words);
+      g_task_set_source_tag (task, count_range);
+      g_task_set_task_data (task, data, (GDestroyNotify) count_data_free);
+      g_task_run_in_thread (task, count_thread);
+      return;
+    }
+
+  counts = count_words (text, length);
+  apply_counts (words, counts, sign);
+}
+
+/*
+ * Moves 'start' back and 'end' forward to the edges of the words they are
+ * in, giving up past MAX_WORD characters as such a run is no word anyway.
+ */
+static void
+extend_to_words (GtkTextIter *start,
+                 GtkTextIter *end)
+{
+  for (int i = 0; i <= MAX_WORD && !gtk_text_iter_is_start (start); i++)
+    {
+      GtkTextIter previous = *start;
+
+      gtk_text_iter_backward_char (&previous);
+      if (!is_word_char (gtk_text_iter_get_char (&previous)))
+        break;
+      *start = previous;
+    }
+
+  for (int i = 0; i <= MAX_WORD && is_word_char (gtk_text_iter_get_char (end)); i++)
+    gtk_text_iter_forward_char (end);
+}
+
+/*
+ * Every edit replaces the words it touches: they are counted out before
+ * the edit, and the words in the same stretch counted back in after it.
+ */
+static void
+on_insert_text (GtkTextBuffer *buffer,
+                GtkTextIter *location,
+                const char *text,
+                int length,
+                BufferWords *words)
+{
+  GtkTextIter start = *location;
+  GtkTextIter end = *location;
+
+  words->insert_offset = gtk_text_iter_get_offset (location);
+  extend_to_words (&start, &end);
+  count_range (words, &start, &end, -1);
+}
+
+static void
+after_insert_text (GtkTextBuffer *buffer,
+                   GtkTextIter *location,
+                   const char *text,
+                   int length,
+                   BufferWords *words)
+{
+  GtkTextIter start;
+  GtkTextIter end = *location;
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, words->insert_offset);
+  extend_to_words (&start, &end);
+  count_range (words, &start, &end, 1);
+}
+
+static void
+on_delete_range (GtkTextBuffer *buffer,
+                 GtkTextIter *start,
+                 GtkTextIter *end,
+                 BufferWords *words)
+{
+  GtkTextIter word_start = *start;
+  GtkTextIter word_end = *end;
+
+  /* clearing the buffer, as reloading does, needs no counting */
+  if (gtk_text_iter_is_start (start) && gtk_text_iter_is_end (end))
+    {
+      forget_words (words);
+      return;
+    }
+
+  extend_to_words (&word_start, &word_end);
+  count_range (words, &word_start, &word_end, -1);
+}
+
+static void
+after_delete_range (GtkTextBuffer *buffer,
+                    GtkTextIter *start,
+                    GtkTextIter *end,
+                    BufferWords *words)
+{
+  GtkTextIter word_start = *start;
+  GtkTextIter word_end = *start;
+
+  extend_to_words (&word_start, &word_end);
+  count_range (words, &word_start, &word_end, 1);
+}
+
+/**********************************/
+/* Tracking 👆️                    */
+/**********************************/
+
+static void
+texty_word_index_finalize (GObject *object)
+{
+  TextyWordIndex *self = TEXTY_WORD_INDEX (object);
+
+  g_tree_unref (self->words);
+
+  G_OBJECT_CLASS (texty_word_index_parent_class)->finalize (object);
+}
+
+static void
+texty_word_index_class_init (TextyWordIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = texty_word_index_finalize;
+}
+
+static void
+texty_word_index_init (TextyWordIndex *self)
+{
+  self->words = g_tree_new_full (compare_words, NULL, NULL, g_free);
+}
+
+/* the index shared by every window, so completions come from all open documents */
+TextyWordIndex *
+texty_word_index_get_default (void)
+{
+  static TextyWordIndex *index;
+
+  if (index == NULL)
+    index = g_object_new (TEXTY_TYPE_WORD_INDEX, NULL);
+
+  return index;
+}
+
+/*
+ * Adds the words of 'buffer' to the index and keeps them up to date from
+ * each edit, never by reading the buffer again. They leave the index along
+ * with the buffer. Watching a buffer twice is harmless.
+ */
+void
+texty_word_index_watch (TextyWordIndex *self,
+                        GtkTextBuffer *buffer)
+{
+  BufferWords *words;
+  GtkTextIter start;
+  GtkTextIter end;
+
+  g_return_if_fail (TEXTY_IS_WORD_INDEX (self));
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+
+  if (g_object_get_data (G_OBJECT (buffer), "words") != NULL)
+    return;
+
+  words = g_new0 (BufferWords, 1);
+  words->index = g_object_ref (self);
+  words->counts = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+  words->cancellable = g_cancellable_new ();
+  g_object_set_data_full (G_OBJECT (buffer), "words", words, (GDestroyNotify) buffer_words_free);
+
+  g_signal_connect (buffer, "insert-text", G_CALLBACK (on_insert_text), words);
+  g_signal_connect_after (buffer, "insert-text", G_CALLBACK (after_insert_text), words);
+  g_signal_connect (buffer, "delete-range", G_CALLBACK (on_delete_range), words);
+  g_signal_connect_after (buffer, "delete-range", G_CALLBACK (after_delete_range), words);
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  count_range (words, &start, &end, 1);
+}
+
+/*
+ * Returns up to 'max_results' words starting with 'prefix', the most
+ * frequent first. Only the words in the prefix's range of the tree are
+ * looked at, so this stays quick however large the documents are.
+ */
+char **
+texty_word_index_complete (TextyWordIndex *self,
+                           const char *prefix,
+                           guint max_results)
+{
+  g_autoptr (GStrvBuilder) builder = g_strv_builder_new ();
+  g_autofree Word **best = NULL;
+  GTreeNode *node;
+  gsize length;
+  guint n_best = 0;
+
+  g_return_val_if_fail (TEXTY_IS_WORD_INDEX (self), NULL);
+  g_return_val_if_fail (prefix != NULL, NULL);
+
+  length = strlen (prefix);
+  best = g_new (Word *, max_results + 1);
+
+  for (node = g_tree_lower_bound (self->words, prefix);
+       node != NULL;
+       node = g_tree_node_next (node))
+    {
+      Word *word = g_tree_node_value (node);
+      guint i;
+
+      if (strncmp (word->word, prefix, length) != 0)
+        break;
+      /* the word being typed is in the index too */
+      if (word->count <= 0 || word->word[length] == '\0')
+        continue;
+
+      /* insertion into the short list; ties stay in alphabetical order */
+      for (i = n_best; i > 0 && best[i - 1]->count < word->count; i--)
+        best[i] = best[i - 1];
+      best[i] = word;
+      n_best = MIN (n_best + 1, max_results);
+    }
+
+  for (guint i = 0; i < n_best; i++)
+    g_strv_builder_add (builder, best[i]->word);
+
+  return g_strv_builder_end (builder);
+}
@@ -0,0 +1,80 @@
+/* test-batch.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "texty-batch.h"
+
+static void
+assert_file_contents (const char *path,
+                      const char *expected)
+{
+  g_autoptr (GError) error = NULL;
+  g_autofree char *contents = NULL;
+  gsize length;
+
+  g_file_get_contents (path, &contents, &length, &error);
+  g_assert_no_error (error);
+  g_assert_cmpmem (contents, length, expected, strlen (expected));
+}
+
+/* re-encoding streams the file back into itself */
+static void
+test_reencode (void)
+{
+  g_autoptr (GError) error = NULL;
+  g_autofree char *dir = NULL;
+  g_autofree char *path = NULL;
+  TextyBatchOptions to_latin1 = { .to_encoding = "ISO-8859-1" };
+  TextyBatchOptions to_utf8 = { .from_encoding = "ISO-8859-1", .line_endings = "crlf" };
+  char *files[2] = { NULL, NULL };
+
+  dir = g_dir_make_tmp ("texty-test-XXXXXX", &error);
+  g_assert_no_error (error);
+  path = g_build_filename (dir, "text.txt", NULL);
+  g_file_set_contents (path, "café\nnaïve\n", -1, &error);
+  g_assert_no_error (error);
+  files[0] = path;
+
+  g_assert_cmpint (texty_batch_run (&to_latin1, files), ==, EXIT_SUCCESS);
+  assert_file_contents (path, "caf\xe9\nna\xefve\n");
+
+  g_assert_cmpint (texty_batch_run (&to_utf8, files), ==, EXIT_SUCCESS);
+  assert_file_contents (path, "café\r\nnaïve\r\n");
+
+  g_unlink (path);
+  g_rmdir (dir);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/batch/reencode", test_reencode);
+
+  return g_test_run ();
+}
@@ -0,0 +1,157 @@
+/* test-file-loader.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "texty-file-loader.h"
+#include "texty-file-saver.h"
+
+/* enough lines that decompressing takes many calls of the converter */
+static GBytes *
+create_text (void)
+{
+  GString *text = g_string_new (NULL);
+
+  for (guint i = 0; i < 100000; i++)
+    g_string_append_printf (text, "line %u of the text, café\n", i);
+
+  return g_string_free_to_bytes (text);
+}
+
+/* saving compressed and loading back gives the same text and compression */
+static void
+test_compressed (gconstpointer data)
+{
+  TextyCompression compression = GPOINTER_TO_INT (data);
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GFile) file = NULL;
+  g_autoptr (GBytes) text = create_text ();
+  g_autoptr (GBytes) loaded = NULL;
+  g_autofree char *dir = NULL;
+  g_autofree char *path = NULL;
+  TextyCompression found;
+  gboolean truncated = TRUE;
+
+#ifndef HAVE_ZSTD
+  if (compression == TEXTY_COMPRESSION_ZSTD)
+    {
+      g_test_skip ("Built without zstd");
+      return;
+    }
+#endif
+
+  dir = g_dir_make_tmp ("texty-test-XXXXXX", &error);
+  g_assert_no_error (error);
+  path = g_build_filename (dir, compression == TEXTY_COMPRESSION_ZSTD ? "text.zst" : "text.gz", NULL);
+  file = g_file_new_for_path (path);
+
+  texty_file_save (file, text, TEXTY_LINE_ENDING_LF, compression, NULL, 0, NULL, &error);
+  g_assert_no_error (error);
+
+  loaded = texty_file_load (file, G_MAXSIZE, &found, &truncated, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (loaded);
+  g_assert_cmpint (found, ==, compression);
+  g_assert_false (truncated);
+  g_assert_true (g_bytes_equal (loaded, text));
+
+  g_unlink (path);
+  g_rmdir (dir);
+}
+
+/* the ASCII runs skipped ahead must stop at whatever is not plain text */
+static void
+test_validate_utf8 (void)
+{
+  static const struct
+  {
+    const char *text;
+    gsize length;
+    gboolean valid;
+    gsize valid_length;
+  } cases[] = {
+    { "", 0, TRUE, 0 },
+    { "plain ascii text, longer than a word", 36, TRUE, 36 },
+    { "twelve bytes café", 18, TRUE, 18 },
+    { "sixteen bytes..\0 and more", 26, FALSE, 15 },
+    { "sixteen bytes..\xff", 16, FALSE, 15 },
+    { "cut in a sequence \xc3", 19, FALSE, 18 },
+    { "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e", 9, TRUE, 9 },
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (cases); i++)
+    {
+      g_autoptr (GBytes) bytes = g_bytes_new_static (cases[i].text, cases[i].length);
+      gsize valid_length = 0;
+
+      g_assert_cmpint (texty_file_validate_utf8 (bytes, &valid_length), ==, cases[i].valid);
+      g_assert_cmpuint (valid_length, ==, cases[i].valid_length);
+    }
+}
+
+/* a preview of one long line is cut between characters, not inside one */
+static void
+test_preview_long_line (void)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GFile) file = NULL;
+  g_autoptr (GString) text = g_string_new (NULL);
+  g_autoptr (GBytes) loaded = NULL;
+  g_autofree char *dir = NULL;
+  g_autofree char *path = NULL;
+  gboolean truncated = FALSE;
+
+  for (guint i = 0; i < 1000; i++)
+    g_string_append (text, "日");
+
+  dir = g_dir_make_tmp ("texty-test-XXXXXX", &error);
+  g_assert_no_error (error);
+  path = g_build_filename (dir, "line.txt", NULL);
+  g_file_set_contents (path, text->str, text->len, &error);
+  g_assert_no_error (error);
+  file = g_file_new_for_path (path);
+
+  /* halves of 50 bytes end two bytes into a character */
+  loaded = texty_file_load (file, 100, NULL, &truncated, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (truncated);
+  g_assert_true (texty_file_validate_utf8 (loaded, NULL));
+  g_assert_true (g_str_has_prefix (g_bytes_get_data (loaded, NULL), "日日日"));
+
+  g_unlink (path);
+  g_rmdir (dir);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_data_func ("/file-loader/gzip", GINT_TO_POINTER (TEXTY_COMPRESSION_GZIP), test_compressed);
+  g_test_add_data_func ("/file-loader/zstd", GINT_TO_POINTER (TEXTY_COMPRESSION_ZSTD), test_compressed);
+  g_test_add_func ("/file-loader/validate-utf8", test_validate_utf8);
+  g_test_add_func ("/file-loader/preview-long-line", test_preview_long_line);
+
+  return g_test_run ();
+}
@@ -0,0 +1,166 @@
+/* test-folding.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+#include <string.h>
+
+#include "texty-folding.h"
+#include "texty-line-ops.h"
+#include "test-util.h"
+
+static const char *source =
+  "int\n"
+  "main (void)\n"
+  "{\n"
+  "  if (argc > 1)\n"
+  "    {\n"
+  "      puts (argv[1]);\n"
+  "    }\n"
+  "  return 0;\n"
+  "}\n";
+
+static GtkTextBuffer *
+create_buffer (const char *text,
+               TextyFolding **folding)
+{
+  GtkTextBuffer *buffer = gtk_text_buffer_new (NULL);
+
+  gtk_text_buffer_set_text (buffer, text, -1);
+  /* owned by the buffer, as in the window */
+  *folding = texty_folding_new (buffer);
+  g_object_set_data_full (G_OBJECT (buffer), "folding", *folding, g_object_unref);
+
+  return buffer;
+}
+
+/* saving, line operations and the rest take the folded lines along */
+static void
+test_document_keeps_folds (void)
+{
+  g_autoptr (GtkTextBuffer) buffer = NULL;
+  g_autoptr (GBytes) document = NULL;
+  g_autoptr (GBytes) reversed = NULL;
+  g_autoptr (GBytes) restored = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree char *visible = NULL;
+  TextyFolding *folding;
+  GtkTextIter start;
+  GtkTextIter end;
+
+  buffer = create_buffer (source, &folding);
+  g_assert_true (texty_folding_toggle (folding, 2));
+
+  /* the fold does hide the block from the view */
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  visible = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+  g_assert_null (strstr (visible, "puts"));
+
+  document = texty_folding_get_document (buffer);
+  g_assert_cmpmem (g_bytes_get_data (document, NULL), g_bytes_get_size (document),
+                   source, strlen (source));
+
+  reversed = texty_line_ops_run (document, TEXTY_LINE_OP_REVERSE, NULL, NULL, &error);
+  g_assert_no_error (error);
+  restored = texty_line_ops_run (reversed, TEXTY_LINE_OP_REVERSE, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpmem (g_bytes_get_data (restored, NULL), g_bytes_get_size (restored),
+                   source, strlen (source));
+}
+
+/* lines that open and close every kind of region, and pieces of them */
+static const char * const pieces[] = {
+  "\n", "\n", "  \n", "{\n", "}\n", "[", "]\n", "x\n", "  x\n", "    x\n",
+  "\tx\n", "# a\n", "## b\n", "if (x) {\n", "} else {\n", "\"{\"", "\\{", "{", "}",
+};
+
+static char *
+get_visible_text (GtkTextBuffer *buffer)
+{
+  GtkTextIter start;
+  GtkTextIter end;
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  return gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+}
+
+/*
+ * Random edits, each followed by the rescan from the edited line, have to
+ * leave the same folds as scanning the resulting text from scratch.
+ */
+static void
+test_random_edits (gconstpointer data)
+{
+  gboolean markdown = GPOINTER_TO_INT (data);
+  g_autoptr (GtkTextBuffer) buffer = NULL;
+  TextyFolding *folding;
+  guint n_edits = g_test_thorough () ? 5000 : 500;
+
+  buffer = create_buffer ("", &folding);
+  texty_folding_set_markdown (folding, markdown);
+
+  for (guint i = 0; i < n_edits; i++)
+    {
+      g_autoptr (GtkTextBuffer) expected = NULL;
+      g_autofree char *document = NULL;
+      g_autofree char *visible = NULL;
+      g_autofree char *expected_visible = NULL;
+      TextyFolding *expected_folding;
+      GtkTextIter start;
+      GtkTextIter end;
+      int line;
+
+      texty_test_random_edit (buffer, pieces, G_N_ELEMENTS (pieces));
+      /* leave several edits pending between scans now and then */
+      if (g_test_rand_int_range (0, 4) != 0)
+        continue;
+
+      gtk_text_buffer_get_bounds (buffer, &start, &end);
+      document = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+      expected = create_buffer (document, &expected_folding);
+      texty_folding_set_markdown (expected_folding, markdown);
+
+      line = g_test_rand_int_range (0, gtk_text_buffer_get_line_count (buffer));
+      g_assert_cmpint (texty_folding_toggle (folding, line), ==,
+                       texty_folding_toggle (expected_folding, line));
+
+      visible = get_visible_text (buffer);
+      expected_visible = get_visible_text (expected);
+      if (g_strcmp0 (visible, expected_visible) != 0)
+        g_test_message ("Folding line %d of:\n%s", line, document);
+      g_assert_cmpstr (visible, ==, expected_visible);
+
+      texty_folding_unfold_all (folding);
+    }
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/folding/document-keeps-folds", test_document_keeps_folds);
+  g_test_add_data_func ("/folding/random-edits", GINT_TO_POINTER (FALSE), test_random_edits);
+  g_test_add_data_func ("/folding/random-edits-markdown", GINT_TO_POINTER (TRUE), test_random_edits);
+
+  return g_test_run ();
+}
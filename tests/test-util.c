@@ -0,0 +1,50 @@
+/* test-util.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "test-util.h"
+
+/*
+ * Deletes a few characters somewhere in 'buffer', or inserts one of
+ * 'pieces' somewhere, from GTest's generator so --seed replays a failure.
+ * A test checks the state it keeps from edits against a fresh start.
+ */
+void
+texty_test_random_edit (GtkTextBuffer *buffer,
+                        const char * const *pieces,
+                        guint n_pieces)
+{
+  GtkTextIter start;
+  GtkTextIter end;
+  int n_chars = gtk_text_buffer_get_char_count (buffer);
+  int offset = g_test_rand_int_range (0, n_chars + 1);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, offset);
+  if (n_chars > 0 && g_test_rand_int_range (0, 3) == 0)
+    {
+      end = start;
+      gtk_text_iter_forward_chars (&end, g_test_rand_int_range (1, 8));
+      gtk_text_buffer_delete (buffer, &start, &end);
+    }
+  else
+    {
+      gtk_text_buffer_insert (buffer, &start, pieces[g_test_rand_int_range (0, n_pieces)], -1);
+    }
+}
@@ -0,0 +1,105 @@
+/* test-word-index.c
+ *
+ * Copyright 2024 Craig Foote
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+
+#include "texty-word-index.h"
+#include "test-util.h"
+
+/* words that merge, split and shrink below the minimum as they are edited */
+static const char * const pieces[] = {
+  "a", "ab", "abc", "abcd", "word", "words", "_id", "x1", "café", "naïve",
+  " ", "  ", "\n", ".", "(", ")", "->", "é",
+};
+
+/*
+ * The counts kept up to date from the edits alone have to match counting
+ * the resulting text from scratch, down to the order of the completions.
+ */
+static void
+test_random_edits (void)
+{
+  g_autoptr (TextyWordIndex) index = g_object_new (TEXTY_TYPE_WORD_INDEX, NULL);
+  g_autoptr (GtkTextBuffer) buffer = gtk_text_buffer_new (NULL);
+  guint n_edits = g_test_thorough () ? 20000 : 2000;
+
+  texty_word_index_watch (index, buffer);
+
+  for (guint i = 0; i < n_edits; i++)
+    {
+      g_autoptr (TextyWordIndex) expected_index = NULL;
+      g_autoptr (GtkTextBuffer) expected = NULL;
+      g_auto (GStrv) words = NULL;
+      g_auto (GStrv) expected_words = NULL;
+      g_autofree char *text = NULL;
+      GtkTextIter start;
+      GtkTextIter end;
+
+      texty_test_random_edit (buffer, pieces, G_N_ELEMENTS (pieces));
+      if (g_test_rand_int_range (0, 8) != 0)
+        continue;
+
+      gtk_text_buffer_get_bounds (buffer, &start, &end);
+      text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+      expected = gtk_text_buffer_new (NULL);
+      gtk_text_buffer_set_text (expected, text, -1);
+      expected_index = g_object_new (TEXTY_TYPE_WORD_INDEX, NULL);
+      texty_word_index_watch (expected_index, expected);
+
+      words = texty_word_index_complete (index, "", G_MAXUINT16);
+      expected_words = texty_word_index_complete (expected_index, "", G_MAXUINT16);
+      if (!g_strv_equal ((const char * const *) words, (const char * const *) expected_words))
+        g_test_message ("Words of:\n%s", text);
+      g_assert_cmpstrv (words, expected_words);
+    }
+}
+
+/* the whole buffer going, as reloading does, takes all of its words along */
+static void
+test_clear (void)
+{
+  g_autoptr (TextyWordIndex) index = g_object_new (TEXTY_TYPE_WORD_INDEX, NULL);
+  g_autoptr (GtkTextBuffer) buffer = gtk_text_buffer_new (NULL);
+  g_auto (GStrv) words = NULL;
+
+  texty_word_index_watch (index, buffer);
+  gtk_text_buffer_set_text (buffer, "some words, some more words", -1);
+  words = texty_word_index_complete (index, "wo", 10);
+  g_assert_cmpstrv (words, ((const char *[]) { "words", NULL }));
+  g_clear_pointer (&words, g_strfreev);
+
+  gtk_text_buffer_set_text (buffer, "", -1);
+  words = texty_word_index_complete (index, "", 10);
+  g_assert_cmpstrv (words, ((const char *[]) { NULL }));
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/word-index/random-edits", test_random_edits);
+  g_test_add_func ("/word-index/clear", test_clear);
+
+  return g_test_run ();
+}